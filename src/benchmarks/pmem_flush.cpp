@@ -32,9 +32,13 @@
 
 /*
  * pmem_flush.cpp -- benchmark implementation for pmem_persist and pmem_msync
+ *
+ * The pmem_flush_latency benchmark runs the same operations and additionally
+ * reports the latency distribution of a single operation.
  */
 #include <cassert>
 #include <cerrno>
+#include <cinttypes>
 #include <climits>
 #include <cstdio>
 #include <cstdlib>
@@ -50,6 +54,15 @@
 #define PAGE_4K ((uintptr_t)1 << 12)
 #define PAGE_2M ((uintptr_t)1 << 21)
 
+/*
+ * Latency histogram layout -- values below HIST_SUB are counted exactly,
+ * every further power of two is split into HIST_SUB linear sub-buckets,
+ * which gives a relative precision of 1 / HIST_SUB.
+ */
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1U << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
 /*
  * align_addr -- round addr down to given boundary
  */
@@ -85,6 +98,7 @@ struct pmem_args {
 	char *operation; /* msync, dummy_msync, persist, ... */
 	char *mode;      /* stat, seq, rand */
 	bool no_warmup;  /* don't do warmup */
+	size_t offset;   /* offset of the range from the chunk boundary */
 };
 
 /*
@@ -100,6 +114,8 @@ struct pmem_bench {
 	void *pmem_addr; /* PMEM base address */
 	size_t pmem_len; /* length of PMEM mapping */
 
+	void *src; /* source buffer for memcpy operations */
+
 	void *invalid_addr;  /* invalid pages */
 	void *nondirty_addr; /* non-dirty pages */
 
@@ -215,6 +231,48 @@ flush_persist_2M(struct pmem_bench *pmb, void *addr, size_t len)
 	return 0;
 }
 
+/*
+ * flush_flush_drain -- flush data using pmem_flush() and pmem_drain()
+ */
+static int
+flush_flush_drain(struct pmem_bench *pmb, void *addr, size_t len)
+{
+	pmem_flush(addr, len);
+	pmem_drain();
+	return 0;
+}
+
+/*
+ * flush_memcpy_t -- store data using temporal stores followed by a flush
+ */
+static int
+flush_memcpy_t(struct pmem_bench *pmb, void *addr, size_t len)
+{
+	pmem_memcpy(addr, pmb->src, len, PMEM_F_MEM_TEMPORAL);
+	return 0;
+}
+
+/*
+ * flush_memcpy_nt -- store data using non-temporal stores
+ */
+static int
+flush_memcpy_nt(struct pmem_bench *pmb, void *addr, size_t len)
+{
+	pmem_memcpy(addr, pmb->src, len, PMEM_F_MEM_NONTEMPORAL);
+	return 0;
+}
+
+/*
+ * flush_memcpy_libc -- store data using libc memcpy() and pmem_persist()
+ */
+static int
+flush_memcpy_libc(struct pmem_bench *pmb, void *addr, size_t len)
+{
+	memcpy(addr, pmb->src, len);
+	pmem_persist(addr, len);
+	return 0;
+}
+
 /*
  * flush_msync -- flush data to persistence using pmem_msync()
  */
@@ -338,6 +396,10 @@ static struct op ops[] = {
 	{"persist", flush_persist},
 	{"persist_4K", flush_persist_4K},
 	{"persist_2M", flush_persist_2M},
+	{"flush_drain", flush_flush_drain},
+	{"memcpy_t", flush_memcpy_t},
+	{"memcpy_nt", flush_memcpy_nt},
+	{"memcpy_libc", flush_memcpy_libc},
 	{"msync", flush_msync},
 	{"msync_0", flush_msync_0},
 	{"msync_err", flush_msync_err},
@@ -414,6 +476,13 @@ pmem_flush_init(struct benchmark *bench, struct benchmark_args *args)
 	for (size_t i = 0; i < pmb->n_offsets; ++i)
 		pmb->offsets[i] = func_mode(pmb, i);
 
+	pmb->src = malloc(args->dsize);
+	if (pmb->src == nullptr) {
+		perror("malloc");
+		goto err_free_offsets;
+	}
+	memset(pmb->src, 0xc5, args->dsize);
+
 	if (!util_file_is_device_dax(args->fname)) {
 		file_size = pmb->fsize;
 		flags = PMEM_FILE_CREATE | PMEM_FILE_EXCL;
@@ -425,7 +494,7 @@ pmem_flush_init(struct benchmark *bench, struct benchmark_args *args)
 
 	if (pmb->pmem_addr == nullptr) {
 		perror("pmem_map_file");
-		goto err_free_pmb;
+		goto err_free_src;
 	}
 
 	pmb->nondirty_addr = mmap(nullptr, pmb->fsize, PROT_READ | PROT_WRITE,
@@ -473,6 +542,10 @@ err_unmap2:
 	munmap(pmb->nondirty_addr, pmb->fsize);
 err_unmap1:
 	pmem_unmap(pmb->pmem_addr, pmb->pmem_len);
+err_free_src:
+	free(pmb->src);
+err_free_offsets:
+	free(pmb->offsets);
 err_free_pmb:
 	free(pmb);
 
@@ -488,6 +561,8 @@ pmem_flush_exit(struct benchmark *bench, struct benchmark_args *args)
 	auto *pmb = (struct pmem_bench *)pmembench_get_priv(bench);
 	pmem_unmap(pmb->pmem_addr, pmb->fsize);
 	munmap(pmb->nondirty_addr, pmb->fsize);
+	free(pmb->src);
+	free(pmb->offsets);
 	free(pmb);
 	return 0;
 }
@@ -504,8 +579,8 @@ pmem_flush_operation(struct benchmark *bench, struct operation_info *info)
 	assert(op_idx < pmb->n_offsets);
 
 	uint64_t chunk_idx = pmb->offsets[op_idx];
-	void *addr =
-		(char *)pmb->pmem_addr_aligned + chunk_idx * info->args->dsize;
+	void *addr = (char *)pmb->pmem_addr_aligned +
+		chunk_idx * info->args->dsize + pmb->pargs->offset;
 
 	/* store + flush */
 	*(int *)addr = *(int *)addr + 1;
@@ -513,10 +588,150 @@ pmem_flush_operation(struct benchmark *bench, struct operation_info *info)
 	return 0;
 }
 
+/*
+ * hist_bucket -- returns index of the histogram bucket for given latency
+ */
+static unsigned
+hist_bucket(uint64_t nsecs)
+{
+	if (nsecs < HIST_SUB)
+		return (unsigned)nsecs;
+
+	unsigned shift = util_mssb_index64(nsecs) - HIST_SUB_BITS;
+	return shift * HIST_SUB + (unsigned)(nsecs >> shift);
+}
+
+/*
+ * hist_bucket_min -- returns the lowest latency counted in given bucket
+ */
+static uint64_t
+hist_bucket_min(unsigned bucket)
+{
+	if (bucket < 2 * HIST_SUB)
+		return bucket;
+
+	unsigned shift = bucket / HIST_SUB - 1;
+	return (uint64_t)(bucket % HIST_SUB + HIST_SUB) << shift;
+}
+
+/*
+ * compare_uint64 -- comparing function used for sorting latencies
+ */
+static int
+compare_uint64(const void *a1, const void *b1)
+{
+	const auto *a = (const uint64_t *)a1;
+	const auto *b = (const uint64_t *)b1;
+	return (*a > *b) - (*a < *b);
+}
+
+/*
+ * flush_env -- environment variables which select the libpmem flush and
+ * memcpy implementation, printed along with the results so that runs with
+ * different variants can be told apart
+ */
+static const char *flush_env[] = {
+	"PMEM_NO_CLWB",
+	"PMEM_NO_CLFLUSHOPT",
+	"PMEM_NO_FLUSH",
+	"PMEM_NO_MOVNT",
+	"PMEM_MOVNT_THRESHOLD",
+	"PMEM_NO_GENERIC_MEMCPY",
+	"PMEM_AVX",
+	"PMEM_AVX512F",
+	"PMEM_NO_CVAP",
+};
+
+/*
+ * pmem_flush_latency_print_extra_headers -- print headers of latency
+ * distribution columns
+ */
+static void
+pmem_flush_latency_print_extra_headers()
+{
+	printf(";latency-pctl-99.99%%[nsec]"
+	       ";latency-histogram[nsec:count]"
+	       ";pmem-env");
+}
+
+/*
+ * pmem_flush_latency_print_extra_values -- print the latency distribution
+ *
+ * The histogram is printed as a comma separated list of "min:count" pairs,
+ * where min is the lowest latency counted in the bucket. Empty buckets are
+ * omitted.
+ */
+static void
+pmem_flush_latency_print_extra_values(struct benchmark *bench,
+				      struct benchmark_args *args,
+				      struct total_results *res)
+{
+	size_t count = res->nrepeats * res->nthreads * res->nops;
+	uint64_t *lat = nullptr;
+	if (count != 0) {
+		lat = (uint64_t *)malloc(count * sizeof(uint64_t));
+		assert(lat != nullptr);
+	}
+	auto *hist = (uint64_t *)calloc(HIST_BUCKETS, sizeof(uint64_t));
+	assert(hist != nullptr);
+
+	size_t n = 0;
+	for (size_t i = 0; i < res->nrepeats; i++) {
+		for (size_t j = 0; j < res->nthreads; j++) {
+			struct thread_results *thres = res->res[i].thres[j];
+			benchmark_time_t *beg = &thres->beg;
+			for (size_t o = 0; o < res->nops; o++) {
+				benchmark_time_t t;
+				benchmark_time_diff(&t, beg, &thres->end_op[o]);
+				lat[n] = benchmark_time_get_nsecs(&t);
+				hist[hist_bucket(lat[n])]++;
+				n++;
+
+				beg = &thres->end_op[o];
+			}
+		}
+	}
+
+	/* no samples are reported as zero latency */
+	uint64_t p9999 = 0;
+	if (count != 0) {
+		qsort(lat, count, sizeof(uint64_t), compare_uint64);
+		p9999 = lat[count * 9999 / 10000];
+	}
+	printf(";%" PRIu64, p9999);
+
+	printf(";");
+	const char *sep = "";
+	for (unsigned b = 0; b < HIST_BUCKETS; b++) {
+		if (hist[b] == 0)
+			continue;
+		printf("%s%" PRIu64 ":%" PRIu64, sep, hist_bucket_min(b),
+		       hist[b]);
+		sep = ",";
+	}
+
+	printf(";");
+	sep = "";
+	for (size_t i = 0; i < ARRAY_SIZE(flush_env); i++) {
+		char *e = os_getenv(flush_env[i]);
+		if (e == nullptr)
+			continue;
+		printf("%s%s=%s", sep, flush_env[i], e);
+		sep = ",";
+	}
+	if (*sep == '\0')
+		printf("default");
+
+	free(hist);
+	free(lat);
+}
+
 /* structure to define command line arguments */
-static struct benchmark_clo pmem_flush_clo[3];
+static struct benchmark_clo pmem_flush_clo[4];
 /* Stores information about benchmark. */
 static struct benchmark_info pmem_flush_bench;
+/* Stores information about latency benchmark. */
+static struct benchmark_info pmem_flush_latency_bench;
 CONSTRUCTOR(pmem_flush_constructor)
 void
 pmem_flush_constructor(void)
@@ -542,6 +757,19 @@ pmem_flush_constructor(void)
 	pmem_flush_clo[2].type = CLO_TYPE_FLAG;
 	pmem_flush_clo[2].off = clo_field_offset(struct pmem_args, no_warmup);
 
+	pmem_flush_clo[3].opt_short = 0;
+	pmem_flush_clo[3].opt_long = "offset";
+	pmem_flush_clo[3].descr = "Offset of the flushed range from "
+				  "the chunk boundary";
+	pmem_flush_clo[3].type = CLO_TYPE_UINT;
+	pmem_flush_clo[3].off = clo_field_offset(struct pmem_args, offset);
+	pmem_flush_clo[3].def = "0";
+	pmem_flush_clo[3].type_uint.size =
+		clo_field_size(struct pmem_args, offset);
+	pmem_flush_clo[3].type_uint.base = CLO_INT_BASE_DEC;
+	pmem_flush_clo[3].type_uint.min = 0;
+	pmem_flush_clo[3].type_uint.max = PAGE_4K - 1;
+
 	pmem_flush_bench.name = "pmem_flush";
 	pmem_flush_bench.brief = "Benchmark for pmem_msync() "
 				 "and pmem_persist()";
@@ -557,4 +785,14 @@ pmem_flush_constructor(void)
 	pmem_flush_bench.rm_file = true;
 	pmem_flush_bench.allow_poolset = false;
 	REGISTER_BENCHMARK(pmem_flush_bench);
+
+	pmem_flush_latency_bench = pmem_flush_bench;
+	pmem_flush_latency_bench.name = "pmem_flush_latency";
+	pmem_flush_latency_bench.brief = "Latency distribution of "
+					 "pmem_flush operations";
+	pmem_flush_latency_bench.print_extra_headers =
+		pmem_flush_latency_print_extra_headers;
+	pmem_flush_latency_bench.print_extra_values =
+		pmem_flush_latency_print_extra_values;
+	REGISTER_BENCHMARK(pmem_flush_latency_bench);
 }
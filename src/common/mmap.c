@@ -55,6 +55,41 @@ static os_rwlock_t Mmap_list_lock;
 static SORTEDQ_HEAD(map_list_head, map_tracker) Mmap_list =
 		SORTEDQ_HEAD_INITIALIZER(Mmap_list);
 
+/*
+ * Read-mostly copy of the map tracking list used by util_range_is_pmem().
+ *
+ * The copy is rebuilt with Mmap_list_lock held for writing whenever the list
+ * changes. Readers don't take the lock, they validate what they've read
+ * with the Mmap_snapshot_seq counter instead, which is odd while the copy is
+ * being modified or replaced. Arrays replaced by bigger ones are not freed
+ * until util_mmap_fini(), because a concurrent reader might still be using
+ * them.
+ */
+#define MMAP_SNAPSHOT_MIN_CAPACITY 16
+
+struct map_range {
+	uintptr_t base_addr;
+	uintptr_t end_addr;
+};
+
+struct map_snapshot {
+	struct map_snapshot *prev; /* array replaced by this one */
+	size_t capacity;
+	size_t count;
+	struct map_range ranges[];
+};
+
+static struct map_snapshot *Mmap_snapshot;
+static uint64_t Mmap_snapshot_seq;
+static int Mmap_snapshot_stale; /* set if the copy couldn't be rebuilt */
+
+/* the last range confirmed by util_range_is_pmem() in this thread */
+static __thread struct {
+	uint64_t seq;
+	uintptr_t base_addr;
+	uintptr_t end_addr;
+} Mmap_last_hit;
+
 /*
  * util_mmap_init -- initialize the mmap utils
  *
@@ -100,6 +135,12 @@ util_mmap_fini(void)
 	LOG(3, NULL);
 
 	util_rwlock_destroy(&Mmap_list_lock);
+
+	while (Mmap_snapshot != NULL) {
+		struct map_snapshot *prev = Mmap_snapshot->prev;
+		Free(Mmap_snapshot);
+		Mmap_snapshot = prev;
+	}
 }
 
 /*
@@ -345,6 +386,69 @@ util_range_find(uintptr_t addr, size_t len)
 	return mt;
 }
 
+/*
+ * util_range_snapshot_update -- (internal) rebuild the copy of the map
+ * tracking list
+ *
+ * Must be called with Mmap_list_lock held for writing.
+ */
+static void
+util_range_snapshot_update(void)
+{
+	LOG(10, NULL);
+
+	size_t count = 0;
+	struct map_tracker *mt;
+	SORTEDQ_FOREACH(mt, &Mmap_list, entry)
+		count++;
+
+	util_atomic_store_explicit64(&Mmap_snapshot_seq,
+			Mmap_snapshot_seq + 1, memory_order_release);
+	/*
+	 * The counter must be odd before any of the ranges is modified and
+	 * before a new, still empty, array is published.
+	 */
+	util_synchronize();
+
+	struct map_snapshot *s = Mmap_snapshot;
+
+	if (s == NULL || s->capacity < count) {
+		size_t capacity = s ? s->capacity : MMAP_SNAPSHOT_MIN_CAPACITY;
+		while (capacity < count)
+			capacity *= 2;
+
+		struct map_snapshot *n = Malloc(sizeof(*n) +
+				capacity * sizeof(n->ranges[0]));
+		if (n == NULL) {
+			/* readers will fall back to the locked lookup */
+			LOG(2, "cannot allocate the map tracking list copy");
+		} else {
+			n->prev = s;
+			n->capacity = capacity;
+			n->count = 0;
+			util_atomic_store_explicit64(&Mmap_snapshot, n,
+					memory_order_release);
+			s = n;
+		}
+	}
+
+	if (s == NULL || s->capacity < count) {
+		Mmap_snapshot_stale = 1;
+	} else {
+		size_t i = 0;
+		SORTEDQ_FOREACH(mt, &Mmap_list, entry) {
+			s->ranges[i].base_addr = mt->base_addr;
+			s->ranges[i].end_addr = mt->end_addr;
+			i++;
+		}
+		s->count = count;
+		Mmap_snapshot_stale = 0;
+	}
+
+	util_atomic_store_explicit64(&Mmap_snapshot_seq,
+			Mmap_snapshot_seq + 1, memory_order_release);
+}
+
 /*
  * util_range_register -- add a memory range into a map tracking list
  */
@@ -381,6 +485,8 @@ util_range_register(const void *addr, size_t len, const char *path,
 	SORTEDQ_INSERT(&Mmap_list, mt, entry, struct map_tracker,
 			util_range_comparer);
 
+	util_range_snapshot_update();
+
 	util_rwlock_unlock(&Mmap_list_lock);
 
 	return 0;
@@ -508,10 +614,65 @@ util_range_unregister(const void *addr, size_t len)
 		}
 	}
 
+	util_range_snapshot_update();
+
 	util_rwlock_unlock(&Mmap_list_lock);
 	return ret;
 }
 
+/*
+ * util_range_is_pmem_snapshot -- (internal) look up the range in the copy
+ * of the map tracking list
+ *
+ * Returns 1 and the boundaries of the entries covering the range if entire
+ * range is persistent memory, 0 if it's not and -1 if the copy is not usable.
+ * The result is meaningful only if Mmap_snapshot_seq didn't change meanwhile.
+ */
+static int
+util_range_is_pmem_snapshot(uintptr_t addr, size_t len,
+	uintptr_t *base, uintptr_t *end)
+{
+	if (Mmap_snapshot_stale)
+		return -1;
+
+	struct map_snapshot *s;
+	util_atomic_load_explicit64(&Mmap_snapshot, &s, memory_order_acquire);
+	if (s == NULL)
+		return 0;
+
+	size_t count = s->count;
+	if (count > s->capacity)
+		count = s->capacity;
+
+	/* find the first entry which ends above the address */
+	size_t lo = 0;
+	size_t hi = count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (s->ranges[mid].end_addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == count || s->ranges[lo].base_addr > addr)
+		return 0;
+
+	*base = s->ranges[lo].base_addr;
+
+	/* the range may span multiple adjacent entries */
+	uintptr_t covered = s->ranges[lo].end_addr;
+	while (covered - addr < len) {
+		if (++lo == count || s->ranges[lo].base_addr != covered)
+			return 0;
+		covered = s->ranges[lo].end_addr;
+	}
+
+	*end = covered;
+
+	return 1;
+}
+
 /*
  * util_range_is_pmem -- return true if entire range
  * is persistent memory
@@ -522,7 +683,51 @@ util_range_is_pmem(const void *addrp, size_t len)
 	LOG(10, "addr %p len %zu", addrp, len);
 
 	uintptr_t addr = (uintptr_t)addrp;
-	int retval = 1;
+	uint64_t seq;
+	util_atomic_load_explicit64(&Mmap_snapshot_seq, &seq,
+			memory_order_acquire);
+
+	/* nothing has been registered or unregistered since the last hit */
+	if (Mmap_last_hit.seq == seq && addr >= Mmap_last_hit.base_addr &&
+			addr < Mmap_last_hit.end_addr &&
+			len <= Mmap_last_hit.end_addr - addr)
+		return 1;
+
+	int retval;
+	uintptr_t base = 0;
+	uintptr_t end = 0;
+	uint64_t seq_end;
+
+	while (1) {
+		if (seq % 2 == 0) {
+			retval = util_range_is_pmem_snapshot(addr, len,
+					&base, &end);
+			/* the ranges must be read before the counter */
+			util_synchronize();
+			util_atomic_load_explicit64(&Mmap_snapshot_seq,
+					&seq_end, memory_order_acquire);
+			if (seq_end == seq)
+				break;
+			seq = seq_end;
+		} else {
+			util_atomic_load_explicit64(&Mmap_snapshot_seq, &seq,
+					memory_order_acquire);
+		}
+	}
+
+	if (retval == 1) {
+		Mmap_last_hit.seq = seq;
+		Mmap_last_hit.base_addr = base;
+		Mmap_last_hit.end_addr = end;
+		return 1;
+	}
+
+	if (retval == 0) {
+		LOG(4, "range not found 0x%016" PRIxPTR, addr);
+		return 0;
+	}
+
+	retval = 1;
 
 	util_rwlock_rdlock(&Mmap_list_lock);
 
@@ -165,6 +165,8 @@ void os_thread_self(os_thread_t *thread);
 int os_thread_setaffinity_np(os_thread_t *thread, size_t set_size,
 	const os_cpu_set_t *set);
 
+int os_thread_numa_node(void);
+
 int os_thread_atfork(void (*prepare)(void), void (*parent)(void),
 	void (*child)(void));
 
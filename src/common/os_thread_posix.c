@@ -40,6 +40,10 @@
 #include <pthread_np.h>
 #endif
 #include <semaphore.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include "os_thread.h"
 #include "util.h"
@@ -400,6 +404,25 @@ os_thread_setaffinity_np(os_thread_t *thread, size_t set_size,
 		(cpu_set_t *)set);
 }
 
+/*
+ * os_thread_numa_node -- returns the NUMA node of the cpu on which the calling
+ *	thread is running, or -1 if it cannot be determined
+ */
+int
+os_thread_numa_node(void)
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+	unsigned cpu;
+	unsigned node;
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+		return -1;
+
+	return (int)node;
+#else
+	return -1;
+#endif
+}
+
 /*
  * os_cpu_zero -- CP_ZERO abstraction layer
  */
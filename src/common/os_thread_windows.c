@@ -594,6 +594,23 @@ os_thread_setaffinity_np(os_thread_t *thread, size_t set_size,
 	return ret != 0 ? 0 : EINVAL;
 }
 
+/*
+ * os_thread_numa_node -- returns the NUMA node of the processor on which the
+ *	calling thread is running, or -1 if it cannot be determined
+ */
+int
+os_thread_numa_node(void)
+{
+	PROCESSOR_NUMBER proc;
+	USHORT node;
+
+	GetCurrentProcessorNumberEx(&proc);
+	if (!GetNumaProcessorNodeEx(&proc, &node))
+		return -1;
+
+	return (int)node;
+}
+
 /*
  * os_semaphore_init -- initializes a new semaphore instance
  */
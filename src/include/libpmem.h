@@ -50,12 +50,20 @@
 #define pmem_map_file pmem_map_fileW
 #define pmem_check_version pmem_check_versionW
 #define pmem_errormsg pmem_errormsgW
+#define pmem_ctl_get pmem_ctl_getW
+#define pmem_ctl_set pmem_ctl_setW
+#define pmem_ctl_exec pmem_ctl_execW
 #else
 #define pmem_map_file pmem_map_fileU
 #define pmem_check_version pmem_check_versionU
 #define pmem_errormsg pmem_errormsgU
+#define pmem_ctl_get pmem_ctl_getU
+#define pmem_ctl_set pmem_ctl_setU
+#define pmem_ctl_exec pmem_ctl_execU
 #endif
 
+#else
+#include <sys/uio.h>
 #endif
 
 #ifdef __cplusplus
@@ -94,6 +102,8 @@ void pmem_persist(const void *addr, size_t len);
 int pmem_msync(const void *addr, size_t len);
 int pmem_has_auto_flush(void);
 void pmem_flush(const void *addr, size_t len);
+void pmem_flush_iov(const struct iovec *iov, int iovcnt);
+void pmem_persist_iov(const struct iovec *iov, int iovcnt);
 void pmem_deep_flush(const void *addr, size_t len);
 int pmem_deep_drain(const void *addr, size_t len);
 int pmem_deep_persist(const void *addr, size_t len);
@@ -117,17 +127,39 @@ void *pmem_memset_nodrain(void *pmemdest, int c, size_t len);
 
 #define PMEM_F_MEM_NOFLUSH	(1U << 5)
 
+/* EXPERIMENTAL */
+#define PMEM_F_MEM_PARALLEL	(1U << 6)
+
 #define PMEM_F_MEM_VALID_FLAGS (PMEM_F_MEM_NODRAIN | \
 				PMEM_F_MEM_NONTEMPORAL | \
 				PMEM_F_MEM_TEMPORAL | \
 				PMEM_F_MEM_WC | \
 				PMEM_F_MEM_WB | \
-				PMEM_F_MEM_NOFLUSH)
+				PMEM_F_MEM_NOFLUSH | \
+				PMEM_F_MEM_PARALLEL)
 
 void *pmem_memmove(void *pmemdest, const void *src, size_t len, unsigned flags);
 void *pmem_memcpy(void *pmemdest, const void *src, size_t len, unsigned flags);
 void *pmem_memset(void *pmemdest, int c, size_t len, unsigned flags);
 
+/* EXPERIMENTAL */
+struct pmem_async;
+
+struct pmem_async *pmem_memcpy_async(void *pmemdest, const void *src,
+	size_t len, unsigned flags);
+struct pmem_async *pmem_memset_async(void *pmemdest, int c, size_t len,
+	unsigned flags);
+int pmem_async_poll(struct pmem_async *async);
+void pmem_async_wait(struct pmem_async *async);
+
+/* EXPERIMENTAL */
+struct pmem_wc;
+
+struct pmem_wc *pmem_wc_begin(void);
+int pmem_wc_write(struct pmem_wc *wc, void *pmemdest, const void *src,
+	size_t len);
+void pmem_wc_commit(struct pmem_wc *wc);
+
 /*
  * PMEM_MAJOR_VERSION and PMEM_MINOR_VERSION provide the current version of the
  * libpmem API as provided by this header file.  Applications can verify that
@@ -154,6 +186,20 @@ const char *pmem_errormsgU(void);
 const wchar_t *pmem_errormsgW(void);
 #endif
 
+#ifndef _WIN32
+/* EXPERIMENTAL */
+int pmem_ctl_get(const char *name, void *arg);
+int pmem_ctl_set(const char *name, void *arg);
+int pmem_ctl_exec(const char *name, void *arg);
+#else
+int pmem_ctl_getU(const char *name, void *arg);
+int pmem_ctl_getW(const wchar_t *name, void *arg);
+int pmem_ctl_setU(const char *name, void *arg);
+int pmem_ctl_setW(const wchar_t *name, void *arg);
+int pmem_ctl_execU(const char *name, void *arg);
+int pmem_ctl_execW(const wchar_t *name, void *arg);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -69,6 +69,20 @@ int pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	uint64_t type_num, uint64_t flags,
 	pmemobj_constr constructor, void *arg);
 
+/*
+ * Allocates nobjs new objects from the pool, each one is initialized by the
+ * constructor function. Either all of the objects are allocated, or none.
+ */
+int pmemobj_alloc_batch(PMEMobjpool *pop, PMEMoid *oids, const size_t *sizes,
+	size_t nobjs, uint64_t type_num, pmemobj_constr constructor, void *arg);
+
+/*
+ * Allocates with flags a batch of new objects from the pool.
+ */
+int pmemobj_xalloc_batch(PMEMobjpool *pop, PMEMoid *oids, const size_t *sizes,
+	size_t nobjs, uint64_t type_num, uint64_t flags,
+	pmemobj_constr constructor, void *arg);
+
 /*
  * Allocates a new zeroed object from the pool.
  */
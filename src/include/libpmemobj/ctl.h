@@ -166,6 +166,150 @@ struct pobj_alloc_class_desc {
 	unsigned class_id;
 };
 
+/*
+ * Arena interface
+ *
+ * Buckets of all allocation classes are grouped into arenas. Each thread is
+ * assigned an arena on its first allocator operation and uses it for the
+ * rest of its lifetime.
+ *
+ * These are the CTL entry points that control arenas:
+ * - heap.arenas.count
+ *	Sets/retrieves the number of arenas threads are assigned to
+ * - heap.arenas.policy
+ *	Sets/retrieves the way in which threads are assigned to arenas
+ * - heap.arenas.[arena_id].thread_count
+ *	Retrieves the number of threads currently assigned to an arena
+ * - heap.arenas.[arena_id].node
+ *	Retrieves the NUMA node an arena is bound to
+ */
+
+/*
+ * Arena assignment policy
+ */
+enum pobj_arena_policy {
+	/*
+	 * Threads are assigned to the arena with the fewest threads.
+	 */
+	POBJ_ARENA_POLICY_LEAST_USED,
+	/*
+	 * Threads are assigned to the least used arena out of those used
+	 * by other threads running on the same NUMA node. Arenas become bound
+	 * to the node of the first thread that is assigned to them.
+	 * If all arenas are already bound to other nodes, or the node cannot be
+	 * determined, this is equivalent to POBJ_ARENA_POLICY_LEAST_USED.
+	 * This is advisory only, chunks of all arenas come from the whole pool.
+	 */
+	POBJ_ARENA_POLICY_NUMA,
+
+	MAX_POBJ_ARENA_POLICIES
+};
+
+/*
+ * Index of the free huge blocks (heap.huge_container)
+ */
+enum pobj_huge_container {
+	/*
+	 * Balanced tree ordered by size, exact best-fit.
+	 */
+	POBJ_HUGE_CONTAINER_RAVL,
+	/*
+	 * Segregated lists indexed by a two-level bitmap, constant time
+	 * lookups. The best-fit is exact up to the size range of a list.
+	 */
+	POBJ_HUGE_CONTAINER_BITMAP,
+
+	MAX_POBJ_HUGE_CONTAINERS
+};
+
+/*
+ * Defragmentation interface
+ *
+ * Objects allocated from sparsely used runs can be relocated into denser
+ * ones, so that the emptied runs can be returned to the heap as free chunks.
+ * The library cannot know where the references to an object are stored, so
+ * every relocation is confirmed by a callback provided by the application.
+ *
+ * These are the CTL entry points that control defragmentation:
+ * - heap.defrag.callback
+ *	Sets the relocation callback
+ * - heap.defrag.threshold
+ *	Sets/retrieves the occupancy below which runs are evacuated
+ * - heap.defrag.interval
+ *	Sets/retrieves the delay between passes of the background worker
+ * - heap.defrag.enabled
+ *	Starts/stops the background worker
+ * - heap.defrag.run
+ *	Performs a single defragmentation pass in the calling thread
+ */
+
+/*
+ * Relocation callback.
+ *
+ * Called inside of a transaction once the new object has been allocated.
+ * The callback must update all references to the old object so that they
+ * point to the new one, and return 0. Returning any other value, or aborting
+ * the transaction, cancels the relocation.
+ * The contents of the old object are copied into the new one after the
+ * callback returns, and the old object is freed when the transaction commits.
+ */
+typedef int (*pobj_defrag_relocate_fn)(PMEMobjpool *pop,
+	PMEMoid oldoid, PMEMoid newoid, void *arg);
+
+struct pobj_defrag_callback {
+	pobj_defrag_relocate_fn relocate;
+	void *arg;
+};
+
+/*
+ * Heap statistics interface
+ *
+ * Apart from the counters, the statistics describe the current layout of
+ * the heap. Those are calculated by traversing the heap on each query.
+ *
+ * These are the CTL entry points that describe the heap layout:
+ * - stats.heap.alloc_class.[class_id].allocated
+ *	Retrieves the number of bytes allocated from the class
+ * - stats.heap.alloc_class.[class_id].free
+ *	Retrieves the number of free bytes in the runs of the class
+ * - stats.heap.alloc_class.[class_id].runs
+ *	Retrieves the number of runs of the class
+ * - stats.heap.alloc_class.[class_id].run_fill
+ *	Retrieves the histogram of occupancy of the runs of the class
+ * - stats.heap.alloc_class.[class_id].recycler_pending
+ *	Retrieves the number of runs of the class waiting to be recycled
+ * - stats.heap.huge_free
+ *	Retrieves the histogram of sizes of free huge blocks
+ */
+
+/*
+ * The occupancy of runs is measured in steps of 10%, the last element of
+ * the histogram counts runs that are entirely full.
+ */
+#define POBJ_STATS_RUN_FILL_BUCKETS 11
+
+struct pobj_stats_run_fill {
+	/*
+	 * The n-th element counts runs that are at least n * 10% full,
+	 * but less than (n + 1) * 10%.
+	 */
+	uint64_t runs[POBJ_STATS_RUN_FILL_BUCKETS];
+};
+
+/*
+ * Huge blocks span at most 65528 chunks, so the power of two size classes
+ * fit in 16 elements.
+ */
+#define POBJ_STATS_HUGE_FREE_BUCKETS 16
+
+struct pobj_stats_huge_free {
+	/*
+	 * The n-th element counts free blocks that span at least 2^n chunks,
+	 * but less than 2^(n + 1).
+	 */
+	uint64_t blocks[POBJ_STATS_HUGE_FREE_BUCKETS];
+};
+
 #ifndef _WIN32
 /* EXPERIMENTAL */
 int pmemobj_ctl_get(PMEMobjpool *pop, const char *name, void *arg);
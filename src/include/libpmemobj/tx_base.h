@@ -72,6 +72,7 @@ enum pobj_tx_param {
 	TX_PARAM_MUTEX,	 /* PMEMmutex */
 	TX_PARAM_RWLOCK, /* PMEMrwlock */
 	TX_PARAM_CB,	 /* pmemobj_tx_callback cb, void *arg */
+	TX_PARAM_REDO,	 /* no arguments, see pmemobj_tx_write */
 };
 
 #if !defined(_has_deprecated_with_message) && defined(__clang__)
@@ -214,6 +215,22 @@ int pmemobj_tx_xadd_range(PMEMoid oid, uint64_t off, size_t size,
  */
 int pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags);
 
+/*
+ * Transactionally writes 'size' bytes from 'src' to the given memory region.
+ * The supplied block of memory has to be within the given pool.
+ *
+ * In transactions started with TX_PARAM_REDO the data is kept in a volatile
+ * shadow buffer and written to the pool through the redo log on commit - the
+ * new content is not visible until then. Otherwise, the region is added to
+ * the undo log and then modified in place.
+ *
+ * If successful, returns zero.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_write(void *dest, const void *src, size_t size);
+
 /*
  * Transactionally allocates a new object.
  *
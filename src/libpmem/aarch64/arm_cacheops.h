@@ -33,6 +33,7 @@
  * ARM inline assembly to flush and invalidate caches
  * clwb => dc cvac
  * clflush | clflushopt => dc civac
+ * clwb to the point of persistence => dc cvap
  * fence => dmb ish
  */
 
@@ -58,4 +59,14 @@ arm_clean_and_invalidate_va_to_poc(const void *addr)
 {
 	asm volatile("dc civac, %0" : : "r" (addr) : "memory");
 }
+
+/*
+ * DC CVAP was introduced in ARMv8.2, so it's encoded as a generic system
+ * instruction which older assemblers accept as well.
+ */
+static inline void
+arm_clean_va_to_pop(const void *addr)
+{
+	asm volatile("sys #3, c7, c12, #1, %0" : : "r" (addr) : "memory");
+}
 #endif
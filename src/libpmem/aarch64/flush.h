@@ -74,4 +74,21 @@ flush_dcache_nolog(const void *addr, size_t len)
 	}
 }
 
+/*
+ * flush_dcache_pop_nolog -- flush the CPU cache to the point of persistence,
+ * using DC CVAP
+ *
+ * The flushes are not followed by a barrier, the drain has to issue one.
+ */
+static force_inline void
+flush_dcache_pop_nolog(const void *addr, size_t len)
+{
+	uintptr_t uptr;
+
+	for (uptr = (uintptr_t)addr & ~(FLUSH_ALIGN - 1);
+		uptr < (uintptr_t)addr + len; uptr += FLUSH_ALIGN) {
+		arm_clean_va_to_pop((char *)uptr);
+	}
+}
+
 #endif
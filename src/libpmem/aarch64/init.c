@@ -34,11 +34,28 @@
 #include "libpmem.h"
 
 #include "flush.h"
+#include "memcpy_memset.h"
 #include "os.h"
 #include "out.h"
 #include "pmem.h"
+#include "stats.h"
 #include "valgrind_internal.h"
 
+#if defined(__linux__)
+#include <sys/auxv.h>
+
+#ifndef HWCAP_DCPOP
+#define HWCAP_DCPOP (1 << 16)
+#endif
+#endif
+
+#define MOVNT_THRESHOLD	256
+
+size_t Movnt_threshold = MOVNT_THRESHOLD;
+
+/* cleared by PMEM_NO_MOVNT, the NEON kernels then use only regular stores */
+static int Movnt_enabled = 1;
+
 /*
  * memmove_nodrain_libc -- (internal) memmove to pmem without hw drain
  */
@@ -50,6 +67,7 @@ memmove_nodrain_libc(void *pmemdest, const void *src, size_t len,
 			flags);
 
 	memmove(pmemdest, src, len);
+	PMEM_STATS_INC(temporal_bytes, len);
 	pmem_flush_flags(pmemdest, len, flags);
 	return pmemdest;
 }
@@ -64,6 +82,7 @@ memset_nodrain_libc(void *pmemdest, int c, size_t len, unsigned flags)
 			flags);
 
 	memset(pmemdest, c, len);
+	PMEM_STATS_INC(temporal_bytes, len);
 	pmem_flush_flags(pmemdest, len, flags);
 	return pmemdest;
 }
@@ -88,6 +107,7 @@ predrain_memory_barrier(void)
 {
 	LOG(15, NULL);
 	arm_data_memory_barrier();
+	PMEM_STATS_INC(fences, 1);
 }
 
 /*
@@ -101,6 +121,7 @@ flush_dcache_invalidate_opt(const void *addr, size_t len)
 	LOG(15, "addr %p len %zu", addr, len);
 
 	flush_dcache_invalidate_opt_nolog(addr, len);
+	PMEM_STATS_FLUSH(addr, len);
 }
 
 /*
@@ -112,6 +133,20 @@ flush_dcache(const void *addr, size_t len)
 	LOG(15, "addr %p len %zu", addr, len);
 
 	flush_dcache_nolog(addr, len);
+	PMEM_STATS_FLUSH(addr, len);
+}
+
+/*
+ * flush_dcache_pop -- (internal) flush the CPU cache to the point of
+ * persistence, using DC CVAP
+ */
+static void
+flush_dcache_pop(const void *addr, size_t len)
+{
+	LOG(15, "addr %p len %zu", addr, len);
+
+	flush_dcache_pop_nolog(addr, len);
+	PMEM_STATS_FLUSH(addr, len);
 }
 
 /*
@@ -125,6 +160,188 @@ flush_empty(const void *addr, size_t len)
 	flush_empty_nolog(addr, len);
 }
 
+#if NEON_AVAILABLE
+#define PMEM_F_MEM_MOVNT (PMEM_F_MEM_WC | PMEM_F_MEM_NONTEMPORAL)
+#define PMEM_F_MEM_MOV   (PMEM_F_MEM_WB | PMEM_F_MEM_TEMPORAL)
+
+/*
+ * flush_civac, flush_cvap -- aliases letting the templates below refer
+ * to the flush functions by the suffixes of the kernels
+ */
+#define flush_civac flush_dcache_invalidate_opt
+#define flush_cvap flush_dcache_pop
+
+/*
+ * use_movnt -- (internal) returns whether non-temporal stores should be used
+ *	for an operation of the given length and flags
+ */
+static force_inline int
+use_movnt(size_t len, unsigned flags)
+{
+	if (!Movnt_enabled)
+		return 0;
+	if (flags & PMEM_F_MEM_MOVNT)
+		return 1;
+	if (flags & PMEM_F_MEM_MOV)
+		return 0;
+
+	return len >= Movnt_threshold;
+}
+
+/*
+ * stats_mov -- (internal) accounts a copy or fill followed by a flush using
+ *	the given function
+ */
+static force_inline void
+stats_mov(const void *dest, size_t len, flush_func flush, int nt)
+{
+	if (unlikely(Pmem_stats_enabled)) {
+		struct pmem_stats *s = pmem_stats_local();
+
+		if (nt)
+			s->nt_bytes += len;
+		else
+			s->temporal_bytes += len;
+		if (flush != flush_empty)
+			s->flushed_lines += pmem_stats_lines(dest, len);
+	}
+}
+
+/*
+ * Unlike on x86, the non-temporal variants flush the lines as well, so the
+ * flushes are accounted for both kinds of stores.
+ */
+#define MEMCPY_TEMPLATE(isa, flush) \
+static void *\
+memmove_nodrain_##isa##_##flush(void *dest, const void *src, size_t len, \
+		unsigned flags)\
+{\
+	if (len == 0 || src == dest)\
+		return dest;\
+\
+	if (flags & PMEM_F_MEM_NOFLUSH) {\
+		memmove_mov_##isa##_empty(dest, src, len);\
+		PMEM_STATS_INC(temporal_bytes, len);\
+	} else if (use_movnt(len, flags)) {\
+		memmove_movnt_##isa##_##flush(dest, src, len);\
+		stats_mov(dest, len, flush_##flush, 1);\
+	} else {\
+		memmove_mov_##isa##_##flush(dest, src, len);\
+		stats_mov(dest, len, flush_##flush, 0);\
+	}\
+\
+	return dest;\
+}
+
+#define MEMSET_TEMPLATE(isa, flush)\
+static void *\
+memset_nodrain_##isa##_##flush(void *dest, int c, size_t len, unsigned flags)\
+{\
+	if (len == 0)\
+		return dest;\
+\
+	if (flags & PMEM_F_MEM_NOFLUSH) {\
+		memset_mov_##isa##_empty(dest, c, len);\
+		PMEM_STATS_INC(temporal_bytes, len);\
+	} else if (use_movnt(len, flags)) {\
+		memset_movnt_##isa##_##flush(dest, c, len);\
+		stats_mov(dest, len, flush_##flush, 1);\
+	} else {\
+		memset_mov_##isa##_##flush(dest, c, len);\
+		stats_mov(dest, len, flush_##flush, 0);\
+	}\
+\
+	return dest;\
+}
+
+MEMCPY_TEMPLATE(neon, civac)
+MEMCPY_TEMPLATE(neon, cvap)
+MEMCPY_TEMPLATE(neon, empty)
+
+MEMSET_TEMPLATE(neon, civac)
+MEMSET_TEMPLATE(neon, cvap)
+MEMSET_TEMPLATE(neon, empty)
+#endif
+
+enum memcpy_impl {
+	MEMCPY_INVALID,
+	MEMCPY_LIBC,
+	MEMCPY_GENERIC,
+	MEMCPY_NEON
+};
+
+/*
+ * use_neon_memcpy_memset -- (internal) use NEON kernels matching the flush
+ *	function
+ *
+ * The kernels flush every line they write, so unlike the DC CIVAC flush
+ * function they don't end with a barrier and the drain has to issue one.
+ */
+static void
+use_neon_memcpy_memset(struct pmem_funcs *funcs, enum memcpy_impl *impl)
+{
+#if NEON_AVAILABLE
+	*impl = MEMCPY_NEON;
+	if (funcs->flush == flush_dcache_invalidate_opt)
+		funcs->memmove_nodrain = memmove_nodrain_neon_civac;
+	else if (funcs->flush == flush_dcache_pop)
+		funcs->memmove_nodrain = memmove_nodrain_neon_cvap;
+	else if (funcs->flush == flush_empty)
+		funcs->memmove_nodrain = memmove_nodrain_neon_empty;
+	else
+		ASSERT(0);
+
+	if (funcs->flush == flush_dcache_invalidate_opt)
+		funcs->memset_nodrain = memset_nodrain_neon_civac;
+	else if (funcs->flush == flush_dcache_pop)
+		funcs->memset_nodrain = memset_nodrain_neon_cvap;
+	else if (funcs->flush == flush_empty)
+		funcs->memset_nodrain = memset_nodrain_neon_empty;
+	else
+		ASSERT(0);
+
+	funcs->predrain_fence = predrain_memory_barrier;
+#else
+	LOG(3, "neon disabled at build time");
+#endif
+}
+
+/*
+ * is_cpu_dcpop_present -- (internal) checks whether DC CVAP is supported
+ */
+static int
+is_cpu_dcpop_present(void)
+{
+#if defined(__linux__)
+	return (getauxval(AT_HWCAP) & HWCAP_DCPOP) != 0;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * pmem_cpuinfo_to_funcs -- (internal) configure libpmem based on the CPU
+ *	capabilities
+ */
+static void
+pmem_cpuinfo_to_funcs(struct pmem_funcs *funcs)
+{
+	LOG(3, NULL);
+
+	if (is_cpu_dcpop_present()) {
+		LOG(3, "dc cvap supported");
+
+		char *e = os_getenv("PMEM_NO_CVAP");
+		if (e && strcmp(e, "1") == 0) {
+			LOG(3, "PMEM_NO_CVAP forced no dc cvap");
+		} else {
+			funcs->deep_flush = flush_dcache_pop;
+			/* DC CVAP isn't followed by a barrier, unlike DC CIVAC */
+			funcs->predrain_fence = predrain_memory_barrier;
+		}
+	}
+}
+
 /*
  * pmem_init_funcs -- initialize architecture-specific list of pmem operations
  */
@@ -138,6 +355,7 @@ pmem_init_funcs(struct pmem_funcs *funcs)
 	funcs->is_pmem = is_pmem_detect;
 	funcs->memmove_nodrain = memmove_nodrain_generic;
 	funcs->memset_nodrain = memset_nodrain_generic;
+	enum memcpy_impl impl = MEMCPY_GENERIC;
 
 	char *ptr = os_getenv("PMEM_NO_GENERIC_MEMCPY");
 	if (ptr) {
@@ -146,9 +364,12 @@ pmem_init_funcs(struct pmem_funcs *funcs)
 		if (val) {
 			funcs->memmove_nodrain = memmove_nodrain_libc;
 			funcs->memset_nodrain = memset_nodrain_libc;
+			impl = MEMCPY_LIBC;
 		}
 	}
 
+	pmem_cpuinfo_to_funcs(funcs);
+
 	int flush;
 	char *e = os_getenv("PMEM_NO_FLUSH");
 	if (e && (strcmp(e, "1") == 0)) {
@@ -172,22 +393,69 @@ pmem_init_funcs(struct pmem_funcs *funcs)
 		funcs->predrain_fence = predrain_memory_barrier;
 	}
 
+	ptr = os_getenv("PMEM_NO_MOVNT");
+	if (ptr && strcmp(ptr, "1") == 0) {
+		LOG(3, "PMEM_NO_MOVNT forced no movnt");
+		Movnt_enabled = 0;
+	}
+
+	/*
+	 * The kernels are chosen after the flush function they inline. They
+	 * replace only the generic implementation, the libc one is kept if it
+	 * was requested.
+	 */
+	if (impl == MEMCPY_GENERIC)
+		use_neon_memcpy_memset(funcs, &impl);
+
+	/*
+	 * For testing, allow overriding the default threshold
+	 * for using non-temporal stores in pmem_memcpy_*(), pmem_memmove_*()
+	 * and pmem_memset_*().
+	 * It has no effect if neon is not supported or not used, or if
+	 * PMEM_NO_MOVNT is set.
+	 */
+	ptr = os_getenv("PMEM_MOVNT_THRESHOLD");
+	if (ptr) {
+		long long val = atoll(ptr);
+
+		if (val < 0) {
+			LOG(3, "Invalid PMEM_MOVNT_THRESHOLD");
+		} else {
+			LOG(3, "PMEM_MOVNT_THRESHOLD set to %zu", (size_t)val);
+			Movnt_threshold = (size_t)val;
+		}
+	}
+
 	if (funcs->deep_flush == flush_dcache)
 		LOG(3, "Using ARM invalidate");
 	else if (funcs->deep_flush == flush_dcache_invalidate_opt)
 		LOG(3, "Synchronize VA to poc for ARM");
+	else if (funcs->deep_flush == flush_dcache_pop)
+		LOG(3, "Synchronize VA to pop for ARM");
 	else
 		FATAL("invalid deep flush function address");
 
-	if (funcs->deep_flush == flush_empty)
+	if (funcs->flush == flush_empty)
 		LOG(3, "not flushing CPU cache");
 	else if (funcs->flush != funcs->deep_flush)
 		FATAL("invalid flush function address");
 
-	if (funcs->memmove_nodrain == memmove_nodrain_generic)
-		LOG(3, "using generic memmove");
-	else if (funcs->memmove_nodrain == memmove_nodrain_libc)
+	if (impl == MEMCPY_NEON)
+		LOG(3, "using neon memmove");
+	else if (impl == MEMCPY_LIBC)
 		LOG(3, "using libc memmove");
+	else if (impl == MEMCPY_GENERIC)
+		LOG(3, "using generic memmove");
 	else
-		FATAL("invalid memove_nodrain function address");
+		FATAL("invalid memcpy impl");
+}
+
+/*
+ * pmem_arch_ctl_register -- registers architecture-specific ctl entry points
+ *
+ * There are none on aarch64.
+ */
+void
+pmem_arch_ctl_register(void)
+{
 }
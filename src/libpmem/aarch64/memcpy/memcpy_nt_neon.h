@@ -0,0 +1,217 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <arm_neon.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pmem.h"
+#include "flush.h"
+#include "memcpy_memset.h"
+#include "memcpy_neon.h"
+
+/*
+ * stnp_neon -- stores 32 bytes with a non-temporal hint
+ *
+ * Unlike MOVNT on x86, STNP doesn't bypass the cache, so the lines still have
+ * to be flushed.
+ */
+static force_inline void
+stnp_neon(char *dest, uint8x16_t q0, uint8x16_t q1)
+{
+	asm volatile("stnp %q0, %q1, [%2]" : : "w" (q0), "w" (q1), "r" (dest)
+			: "memory");
+}
+
+static force_inline void
+memmove_movnt4x64b(char *dest, const char *src)
+{
+	uint8x16_t q0 = vld1q_u8((const uint8_t *)src + 0 * 16);
+	uint8x16_t q1 = vld1q_u8((const uint8_t *)src + 1 * 16);
+	uint8x16_t q2 = vld1q_u8((const uint8_t *)src + 2 * 16);
+	uint8x16_t q3 = vld1q_u8((const uint8_t *)src + 3 * 16);
+	uint8x16_t q4 = vld1q_u8((const uint8_t *)src + 4 * 16);
+	uint8x16_t q5 = vld1q_u8((const uint8_t *)src + 5 * 16);
+	uint8x16_t q6 = vld1q_u8((const uint8_t *)src + 6 * 16);
+	uint8x16_t q7 = vld1q_u8((const uint8_t *)src + 7 * 16);
+	uint8x16_t q8 = vld1q_u8((const uint8_t *)src + 8 * 16);
+	uint8x16_t q9 = vld1q_u8((const uint8_t *)src + 9 * 16);
+	uint8x16_t q10 = vld1q_u8((const uint8_t *)src + 10 * 16);
+	uint8x16_t q11 = vld1q_u8((const uint8_t *)src + 11 * 16);
+	uint8x16_t q12 = vld1q_u8((const uint8_t *)src + 12 * 16);
+	uint8x16_t q13 = vld1q_u8((const uint8_t *)src + 13 * 16);
+	uint8x16_t q14 = vld1q_u8((const uint8_t *)src + 14 * 16);
+	uint8x16_t q15 = vld1q_u8((const uint8_t *)src + 15 * 16);
+
+	stnp_neon(dest + 0 * 32, q0, q1);
+	stnp_neon(dest + 1 * 32, q2, q3);
+	stnp_neon(dest + 2 * 32, q4, q5);
+	stnp_neon(dest + 3 * 32, q6, q7);
+	stnp_neon(dest + 4 * 32, q8, q9);
+	stnp_neon(dest + 5 * 32, q10, q11);
+	stnp_neon(dest + 6 * 32, q12, q13);
+	stnp_neon(dest + 7 * 32, q14, q15);
+
+	flush64b(dest + 0 * 64);
+	flush64b(dest + 1 * 64);
+	flush64b(dest + 2 * 64);
+	flush64b(dest + 3 * 64);
+}
+
+static force_inline void
+memmove_movnt2x64b(char *dest, const char *src)
+{
+	uint8x16_t q0 = vld1q_u8((const uint8_t *)src + 0 * 16);
+	uint8x16_t q1 = vld1q_u8((const uint8_t *)src + 1 * 16);
+	uint8x16_t q2 = vld1q_u8((const uint8_t *)src + 2 * 16);
+	uint8x16_t q3 = vld1q_u8((const uint8_t *)src + 3 * 16);
+	uint8x16_t q4 = vld1q_u8((const uint8_t *)src + 4 * 16);
+	uint8x16_t q5 = vld1q_u8((const uint8_t *)src + 5 * 16);
+	uint8x16_t q6 = vld1q_u8((const uint8_t *)src + 6 * 16);
+	uint8x16_t q7 = vld1q_u8((const uint8_t *)src + 7 * 16);
+
+	stnp_neon(dest + 0 * 32, q0, q1);
+	stnp_neon(dest + 1 * 32, q2, q3);
+	stnp_neon(dest + 2 * 32, q4, q5);
+	stnp_neon(dest + 3 * 32, q6, q7);
+
+	flush64b(dest + 0 * 64);
+	flush64b(dest + 1 * 64);
+}
+
+static force_inline void
+memmove_movnt1x64b(char *dest, const char *src)
+{
+	uint8x16_t q0 = vld1q_u8((const uint8_t *)src + 0 * 16);
+	uint8x16_t q1 = vld1q_u8((const uint8_t *)src + 1 * 16);
+	uint8x16_t q2 = vld1q_u8((const uint8_t *)src + 2 * 16);
+	uint8x16_t q3 = vld1q_u8((const uint8_t *)src + 3 * 16);
+
+	stnp_neon(dest + 0 * 32, q0, q1);
+	stnp_neon(dest + 1 * 32, q2, q3);
+
+	flush64b(dest + 0 * 64);
+}
+
+static force_inline void
+memmove_movnt_neon_fw(char *dest, const char *src, size_t len)
+{
+	size_t cnt = (uint64_t)dest & 63;
+	if (cnt > 0) {
+		cnt = 64 - cnt;
+
+		if (cnt > len)
+			cnt = len;
+
+		memmove_small_neon(dest, src, cnt);
+
+		dest += cnt;
+		src += cnt;
+		len -= cnt;
+	}
+
+	while (len >= 4 * 64) {
+		memmove_movnt4x64b(dest, src);
+		dest += 4 * 64;
+		src += 4 * 64;
+		len -= 4 * 64;
+	}
+
+	if (len >= 2 * 64) {
+		memmove_movnt2x64b(dest, src);
+		dest += 2 * 64;
+		src += 2 * 64;
+		len -= 2 * 64;
+	}
+
+	if (len >= 1 * 64) {
+		memmove_movnt1x64b(dest, src);
+
+		dest += 1 * 64;
+		src += 1 * 64;
+		len -= 1 * 64;
+	}
+
+	if (len)
+		memmove_small_neon(dest, src, len);
+}
+
+static force_inline void
+memmove_movnt_neon_bw(char *dest, const char *src, size_t len)
+{
+	dest += len;
+	src += len;
+
+	size_t cnt = (uint64_t)dest & 63;
+	if (cnt > 0) {
+		if (cnt > len)
+			cnt = len;
+
+		dest -= cnt;
+		src -= cnt;
+		len -= cnt;
+		memmove_small_neon(dest, src, cnt);
+	}
+
+	while (len >= 4 * 64) {
+		dest -= 4 * 64;
+		src -= 4 * 64;
+		len -= 4 * 64;
+		memmove_movnt4x64b(dest, src);
+	}
+
+	if (len >= 2 * 64) {
+		dest -= 2 * 64;
+		src -= 2 * 64;
+		len -= 2 * 64;
+		memmove_movnt2x64b(dest, src);
+	}
+
+	if (len >= 1 * 64) {
+		dest -= 1 * 64;
+		src -= 1 * 64;
+		len -= 1 * 64;
+		memmove_movnt1x64b(dest, src);
+	}
+
+	if (len)
+		memmove_small_neon(dest - len, src - len, len);
+}
+
+void
+EXPORTED_SYMBOL(char *dest, const char *src, size_t len)
+{
+	if ((uintptr_t)dest - (uintptr_t)src >= len)
+		memmove_movnt_neon_fw(dest, src, len);
+	else
+		memmove_movnt_neon_bw(dest, src, len);
+}
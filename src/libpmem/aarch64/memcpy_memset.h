@@ -0,0 +1,65 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AARCH64_MEMCPY_MEMSET_H
+#define AARCH64_MEMCPY_MEMSET_H
+
+#include <stddef.h>
+#include "pmem.h"
+#include "util.h"
+
+/*
+ * Advanced SIMD is a mandatory part of ARMv8-A, so the kernels are built
+ * unless explicitly disabled.
+ */
+#ifndef NEON_AVAILABLE
+#define NEON_AVAILABLE 1
+#endif
+
+#if NEON_AVAILABLE
+void memmove_mov_neon_civac(char *dest, const char *src, size_t len);
+void memmove_mov_neon_cvap(char *dest, const char *src, size_t len);
+void memmove_mov_neon_empty(char *dest, const char *src, size_t len);
+void memmove_movnt_neon_civac(char *dest, const char *src, size_t len);
+void memmove_movnt_neon_cvap(char *dest, const char *src, size_t len);
+void memmove_movnt_neon_empty(char *dest, const char *src, size_t len);
+void memset_mov_neon_civac(char *dest, int c, size_t len);
+void memset_mov_neon_cvap(char *dest, int c, size_t len);
+void memset_mov_neon_empty(char *dest, int c, size_t len);
+void memset_movnt_neon_civac(char *dest, int c, size_t len);
+void memset_movnt_neon_cvap(char *dest, int c, size_t len);
+void memset_movnt_neon_empty(char *dest, int c, size_t len);
+#endif
+
+extern size_t Movnt_threshold;
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <arm_neon.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pmem.h"
+#include "flush.h"
+#include "memcpy_memset.h"
+#include "memset_neon.h"
+
+/*
+ * stnp_neon -- stores 32 bytes with a non-temporal hint
+ *
+ * Unlike MOVNT on x86, STNP doesn't bypass the cache, so the lines still have
+ * to be flushed.
+ */
+static force_inline void
+stnp_neon(char *dest, uint8x16_t q)
+{
+	asm volatile("stnp %q0, %q0, [%1]" : : "w" (q), "r" (dest)
+			: "memory");
+}
+
+static force_inline void
+memset_movnt4x64b(char *dest, uint8x16_t q)
+{
+	stnp_neon(dest + 0 * 32, q);
+	stnp_neon(dest + 1 * 32, q);
+	stnp_neon(dest + 2 * 32, q);
+	stnp_neon(dest + 3 * 32, q);
+	stnp_neon(dest + 4 * 32, q);
+	stnp_neon(dest + 5 * 32, q);
+	stnp_neon(dest + 6 * 32, q);
+	stnp_neon(dest + 7 * 32, q);
+
+	flush64b(dest + 0 * 64);
+	flush64b(dest + 1 * 64);
+	flush64b(dest + 2 * 64);
+	flush64b(dest + 3 * 64);
+}
+
+static force_inline void
+memset_movnt2x64b(char *dest, uint8x16_t q)
+{
+	stnp_neon(dest + 0 * 32, q);
+	stnp_neon(dest + 1 * 32, q);
+	stnp_neon(dest + 2 * 32, q);
+	stnp_neon(dest + 3 * 32, q);
+
+	flush64b(dest + 0 * 64);
+	flush64b(dest + 1 * 64);
+}
+
+static force_inline void
+memset_movnt1x64b(char *dest, uint8x16_t q)
+{
+	stnp_neon(dest + 0 * 32, q);
+	stnp_neon(dest + 1 * 32, q);
+
+	flush64b(dest + 0 * 64);
+}
+
+void
+EXPORTED_SYMBOL(char *dest, int c, size_t len)
+{
+	uint8x16_t q = vdupq_n_u8((uint8_t)c);
+
+	size_t cnt = (uint64_t)dest & 63;
+	if (cnt > 0) {
+		cnt = 64 - cnt;
+
+		if (cnt > len)
+			cnt = len;
+
+		memset_small_neon(dest, q, cnt);
+
+		dest += cnt;
+		len -= cnt;
+	}
+
+	while (len >= 4 * 64) {
+		memset_movnt4x64b(dest, q);
+		dest += 4 * 64;
+		len -= 4 * 64;
+	}
+
+	if (len >= 2 * 64) {
+		memset_movnt2x64b(dest, q);
+		dest += 2 * 64;
+		len -= 2 * 64;
+	}
+
+	if (len >= 1 * 64) {
+		memset_movnt1x64b(dest, q);
+
+		dest += 1 * 64;
+		len -= 1 * 64;
+	}
+
+	if (len)
+		memset_small_neon(dest, q, len);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * async.c -- asynchronous memcpy and memset entry points for libpmem
+ */
+
+#include "libpmem.h"
+#include "out.h"
+#include "pmem.h"
+#include "workers.h"
+
+struct pmem_async {
+	struct pmem_job job;
+};
+
+/*
+ * pmem_async_submit -- (internal) allocates a handle and queues the job
+ */
+static struct pmem_async *
+pmem_async_submit(pmem_job_func func, void *pmemdest, const void *src,
+	int c, size_t len, unsigned flags)
+{
+#ifdef DEBUG
+	if (flags & ~PMEM_F_MEM_VALID_FLAGS)
+		ERR("invalid flags 0x%x", flags);
+#endif
+
+	struct pmem_async *async = Malloc(sizeof(*async));
+	if (async == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	pmem_job_init(&async->job, func, pmemdest, src, c, len, flags);
+
+	if (pmem_job_submit(&async->job)) {
+		Free(async);
+		return NULL;
+	}
+
+	return async;
+}
+
+/*
+ * pmem_memcpy_async -- starts a memcpy executed by the worker threads
+ */
+struct pmem_async *
+pmem_memcpy_async(void *pmemdest, const void *src, size_t len, unsigned flags)
+{
+	LOG(15, "pmemdest %p src %p len %zu flags 0x%x",
+			pmemdest, src, len, flags);
+
+	return pmem_async_submit(pmem_job_memmove, pmemdest, src, 0, len,
+			flags);
+}
+
+/*
+ * pmem_memset_async -- starts a memset executed by the worker threads
+ */
+struct pmem_async *
+pmem_memset_async(void *pmemdest, int c, size_t len, unsigned flags)
+{
+	LOG(15, "pmemdest %p c 0x%x len %zu flags 0x%x",
+			pmemdest, c, len, flags);
+
+	return pmem_async_submit(pmem_job_memset, pmemdest, NULL, c, len,
+			flags);
+}
+
+/*
+ * pmem_async_poll -- returns 1 if the operation has been completed,
+ *	0 otherwise
+ */
+int
+pmem_async_poll(struct pmem_async *async)
+{
+	LOG(15, "async %p", async);
+
+	return pmem_job_poll(&async->job);
+}
+
+/*
+ * pmem_async_wait -- waits for the operation to complete and releases
+ *	the handle
+ */
+void
+pmem_async_wait(struct pmem_async *async)
+{
+	LOG(15, "async %p", async);
+
+	pmem_job_wait(&async->job);
+	Free(async);
+}
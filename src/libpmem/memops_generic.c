@@ -46,6 +46,7 @@
 #include "out.h"
 #include "pmem.h"
 #include "libpmem.h"
+#include "stats.h"
 #include "util.h"
 
 /*
@@ -112,6 +113,8 @@ memmove_nodrain_generic(void *dst, const void *src, size_t len,
 	size_t remaining;
 	(void) flags;
 
+	PMEM_STATS_INC(temporal_bytes, len);
+
 	if ((uintptr_t)cdst - (uintptr_t)csrc >= len) {
 		size_t cnt = (uint64_t)cdst & 7;
 		if (cnt > 0) {
@@ -217,6 +220,8 @@ memset_nodrain_generic(void *dst, int c, size_t len, unsigned flags)
 			flags);
 	(void) flags;
 
+	PMEM_STATS_INC(temporal_bytes, len);
+
 	char *cdst = dst;
 	size_t cnt = (uint64_t)cdst & 7;
 	if (cnt > 0) {
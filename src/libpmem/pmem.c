@@ -105,6 +105,15 @@
  *
  *	SFENCE unless using CLFLUSH
  *
+ * pmem_flush_iov(iov, iovcnt)
+ *
+ *	Sorts the ranges, merges the ones that touch the same cache lines
+ *	and then flushes every resulting line exactly once.
+ *
+ * pmem_persist_iov(iov, iovcnt)
+ *
+ *	Same as above, followed by a single pmem_drain().
+ *
  *
  * INTERFACES FOR COPYING/SETTING RANGES OF MEMORY
  *
@@ -180,9 +189,24 @@
 #include "valgrind_internal.h"
 #include "os_deep.h"
 #include "os_auto_flush.h"
+#include "stats.h"
+#include "workers.h"
 
 static struct pmem_funcs Funcs;
 
+/*
+ * Number of ranges pmem_flush_iov() can handle without a memory allocation.
+ */
+#define PMEM_IOV_STACK_CNT 64
+
+/*
+ * cache line aligned range used by pmem_flush_iov()
+ */
+struct pmem_line_range {
+	uintptr_t start;
+	uintptr_t end;
+};
+
 /*
  * pmem_has_hw_drain -- return whether or not HW drain was found
  *
@@ -257,6 +281,104 @@ pmem_persist(const void *addr, size_t len)
 	pmem_drain();
 }
 
+/*
+ * pmem_line_range_cmp -- (internal) compares two ranges by their start
+ */
+static int
+pmem_line_range_cmp(const void *lhs, const void *rhs)
+{
+	const struct pmem_line_range *l = lhs;
+	const struct pmem_line_range *r = rhs;
+
+	if (l->start < r->start)
+		return -1;
+	if (l->start > r->start)
+		return 1;
+
+	return 0;
+}
+
+/*
+ * pmem_flush_iov -- flush processor cache for a vector of ranges
+ *
+ * The ranges are expanded to cache line boundaries, sorted and merged, so
+ * that every cache line covered by the vector is flushed exactly once.
+ */
+void
+pmem_flush_iov(const struct iovec *iov, int iovcnt)
+{
+	LOG(15, "iov %p iovcnt %d", iov, iovcnt);
+
+	if (iovcnt <= 0)
+		return;
+
+	struct pmem_line_range stack_ranges[PMEM_IOV_STACK_CNT];
+	struct pmem_line_range *ranges = stack_ranges;
+
+	if ((size_t)iovcnt > PMEM_IOV_STACK_CNT) {
+		ranges = Malloc(sizeof(*ranges) * (size_t)iovcnt);
+		if (ranges == NULL) {
+			/* still correct, just possibly flushing lines twice */
+			for (int i = 0; i < iovcnt; ++i)
+				pmem_flush(iov[i].iov_base, iov[i].iov_len);
+			return;
+		}
+	}
+
+	size_t nranges = 0;
+	for (int i = 0; i < iovcnt; ++i) {
+		if (iov[i].iov_len == 0)
+			continue;
+
+		VALGRIND_DO_CHECK_MEM_IS_ADDRESSABLE(iov[i].iov_base,
+			iov[i].iov_len);
+
+		uintptr_t start = (uintptr_t)iov[i].iov_base;
+		uintptr_t end = start + iov[i].iov_len;
+
+		ranges[nranges].start = ALIGN_DOWN(start,
+			(uintptr_t)CACHELINE_SIZE);
+		ranges[nranges].end = ALIGN_UP(end, (uintptr_t)CACHELINE_SIZE);
+		nranges++;
+	}
+
+	if (nranges > 1)
+		qsort(ranges, nranges, sizeof(*ranges), pmem_line_range_cmp);
+
+	struct pmem_line_range *cur = NULL;
+	for (size_t i = 0; i < nranges; ++i) {
+		if (cur != NULL && ranges[i].start <= cur->end) {
+			if (ranges[i].end > cur->end)
+				cur->end = ranges[i].end;
+			continue;
+		}
+
+		if (cur != NULL)
+			Funcs.flush((void *)cur->start, cur->end - cur->start);
+
+		cur = &ranges[i];
+	}
+
+	if (cur != NULL)
+		Funcs.flush((void *)cur->start, cur->end - cur->start);
+
+	if (ranges != stack_ranges)
+		Free(ranges);
+}
+
+/*
+ * pmem_persist_iov -- make any cached changes to a vector of ranges
+ *	persistent, with a single drain at the end
+ */
+void
+pmem_persist_iov(const struct iovec *iov, int iovcnt)
+{
+	LOG(15, "iov %p iovcnt %d", iov, iovcnt);
+
+	pmem_flush_iov(iov, iovcnt);
+	pmem_drain();
+}
+
 /*
  * pmem_msync -- flush to persistence via msync
  *
@@ -610,6 +732,16 @@ pmem_memmove(void *pmemdest, const void *src, size_t len, unsigned flags)
 		ERR("invalid flags 0x%x", flags);
 #endif
 
+	if (pmem_job_parallel(len, flags) &&
+			(uintptr_t)pmemdest - (uintptr_t)src >= len &&
+			(uintptr_t)src - (uintptr_t)pmemdest >= len) {
+		struct pmem_job job;
+		pmem_job_init(&job, pmem_job_memmove, pmemdest, src, 0, len,
+				flags);
+		if (pmem_job_run_parallel(&job) == 0)
+			return pmemdest;
+	}
+
 	Funcs.memmove_nodrain(pmemdest, src, len, flags & ~PMEM_F_MEM_NODRAIN);
 
 	if ((flags & (PMEM_F_MEM_NODRAIN | PMEM_F_MEM_NOFLUSH)) == 0)
@@ -641,6 +773,14 @@ pmem_memset(void *pmemdest, int c, size_t len, unsigned flags)
 		ERR("invalid flags 0x%x", flags);
 #endif
 
+	if (pmem_job_parallel(len, flags)) {
+		struct pmem_job job;
+		pmem_job_init(&job, pmem_job_memset, pmemdest, NULL, c, len,
+				flags);
+		if (pmem_job_run_parallel(&job) == 0)
+			return pmemdest;
+	}
+
 	Funcs.memset_nodrain(pmemdest, c, len, flags & ~PMEM_F_MEM_NODRAIN);
 
 	if ((flags & (PMEM_F_MEM_NODRAIN | PMEM_F_MEM_NOFLUSH)) == 0)
@@ -649,6 +789,35 @@ pmem_memset(void *pmemdest, int c, size_t len, unsigned flags)
 	return pmemdest;
 }
 
+/*
+ * pmem_job_memmove -- copies a chunk of a job executed by the worker pool
+ *
+ * The chunk is always drained, regardless of PMEM_F_MEM_NODRAIN and
+ * PMEM_F_MEM_NOFLUSH - a drain issued later by the caller of the operation
+ * only fences the stores of its own thread.
+ */
+void
+pmem_job_memmove(struct pmem_job *job, size_t off, size_t len)
+{
+	Funcs.memmove_nodrain(job->dest + off, job->src + off, len,
+			job->flags & ~PMEM_F_MEM_NODRAIN);
+
+	pmem_drain();
+}
+
+/*
+ * pmem_job_memset -- fills a chunk of a job executed by the worker pool
+ */
+void
+pmem_job_memset(struct pmem_job *job, size_t off, size_t len)
+{
+	Funcs.memset_nodrain(job->dest + off, job->c, len,
+			job->flags & ~PMEM_F_MEM_NODRAIN);
+
+	/* see pmem_job_memmove */
+	pmem_drain();
+}
+
 /*
  * pmem_memmove_nodrain -- memmove to pmem without hw drain
  */
@@ -711,8 +880,23 @@ pmem_init(void)
 {
 	LOG(3, NULL);
 
+	pmem_stats_init();
+	pmem_workers_init();
 	pmem_init_funcs(&Funcs);
 	pmem_os_init();
+	pmem_arch_ctl_register();
+}
+
+/*
+ * pmem_fini -- libpmem cleanup routine
+ */
+void
+pmem_fini(void)
+{
+	LOG(3, NULL);
+
+	pmem_workers_fini();
+	pmem_stats_fini();
 }
 
 /*
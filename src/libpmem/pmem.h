@@ -62,8 +62,10 @@ struct pmem_funcs {
 };
 
 void pmem_init(void);
+void pmem_fini(void);
 void pmem_os_init(void);
 void pmem_init_funcs(struct pmem_funcs *funcs);
+void pmem_arch_ctl_register(void);
 
 int is_pmem_detect(const void *addr, size_t len);
 void *pmem_map_register(int fd, size_t len, const char *path, int is_dev_dax);
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * stats.c -- per-thread libpmem statistics
+ */
+
+#include <errno.h>
+
+#include "ctl.h"
+#include "os_thread.h"
+#include "out.h"
+#include "stats.h"
+#include "sys_util.h"
+
+int Pmem_stats_enabled;
+__thread struct pmem_stats_thread *Pmem_stats_local;
+
+/*
+ * Used by threads for which the per-thread instance couldn't be allocated.
+ * Updates of these counters may race, so they're only approximate.
+ */
+static struct pmem_stats_thread Stats_fallback;
+
+/* totals of all threads that already exited */
+static struct pmem_stats Stats_retired;
+
+static struct pmem_stats_thread *Stats_threads;
+static os_mutex_t Stats_lock;
+static os_tls_key_t Stats_key;
+
+/*
+ * pmem_stats_add -- (internal) adds values of src counters to dst
+ */
+static void
+pmem_stats_add(struct pmem_stats *dst, const struct pmem_stats *src)
+{
+	dst->flushed_lines += src->flushed_lines;
+	dst->fences += src->fences;
+	dst->nt_bytes += src->nt_bytes;
+	dst->temporal_bytes += src->temporal_bytes;
+}
+
+/*
+ * pmem_stats_thread_unlink -- (internal) removes thread instance from
+ *	the global list, must be called with Stats_lock held
+ */
+static void
+pmem_stats_thread_unlink(struct pmem_stats_thread *t)
+{
+	if (t->prev)
+		t->prev->next = t->next;
+	else
+		Stats_threads = t->next;
+
+	if (t->next)
+		t->next->prev = t->prev;
+}
+
+/*
+ * pmem_stats_thread_destroy -- (internal) folds counters of an exiting
+ *	thread into the global totals
+ */
+static void
+pmem_stats_thread_destroy(void *arg)
+{
+	struct pmem_stats_thread *t = arg;
+
+	util_mutex_lock(&Stats_lock);
+	pmem_stats_add(&Stats_retired, &t->counters);
+	pmem_stats_thread_unlink(t);
+	util_mutex_unlock(&Stats_lock);
+
+	Pmem_stats_local = NULL;
+	Free(t);
+}
+
+/*
+ * pmem_stats_thread_register -- allocates counters of the calling thread
+ */
+struct pmem_stats_thread *
+pmem_stats_thread_register(void)
+{
+	struct pmem_stats_thread *t = Zalloc(sizeof(*t));
+	if (t == NULL) {
+		LOG(1, "!Zalloc");
+		Pmem_stats_local = &Stats_fallback;
+		return &Stats_fallback;
+	}
+
+	int ret = os_tls_set(Stats_key, t);
+	if (ret != 0) {
+		errno = ret;
+		LOG(1, "!os_tls_set");
+		Free(t);
+		Pmem_stats_local = &Stats_fallback;
+		return &Stats_fallback;
+	}
+
+	util_mutex_lock(&Stats_lock);
+	t->next = Stats_threads;
+	if (Stats_threads)
+		Stats_threads->prev = t;
+	Stats_threads = t;
+	util_mutex_unlock(&Stats_lock);
+
+	Pmem_stats_local = t;
+
+	return t;
+}
+
+/*
+ * pmem_stats_sum -- (internal) sums up the counters of all threads
+ */
+static void
+pmem_stats_sum(struct pmem_stats *sum)
+{
+	util_mutex_lock(&Stats_lock);
+
+	*sum = Stats_retired;
+	pmem_stats_add(sum, &Stats_fallback.counters);
+	for (struct pmem_stats_thread *t = Stats_threads; t; t = t->next)
+		pmem_stats_add(sum, &t->counters);
+
+	util_mutex_unlock(&Stats_lock);
+}
+
+#define PMEM_STATS_CTL_HANDLER(name)\
+static int CTL_READ_HANDLER(name)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	struct pmem_stats sum;\
+	pmem_stats_sum(&sum);\
+	*(uint64_t *)arg = sum.name;\
+	return 0;\
+}
+
+PMEM_STATS_CTL_HANDLER(flushed_lines);
+PMEM_STATS_CTL_HANDLER(fences);
+PMEM_STATS_CTL_HANDLER(nt_bytes);
+PMEM_STATS_CTL_HANDLER(temporal_bytes);
+
+/*
+ * CTL_READ_HANDLER(enabled) -- returns whether or not statistics are enabled
+ */
+static int
+CTL_READ_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+
+	*arg_out = Pmem_stats_enabled > 0;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled) -- enables or disables statistics counting
+ */
+static int
+CTL_WRITE_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+
+	Pmem_stats_enabled = arg_in > 0;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(stats)[] = {
+	CTL_LEAF_RW(enabled),
+	CTL_LEAF_RO(flushed_lines),
+	CTL_LEAF_RO(fences),
+	CTL_LEAF_RO(nt_bytes),
+	CTL_LEAF_RO(temporal_bytes),
+
+	CTL_NODE_END
+};
+
+/*
+ * pmem_stats_init -- initializes statistics and registers their ctl nodes
+ */
+void
+pmem_stats_init(void)
+{
+	util_mutex_init(&Stats_lock);
+
+	int ret = os_tls_key_create(&Stats_key, pmem_stats_thread_destroy);
+	if (ret != 0) {
+		errno = ret;
+		FATAL("!os_tls_key_create");
+	}
+
+	CTL_REGISTER_MODULE(NULL, stats);
+}
+
+/*
+ * pmem_stats_fini -- releases counters of all threads
+ */
+void
+pmem_stats_fini(void)
+{
+	Pmem_stats_enabled = 0;
+
+	(void) os_tls_key_delete(Stats_key);
+
+	while (Stats_threads) {
+		struct pmem_stats_thread *t = Stats_threads;
+		Stats_threads = t->next;
+		Free(t);
+	}
+	Pmem_stats_local = NULL;
+
+	util_mutex_destroy(&Stats_lock);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * stats.h -- internal definitions of libpmem statistics
+ */
+
+#ifndef PMEM_STATS_H
+#define PMEM_STATS_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+struct pmem_stats {
+	uint64_t flushed_lines;	/* cache lines explicitly flushed */
+	uint64_t fences;	/* store fences issued by pmem_drain */
+	uint64_t nt_bytes;	/* bytes written using non-temporal stores */
+	uint64_t temporal_bytes; /* bytes written using regular stores */
+};
+
+/*
+ * Counters are kept per thread, so that updating them costs a single
+ * non-atomic add on a thread-private cache line. Each thread's instance is
+ * linked into a global list when it's first used and its values are folded
+ * into the global totals when the thread exits.
+ */
+struct pmem_stats_thread {
+	struct pmem_stats counters;
+	struct pmem_stats_thread *prev;
+	struct pmem_stats_thread *next;
+};
+
+extern int Pmem_stats_enabled;
+extern __thread struct pmem_stats_thread *Pmem_stats_local;
+
+struct pmem_stats_thread *pmem_stats_thread_register(void);
+
+/*
+ * pmem_stats_local -- returns the calling thread's counters
+ */
+static inline struct pmem_stats *
+pmem_stats_local(void)
+{
+	struct pmem_stats_thread *t = Pmem_stats_local;
+	if (unlikely(t == NULL))
+		t = pmem_stats_thread_register();
+
+	return &t->counters;
+}
+
+/*
+ * pmem_stats_lines -- returns the number of cache lines spanned by a range
+ */
+static inline uint64_t
+pmem_stats_lines(const void *addr, size_t len)
+{
+	uintptr_t start = ALIGN_DOWN((uintptr_t)addr, CACHELINE_SIZE);
+	uintptr_t end = ALIGN_UP((uintptr_t)addr + len, CACHELINE_SIZE);
+
+	return (end - start) / CACHELINE_SIZE;
+}
+
+#define PMEM_STATS_INC(name, value) do {\
+	if (unlikely(Pmem_stats_enabled))\
+		pmem_stats_local()->name += (value);\
+} while (0)
+
+#define PMEM_STATS_FLUSH(addr, len) do {\
+	if (unlikely(Pmem_stats_enabled))\
+		pmem_stats_local()->flushed_lines +=\
+			pmem_stats_lines((addr), (len));\
+} while (0)
+
+void pmem_stats_init(void);
+void pmem_stats_fini(void);
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * wc.c -- write-combining staging of small persistent stores
+ *
+ * Stores are gathered in a DRAM copy of the cachelines they touch, which is
+ * an open addressing hash table keyed by the address of the line. On commit
+ * every fully written line is emitted with a single non-temporal store and
+ * partially written lines have only their modified bytes stored and flushed,
+ * so that bytes not written by the caller are never read nor rewritten.
+ */
+
+#include <string.h>
+
+#include "libpmem.h"
+#include "out.h"
+#include "pmem.h"
+#include "util.h"
+
+#define WC_LINE_SIZE 64
+#define WC_LINE_MASK ((uintptr_t)WC_LINE_SIZE - 1)
+#define WC_LINE_FULL UINT64_MAX
+
+#define WC_MIN_CAPACITY 16 /* must be a power of two */
+
+struct pmem_wc_line {
+	uintptr_t addr; /* persistent memory address, 0 if the slot is free */
+	uint64_t mask; /* bytes of the line written by the caller */
+	char data[WC_LINE_SIZE];
+};
+
+struct pmem_wc {
+	struct pmem_wc_line *lines;
+	size_t capacity;
+	size_t count;
+};
+
+/*
+ * wc_hash -- (internal) returns the slot of a cacheline address
+ */
+static inline size_t
+wc_hash(const struct pmem_wc *wc, uintptr_t addr)
+{
+	uint64_t h = (uint64_t)addr / WC_LINE_SIZE;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+
+	return (size_t)h & (wc->capacity - 1);
+}
+
+/*
+ * wc_line_find -- (internal) returns the line staged for the address or
+ *	the free slot where it should be inserted
+ */
+static struct pmem_wc_line *
+wc_line_find(struct pmem_wc *wc, uintptr_t addr)
+{
+	size_t i = wc_hash(wc, addr);
+	while (wc->lines[i].addr != 0 && wc->lines[i].addr != addr)
+		i = (i + 1) & (wc->capacity - 1);
+
+	return &wc->lines[i];
+}
+
+/*
+ * wc_reserve -- (internal) makes sure the table can hold nlines more lines
+ *	while staying at most half full
+ */
+static int
+wc_reserve(struct pmem_wc *wc, size_t nlines)
+{
+	size_t capacity = wc->capacity;
+	while ((wc->count + nlines) * 2 > capacity)
+		capacity *= 2;
+
+	if (capacity == wc->capacity)
+		return 0;
+
+	struct pmem_wc_line *old = wc->lines;
+	size_t old_capacity = wc->capacity;
+
+	wc->lines = Zalloc(capacity * sizeof(*wc->lines));
+	if (wc->lines == NULL) {
+		ERR("!Zalloc");
+		wc->lines = old;
+		return -1;
+	}
+	wc->capacity = capacity;
+
+	for (size_t i = 0; i < old_capacity; ++i) {
+		if (old[i].addr != 0)
+			*wc_line_find(wc, old[i].addr) = old[i];
+	}
+
+	Free(old);
+
+	return 0;
+}
+
+/*
+ * wc_line_commit -- (internal) stores the bytes of a partially written line
+ */
+static void
+wc_line_commit(const struct pmem_wc_line *line)
+{
+	char *dest = (char *)line->addr;
+	uint64_t mask = line->mask;
+
+	/* copy every run of consecutive written bytes separately */
+	while (mask != 0) {
+		unsigned first = util_lssb_index64(mask);
+		uint64_t unwritten = ~mask & (WC_LINE_FULL << first);
+		unsigned end = unwritten == 0 ? WC_LINE_SIZE :
+				util_lssb_index64(unwritten);
+
+		pmem_memcpy(dest + first, line->data + first, end - first,
+				PMEM_F_MEM_NOFLUSH);
+
+		mask = end == WC_LINE_SIZE ? 0 : mask & (WC_LINE_FULL << end);
+	}
+
+	pmem_flush(dest, WC_LINE_SIZE);
+}
+
+/*
+ * pmem_wc_begin -- starts a new batch of staged stores
+ */
+struct pmem_wc *
+pmem_wc_begin(void)
+{
+	LOG(15, NULL);
+
+	struct pmem_wc *wc = Malloc(sizeof(*wc));
+	if (wc == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	wc->lines = Zalloc(WC_MIN_CAPACITY * sizeof(*wc->lines));
+	if (wc->lines == NULL) {
+		ERR("!Zalloc");
+		Free(wc);
+		return NULL;
+	}
+	wc->capacity = WC_MIN_CAPACITY;
+	wc->count = 0;
+
+	return wc;
+}
+
+/*
+ * pmem_wc_write -- stages a store of len bytes to pmemdest
+ */
+int
+pmem_wc_write(struct pmem_wc *wc, void *pmemdest, const void *src, size_t len)
+{
+	LOG(15, "wc %p pmemdest %p src %p len %zu", wc, pmemdest, src, len);
+
+	if (len == 0)
+		return 0;
+
+	uintptr_t dest = (uintptr_t)pmemdest;
+	uintptr_t first = dest & ~WC_LINE_MASK;
+	uintptr_t last = (dest + len - 1) & ~WC_LINE_MASK;
+
+	/* reserve all the lines upfront, so that a write is never partial */
+	if (wc_reserve(wc, (last - first) / WC_LINE_SIZE + 1))
+		return -1;
+
+	const char *s = src;
+	while (len > 0) {
+		uintptr_t addr = dest & ~WC_LINE_MASK;
+		size_t off = dest - addr;
+		size_t n = WC_LINE_SIZE - off;
+		if (n > len)
+			n = len;
+
+		struct pmem_wc_line *line = wc_line_find(wc, addr);
+		if (line->addr == 0) {
+			line->addr = addr;
+			wc->count++;
+		}
+
+		memcpy(line->data + off, s, n);
+		line->mask |= n == WC_LINE_SIZE ? WC_LINE_FULL :
+				((1ULL << n) - 1) << off;
+
+		dest += n;
+		s += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * pmem_wc_commit -- makes all staged stores persistent and releases
+ *	the batch
+ */
+void
+pmem_wc_commit(struct pmem_wc *wc)
+{
+	LOG(15, "wc %p", wc);
+
+	for (size_t i = 0; i < wc->capacity; ++i) {
+		struct pmem_wc_line *line = &wc->lines[i];
+		if (line->addr == 0)
+			continue;
+
+		if (line->mask == WC_LINE_FULL)
+			pmem_memcpy((void *)line->addr, line->data,
+				WC_LINE_SIZE,
+				PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
+		else
+			wc_line_commit(line);
+	}
+
+	if (wc->count != 0)
+		pmem_drain();
+
+	Free(wc->lines);
+	Free(wc);
+}
@@ -0,0 +1,406 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * workers.c -- pool of threads executing large copies in chunks
+ *
+ * The pool is started lazily, when the first job is submitted. Each job is
+ * split into slices aligned to PMEM_JOB_CHUNK, which are claimed one at a
+ * time by the workers and by the thread waiting for the job, so a waiter
+ * never sleeps while there's still work to be done.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "ctl.h"
+#include "os_thread.h"
+#include "out.h"
+#include "pmem.h"
+#include "sys_util.h"
+#include "util.h"
+#include "workers.h"
+
+#define PMEM_WORKERS_DEFAULT 4
+
+/* 0 means only operations with PMEM_F_MEM_PARALLEL flag are split */
+size_t Pmem_parallel_threshold;
+
+static struct {
+	os_mutex_t lock;
+	os_cond_t work;		/* signaled when a job is queued */
+	os_cond_t done;		/* broadcast when a job completes */
+
+	struct pmem_job *head;	/* queue of jobs with unclaimed chunks */
+	struct pmem_job *tail;
+
+	os_thread_t threads[PMEM_WORKERS_MAX];
+	unsigned nthreads;	/* number of running threads */
+	unsigned count;		/* number of threads to start */
+	int stop;
+} Workers;
+
+/*
+ * pmem_job_init -- initializes a job
+ */
+void
+pmem_job_init(struct pmem_job *job, pmem_job_func func, void *dest,
+	const void *src, int c, size_t len, unsigned flags)
+{
+	job->func = func;
+	job->dest = dest;
+	job->src = src;
+	job->c = c;
+	job->flags = flags;
+	job->len = len;
+	job->claimed = 0;
+	job->completed = 0;
+	job->next = NULL;
+}
+
+/*
+ * pmem_job_dequeue -- (internal) removes a job from the queue,
+ *	must be called with the pool lock held
+ */
+static void
+pmem_job_dequeue(struct pmem_job *job)
+{
+	struct pmem_job **prev = &Workers.head;
+	struct pmem_job *last = NULL;
+
+	while (*prev != job) {
+		last = *prev;
+		prev = &(*prev)->next;
+	}
+
+	*prev = job->next;
+	if (Workers.tail == job)
+		Workers.tail = last;
+
+	job->next = NULL;
+}
+
+/*
+ * pmem_job_claim -- (internal) claims next chunk of the job, must be called
+ *	with the pool lock held
+ */
+static size_t
+pmem_job_claim(struct pmem_job *job, size_t *off)
+{
+	ASSERT(job->claimed < job->len);
+
+	uintptr_t start = (uintptr_t)job->dest + job->claimed;
+	size_t len = (size_t)(ALIGN_DOWN(start + PMEM_JOB_CHUNK,
+			PMEM_JOB_CHUNK) - start);
+	if (len > job->len - job->claimed)
+		len = job->len - job->claimed;
+
+	*off = job->claimed;
+	job->claimed += len;
+
+	if (job->claimed == job->len)
+		pmem_job_dequeue(job);
+
+	return len;
+}
+
+/*
+ * pmem_job_run -- (internal) executes a chunk of the job, must be called
+ *	with the pool lock held, drops it for the time of the copy
+ */
+static void
+pmem_job_run(struct pmem_job *job)
+{
+	size_t off;
+	size_t len = pmem_job_claim(job, &off);
+
+	util_mutex_unlock(&Workers.lock);
+	job->func(job, off, len);
+	util_mutex_lock(&Workers.lock);
+
+	job->completed += len;
+	if (job->completed == job->len)
+		os_cond_broadcast(&Workers.done);
+}
+
+/*
+ * pmem_worker -- (internal) worker thread main loop
+ */
+static void *
+pmem_worker(void *arg)
+{
+	util_mutex_lock(&Workers.lock);
+
+	while (!Workers.stop) {
+		if (Workers.head == NULL) {
+			os_cond_wait(&Workers.work, &Workers.lock);
+			continue;
+		}
+
+		pmem_job_run(Workers.head);
+	}
+
+	util_mutex_unlock(&Workers.lock);
+
+	return NULL;
+}
+
+/*
+ * pmem_workers_start -- (internal) starts the worker threads, must be called
+ *	with the pool lock held
+ */
+static int
+pmem_workers_start(void)
+{
+	while (Workers.nthreads < Workers.count) {
+		int ret = os_thread_create(&Workers.threads[Workers.nthreads],
+				NULL, pmem_worker, NULL);
+		if (ret) {
+			errno = ret;
+			ERR("!os_thread_create");
+			break;
+		}
+		Workers.nthreads++;
+	}
+
+	return Workers.nthreads ? 0 : -1;
+}
+
+/*
+ * pmem_job_submit -- queues a job for execution by the worker pool
+ */
+int
+pmem_job_submit(struct pmem_job *job)
+{
+	LOG(15, "job %p dest %p len %zu", job, job->dest, job->len);
+
+	if (job->len == 0)
+		return 0;
+
+	util_mutex_lock(&Workers.lock);
+
+	if (Workers.nthreads == 0 && pmem_workers_start()) {
+		util_mutex_unlock(&Workers.lock);
+		return -1;
+	}
+
+	if (Workers.tail)
+		Workers.tail->next = job;
+	else
+		Workers.head = job;
+	Workers.tail = job;
+
+	os_cond_broadcast(&Workers.work);
+	util_mutex_unlock(&Workers.lock);
+
+	return 0;
+}
+
+/*
+ * pmem_job_poll -- returns 1 if the job has been completed, 0 otherwise
+ */
+int
+pmem_job_poll(struct pmem_job *job)
+{
+	util_mutex_lock(&Workers.lock);
+	int done = job->completed == job->len;
+	util_mutex_unlock(&Workers.lock);
+
+	return done;
+}
+
+/*
+ * pmem_job_wait -- executes the remaining chunks of the job on the calling
+ *	thread and waits for the ones claimed by the workers
+ */
+void
+pmem_job_wait(struct pmem_job *job)
+{
+	util_mutex_lock(&Workers.lock);
+
+	while (job->claimed < job->len)
+		pmem_job_run(job);
+
+	while (job->completed < job->len)
+		os_cond_wait(&Workers.done, &Workers.lock);
+
+	util_mutex_unlock(&Workers.lock);
+}
+
+/*
+ * pmem_job_run_parallel -- executes the job using the worker threads and
+ *	the calling thread, returns -1 if the worker pool is not available
+ */
+int
+pmem_job_run_parallel(struct pmem_job *job)
+{
+	if (pmem_job_submit(job))
+		return -1;
+
+	pmem_job_wait(job);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(count) -- returns the number of worker threads
+ */
+static int
+CTL_READ_HANDLER(count)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+
+	util_mutex_lock(&Workers.lock);
+	*arg_out = (int)Workers.count;
+	util_mutex_unlock(&Workers.lock);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(count) -- changes the number of worker threads,
+ *	possible only before the pool is started
+ */
+static int
+CTL_WRITE_HANDLER(count)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+	if (arg_in < 1 || arg_in > PMEM_WORKERS_MAX) {
+		ERR("invalid number of workers %d", arg_in);
+		errno = EINVAL;
+		return -1;
+	}
+
+	int ret = 0;
+	util_mutex_lock(&Workers.lock);
+	if (Workers.nthreads) {
+		ERR("worker pool already started");
+		errno = EBUSY;
+		ret = -1;
+	} else {
+		Workers.count = (unsigned)arg_in;
+	}
+	util_mutex_unlock(&Workers.lock);
+
+	return ret;
+}
+
+static struct ctl_argument CTL_ARG(count) = CTL_ARG_INT;
+
+/*
+ * CTL_READ_HANDLER(parallel_threshold) -- returns the minimum length of
+ *	the operations split between the worker threads
+ */
+static int
+CTL_READ_HANDLER(parallel_threshold)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t *arg_out = arg;
+	*arg_out = (ssize_t)Pmem_parallel_threshold;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(parallel_threshold) -- changes the minimum length of
+ *	the operations split between the worker threads
+ */
+static int
+CTL_WRITE_HANDLER(parallel_threshold)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t arg_in = *(ssize_t *)arg;
+	if (arg_in < 0) {
+		ERR("invalid parallel threshold %zd", arg_in);
+		errno = EINVAL;
+		return -1;
+	}
+
+	Pmem_parallel_threshold = (size_t)arg_in;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(parallel_threshold) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(workers)[] = {
+	CTL_LEAF_RW(count),
+	CTL_LEAF_RW(parallel_threshold),
+
+	CTL_NODE_END
+};
+
+/*
+ * pmem_workers_init -- initializes the worker pool, the threads are started
+ *	when the first job is submitted
+ */
+void
+pmem_workers_init(void)
+{
+	util_mutex_init(&Workers.lock);
+
+	int ret;
+	if ((ret = os_cond_init(&Workers.work)) != 0 ||
+			(ret = os_cond_init(&Workers.done)) != 0) {
+		errno = ret;
+		FATAL("!os_cond_init");
+	}
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	Workers.count = PMEM_WORKERS_DEFAULT;
+	if (cpus > 0 && cpus < PMEM_WORKERS_DEFAULT)
+		Workers.count = (unsigned)cpus;
+
+	CTL_REGISTER_MODULE(NULL, workers);
+}
+
+/*
+ * pmem_workers_fini -- stops the worker threads
+ */
+void
+pmem_workers_fini(void)
+{
+	util_mutex_lock(&Workers.lock);
+	Workers.stop = 1;
+	os_cond_broadcast(&Workers.work);
+	util_mutex_unlock(&Workers.lock);
+
+	for (unsigned i = 0; i < Workers.nthreads; ++i)
+		os_thread_join(&Workers.threads[i], NULL);
+	Workers.nthreads = 0;
+
+	(void) os_cond_destroy(&Workers.done);
+	(void) os_cond_destroy(&Workers.work);
+	util_mutex_destroy(&Workers.lock);
+}
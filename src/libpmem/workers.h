@@ -0,0 +1,102 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * workers.h -- internal definitions of the libpmem worker pool
+ */
+
+#ifndef PMEM_WORKERS_H
+#define PMEM_WORKERS_H 1
+
+#include <stddef.h>
+
+#include "libpmem.h"
+
+#define PMEM_WORKERS_MAX 64
+
+/* jobs are split into slices aligned to this boundary of the destination */
+#define PMEM_JOB_CHUNK (2ULL << 20) /* 2 MiB */
+
+struct pmem_job;
+
+typedef void (*pmem_job_func)(struct pmem_job *job, size_t off, size_t len);
+
+/*
+ * A single copy or fill operation executed in chunks by the worker pool.
+ * All fields below 'len' are protected by the pool lock.
+ */
+struct pmem_job {
+	pmem_job_func func;
+	char *dest;
+	const char *src;
+	int c;
+	unsigned flags;
+	size_t len;
+
+	size_t claimed;		/* bytes handed out to threads */
+	size_t completed;	/* bytes already copied */
+	struct pmem_job *next;	/* next job with unclaimed chunks */
+};
+
+extern size_t Pmem_parallel_threshold;
+
+/*
+ * pmem_job_parallel -- returns whether a synchronous operation should be
+ *	split between the worker threads
+ */
+static inline int
+pmem_job_parallel(size_t len, unsigned flags)
+{
+	if (len <= PMEM_JOB_CHUNK)
+		return 0;
+
+	if (flags & PMEM_F_MEM_PARALLEL)
+		return 1;
+
+	return Pmem_parallel_threshold != 0 && len >= Pmem_parallel_threshold;
+}
+
+/* job functions executing chunks of memmove and memset, see pmem.c */
+void pmem_job_memmove(struct pmem_job *job, size_t off, size_t len);
+void pmem_job_memset(struct pmem_job *job, size_t off, size_t len);
+
+void pmem_job_init(struct pmem_job *job, pmem_job_func func, void *dest,
+	const void *src, int c, size_t len, unsigned flags);
+int pmem_job_submit(struct pmem_job *job);
+int pmem_job_poll(struct pmem_job *job);
+void pmem_job_wait(struct pmem_job *job);
+int pmem_job_run_parallel(struct pmem_job *job);
+
+void pmem_workers_init(void);
+void pmem_workers_fini(void);
+
+#endif
@@ -30,20 +30,35 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <inttypes.h>
 #include <string.h>
+#include <time.h>
 #include <xmmintrin.h>
 #include "libpmem.h"
 
 #include "cpu.h"
+#include "ctl.h"
 #include "flush.h"
 #include "memcpy_memset.h"
 #include "os.h"
 #include "out.h"
 #include "pmem.h"
+#include "stats.h"
 #include "valgrind_internal.h"
 
 #define MOVNT_THRESHOLD	256
 
+/*
+ * Range of copy sizes probed by the movnt threshold calibration. The scratch
+ * buffer is much bigger than the largest copy, so that most of the stores
+ * hit cache lines which are not in the CPU cache already, like they would
+ * when writing to a freshly mapped pmem range.
+ */
+#define MOVNT_CALIBRATION_MIN_SIZE	64
+#define MOVNT_CALIBRATION_MAX_SIZE	(64 * 1024)
+#define MOVNT_CALIBRATION_BUF_SIZE	(4 * 1024 * 1024)
+#define MOVNT_CALIBRATION_ROUNDS	3
+
 size_t Movnt_threshold = MOVNT_THRESHOLD;
 
 /*
@@ -66,6 +81,7 @@ predrain_memory_barrier(void)
 {
 	LOG(15, NULL);
 	_mm_sfence();	/* ensure CLWB or CLFLUSHOPT completes */
+	PMEM_STATS_INC(fences, 1);
 }
 
 /*
@@ -77,6 +93,7 @@ flush_clflush(const void *addr, size_t len)
 	LOG(15, "addr %p len %zu", addr, len);
 
 	flush_clflush_nolog(addr, len);
+	PMEM_STATS_FLUSH(addr, len);
 }
 
 /*
@@ -88,6 +105,7 @@ flush_clflushopt(const void *addr, size_t len)
 	LOG(15, "addr %p len %zu", addr, len);
 
 	flush_clflushopt_nolog(addr, len);
+	PMEM_STATS_FLUSH(addr, len);
 }
 
 /*
@@ -99,6 +117,7 @@ flush_clwb(const void *addr, size_t len)
 	LOG(15, "addr %p len %zu", addr, len);
 
 	flush_clwb_nolog(addr, len);
+	PMEM_STATS_FLUSH(addr, len);
 }
 
 /*
@@ -116,6 +135,37 @@ flush_empty(const void *addr, size_t len)
 #define PMEM_F_MEM_MOVNT (PMEM_F_MEM_WC | PMEM_F_MEM_NONTEMPORAL)
 #define PMEM_F_MEM_MOV   (PMEM_F_MEM_WB | PMEM_F_MEM_TEMPORAL)
 
+/*
+ * use_movnt -- (internal) returns whether non-temporal stores should be used
+ *	for an operation of the given length and flags
+ */
+static force_inline int
+use_movnt(size_t len, unsigned flags)
+{
+	if (flags & PMEM_F_MEM_MOVNT)
+		return 1;
+	if (flags & PMEM_F_MEM_MOV)
+		return 0;
+
+	return len >= Movnt_threshold;
+}
+
+/*
+ * stats_mov -- (internal) accounts a temporal copy or fill followed by
+ *	a flush using the given function
+ */
+static force_inline void
+stats_mov(const void *dest, size_t len, flush_func flush)
+{
+	if (unlikely(Pmem_stats_enabled)) {
+		struct pmem_stats *s = pmem_stats_local();
+
+		s->temporal_bytes += len;
+		if (flush != flush_empty)
+			s->flushed_lines += pmem_stats_lines(dest, len);
+	}
+}
+
 #define MEMCPY_TEMPLATE(isa, flush) \
 static void *\
 memmove_nodrain_##isa##_##flush(void *dest, const void *src, size_t len, \
@@ -124,16 +174,16 @@ memmove_nodrain_##isa##_##flush(void *dest, const void *src, size_t len, \
 	if (len == 0 || src == dest)\
 		return dest;\
 \
-	if (flags & PMEM_F_MEM_NOFLUSH) \
-		memmove_mov_##isa##_empty(dest, src, len); \
-	else if (flags & PMEM_F_MEM_MOVNT)\
-		memmove_movnt_##isa ##_##flush(dest, src, len);\
-	else if (flags & PMEM_F_MEM_MOV)\
-		memmove_mov_##isa##_##flush(dest, src, len);\
-	else if (len < Movnt_threshold)\
-		memmove_mov_##isa##_##flush(dest, src, len);\
-	else\
+	if (flags & PMEM_F_MEM_NOFLUSH) {\
+		memmove_mov_##isa##_empty(dest, src, len);\
+		PMEM_STATS_INC(temporal_bytes, len);\
+	} else if (use_movnt(len, flags)) {\
 		memmove_movnt_##isa##_##flush(dest, src, len);\
+		PMEM_STATS_INC(nt_bytes, len);\
+	} else {\
+		memmove_mov_##isa##_##flush(dest, src, len);\
+		stats_mov(dest, len, flush_##flush);\
+	}\
 \
 	return dest;\
 }
@@ -145,16 +195,16 @@ memset_nodrain_##isa##_##flush(void *dest, int c, size_t len, unsigned flags)\
 	if (len == 0)\
 		return dest;\
 \
-	if (flags & PMEM_F_MEM_NOFLUSH) \
-		memset_mov_##isa##_empty(dest, c, len); \
-	else if (flags & PMEM_F_MEM_MOVNT)\
+	if (flags & PMEM_F_MEM_NOFLUSH) {\
+		memset_mov_##isa##_empty(dest, c, len);\
+		PMEM_STATS_INC(temporal_bytes, len);\
+	} else if (use_movnt(len, flags)) {\
 		memset_movnt_##isa##_##flush(dest, c, len);\
-	else if (flags & PMEM_F_MEM_MOV)\
+		PMEM_STATS_INC(nt_bytes, len);\
+	} else {\
 		memset_mov_##isa##_##flush(dest, c, len);\
-	else if (len < Movnt_threshold)\
-		memset_mov_##isa##_##flush(dest, c, len);\
-	else\
-		memset_movnt_##isa##_##flush(dest, c, len);\
+		stats_mov(dest, len, flush_##flush);\
+	}\
 \
 	return dest;\
 }
@@ -208,6 +258,7 @@ memmove_nodrain_libc(void *pmemdest, const void *src, size_t len,
 	(void) flags;
 
 	memmove(pmemdest, src, len);
+	PMEM_STATS_INC(temporal_bytes, len);
 	pmem_flush_flags(pmemdest, len, flags);
 	return pmemdest;
 }
@@ -223,6 +274,7 @@ memset_nodrain_libc(void *pmemdest, int c, size_t len, unsigned flags)
 	(void) flags;
 
 	memset(pmemdest, c, len);
+	PMEM_STATS_INC(temporal_bytes, len);
 	pmem_flush_flags(pmemdest, len, flags);
 	return pmemdest;
 }
@@ -359,6 +411,94 @@ use_avx512f_memcpy_memset(struct pmem_funcs *funcs, enum memcpy_impl *impl)
 #endif
 }
 
+/*
+ * movnt_calibration_time -- (internal) returns the best time (in nanoseconds)
+ *	of copying the whole scratch buffer in chunks of the given size
+ */
+static uint64_t
+movnt_calibration_time(const struct pmem_funcs *funcs, char *dst,
+	const char *src, size_t size, unsigned flags)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (int r = 0; r < MOVNT_CALIBRATION_ROUNDS; ++r) {
+		struct timespec start;
+		struct timespec end;
+
+		os_clock_gettime(CLOCK_MONOTONIC, &start);
+		for (size_t off = 0; off < MOVNT_CALIBRATION_BUF_SIZE;
+				off += size) {
+			funcs->memmove_nodrain(dst + off, src + off, size,
+				flags);
+			funcs->predrain_fence();
+		}
+		os_clock_gettime(CLOCK_MONOTONIC, &end);
+
+		uint64_t t = (uint64_t)(end.tv_sec - start.tv_sec) *
+			1000000000ULL +
+			(uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+		if (t < best)
+			best = t;
+	}
+
+	return best;
+}
+
+/*
+ * movnt_calibrate -- (internal) measures the crossover point between
+ *	temporal and non-temporal stores of the selected memmove variant
+ *
+ * The threshold is set to the smallest probed size from which non-temporal
+ * stores are never slower than temporal stores followed by a flush.
+ * Returns 0 on success, -1 if the calibration could not be performed.
+ */
+static int
+movnt_calibrate(const struct pmem_funcs *funcs)
+{
+	LOG(3, NULL);
+
+	if (funcs->memmove_nodrain == memmove_nodrain_generic ||
+			funcs->memmove_nodrain == memmove_nodrain_libc) {
+		LOG(3, "movnt not used, skipping calibration");
+		return -1;
+	}
+
+	char *buf = Malloc(2 * MOVNT_CALIBRATION_BUF_SIZE + FLUSH_ALIGN);
+	if (buf == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	char *src = (char *)ALIGN_UP((uintptr_t)buf, FLUSH_ALIGN);
+	char *dst = src + MOVNT_CALIBRATION_BUF_SIZE;
+	memset(src, 0xc5, MOVNT_CALIBRATION_BUF_SIZE);
+	memset(dst, 0, MOVNT_CALIBRATION_BUF_SIZE);
+
+	size_t threshold = MOVNT_CALIBRATION_MAX_SIZE * 2;
+	for (size_t size = MOVNT_CALIBRATION_MAX_SIZE;
+			size >= MOVNT_CALIBRATION_MIN_SIZE; size /= 2) {
+		uint64_t t = movnt_calibration_time(funcs, dst, src, size,
+			PMEM_F_MEM_TEMPORAL);
+		uint64_t nt = movnt_calibration_time(funcs, dst, src, size,
+			PMEM_F_MEM_NONTEMPORAL);
+
+		LOG(4, "size %zu temporal %" PRIu64 "ns non-temporal %"
+			PRIu64 "ns", size, t, nt);
+
+		if (nt > t)
+			break;
+
+		threshold = size;
+	}
+
+	Free(buf);
+
+	LOG(3, "calibrated movnt threshold %zu", threshold);
+	Movnt_threshold = threshold;
+
+	return 0;
+}
+
 /*
  * pmem_get_cpuinfo -- configure libpmem based on CPUID
  */
@@ -444,17 +584,6 @@ pmem_init_funcs(struct pmem_funcs *funcs)
 	 * and pmem_memset_*().
 	 * It has no effect if movnt is not supported or disabled.
 	 */
-	ptr = os_getenv("PMEM_MOVNT_THRESHOLD");
-	if (ptr) {
-		long long val = atoll(ptr);
-
-		if (val < 0) {
-			LOG(3, "Invalid PMEM_MOVNT_THRESHOLD");
-		} else {
-			LOG(3, "PMEM_MOVNT_THRESHOLD set to %zu", (size_t)val);
-			Movnt_threshold = (size_t)val;
-		}
-	}
 
 	int flush;
 	char *e = os_getenv("PMEM_NO_FLUSH");
@@ -479,6 +608,27 @@ pmem_init_funcs(struct pmem_funcs *funcs)
 		funcs->predrain_fence = predrain_memory_barrier;
 	}
 
+	ptr = os_getenv("PMEM_MOVNT_THRESHOLD");
+	if (ptr) {
+		long long val = atoll(ptr);
+
+		if (val < 0) {
+			LOG(3, "Invalid PMEM_MOVNT_THRESHOLD");
+		} else {
+			LOG(3, "PMEM_MOVNT_THRESHOLD set to %zu", (size_t)val);
+			Movnt_threshold = (size_t)val;
+		}
+	} else {
+		/*
+		 * The calibration runs only on request, because it takes
+		 * a noticeable amount of time and its result depends on
+		 * what else is running on the machine at the moment.
+		 */
+		ptr = os_getenv("PMEM_MOVNT_CALIBRATE");
+		if (ptr && strcmp(ptr, "1") == 0)
+			(void) movnt_calibrate(funcs);
+	}
+
 	if (funcs->deep_flush == flush_clwb)
 		LOG(3, "using clwb");
 	else if (funcs->deep_flush == flush_clflushopt)
@@ -506,3 +656,52 @@ pmem_init_funcs(struct pmem_funcs *funcs)
 	else
 		FATAL("invalid memcpy impl");
 }
+
+/*
+ * CTL_READ_HANDLER(threshold) -- returns the current movnt threshold
+ */
+static int
+CTL_READ_HANDLER(threshold)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t *arg_out = arg;
+	*arg_out = (ssize_t)Movnt_threshold;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(threshold) -- changes the movnt threshold
+ */
+static int
+CTL_WRITE_HANDLER(threshold)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t arg_in = *(ssize_t *)arg;
+	if (arg_in < 0) {
+		ERR("movnt threshold cannot be negative");
+		errno = EINVAL;
+		return -1;
+	}
+
+	Movnt_threshold = (size_t)arg_in;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(threshold) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(movnt)[] = {
+	CTL_LEAF_RW(threshold),
+
+	CTL_NODE_END
+};
+
+/*
+ * pmem_arch_ctl_register -- registers architecture-specific ctl entry points
+ */
+void
+pmem_arch_ctl_register(void)
+{
+	CTL_REGISTER_MODULE(NULL, movnt);
+}
@@ -44,4 +44,11 @@ memmove_small_avx512f(char *dest, const char *src, size_t len)
 	memmove_small_avx(dest, src, len);
 }
 
+static force_inline int
+memmove_fixed_avx512f(char *dest, const char *src, size_t len)
+{
+	/* Fixed-size copies are at most 4 cache lines, AVX is enough. */
+	return memmove_fixed_avx(dest, src, len);
+}
+
 #endif
@@ -38,6 +38,7 @@
 #include <stdint.h>
 
 #include "libpmem.h"
+#include "memcpy_memset.h"
 #include "out.h"
 
 static force_inline void
@@ -131,4 +132,65 @@ memmove_small_sse2(char *dest, const char *src, size_t len)
 	flush(dest, len);
 }
 
+static force_inline void
+memmove_fixed_sse2_64b(char *dest, const char *src)
+{
+	__m128i xmm0 = _mm_loadu_si128((__m128i *)src + 0);
+	__m128i xmm1 = _mm_loadu_si128((__m128i *)src + 1);
+	__m128i xmm2 = _mm_loadu_si128((__m128i *)src + 2);
+	__m128i xmm3 = _mm_loadu_si128((__m128i *)src + 3);
+
+	_mm_storeu_si128((__m128i *)dest + 0, xmm0);
+	_mm_storeu_si128((__m128i *)dest + 1, xmm1);
+	_mm_storeu_si128((__m128i *)dest + 2, xmm2);
+	_mm_storeu_si128((__m128i *)dest + 3, xmm3);
+}
+
+/*
+ * memmove_fixed_sse2 -- copies len bytes forward using a fixed-size kernel,
+ *	returns 0 if len is not one of the fixed size classes
+ *
+ * Each 64-byte chunk is loaded before it is stored, so this is safe for
+ * every overlap for which a forward copy is safe.
+ */
+static force_inline int
+memmove_fixed_sse2(char *dest, const char *src, size_t len)
+{
+	switch (fixed_size_class(len)) {
+	case 3:
+		*(uint64_t *)dest = *(uint64_t *)src;
+		break;
+	case 4:
+		_mm_storeu_si128((__m128i *)dest,
+				_mm_loadu_si128((__m128i *)src));
+		break;
+	case 5: {
+		__m128i xmm0 = _mm_loadu_si128((__m128i *)src + 0);
+		__m128i xmm1 = _mm_loadu_si128((__m128i *)src + 1);
+
+		_mm_storeu_si128((__m128i *)dest + 0, xmm0);
+		_mm_storeu_si128((__m128i *)dest + 1, xmm1);
+		break;
+	}
+	case 6:
+		memmove_fixed_sse2_64b(dest, src);
+		break;
+	case 7:
+		memmove_fixed_sse2_64b(dest + 0 * 64, src + 0 * 64);
+		memmove_fixed_sse2_64b(dest + 1 * 64, src + 1 * 64);
+		break;
+	case 8:
+		memmove_fixed_sse2_64b(dest + 0 * 64, src + 0 * 64);
+		memmove_fixed_sse2_64b(dest + 1 * 64, src + 1 * 64);
+		memmove_fixed_sse2_64b(dest + 2 * 64, src + 2 * 64);
+		memmove_fixed_sse2_64b(dest + 3 * 64, src + 3 * 64);
+		break;
+	default:
+		return 0;
+	}
+
+	flush(dest, len);
+	return 1;
+}
+
 #endif
@@ -402,9 +402,14 @@ memmove_mov_avx512f_bw(char *dest, const char *src, size_t len)
 void
 EXPORTED_SYMBOL(char *dest, const char *src, size_t len)
 {
-	if ((uintptr_t)dest - (uintptr_t)src >= len)
+	if ((uintptr_t)dest - (uintptr_t)src >= len) {
+		if (memmove_fixed_avx512f(dest, src, len)) {
+			avx_zeroupper();
+			return;
+		}
+
 		memmove_mov_avx512f_fw(dest, src, len);
-	else
+	} else
 		memmove_mov_avx512f_bw(dest, src, len);
 
 	avx_zeroupper();
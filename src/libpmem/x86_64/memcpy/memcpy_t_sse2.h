@@ -211,8 +211,11 @@ memmove_mov_sse_bw(char *dest, const char *src, size_t len)
 void
 EXPORTED_SYMBOL(char *dest, const char *src, size_t len)
 {
-	if ((uintptr_t)dest - (uintptr_t)src >= len)
+	if ((uintptr_t)dest - (uintptr_t)src >= len) {
+		if (memmove_fixed_sse2(dest, src, len))
+			return;
+
 		memmove_mov_sse_fw(dest, src, len);
-	else
+	} else
 		memmove_mov_sse_bw(dest, src, len);
 }
@@ -36,6 +36,7 @@
 #include <stddef.h>
 #include <xmmintrin.h>
 #include "pmem.h"
+#include "util.h"
 
 static inline void
 barrier_after_ntstores(void)
@@ -132,4 +133,27 @@ void memset_movnt_avx512f_empty(char *dest, int c, size_t len);
 
 extern size_t Movnt_threshold;
 
+/*
+ * Temporal copies and fills of exactly 8, 16, 32, 64, 128 or 256 bytes are
+ * handed to fixed-size kernels, which skip the alignment prologue and the
+ * tail handling of the generic loops and flush every touched line once.
+ */
+#define FIXED_SIZE_MIN_SHIFT 3
+#define FIXED_SIZE_MAX_SHIFT 8
+
+/*
+ * fixed_size_class -- returns log2(len) if len has a fixed-size kernel,
+ *	0 otherwise
+ */
+static force_inline unsigned
+fixed_size_class(size_t len)
+{
+	if (len < (1U << FIXED_SIZE_MIN_SHIFT) ||
+			len > (1U << FIXED_SIZE_MAX_SHIFT) ||
+			!util_is_pow2(len))
+		return 0;
+
+	return util_mssb_index((unsigned)len);
+}
+
 #endif
@@ -40,6 +40,7 @@
 
 #include "avx.h"
 #include "libpmem.h"
+#include "memcpy_memset.h"
 #include "out.h"
 
 static force_inline void
@@ -112,4 +113,49 @@ memset_small_avx(char *dest, __m256i ymm, size_t len)
 	flush(dest, len);
 }
 
+static force_inline void
+memset_fixed_avx_64b(char *dest, __m256i ymm)
+{
+	_mm256_storeu_si256((__m256i *)dest + 0, ymm);
+	_mm256_storeu_si256((__m256i *)dest + 1, ymm);
+}
+
+/*
+ * memset_fixed_avx -- fills len bytes using a fixed-size kernel,
+ *	returns 0 if len is not one of the fixed size classes
+ */
+static force_inline int
+memset_fixed_avx(char *dest, __m256i ymm, size_t len)
+{
+	switch (fixed_size_class(len)) {
+	case 3:
+		*(uint64_t *)dest = m256_get8b(ymm);
+		break;
+	case 4:
+		_mm_storeu_si128((__m128i *)dest, m256_get16b(ymm));
+		break;
+	case 5:
+		_mm256_storeu_si256((__m256i *)dest, ymm);
+		break;
+	case 6:
+		memset_fixed_avx_64b(dest, ymm);
+		break;
+	case 7:
+		memset_fixed_avx_64b(dest + 0 * 64, ymm);
+		memset_fixed_avx_64b(dest + 1 * 64, ymm);
+		break;
+	case 8:
+		memset_fixed_avx_64b(dest + 0 * 64, ymm);
+		memset_fixed_avx_64b(dest + 1 * 64, ymm);
+		memset_fixed_avx_64b(dest + 2 * 64, ymm);
+		memset_fixed_avx_64b(dest + 3 * 64, ymm);
+		break;
+	default:
+		return 0;
+	}
+
+	flush(dest, len);
+	return 1;
+}
+
 #endif
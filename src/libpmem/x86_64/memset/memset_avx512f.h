@@ -44,4 +44,11 @@ memset_small_avx512f(char *dest, __m256i ymm, size_t len)
 	memset_small_avx(dest, ymm, len);
 }
 
+static force_inline int
+memset_fixed_avx512f(char *dest, __m256i ymm, size_t len)
+{
+	/* Fixed-size fills are at most 4 cache lines, AVX is enough. */
+	return memset_fixed_avx(dest, ymm, len);
+}
+
 #endif
@@ -39,6 +39,7 @@
 #include <string.h>
 
 #include "libpmem.h"
+#include "memcpy_memset.h"
 #include "out.h"
 
 static force_inline void
@@ -119,4 +120,52 @@ memset_small_sse2(char *dest, __m128i xmm, size_t len)
 	flush(dest, len);
 }
 
+static force_inline void
+memset_fixed_sse2_64b(char *dest, __m128i xmm)
+{
+	_mm_storeu_si128((__m128i *)dest + 0, xmm);
+	_mm_storeu_si128((__m128i *)dest + 1, xmm);
+	_mm_storeu_si128((__m128i *)dest + 2, xmm);
+	_mm_storeu_si128((__m128i *)dest + 3, xmm);
+}
+
+/*
+ * memset_fixed_sse2 -- fills len bytes using a fixed-size kernel,
+ *	returns 0 if len is not one of the fixed size classes
+ */
+static force_inline int
+memset_fixed_sse2(char *dest, __m128i xmm, size_t len)
+{
+	switch (fixed_size_class(len)) {
+	case 3:
+		*(uint64_t *)dest = (uint64_t)_mm_cvtsi128_si64(xmm);
+		break;
+	case 4:
+		_mm_storeu_si128((__m128i *)dest, xmm);
+		break;
+	case 5:
+		_mm_storeu_si128((__m128i *)dest + 0, xmm);
+		_mm_storeu_si128((__m128i *)dest + 1, xmm);
+		break;
+	case 6:
+		memset_fixed_sse2_64b(dest, xmm);
+		break;
+	case 7:
+		memset_fixed_sse2_64b(dest + 0 * 64, xmm);
+		memset_fixed_sse2_64b(dest + 1 * 64, xmm);
+		break;
+	case 8:
+		memset_fixed_sse2_64b(dest + 0 * 64, xmm);
+		memset_fixed_sse2_64b(dest + 1 * 64, xmm);
+		memset_fixed_sse2_64b(dest + 2 * 64, xmm);
+		memset_fixed_sse2_64b(dest + 3 * 64, xmm);
+		break;
+	default:
+		return 0;
+	}
+
+	flush(dest, len);
+	return 1;
+}
+
 #endif
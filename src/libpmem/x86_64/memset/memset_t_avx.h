@@ -114,6 +114,11 @@ EXPORTED_SYMBOL(char *dest, int c, size_t len)
 {
 	__m256i ymm = _mm256_set1_epi8((char)c);
 
+	if (memset_fixed_avx(dest, ymm, len)) {
+		avx_zeroupper();
+		return;
+	}
+
 	size_t cnt = (uint64_t)dest & 63;
 	if (cnt > 0) {
 		cnt = 64 - cnt;
@@ -209,6 +209,11 @@ EXPORTED_SYMBOL(char *dest, int c, size_t len)
 	/* See comment in memset_movnt_avx512f */
 	__m256i ymm = _mm256_set1_epi8((char)c);
 
+	if (memset_fixed_avx512f(dest, ymm, len)) {
+		avx_zeroupper();
+		return;
+	}
+
 	size_t cnt = (uint64_t)dest & 63;
 	if (cnt > 0) {
 		cnt = 64 - cnt;
@@ -97,6 +97,9 @@ EXPORTED_SYMBOL(char *dest, int c, size_t len)
 {
 	__m128i xmm = _mm_set1_epi8((char)c);
 
+	if (memset_fixed_sse2(dest, xmm, len))
+		return;
+
 	size_t cnt = (uint64_t)dest & 63;
 	if (cnt > 0) {
 		cnt = 64 - cnt;
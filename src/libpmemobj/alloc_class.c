@@ -117,8 +117,19 @@ static struct {
 /*
  * Calculates the size in bytes of a single run instance
  */
-#define RUN_SIZE_BYTES(size_idx)\
-(RUNSIZE + (((size_idx) - 1) * CHUNKSIZE))
+#define RUN_SIZE_BYTES(ac, size_idx)\
+((size_idx) * (ac)->chunksize - RUN_METASIZE_NVAL((ac)->run_bitmap_nval))
+
+/*
+ * Calculates the number of bytes at the end of a run that are not divided into
+ * units, because the beginning of the data might be moved forward by the
+ * alignment padding or, in colored runs, by the color offset - which together
+ * never exceed a single unit. Aligned runs created before the tail was
+ * reserved lack CHUNK_FLAG_ALIGNED_TAIL, and are divided as they always were.
+ */
+#define RUN_RESERVED_BYTES(unit_size, alignment, flags)\
+((flags) & CHUNK_FLAG_COLORED ? (unit_size) :\
+((flags) & CHUNK_FLAG_ALIGNED_TAIL ? (alignment) : 0))
 
 /*
  * Target number of allocations per run instance.
@@ -126,13 +137,18 @@ static struct {
 #define RUN_MIN_NALLOCS 500
 
 /*
- * Hard limit of chunks per single run.
+ * Hard limit of chunks per single run, in the default geometry. Heaps with
+ * larger chunks use proportionally fewer chunks.
  */
 #define RUN_SIZE_IDX_CAP (16)
 
 struct alloc_class_collection {
 	size_t granularity;
 
+	/* geometry of the heap the classes are generated for */
+	size_t chunksize;
+	unsigned run_bitmap_nval;
+
 	struct alloc_class *aclasses[MAX_ALLOCATION_CLASSES];
 
 	/*
@@ -200,16 +216,33 @@ alloc_class_reservation_clear(struct alloc_class_collection *ac, int id)
 	ASSERT(ret);
 }
 
+/*
+ * alloc_class_run_usable_size -- (internal) returns the number of bytes of
+ *	a run that can be divided into units
+ */
+static size_t
+alloc_class_run_usable_size(struct alloc_class_collection *ac,
+	uint32_t size_idx, size_t reserved)
+{
+	size_t run_size = RUN_SIZE_BYTES(ac, size_idx);
+
+	return run_size > reserved ? run_size - reserved : 0;
+}
+
 /*
  * alloc_class_generate_run_proto -- generates the run bitmap-related
  *	information needed for the allocation class
  */
 void
-alloc_class_generate_run_proto(struct alloc_class_run_proto *dest,
-	size_t unit_size, uint32_t size_idx, size_t alignment)
+alloc_class_generate_run_proto(struct alloc_class_collection *ac,
+	struct alloc_class_run_proto *dest,
+	size_t unit_size, uint32_t size_idx, size_t alignment, uint16_t flags)
 {
 	LOG(10, NULL);
 
+	unsigned bitmap_size = BITS_PER_VALUE * ac->run_bitmap_nval;
+	size_t reserved = RUN_RESERVED_BYTES(unit_size, alignment, flags);
+
 	ASSERTne(size_idx, 0);
 	dest->size_idx = size_idx;
 	dest->alignment = alignment;
@@ -223,17 +256,19 @@ alloc_class_generate_run_proto(struct alloc_class_run_proto *dest,
 	 * in the bitmap.
 	 */
 	dest->bitmap_nallocs = (uint32_t)
-		(RUN_SIZE_BYTES(dest->size_idx) / unit_size);
+		(alloc_class_run_usable_size(ac, dest->size_idx, reserved) /
+		unit_size);
 
-	while (dest->bitmap_nallocs > RUN_BITMAP_SIZE) {
+	while (dest->bitmap_nallocs > bitmap_size) {
 		LOG(3, "tried to create allocation class (%lu) with number "
 			"of units (%u) exceeding the bitmap size (%u)",
-			unit_size, dest->bitmap_nallocs, RUN_BITMAP_SIZE);
+			unit_size, dest->bitmap_nallocs, bitmap_size);
 		if (dest->size_idx > 1) {
 			dest->size_idx -= 1;
 			/* recalculate the number of allocations */
 			dest->bitmap_nallocs = (uint32_t)
-				(RUN_SIZE_BYTES(dest->size_idx) / unit_size);
+				(alloc_class_run_usable_size(ac,
+				dest->size_idx, reserved) / unit_size);
 			LOG(3, "allocation class (%lu) was constructed with "
 				"fewer (%u) than requested chunks (%u)",
 				unit_size, dest->size_idx, dest->size_idx + 1);
@@ -243,9 +278,9 @@ alloc_class_generate_run_proto(struct alloc_class_run_proto *dest,
 				"this might lead to "
 				"inefficient memory utilization!",
 				unit_size,
-				RUN_BITMAP_SIZE, dest->bitmap_nallocs);
+				bitmap_size, dest->bitmap_nallocs);
 
-			dest->bitmap_nallocs = RUN_BITMAP_SIZE;
+			dest->bitmap_nallocs = bitmap_size;
 		}
 	}
 
@@ -255,13 +290,13 @@ alloc_class_generate_run_proto(struct alloc_class_run_proto *dest,
 	 * last value of that array with the bits that exceed
 	 * number of blocks marked as set (1).
 	 */
-	ASSERT(dest->bitmap_nallocs <= RUN_BITMAP_SIZE);
-	unsigned unused_bits = RUN_BITMAP_SIZE - dest->bitmap_nallocs;
+	ASSERT(dest->bitmap_nallocs <= bitmap_size);
+	unsigned unused_bits = bitmap_size - dest->bitmap_nallocs;
 
 	unsigned unused_values = unused_bits / BITS_PER_VALUE;
 
-	ASSERT(MAX_BITMAP_VALUES >= unused_values);
-	dest->bitmap_nval = MAX_BITMAP_VALUES - unused_values;
+	ASSERT(ac->run_bitmap_nval >= unused_values);
+	dest->bitmap_nval = ac->run_bitmap_nval - unused_values;
 
 	ASSERT(unused_bits >= unused_values * BITS_PER_VALUE);
 	unused_bits -= unused_values * BITS_PER_VALUE;
@@ -278,10 +313,12 @@ struct alloc_class *
 alloc_class_new(int id, struct alloc_class_collection *ac,
 	enum alloc_class_type type, enum header_type htype,
 	size_t unit_size, size_t alignment,
-	uint32_t size_idx)
+	uint32_t size_idx, uint16_t flags)
 {
 	LOG(10, NULL);
 
+	ASSERTeq(flags & ~CHUNK_FLAG_COLORED, 0);
+
 	struct alloc_class *c = Malloc(sizeof(*c));
 	if (c == NULL)
 		goto error_class_alloc;
@@ -291,15 +328,16 @@ alloc_class_new(int id, struct alloc_class_collection *ac,
 	c->type = type;
 	c->flags = (uint16_t)
 		(header_type_to_flag[c->header_type] |
-		(alignment ? CHUNK_FLAG_ALIGNED : 0));
+		(alignment ? CHUNK_FLAG_ALIGNED | CHUNK_FLAG_ALIGNED_TAIL : 0) |
+		flags);
 
 	switch (type) {
 		case CLASS_HUGE:
 			id = DEFAULT_ALLOC_CLASS_ID;
 			break;
 		case CLASS_RUN:
-			alloc_class_generate_run_proto(&c->run, unit_size,
-				size_idx, alignment);
+			alloc_class_generate_run_proto(ac, &c->run, unit_size,
+				size_idx, alignment, c->flags);
 
 			uint8_t slot = (uint8_t)id;
 			if (id < 0 && alloc_class_find_first_free_slot(ac,
@@ -365,12 +403,17 @@ alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
 	COMPILE_ERROR_ON(MAX_ALLOCATION_CLASSES > UINT8_MAX);
 	uint64_t required_size_bytes = n * RUN_MIN_NALLOCS;
 	uint32_t required_size_idx = 1;
-	if (required_size_bytes > RUNSIZE) {
-		required_size_bytes -= RUNSIZE;
+	uint32_t size_idx_cap = (uint32_t)(RUN_SIZE_IDX_CAP * CHUNKSIZE /
+		ac->chunksize);
+	if (size_idx_cap == 0)
+		size_idx_cap = 1;
+
+	if (required_size_bytes > RUN_SIZE_BYTES(ac, 1)) {
+		required_size_bytes -= RUN_SIZE_BYTES(ac, 1);
 		required_size_idx +=
-			CALC_SIZE_IDX(CHUNKSIZE, required_size_bytes);
-		if (required_size_idx > RUN_SIZE_IDX_CAP)
-			required_size_idx = RUN_SIZE_IDX_CAP;
+			CALC_SIZE_IDX(ac->chunksize, required_size_bytes);
+		if (required_size_idx > size_idx_cap)
+			required_size_idx = size_idx_cap;
 	}
 
 	for (int i = MAX_ALLOCATION_CLASSES - 1; i >= 0; --i) {
@@ -390,7 +433,7 @@ alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
 	 * run data size must be divisible by the allocation class unit size
 	 * with the smallest possible remainder, preferably 0.
 	 */
-	size_t runsize_bytes = RUN_SIZE_BYTES(required_size_idx);
+	size_t runsize_bytes = RUN_SIZE_BYTES(ac, required_size_idx);
 	while ((runsize_bytes % n) > MAX_RUN_WASTED_BYTES) {
 		n += ALLOC_BLOCK_SIZE_GEN;
 	}
@@ -412,7 +455,7 @@ alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
 	}
 
 	return alloc_class_new(-1, ac, CLASS_RUN, HEADER_COMPACT, n, 0,
-		required_size_idx);
+		required_size_idx, 0);
 }
 
 /*
@@ -481,9 +524,10 @@ alloc_class_find_min_frag(struct alloc_class_collection *ac, size_t n)
 
 /*
  * alloc_class_collection_new -- creates a new collection of allocation classes
+ *	for a heap with the given chunk size and maximum run bitmap length
  */
 struct alloc_class_collection *
-alloc_class_collection_new()
+alloc_class_collection_new(size_t chunksize, unsigned run_bitmap_nval)
 {
 	LOG(10, NULL);
 
@@ -492,6 +536,8 @@ alloc_class_collection_new()
 		return NULL;
 
 	ac->granularity = ALLOC_BLOCK_SIZE;
+	ac->chunksize = chunksize;
+	ac->run_bitmap_nval = run_bitmap_nval;
 	ac->last_run_max_size = MAX_RUN_SIZE;
 	ac->fail_on_missing_class = 0;
 	ac->autogenerate_on_missing_class = 1;
@@ -506,12 +552,12 @@ alloc_class_collection_new()
 	memset(ac->class_map_by_alloc_size, 0xFF, maps_size);
 
 	if (alloc_class_new(-1, ac, CLASS_HUGE, HEADER_COMPACT,
-		CHUNKSIZE, 0, 1) == NULL)
+		chunksize, 0, 1, 0) == NULL)
 		goto error;
 
 	struct alloc_class *predefined_class =
 		alloc_class_new(-1, ac, CLASS_RUN, HEADER_COMPACT,
-			MIN_RUN_SIZE, 0, 1);
+			MIN_RUN_SIZE, 0, 1, 0);
 	if (predefined_class == NULL)
 		goto error;
 
@@ -98,11 +98,13 @@ struct alloc_class {
 	};
 };
 
-struct alloc_class_collection *alloc_class_collection_new(void);
+struct alloc_class_collection *alloc_class_collection_new(size_t chunksize,
+	unsigned run_bitmap_nval);
 void alloc_class_collection_delete(struct alloc_class_collection *ac);
 
-void alloc_class_generate_run_proto(struct alloc_class_run_proto *dest,
-	size_t unit_size, uint32_t size_idx, size_t alignment);
+void alloc_class_generate_run_proto(struct alloc_class_collection *ac,
+	struct alloc_class_run_proto *dest,
+	size_t unit_size, uint32_t size_idx, size_t alignment, uint16_t flags);
 
 struct alloc_class *alloc_class_by_run(
 	struct alloc_class_collection *ac,
@@ -123,7 +125,7 @@ struct alloc_class *
 alloc_class_new(int id, struct alloc_class_collection *ac,
 	enum alloc_class_type type, enum header_type htype,
 	size_t unit_size, size_t alignment,
-	uint32_t size_idx);
+	uint32_t size_idx, uint16_t flags);
 
 void alloc_class_delete(struct alloc_class_collection *ac,
 	struct alloc_class *c);
@@ -104,6 +104,35 @@ bucket_insert_block(struct bucket *b, const struct memory_block *m)
 	return b->c_ops->insert(b->container, m);
 }
 
+/*
+ * bucket_insert_blocks -- inserts an array of blocks into the bucket
+ */
+int
+bucket_insert_blocks(struct bucket *b, const struct memory_block *m,
+	size_t nblocks)
+{
+	if (b->c_ops->insert_bulk == NULL) {
+		for (size_t i = 0; i < nblocks; ++i) {
+			if (bucket_insert_block(b, &m[i]) != 0)
+				return -1;
+		}
+
+		return 0;
+	}
+
+#if VG_MEMCHECK_ENABLED || VG_HELGRIND_ENABLED || VG_DRD_ENABLED
+	if (On_valgrind) {
+		for (size_t i = 0; i < nblocks; ++i) {
+			size_t size = m[i].m_ops->get_real_size(&m[i]);
+			void *data = m[i].m_ops->get_real_data(&m[i]);
+			VALGRIND_DO_MAKE_MEM_NOACCESS(data, size);
+			VALGRIND_ANNOTATE_NEW_MEMORY(data, size);
+		}
+	}
+#endif
+	return b->c_ops->insert_bulk(b->container, m, nblocks);
+}
+
 /*
  * bucket_delete -- cleanups and deallocates bucket instance
  */
@@ -65,6 +65,8 @@ struct bucket *bucket_new(struct block_container *c,
 int *bucket_current_resvp(struct bucket *b);
 
 int bucket_insert_block(struct bucket *b, const struct memory_block *m);
+int bucket_insert_blocks(struct bucket *b, const struct memory_block *m,
+	size_t nblocks);
 
 void bucket_delete(struct bucket *b);
 
@@ -0,0 +1,464 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * container_bitmap.c -- implementation of bitmap-indexed segregated lists
+ *	block container
+ *
+ * This container is meant for the huge blocks, whose sizes range from one
+ * chunk up to an entire zone. The blocks are kept in intrusive lists, each
+ * serving a range of sizes. The ranges double every BITMAP_SL_LISTS lists and
+ * are split evenly inside, so that the list of a size is computed from its
+ * most significant bits. Two levels of bitmaps mark the nonempty lists, which
+ * means that finding a block large enough for the requested size takes two
+ * bit scans instead of a tree traversal.
+ *
+ * Additionally, every zone has a bitmap of the chunks that begin a block in
+ * the container, which lets the exact lookups used for coalescing of
+ * neighbouring blocks skip the lists altogether.
+ */
+
+#include "container_bitmap.h"
+#include "out.h"
+#include "sys_util.h"
+#include "util.h"
+#include "valgrind_internal.h"
+#include "vec.h"
+#include "queue.h"
+
+/*
+ * Just like in the segregated lists container, the list entries are stored
+ * inside of the free memory blocks and are treated as volatile.
+ */
+struct bitmap_entry {
+	struct memory_block m;
+	TAILQ_ENTRY(bitmap_entry) entry;
+};
+
+/* number of lists in a single first level range, log2 */
+#define BITMAP_SL_BITS 3U
+#define BITMAP_SL_LISTS (1U << BITMAP_SL_BITS)
+
+/* sizes below BITMAP_SL_LISTS are served by the first range, one each */
+#define BITMAP_FL_LISTS (16U - BITMAP_SL_BITS + 1U)
+
+#define BITMAP_ZONE_WORDS ((MAX_CHUNK + 63U) / 64U)
+
+struct block_container_bitmap {
+	struct block_container super;
+	TAILQ_HEAD(, bitmap_entry) blocks[BITMAP_FL_LISTS][BITMAP_SL_LISTS];
+
+	/* nonempty first level ranges */
+	uint64_t fl_nonempty;
+
+	/* nonempty lists of each of the ranges */
+	uint64_t sl_nonempty[BITMAP_FL_LISTS];
+
+	/* chunks at which the blocks in the container begin, per zone */
+	VEC(, uint64_t *) chunks;
+};
+
+/*
+ * container_bitmap_mapping -- (internal) calculates the list that serves
+ *	the given size
+ */
+static void
+container_bitmap_mapping(uint32_t size_idx, unsigned *fl, unsigned *sl)
+{
+	if (size_idx < BITMAP_SL_LISTS) {
+		*fl = 0;
+		*sl = size_idx;
+	} else {
+		unsigned msb = util_mssb_index(size_idx);
+		*fl = msb - BITMAP_SL_BITS + 1;
+		*sl = (size_idx >> (msb - BITMAP_SL_BITS)) &
+			(BITMAP_SL_LISTS - 1);
+	}
+}
+
+/*
+ * container_bitmap_chunks -- (internal) returns the chunk bitmap of a zone,
+ *	optionally allocating it
+ */
+static uint64_t *
+container_bitmap_chunks(struct block_container_bitmap *c, uint32_t zone_id,
+	int alloc)
+{
+	if (zone_id < VEC_SIZE(&c->chunks) && VEC_ARR(&c->chunks)[zone_id])
+		return VEC_ARR(&c->chunks)[zone_id];
+
+	if (!alloc)
+		return NULL;
+
+	while (VEC_SIZE(&c->chunks) <= zone_id) {
+		if (VEC_PUSH_BACK(&c->chunks, NULL) != 0)
+			return NULL;
+	}
+
+	uint64_t *chunks = Zalloc(BITMAP_ZONE_WORDS * sizeof(uint64_t));
+	if (chunks == NULL)
+		return NULL;
+
+	VEC_ARR(&c->chunks)[zone_id] = chunks;
+
+	return chunks;
+}
+
+/*
+ * container_bitmap_find_entry -- (internal) returns the entry of the block
+ *	that begins at the same chunk as the given one, or NULL
+ */
+static struct bitmap_entry *
+container_bitmap_find_entry(struct block_container_bitmap *c,
+	const struct memory_block *m)
+{
+	uint64_t *chunks = container_bitmap_chunks(c, m->zone_id, 0);
+	if (chunks == NULL)
+		return NULL;
+
+	if ((chunks[m->chunk_id / 64] & (1ULL << (m->chunk_id % 64))) == 0)
+		return NULL;
+
+	struct bitmap_entry *e = m->m_ops->get_real_data(m);
+	if (e->m.size_idx != m->size_idx)
+		return NULL;
+
+	return e;
+}
+
+/*
+ * container_bitmap_insert_block -- (internal) inserts a new memory block
+ *	into the container
+ */
+static int
+container_bitmap_insert_block(struct block_container *bc,
+	const struct memory_block *m)
+{
+	struct block_container_bitmap *c =
+		(struct block_container_bitmap *)bc;
+
+	ASSERT(m->chunk_id < MAX_CHUNK);
+	ASSERT(m->zone_id < UINT16_MAX);
+	ASSERTne(m->size_idx, 0);
+
+	uint64_t *chunks = container_bitmap_chunks(c, m->zone_id, 1);
+	if (chunks == NULL)
+		return ENOMEM;
+
+	unsigned fl;
+	unsigned sl;
+	container_bitmap_mapping(m->size_idx, &fl, &sl);
+	ASSERT(fl < BITMAP_FL_LISTS);
+
+	struct bitmap_entry *e = m->m_ops->get_real_data(m);
+	VALGRIND_DO_MAKE_MEM_DEFINED(e, sizeof(*e));
+
+	struct bitmap_entry *first = TAILQ_FIRST(&c->blocks[fl][sl]);
+
+	VALGRIND_ADD_TO_TX(e, sizeof(*e));
+	if (first != NULL)
+		VALGRIND_ADD_TO_TX(first, sizeof(*first));
+
+	e->m = *m;
+
+	/*
+	 * Add to the beginning of the list, so that the most recently freed
+	 * block, which is the most likely to still be in the cache, is reused
+	 * first (LIFO).
+	 */
+	TAILQ_INSERT_HEAD(&c->blocks[fl][sl], e, entry);
+
+	if (first != NULL) {
+		VALGRIND_SET_CLEAN(first, sizeof(*first));
+		VALGRIND_REMOVE_FROM_TX(first, sizeof(*first));
+	}
+	VALGRIND_SET_CLEAN(e, sizeof(*e));
+	VALGRIND_REMOVE_FROM_TX(e, sizeof(*e));
+
+	chunks[m->chunk_id / 64] |= 1ULL << (m->chunk_id % 64);
+	c->sl_nonempty[fl] |= 1ULL << sl;
+	c->fl_nonempty |= 1ULL << fl;
+
+	return 0;
+}
+
+/*
+ * container_bitmap_unlink -- (internal) removes the entry from its list
+ */
+static void
+container_bitmap_unlink(struct block_container_bitmap *c,
+	struct bitmap_entry *e)
+{
+	unsigned fl;
+	unsigned sl;
+	container_bitmap_mapping(e->m.size_idx, &fl, &sl);
+
+	struct bitmap_entry *next = TAILQ_NEXT(e, entry);
+	struct bitmap_entry **prev = e->entry.tqe_prev;
+
+	VALGRIND_ADD_TO_TX(prev, sizeof(*prev));
+	if (next != NULL)
+		VALGRIND_ADD_TO_TX(next, sizeof(*next));
+
+	TAILQ_REMOVE(&c->blocks[fl][sl], e, entry);
+
+	VALGRIND_SET_CLEAN(prev, sizeof(*prev));
+	VALGRIND_REMOVE_FROM_TX(prev, sizeof(*prev));
+	if (next != NULL) {
+		VALGRIND_SET_CLEAN(next, sizeof(*next));
+		VALGRIND_REMOVE_FROM_TX(next, sizeof(*next));
+	}
+
+	if (TAILQ_EMPTY(&c->blocks[fl][sl])) {
+		c->sl_nonempty[fl] &= ~(1ULL << sl);
+		if (c->sl_nonempty[fl] == 0)
+			c->fl_nonempty &= ~(1ULL << fl);
+	}
+
+	uint64_t *chunks = container_bitmap_chunks(c, e->m.zone_id, 0);
+	ASSERTne(chunks, NULL);
+
+	chunks[e->m.chunk_id / 64] &= ~(1ULL << (e->m.chunk_id % 64));
+}
+
+/*
+ * container_bitmap_search -- (internal) finds the smallest nonempty list
+ *	whose every block is at least as large as the given size
+ */
+static struct bitmap_entry *
+container_bitmap_search(struct block_container_bitmap *c, uint32_t size_idx)
+{
+	/* rounds the size up to the beginning of the next list */
+	if (size_idx >= BITMAP_SL_LISTS)
+		size_idx += (1U << (util_mssb_index(size_idx) -
+			BITMAP_SL_BITS)) - 1;
+
+	unsigned fl;
+	unsigned sl;
+	container_bitmap_mapping(size_idx, &fl, &sl);
+	if (fl >= BITMAP_FL_LISTS)
+		return NULL;
+
+	uint64_t v = c->sl_nonempty[fl] & (~0ULL << sl);
+	if (v == 0) {
+		uint64_t f = c->fl_nonempty & (~0ULL << (fl + 1));
+		if (f == 0)
+			return NULL;
+
+		fl = util_lssb_index64(f);
+		v = c->sl_nonempty[fl];
+	}
+
+	sl = util_lssb_index64(v);
+
+	return TAILQ_FIRST(&c->blocks[fl][sl]);
+}
+
+/*
+ * container_bitmap_get_rm_block_bestfit -- (internal) removes and returns the
+ *	best-fit memory block for size
+ */
+static int
+container_bitmap_get_rm_block_bestfit(struct block_container *bc,
+	struct memory_block *m)
+{
+	struct block_container_bitmap *c =
+		(struct block_container_bitmap *)bc;
+
+	ASSERTne(m->size_idx, 0);
+
+	unsigned fl;
+	unsigned sl;
+	container_bitmap_mapping(m->size_idx, &fl, &sl);
+	if (fl >= BITMAP_FL_LISTS)
+		return ENOMEM;
+
+	/*
+	 * The list that serves the requested size is skipped by the search,
+	 * but its most recently inserted block is worth checking first - it
+	 * might be a close fit, e.g., the remainder of a canceled reservation.
+	 */
+	struct bitmap_entry *e = TAILQ_FIRST(&c->blocks[fl][sl]);
+	if (e == NULL || e->m.size_idx < m->size_idx)
+		e = container_bitmap_search(c, m->size_idx);
+
+	if (e == NULL) {
+		/*
+		 * The lists above are all empty, but the one that serves
+		 * the requested size might still contain a large enough block.
+		 */
+		TAILQ_FOREACH(e, &c->blocks[fl][sl], entry) {
+			if (e->m.size_idx >= m->size_idx)
+				break;
+		}
+
+		if (e == NULL)
+			return ENOMEM;
+	}
+
+	*m = e->m;
+	container_bitmap_unlink(c, e);
+
+	return 0;
+}
+
+/*
+ * container_bitmap_get_rm_block_exact --
+ *	(internal) removes exact match memory block
+ */
+static int
+container_bitmap_get_rm_block_exact(struct block_container *bc,
+	const struct memory_block *m)
+{
+	struct block_container_bitmap *c =
+		(struct block_container_bitmap *)bc;
+
+	struct bitmap_entry *e = container_bitmap_find_entry(c, m);
+	if (e == NULL)
+		return ENOMEM;
+
+	container_bitmap_unlink(c, e);
+
+	return 0;
+}
+
+/*
+ * container_bitmap_get_block_exact -- (internal) finds exact match memory block
+ */
+static int
+container_bitmap_get_block_exact(struct block_container *bc,
+	const struct memory_block *m)
+{
+	struct block_container_bitmap *c =
+		(struct block_container_bitmap *)bc;
+
+	return container_bitmap_find_entry(c, m) ? 0 : ENOMEM;
+}
+
+/*
+ * container_bitmap_is_empty -- (internal) checks whether the container is
+ * empty
+ */
+static int
+container_bitmap_is_empty(struct block_container *bc)
+{
+	struct block_container_bitmap *c =
+		(struct block_container_bitmap *)bc;
+
+	return c->fl_nonempty == 0;
+}
+
+/*
+ * container_bitmap_rm_all -- (internal) removes all elements from the container
+ */
+static void
+container_bitmap_rm_all(struct block_container *bc)
+{
+	struct block_container_bitmap *c =
+		(struct block_container_bitmap *)bc;
+
+	for (unsigned fl = 0; fl < BITMAP_FL_LISTS; ++fl) {
+		for (unsigned sl = 0; sl < BITMAP_SL_LISTS; ++sl)
+			TAILQ_INIT(&c->blocks[fl][sl]);
+		c->sl_nonempty[fl] = 0;
+	}
+	c->fl_nonempty = 0;
+
+	uint64_t *chunks;
+	VEC_FOREACH(chunks, &c->chunks) {
+		if (chunks != NULL)
+			memset(chunks, 0, BITMAP_ZONE_WORDS * sizeof(uint64_t));
+	}
+}
+
+/*
+ * container_bitmap_destroy -- (internal) deletes the container
+ */
+static void
+container_bitmap_destroy(struct block_container *bc)
+{
+	struct block_container_bitmap *c =
+		(struct block_container_bitmap *)bc;
+
+	uint64_t *chunks;
+	VEC_FOREACH(chunks, &c->chunks) {
+		Free(chunks);
+	}
+	VEC_DELETE(&c->chunks);
+
+	Free(c);
+}
+
+/*
+ * This container provides best-fit in O(1) time for any size, but it's only
+ * exact up to the size range of a list - the blocks of the found list are
+ * served in LIFO order.
+ */
+static struct block_container_ops container_bitmap_ops = {
+	.insert = container_bitmap_insert_block,
+	.insert_bulk = NULL,
+	.get_rm_exact = container_bitmap_get_rm_block_exact,
+	.get_rm_bestfit = container_bitmap_get_rm_block_bestfit,
+	.get_exact = container_bitmap_get_block_exact,
+	.is_empty = container_bitmap_is_empty,
+	.rm_all = container_bitmap_rm_all,
+	.destroy = container_bitmap_destroy,
+};
+
+/*
+ * container_new_bitmap -- allocates and initializes a bitmap container
+ */
+struct block_container *
+container_new_bitmap(struct palloc_heap *heap)
+{
+	struct block_container_bitmap *bc = Malloc(sizeof(*bc));
+	if (bc == NULL)
+		goto error_container_malloc;
+
+	bc->super.heap = heap;
+	bc->super.c_ops = &container_bitmap_ops;
+
+	for (unsigned fl = 0; fl < BITMAP_FL_LISTS; ++fl) {
+		for (unsigned sl = 0; sl < BITMAP_SL_LISTS; ++sl)
+			TAILQ_INIT(&bc->blocks[fl][sl]);
+		bc->sl_nonempty[fl] = 0;
+	}
+	bc->fl_nonempty = 0;
+
+	VEC_INIT(&bc->chunks);
+
+	return (struct block_container *)&bc->super;
+
+error_container_malloc:
+	return NULL;
+}
@@ -64,20 +64,16 @@ struct block_container_seglists {
 };
 
 /*
- * container_seglists_insert_block -- (internal) inserts a new memory block
- *	into the container
+ * container_seglists_link_block -- (internal) appends a memory block to the
+ *	list of its size, without marking that list as nonempty
  */
-static int
-container_seglists_insert_block(struct block_container *bc,
+static void
+container_seglists_link_block(struct block_container_seglists *c,
 	const struct memory_block *m)
 {
 	ASSERT(m->chunk_id < MAX_CHUNK);
 	ASSERT(m->zone_id < UINT16_MAX);
 	ASSERTne(m->size_idx, 0);
-
-	struct block_container_seglists *c =
-		(struct block_container_seglists *)bc;
-
 	ASSERT(m->size_idx <= SEGLIST_BLOCK_LISTS);
 
 	struct seglist_entry *e = m->m_ops->get_user_data(m);
@@ -101,6 +97,20 @@ container_seglists_insert_block(struct block_container *bc,
 
 	VALGRIND_REMOVE_FROM_TX(last, sizeof(*last));
 	VALGRIND_REMOVE_FROM_TX(e, sizeof(*e));
+}
+
+/*
+ * container_seglists_insert_block -- (internal) inserts a new memory block
+ *	into the container
+ */
+static int
+container_seglists_insert_block(struct block_container *bc,
+	const struct memory_block *m)
+{
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+	container_seglists_link_block(c, m);
 
 	/* marks the list as nonempty */
 	c->nonempty_lists |= 1ULL << (m->size_idx - 1);
@@ -108,6 +118,28 @@ container_seglists_insert_block(struct block_container *bc,
 	return 0;
 }
 
+/*
+ * container_seglists_insert_bulk -- (internal) inserts an array of memory
+ *	blocks into the container
+ */
+static int
+container_seglists_insert_bulk(struct block_container *bc,
+	const struct memory_block *m, size_t nblocks)
+{
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+	uint64_t nonempty = 0;
+	for (size_t i = 0; i < nblocks; ++i) {
+		container_seglists_link_block(c, &m[i]);
+		nonempty |= 1ULL << (m[i].size_idx - 1);
+	}
+
+	c->nonempty_lists |= nonempty;
+
+	return 0;
+}
+
 /*
  * container_seglists_get_rm_block_bestfit -- (internal) removes and returns the
  *	best-fit memory block for size
@@ -202,6 +234,7 @@ container_seglists_destroy(struct block_container *bc)
  */
 static struct block_container_ops container_seglists_ops = {
 	.insert = container_seglists_insert_block,
+	.insert_bulk = container_seglists_insert_bulk,
 	.get_rm_exact = NULL,
 	.get_rm_bestfit = container_seglists_get_rm_block_bestfit,
 	.get_exact = NULL,
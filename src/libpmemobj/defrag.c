@@ -0,0 +1,694 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * defrag.c -- heap defragmentation
+ *
+ * A defragmentation pass finds the runs whose occupancy is below the
+ * configured threshold and tries to move all of the objects allocated from
+ * those runs into other, denser, runs. Each object is moved in a separate
+ * transaction: a new object of the same allocation class is allocated, the
+ * application is asked to update the references to the object through the
+ * relocation callback, the contents are copied and the old object is freed.
+ * Once a run is emptied, the recycler returns it to the heap as free chunks.
+ *
+ * Passes can be either performed on demand or periodically by a background
+ * worker thread.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc_class.h"
+#include "defrag.h"
+#include "heap.h"
+#include "obj.h"
+#include "os.h"
+#include "os_thread.h"
+#include "out.h"
+#include "stats.h"
+#include "sys_util.h"
+#include "tx.h"
+#include "vec.h"
+
+struct defrag {
+	PMEMobjpool *pop;
+
+	os_mutex_t lock; /* protects the parameters and the worker state */
+	os_cond_t cond; /* wakes up the worker when it's stopped */
+
+	struct pobj_defrag_callback cb;
+	unsigned threshold; /* percentage of used units */
+	unsigned interval; /* milliseconds */
+
+	os_mutex_t state_lock; /* serializes starting and stopping the worker */
+	int enabled;
+	int stop;
+	os_thread_t worker;
+
+	os_mutex_t pass_lock; /* serializes the passes */
+};
+
+/* a run selected for evacuation */
+struct defrag_candidate {
+	struct memory_block m;
+	int evacuated;
+};
+
+struct defrag_pass {
+	struct defrag *d;
+	struct pobj_defrag_callback cb;
+	unsigned threshold;
+
+	/* sorted by the position of the run in the heap */
+	VEC(, struct defrag_candidate) candidates;
+
+	/* offsets of the objects from the run currently being evacuated */
+	VEC(, uint64_t) objects;
+
+	uint64_t relocated;
+};
+
+/* the outcome of an attempt to move a single object */
+enum defrag_result {
+	DEFRAG_RESULT_SKIPPED,
+	DEFRAG_RESULT_RELOCATED,
+	DEFRAG_RESULT_FAILED,
+};
+
+/*
+ * defrag_run_sparse -- (internal) checks whether the occupancy of the run
+ *	is below the threshold
+ */
+static int
+defrag_run_sparse(struct defrag_pass *p, uint32_t used, uint32_t nallocs)
+{
+	/* empty runs are reclaimed without any help */
+	if (used == 0)
+		return 0;
+
+	return (uint64_t)used * 100 < (uint64_t)nallocs * p->threshold;
+}
+
+/*
+ * defrag_collect_cb -- (internal) adds the run to the candidates if its
+ *	occupancy is below the threshold
+ */
+static int
+defrag_collect_cb(const struct memory_block *m, void *arg)
+{
+	struct defrag_pass *p = arg;
+	struct palloc_heap *heap = &p->d->pop->heap;
+
+	uint32_t used;
+	uint32_t nallocs;
+
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+	util_mutex_lock(lock);
+	heap_run_get_usage(heap, m, &used, &nallocs);
+	util_mutex_unlock(lock);
+
+	if (!defrag_run_sparse(p, used, nallocs))
+		return 0;
+
+	struct defrag_candidate c;
+	c.m = *m;
+	c.evacuated = 0;
+
+	return VEC_PUSH_BACK(&p->candidates, c) != 0;
+}
+
+/*
+ * defrag_candidate_cmp -- (internal) compares the positions of two runs
+ */
+static int
+defrag_candidate_cmp(const void *lhs, const void *rhs)
+{
+	const struct defrag_candidate *l = lhs;
+	const struct defrag_candidate *r = rhs;
+
+	if (l->m.zone_id != r->m.zone_id)
+		return l->m.zone_id < r->m.zone_id ? -1 : 1;
+
+	if (l->m.chunk_id != r->m.chunk_id)
+		return l->m.chunk_id < r->m.chunk_id ? -1 : 1;
+
+	return 0;
+}
+
+/*
+ * defrag_find_candidate -- (internal) returns the candidate that describes
+ *	the run from which the memory block originates, or NULL
+ */
+static struct defrag_candidate *
+defrag_find_candidate(struct defrag_pass *p, const struct memory_block *m)
+{
+	struct defrag_candidate key;
+	key.m = *m;
+	key.evacuated = 0;
+
+	return bsearch(&key, VEC_ARR(&p->candidates), VEC_SIZE(&p->candidates),
+		sizeof(key), defrag_candidate_cmp);
+}
+
+/*
+ * defrag_collect_object_cb -- (internal) stores the offset of an object that
+ *	needs to be moved
+ */
+static int
+defrag_collect_object_cb(const struct memory_block *m, void *arg)
+{
+	struct defrag_pass *p = arg;
+	PMEMobjpool *pop = p->d->pop;
+
+	uint64_t off = OBJ_PTR_TO_OFF(pop, m->m_ops->get_user_data(m));
+
+	/* internal objects, and the root object, have fixed locations */
+	if (off == pop->root_offset)
+		return 0;
+
+	if (m->m_ops->get_flags(m) & OBJ_INTERNAL_OBJECT_MASK)
+		return 0;
+
+	return VEC_PUSH_BACK(&p->objects, off) != 0;
+}
+
+/*
+ * defrag_destination_valid -- (internal) checks whether the object can be
+ *	moved into the newly allocated block
+ *
+ * The new block must not be located in the evacuated run, nor in any of the
+ * runs evacuated earlier in the pass, otherwise objects could be moved back
+ * and forth between sparse runs.
+ */
+static int
+defrag_destination_valid(struct defrag_pass *p,
+	const struct memory_block *src, const struct memory_block *dst)
+{
+	if (dst->type != MEMORY_BLOCK_RUN)
+		return 0;
+
+	if (dst->zone_id == src->zone_id && dst->chunk_id == src->chunk_id)
+		return 0;
+
+	struct defrag_candidate *c = defrag_find_candidate(p, dst);
+
+	return c == NULL || !c->evacuated;
+}
+
+/*
+ * defrag_object_allocated -- (internal) checks whether the memory block is
+ *	still allocated
+ */
+static int
+defrag_object_allocated(const struct memory_block *m)
+{
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+
+	util_mutex_lock(lock);
+	int allocated = m->m_ops->get_state(m) == MEMBLOCK_ALLOCATED;
+	util_mutex_unlock(lock);
+
+	return allocated;
+}
+
+/*
+ * defrag_relocate -- (internal) moves a single object out of the run
+ */
+static enum defrag_result
+defrag_relocate(struct defrag_pass *p, const struct memory_block *run,
+	struct alloc_class *c, uint64_t off)
+{
+	PMEMobjpool *pop = p->d->pop;
+	struct palloc_heap *heap = &pop->heap;
+
+	struct memory_block m = memblock_from_offset(heap, off);
+
+	/* the object might have been freed since the run was scanned */
+	if (!defrag_object_allocated(&m))
+		return DEFRAG_RESULT_SKIPPED;
+
+	size_t size = m.m_ops->get_user_size(&m);
+	uint64_t type_num = m.m_ops->get_extra(&m);
+
+	PMEMoid oldoid = {pop->uuid_lo, off};
+
+	if (pmemobj_tx_begin(pop, NULL, TX_PARAM_NONE) != 0)
+		return DEFRAG_RESULT_FAILED;
+
+	enum defrag_result ret = DEFRAG_RESULT_SKIPPED;
+
+	PMEMoid newoid = pmemobj_tx_xalloc(size, type_num,
+		POBJ_CLASS_ID(c->id));
+	if (pmemobj_tx_stage() != TX_STAGE_WORK) {
+		/* there's no point in continuing if the heap is exhausted */
+		ret = DEFRAG_RESULT_FAILED;
+		goto end;
+	}
+
+	struct memory_block nm = memblock_from_offset(heap, newoid.off);
+	if (!defrag_destination_valid(p, run, &nm)) {
+		pmemobj_tx_abort(ECANCELED);
+		goto end;
+	}
+
+	if (p->cb.relocate(pop, oldoid, newoid, p->cb.arg) != 0) {
+		if (pmemobj_tx_stage() == TX_STAGE_WORK)
+			pmemobj_tx_abort(ECANCELED);
+		goto end;
+	}
+
+	if (pmemobj_tx_stage() != TX_STAGE_WORK)
+		goto end;
+
+	/*
+	 * The callback might have freed the object instead of relocating it,
+	 * only the new object is released then, so that the changes made by
+	 * the callback are still committed.
+	 */
+	if (!defrag_object_allocated(&m) || tx_frees(off)) {
+		if (pmemobj_tx_free(newoid) == 0)
+			pmemobj_tx_commit();
+		goto end;
+	}
+
+	/* new objects are flushed on commit */
+	memcpy(OBJ_OFF_TO_PTR(pop, newoid.off), OBJ_OFF_TO_PTR(pop, off),
+		size);
+
+	if (pmemobj_tx_free(oldoid) != 0)
+		goto end;
+
+	pmemobj_tx_commit();
+	if (pmemobj_tx_stage() == TX_STAGE_ONCOMMIT)
+		ret = DEFRAG_RESULT_RELOCATED;
+
+end:
+	pmemobj_tx_end();
+
+	return ret;
+}
+
+/*
+ * defrag_evacuate -- (internal) moves all of the objects out of the run
+ */
+static int
+defrag_evacuate(struct defrag_pass *p, struct defrag_candidate *cand)
+{
+	struct palloc_heap *heap = &p->d->pop->heap;
+	struct memory_block run = cand->m;
+
+	cand->evacuated = 1;
+
+	VEC_CLEAR(&p->objects);
+
+	os_mutex_t *lock = run.m_ops->get_lock(&run);
+	util_mutex_lock(lock);
+
+	/* the run might have been reclaimed since it was selected */
+	struct chunk_header *hdr = heap_get_chunk_hdr(heap, &run);
+	if (hdr->type != CHUNK_TYPE_RUN) {
+		util_mutex_unlock(lock);
+		return 0;
+	}
+
+	/* ... or it might have been filled by objects from other candidates */
+	uint32_t used;
+	uint32_t nallocs;
+	heap_run_get_usage(heap, &run, &used, &nallocs);
+	if (!defrag_run_sparse(p, used, nallocs)) {
+		util_mutex_unlock(lock);
+		return 0;
+	}
+
+	struct chunk_run *r = heap_get_chunk_run(heap, &run);
+	struct alloc_class *c = alloc_class_by_run(heap_alloc_classes(heap),
+		r->block_size, hdr->flags, hdr->size_idx);
+
+	/* objects from runs of removed classes cannot be reallocated */
+	if (c == NULL) {
+		util_mutex_unlock(lock);
+		return 0;
+	}
+
+	struct memory_block iter = run;
+	int ret = heap_run_foreach_object(heap, defrag_collect_object_cb,
+		p, &iter);
+
+	util_mutex_unlock(lock);
+
+	if (ret != 0)
+		return -1;
+
+	uint64_t *off;
+	VEC_FOREACH_BY_PTR(off, &p->objects) {
+		switch (defrag_relocate(p, &run, c, *off)) {
+			case DEFRAG_RESULT_RELOCATED:
+				p->relocated++;
+				break;
+			case DEFRAG_RESULT_SKIPPED:
+				break;
+			case DEFRAG_RESULT_FAILED:
+				return -1;
+			default:
+				ASSERT(0);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * defrag_run -- performs a single defragmentation pass
+ */
+int
+defrag_run(struct defrag *d)
+{
+	PMEMobjpool *pop = d->pop;
+
+	if (pmemobj_tx_stage() != TX_STAGE_NONE) {
+		ERR("defragmentation cannot be performed inside of a "
+			"transaction");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct defrag_pass p;
+	p.d = d;
+	p.relocated = 0;
+	VEC_INIT(&p.candidates);
+	VEC_INIT(&p.objects);
+
+	util_mutex_lock(&d->lock);
+	p.cb = d->cb;
+	p.threshold = d->threshold;
+	util_mutex_unlock(&d->lock);
+
+	if (p.cb.relocate == NULL) {
+		ERR("relocation callback not set");
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&d->pass_lock);
+
+	heap_foreach_run(&pop->heap, defrag_collect_cb, &p);
+
+	struct defrag_candidate *cand;
+	VEC_FOREACH_BY_PTR(cand, &p.candidates) {
+		if (defrag_evacuate(&p, cand) != 0)
+			break;
+	}
+
+	size_t reclaimed = heap_reclaim_empty_runs(&pop->heap);
+
+	util_mutex_unlock(&d->pass_lock);
+
+	STATS_INC(pop->stats, transient, heap_defrag_relocated, p.relocated);
+	STATS_INC(pop->stats, transient, heap_defrag_reclaimed, reclaimed);
+
+	LOG(4, "relocated %" PRIu64 " objects, reclaimed %zu bytes",
+		p.relocated, reclaimed);
+
+	VEC_DELETE(&p.candidates);
+	VEC_DELETE(&p.objects);
+
+	return 0;
+}
+
+/*
+ * defrag_worker -- (internal) periodically performs defragmentation passes
+ *	until stopped
+ */
+static void *
+defrag_worker(void *arg)
+{
+	struct defrag *d = arg;
+
+	util_mutex_lock(&d->lock);
+	while (!d->stop) {
+		struct timespec ts;
+		os_clock_gettime(CLOCK_REALTIME, &ts);
+
+		uint64_t nsec = (uint64_t)ts.tv_nsec +
+			(uint64_t)d->interval * 1000000ULL;
+		ts.tv_sec += (time_t)(nsec / 1000000000ULL);
+		ts.tv_nsec = (long)(nsec % 1000000000ULL);
+
+		os_cond_timedwait(&d->cond, &d->lock, &ts);
+		if (d->stop)
+			break;
+
+		util_mutex_unlock(&d->lock);
+
+		if (defrag_run(d) != 0)
+			LOG(2, "!defragmentation pass failed");
+
+		util_mutex_lock(&d->lock);
+	}
+	util_mutex_unlock(&d->lock);
+
+	return NULL;
+}
+
+/*
+ * defrag_is_enabled -- returns whether the background worker is running
+ */
+int
+defrag_is_enabled(struct defrag *d)
+{
+	util_mutex_lock(&d->state_lock);
+	int enabled = d->enabled;
+	util_mutex_unlock(&d->state_lock);
+
+	return enabled;
+}
+
+/*
+ * defrag_enable -- starts the background worker
+ */
+int
+defrag_enable(struct defrag *d)
+{
+	int ret = 0;
+
+	util_mutex_lock(&d->state_lock);
+	if (d->enabled)
+		goto out;
+
+	util_mutex_lock(&d->lock);
+	pobj_defrag_relocate_fn relocate = d->cb.relocate;
+	d->stop = 0;
+	util_mutex_unlock(&d->lock);
+
+	if (relocate == NULL) {
+		ERR("relocation callback not set");
+		errno = EINVAL;
+		ret = -1;
+		goto out;
+	}
+
+	if ((errno = os_thread_create(&d->worker, NULL,
+			defrag_worker, d)) != 0) {
+		ERR("!os_thread_create");
+		ret = -1;
+		goto out;
+	}
+
+	d->enabled = 1;
+
+out:
+	util_mutex_unlock(&d->state_lock);
+
+	return ret;
+}
+
+/*
+ * defrag_disable -- stops the background worker and waits for the pass
+ *	in progress to finish
+ */
+void
+defrag_disable(struct defrag *d)
+{
+	util_mutex_lock(&d->state_lock);
+	if (!d->enabled)
+		goto out;
+
+	util_mutex_lock(&d->lock);
+	d->stop = 1;
+	os_cond_signal(&d->cond);
+	util_mutex_unlock(&d->lock);
+
+	os_thread_join(&d->worker, NULL);
+	d->enabled = 0;
+
+out:
+	util_mutex_unlock(&d->state_lock);
+}
+
+/*
+ * defrag_set_callback -- changes the relocation callback
+ */
+int
+defrag_set_callback(struct defrag *d, const struct pobj_defrag_callback *cb)
+{
+	util_mutex_lock(&d->state_lock);
+
+	if (cb->relocate == NULL && d->enabled) {
+		util_mutex_unlock(&d->state_lock);
+		ERR("relocation callback cannot be removed while the "
+			"defragmentation is enabled");
+		errno = EBUSY;
+		return -1;
+	}
+
+	util_mutex_lock(&d->lock);
+	d->cb = *cb;
+	util_mutex_unlock(&d->lock);
+
+	util_mutex_unlock(&d->state_lock);
+
+	return 0;
+}
+
+/*
+ * defrag_get_threshold -- returns the occupancy below which runs are
+ *	evacuated
+ */
+unsigned
+defrag_get_threshold(struct defrag *d)
+{
+	util_mutex_lock(&d->lock);
+	unsigned threshold = d->threshold;
+	util_mutex_unlock(&d->lock);
+
+	return threshold;
+}
+
+/*
+ * defrag_set_threshold -- changes the occupancy below which runs are
+ *	evacuated
+ */
+int
+defrag_set_threshold(struct defrag *d, unsigned threshold)
+{
+	if (threshold == 0 || threshold > 100) {
+		ERR("defragmentation threshold must be between 1 and 100");
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&d->lock);
+	d->threshold = threshold;
+	util_mutex_unlock(&d->lock);
+
+	return 0;
+}
+
+/*
+ * defrag_get_interval -- returns the delay between the worker passes
+ */
+unsigned
+defrag_get_interval(struct defrag *d)
+{
+	util_mutex_lock(&d->lock);
+	unsigned interval = d->interval;
+	util_mutex_unlock(&d->lock);
+
+	return interval;
+}
+
+/*
+ * defrag_set_interval -- changes the delay between the worker passes
+ */
+int
+defrag_set_interval(struct defrag *d, unsigned interval)
+{
+	if (interval == 0) {
+		ERR("defragmentation interval must be larger than 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&d->lock);
+	d->interval = interval;
+	util_mutex_unlock(&d->lock);
+
+	return 0;
+}
+
+/*
+ * defrag_new -- creates a new defragmentation instance, the background
+ *	worker is not started
+ */
+struct defrag *
+defrag_new(PMEMobjpool *pop)
+{
+	struct defrag *d = Malloc(sizeof(*d));
+	if (d == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	d->pop = pop;
+	d->cb.relocate = NULL;
+	d->cb.arg = NULL;
+	d->threshold = DEFRAG_DEFAULT_THRESHOLD;
+	d->interval = DEFRAG_DEFAULT_INTERVAL;
+	d->enabled = 0;
+	d->stop = 0;
+
+	util_mutex_init(&d->lock);
+	os_cond_init(&d->cond);
+	util_mutex_init(&d->state_lock);
+	util_mutex_init(&d->pass_lock);
+
+	return d;
+}
+
+/*
+ * defrag_delete -- stops the background worker and deletes the
+ *	defragmentation instance
+ */
+void
+defrag_delete(struct defrag *d)
+{
+	defrag_disable(d);
+
+	util_mutex_destroy(&d->pass_lock);
+	util_mutex_destroy(&d->state_lock);
+	os_cond_destroy(&d->cond);
+	util_mutex_destroy(&d->lock);
+
+	Free(d);
+}
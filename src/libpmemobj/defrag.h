@@ -0,0 +1,68 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * defrag.h -- internal definitions for heap defragmentation
+ */
+
+#ifndef LIBPMEMOBJ_DEFRAG_H
+#define LIBPMEMOBJ_DEFRAG_H 1
+
+#include "libpmemobj.h"
+
+/* runs with a smaller percentage of used units are evacuated */
+#define DEFRAG_DEFAULT_THRESHOLD 50
+
+/* delay between the passes of the background worker, in milliseconds */
+#define DEFRAG_DEFAULT_INTERVAL 1000
+
+struct defrag;
+
+struct defrag *defrag_new(PMEMobjpool *pop);
+void defrag_delete(struct defrag *d);
+
+int defrag_set_callback(struct defrag *d,
+	const struct pobj_defrag_callback *cb);
+
+unsigned defrag_get_threshold(struct defrag *d);
+int defrag_set_threshold(struct defrag *d, unsigned threshold);
+
+unsigned defrag_get_interval(struct defrag *d);
+int defrag_set_interval(struct defrag *d, unsigned interval);
+
+int defrag_is_enabled(struct defrag *d);
+int defrag_enable(struct defrag *d);
+void defrag_disable(struct defrag *d);
+
+int defrag_run(struct defrag *d);
+
+#endif
@@ -38,6 +38,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <float.h>
+#include <inttypes.h>
 
 #include "queue.h"
 #include "heap.h"
@@ -46,15 +47,14 @@
 #include "sys_util.h"
 #include "valgrind_internal.h"
 #include "recycler.h"
+#include "tcache.h"
+#include "container_bitmap.h"
 #include "container_ravl.h"
 #include "container_seglists.h"
 #include "alloc_class.h"
 #include "os_thread.h"
 #include "set.h"
-
-/* calculates the size of the entire run, including any additional chunks */
-#define SIZEOF_RUN(runp, size_idx)\
-	(sizeof(*(runp)) + (((size_idx) - 1) * CHUNKSIZE))
+#include "vec.h"
 
 #define MAX_RUN_LOCKS MAX_CHUNK
 #define MAX_RUN_LOCKS_VG 1024 /* avoid perf issues /w drd */
@@ -64,6 +64,16 @@
  */
 #define HEAP_DEFAULT_GROW_SIZE (1 << 27) /* 128 megabytes */
 
+/* NUMA node of an arena that has not yet been bound to any node */
+#define ARENA_NODE_UNBOUND (-1)
+
+/*
+ * Geometry used for the heaps created by this process, set through the global
+ * heap.layout ctl namespace.
+ */
+static size_t Heap_create_chunksize = CHUNKSIZE;
+static unsigned Heap_create_run_bitmap_nval = MAX_BITMAP_VALUES;
+
 /*
  * Arenas store the collection of buckets for allocation classes. Each thread
  * is assigned an arena on its first allocator operation.
@@ -73,6 +83,12 @@ struct arena {
 	struct bucket *buckets[MAX_ALLOCATION_CLASSES];
 
 	size_t nthreads;
+
+	/* the node of threads using this arena, only for the NUMA policy */
+	int node;
+
+	/* how many times a thread had to wait for one of the buckets */
+	uint64_t lock_contention;
 };
 
 struct heap_rt {
@@ -80,9 +96,12 @@ struct heap_rt {
 
 	/* DON'T use these two variable directly! */
 	struct bucket *default_bucket;
-	struct arena *arenas;
+	VEC(, struct arena *) arenas;
+
+	/* how many times a thread had to wait for the default bucket */
+	uint64_t global_lock_contention;
 
-	/* protects assignment of arenas */
+	/* protects assignment of arenas and the arenas vector */
 	os_mutex_t arenas_lock;
 
 	/* stores a pointer to one of the arenas */
@@ -90,12 +109,32 @@ struct heap_rt {
 
 	struct recycler *recyclers[MAX_ALLOCATION_CLASSES];
 
+	/* per-thread caches of small memory blocks */
+	struct tcache_collection *tcaches;
+
 	os_mutex_t run_locks[MAX_RUN_LOCKS];
 	unsigned nlocks;
 
 	unsigned nzones;
 	unsigned zones_exhausted;
+
+	/* zones below zones_verified have been verified, in order */
+	os_mutex_t zones_verify_lock;
+	unsigned zones_verified;
+	int zones_corrupted;
+
+	/* loads the remaining zones in the background */
+	os_mutex_t prefetch_lock;
+	os_thread_t prefetcher;
+	int prefetch_running;
+	int32_t prefetch_stop;
+
+	/* number of arenas to which new threads are assigned */
 	unsigned narenas;
+	enum pobj_arena_policy arena_policy;
+
+	/* type of the container of the default bucket */
+	enum pobj_huge_container huge_container;
 };
 
 /*
@@ -107,28 +146,87 @@ heap_alloc_classes(struct palloc_heap *heap)
 	return heap->rt->alloc_classes;
 }
 
+/*
+ * heap_tcaches -- returns the collection of per-thread allocation caches
+ */
+struct tcache_collection *
+heap_tcaches(struct palloc_heap *heap)
+{
+	return heap->rt->tcaches;
+}
+
 
 /*
- * heap_arena_init -- (internal) initializes arena instance
+ * heap_arena_delete -- (internal) destroys arena instance
  */
 static void
-heap_arena_init(struct arena *arena)
+heap_arena_delete(struct arena *arena)
+{
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
+		if (arena->buckets[i] != NULL)
+			bucket_delete(arena->buckets[i]);
+
+	Free(arena);
+}
+
+/*
+ * heap_arena_new -- (internal) creates a new arena instance with buckets for
+ *	all of the currently existing allocation classes
+ */
+static struct arena *
+heap_arena_new(struct palloc_heap *heap)
 {
+	struct heap_rt *h = heap->rt;
+
+	struct arena *arena = Malloc(sizeof(*arena));
+	if (arena == NULL)
+		return NULL;
+
 	arena->nthreads = 0;
+	arena->node = ARENA_NODE_UNBOUND;
+	arena->lock_contention = 0;
 
 	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
 		arena->buckets[i] = NULL;
+
+	for (uint8_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		struct alloc_class *c = alloc_class_by_id(h->alloc_classes, i);
+		if (c == NULL)
+			continue;
+
+		arena->buckets[i] = bucket_new(container_new_seglists(heap), c);
+		if (arena->buckets[i] == NULL)
+			goto error_bucket_new;
+	}
+
+	return arena;
+
+error_bucket_new:
+	heap_arena_delete(arena);
+	return NULL;
 }
 
 /*
- * heap_arena_destroy -- (internal) destroys arena instance
+ * heap_arenas_grow -- (internal) creates arenas until there's at least
+ *	the given number of them, must be called with arenas lock held
  */
-static void
-heap_arena_destroy(struct arena *arena)
+static int
+heap_arenas_grow(struct palloc_heap *heap, unsigned narenas)
 {
-	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
-		if (arena->buckets[i] != NULL)
-			bucket_delete(arena->buckets[i]);
+	struct heap_rt *h = heap->rt;
+
+	while (VEC_SIZE(&h->arenas) < narenas) {
+		struct arena *arena = heap_arena_new(heap);
+		if (arena == NULL)
+			return -1;
+
+		if (VEC_PUSH_BACK(&h->arenas, arena) != 0) {
+			heap_arena_delete(arena);
+			return -1;
+		}
+	}
+
+	return 0;
 }
 
 /*
@@ -151,6 +249,35 @@ heap_thread_arena_destructor(void *arg)
 	util_fetch_and_sub64(&a->nthreads, 1);
 }
 
+/*
+ * heap_arena_least_used -- (internal) returns the least used arena out of
+ *	those that are either unbound or bound to the given node, or NULL if
+ *	there's no such arena
+ *
+ * When searching for an arena for a specific node, arenas already bound to
+ * that node are preferred over unbound arenas with the same number of threads.
+ */
+static struct arena *
+heap_arena_least_used(struct heap_rt *heap, int node)
+{
+	struct arena *least_used = NULL;
+
+	struct arena *a;
+	for (unsigned i = 0; i < heap->narenas; ++i) {
+		a = VEC_ARR(&heap->arenas)[i];
+		if (node != ARENA_NODE_UNBOUND &&
+		    a->node != ARENA_NODE_UNBOUND && a->node != node)
+			continue;
+
+		if (least_used == NULL || a->nthreads < least_used->nthreads ||
+		    (a->nthreads == least_used->nthreads &&
+		    a->node == node && least_used->node != node))
+			least_used = a;
+	}
+
+	return least_used;
+}
+
 /*
  * heap_thread_arena_assign -- (internal) assigns the least used arena
  *	to current thread
@@ -159,6 +286,11 @@ heap_thread_arena_destructor(void *arg)
  * used arena, a lock is used, but the nthreads counter of the arena is still
  * bumped using atomic instruction because it can happen in parallel to a
  * destructor of a thread, which also touches that variable.
+ *
+ * With the NUMA policy, the search is limited to arenas used by threads
+ * running on the same node as the current one, and the selected arena becomes
+ * bound to that node. The thread can later migrate to a different node, but
+ * its arena assignment doesn't change.
  */
 static struct arena *
 heap_thread_arena_assign(struct heap_rt *heap)
@@ -167,13 +299,19 @@ heap_thread_arena_assign(struct heap_rt *heap)
 
 	struct arena *least_used = NULL;
 
-	struct arena *a;
-	for (unsigned i = 0; i < heap->narenas; ++i) {
-		a = &heap->arenas[i];
-		if (least_used == NULL || a->nthreads < least_used->nthreads)
-			least_used = a;
+	if (heap->arena_policy == POBJ_ARENA_POLICY_NUMA) {
+		int node = os_thread_numa_node();
+		if (node >= 0) {
+			least_used = heap_arena_least_used(heap, node);
+			if (least_used != NULL &&
+			    least_used->node == ARENA_NODE_UNBOUND)
+				least_used->node = node;
+		}
 	}
 
+	if (least_used == NULL)
+		least_used = heap_arena_least_used(heap, ARENA_NODE_UNBOUND);
+
 	LOG(4, "assigning %p arena to current thread", least_used);
 
 	util_fetch_and_add64(&least_used->nthreads, 1);
@@ -208,16 +346,24 @@ heap_bucket_acquire_by_id(struct palloc_heap *heap, uint8_t class_id)
 {
 	struct heap_rt *rt = heap->rt;
 	struct bucket *b;
+	uint64_t *contention;
 
 	if (class_id == DEFAULT_ALLOC_CLASS_ID) {
 		b = rt->default_bucket;
+		contention = &rt->global_lock_contention;
 	} else {
 		struct arena *arena = heap_thread_arena(heap->rt);
 		ASSERTne(arena->buckets, NULL);
 		b = arena->buckets[class_id];
+		contention = &arena->lock_contention;
 	}
 
-	util_mutex_lock(&b->lock);
+	/* the counter is only touched if the thread is about to wait anyway */
+	if (util_mutex_trylock(&b->lock) != 0) {
+		if (heap->stats->enabled)
+			util_fetch_and_add64(contention, 1);
+		util_mutex_lock(&b->lock);
+	}
 
 	return b;
 }
@@ -254,14 +400,17 @@ heap_get_run_lock(struct palloc_heap *heap, uint32_t chunk_id)
  * heap_max_zone -- (internal) calculates how many zones can the heap fit
  */
 static unsigned
-heap_max_zone(size_t size)
+heap_max_zone(size_t size, size_t chunksize)
 {
 	unsigned max_zone = 0;
 	size -= sizeof(struct heap_header);
 
-	while (size >= ZONE_MIN_SIZE) {
+	size_t zone_min_size = ZONE_SIZE(chunksize, 1);
+	size_t zone_max_size = ZONE_SIZE(chunksize, MAX_CHUNK);
+
+	while (size >= zone_min_size) {
 		max_zone++;
-		size -= size <= ZONE_MAX_SIZE ? size : ZONE_MAX_SIZE;
+		size -= size <= zone_max_size ? size : zone_max_size;
 	}
 
 	return max_zone;
@@ -271,21 +420,24 @@ heap_max_zone(size_t size)
  * zone_calc_size_idx -- (internal) calculates zone size index
  */
 static uint32_t
-zone_calc_size_idx(uint32_t zone_id, unsigned max_zone, size_t heap_size)
+zone_calc_size_idx(uint32_t zone_id, unsigned max_zone, size_t heap_size,
+	size_t chunksize)
 {
 	ASSERT(max_zone > 0);
 	if (zone_id < max_zone - 1)
 		return MAX_CHUNK;
 
-	ASSERT(heap_size >= zone_id * ZONE_MAX_SIZE);
-	size_t zone_raw_size = heap_size - zone_id * ZONE_MAX_SIZE;
+	size_t zone_max_size = ZONE_SIZE(chunksize, MAX_CHUNK);
+
+	ASSERT(heap_size >= zone_id * zone_max_size);
+	size_t zone_raw_size = heap_size - zone_id * zone_max_size;
 
 	ASSERT(zone_raw_size >= (sizeof(struct zone_header) +
 			sizeof(struct chunk_header) * MAX_CHUNK));
 	zone_raw_size -= sizeof(struct zone_header) +
 		sizeof(struct chunk_header) * MAX_CHUNK;
 
-	size_t zone_size_idx = zone_raw_size / CHUNKSIZE;
+	size_t zone_size_idx = zone_raw_size / chunksize;
 	ASSERT(zone_size_idx <= UINT32_MAX);
 
 	return (uint32_t)zone_size_idx;
@@ -341,7 +493,7 @@ heap_zone_init(struct palloc_heap *heap, uint32_t zone_id,
 {
 	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
 	uint32_t size_idx = zone_calc_size_idx(zone_id, heap->rt->nzones,
-			*heap->sizep);
+			*heap->sizep, heap_chunksize(heap));
 
 	ASSERT(size_idx - first_chunk_id > 0);
 
@@ -368,9 +520,11 @@ heap_run_init(struct palloc_heap *heap, struct bucket *b,
 
 	struct zone *z = ZID_TO_ZONE(heap->layout, m->zone_id);
 
-	struct chunk_run *run = (struct chunk_run *)&z->chunks[m->chunk_id];
+	struct chunk_run *run = heap_get_chunk_run(heap, m);
 	ASSERTne(m->size_idx, 0);
-	size_t runsize = SIZEOF_RUN(run, m->size_idx);
+	size_t runsize = m->size_idx * heap_chunksize(heap);
+	size_t bitmap_size = heap_run_metasize(heap) -
+		sizeof(run->block_size) - sizeof(run->alignment);
 
 	VALGRIND_DO_MAKE_MEM_UNDEFINED(run, runsize);
 
@@ -379,21 +533,20 @@ heap_run_init(struct palloc_heap *heap, struct bucket *b,
 	run->block_size = c->unit_size;
 	run->alignment = c->run.alignment;
 
+	uint64_t *bitmap = RUN_BITMAP(run);
+
 	/* set all the bits */
-	memset(run->bitmap, 0xFF, sizeof(run->bitmap));
+	memset(bitmap, 0xFF, bitmap_size);
 
 	unsigned nval = c->run.bitmap_nval;
 	ASSERT(nval > 0);
 	/* clear only the bits available for allocations from this bucket */
-	memset(run->bitmap, 0, sizeof(uint64_t) * (nval - 1));
-	run->bitmap[nval - 1] = c->run.bitmap_lastval;
+	memset(bitmap, 0, sizeof(uint64_t) * (nval - 1));
+	bitmap[nval - 1] = c->run.bitmap_lastval;
 
 	VALGRIND_REMOVE_FROM_TX(run, runsize);
 
-	pmemops_flush(&heap->p_ops, run,
-		sizeof(run->block_size) +
-		sizeof(run->alignment) +
-		sizeof(run->bitmap));
+	pmemops_flush(&heap->p_ops, run, heap_run_metasize(heap));
 
 	struct chunk_header run_data_hdr;
 	run_data_hdr.type = CHUNK_TYPE_RUN_DATA;
@@ -430,14 +583,78 @@ heap_run_init(struct palloc_heap *heap, struct bucket *b,
 		sizeof(struct chunk_header) * m->size_idx);
 }
 
+/*
+ * Free blocks found while parsing a run bitmap are collected into a batch
+ * and inserted into the bucket in bulk.
+ */
+#define RUN_BLOCKS_BATCH 64
+
+struct run_blocks_batch {
+	struct bucket *b;
+	size_t nblocks;
+	struct memory_block blocks[RUN_BLOCKS_BATCH];
+};
+
+/*
+ * heap_run_batch_flush -- (internal) inserts all of the collected blocks
+ *	into the bucket
+ */
+static void
+heap_run_batch_flush(struct run_blocks_batch *batch)
+{
+	if (batch->nblocks == 0)
+		return;
+
+	bucket_insert_blocks(batch->b, batch->blocks, batch->nblocks);
+	batch->nblocks = 0;
+}
+
+/*
+ * heap_run_batch_add -- (internal) adds a free block to the batch
+ */
+static void
+heap_run_batch_add(struct run_blocks_batch *batch,
+	const struct memory_block *m)
+{
+	if (batch->nblocks == RUN_BLOCKS_BATCH)
+		heap_run_batch_flush(batch);
+
+	batch->blocks[batch->nblocks++] = *m;
+}
+
+/*
+ * heap_run_bitmap_next_free -- (internal) returns the index of the first
+ *	bitmap value, starting from the given one, that has any unset bits,
+ *	or nval if there's none
+ *
+ * Fully allocated values are skipped four at a time, a loop which compilers
+ * turn into vector instructions where available.
+ */
+static unsigned
+heap_run_bitmap_next_free(const uint64_t *bitmap, unsigned i, unsigned nval)
+{
+	for (; i + 4 <= nval; i += 4) {
+		if ((bitmap[i] & bitmap[i + 1] &
+		    bitmap[i + 2] & bitmap[i + 3]) != UINT64_MAX)
+			break;
+	}
+
+	for (; i < nval; ++i) {
+		if (bitmap[i] != UINT64_MAX)
+			break;
+	}
+
+	return i;
+}
+
 /*
  * heap_run_process_bitmap_value -- (internal) looks for unset bits in the
- * value, creates a valid memory block out of them and inserts that
- * block into the given bucket.
+ * value, creates a valid memory block out of them and adds that
+ * block to the batch of blocks to be inserted into the bucket.
  */
 static uint32_t
-heap_run_process_bitmap_value(struct bucket *b, struct memory_block *m,
-	uint64_t value, uint16_t base_offset)
+heap_run_process_bitmap_value(struct run_blocks_batch *batch,
+	struct memory_block *m, uint64_t value, uint16_t base_offset)
 {
 	uint64_t shift = 0; /* already processed bits */
 	uint32_t inserted = 0;
@@ -463,7 +680,7 @@ heap_run_process_bitmap_value(struct bucket *b, struct memory_block *m,
 
 			m->block_off = (uint16_t)(base_offset + shift);
 			m->size_idx = (uint32_t)(BITS_PER_VALUE - shift);
-			bucket_insert_block(b, m);
+			heap_run_batch_add(batch, m);
 
 			break;
 		} else if (shifted == UINT64_MAX) {
@@ -485,7 +702,7 @@ heap_run_process_bitmap_value(struct bucket *b, struct memory_block *m,
 
 			m->block_off = (uint16_t)(base_offset + (shift - size));
 			m->size_idx = (uint32_t)(size);
-			bucket_insert_block(b, m);
+			heap_run_batch_add(batch, m);
 		}
 	} while (shift != BITS_PER_VALUE);
 
@@ -510,16 +727,26 @@ heap_run_process_metadata(struct palloc_heap *heap, struct bucket *b,
 
 	ASSERTeq(run->block_size, c->unit_size);
 
+	struct run_blocks_batch batch;
+	batch.b = b;
+	batch.nblocks = 0;
+
 	struct memory_block nm = *m;
-	for (unsigned i = 0; i < c->run.bitmap_nval; ++i) {
-		ASSERT(i < MAX_BITMAP_VALUES);
-		uint64_t v = run->bitmap[i];
+	uint64_t *bitmap = RUN_BITMAP(run);
+	unsigned nval = c->run.bitmap_nval;
+	for (unsigned i = heap_run_bitmap_next_free(bitmap, 0, nval);
+	    i < nval;
+	    i = heap_run_bitmap_next_free(bitmap, i + 1, nval)) {
+		ASSERT(i < HEAP_RUN_BITMAP_NVAL(heap->layout));
+		uint64_t v = bitmap[i];
 		ASSERT(BITS_PER_VALUE * i <= UINT16_MAX);
 		block_off = (uint16_t)(BITS_PER_VALUE * i);
-		inserted_blocks += heap_run_process_bitmap_value(b, &nm, v,
+		inserted_blocks += heap_run_process_bitmap_value(&batch, &nm, v,
 			block_off);
 	}
 
+	heap_run_batch_flush(&batch);
+
 	return inserted_blocks;
 }
 
@@ -630,8 +857,9 @@ heap_reclaim_run(struct palloc_heap *heap, struct memory_block *m)
 	struct recycler_element e = recycler_element_new(heap, m);
 	if (c == NULL) {
 		struct alloc_class_run_proto run_proto;
-		alloc_class_generate_run_proto(&run_proto,
-			run->block_size, m->size_idx, run->alignment);
+		alloc_class_generate_run_proto(heap->rt->alloc_classes,
+			&run_proto, run->block_size, m->size_idx,
+			run->alignment, hdr->flags);
 
 		return e.free_space == run_proto.bitmap_nallocs;
 	}
@@ -706,6 +934,136 @@ heap_reclaim_zone_garbage(struct palloc_heap *heap, struct bucket *bucket,
 	}
 }
 
+/*
+ * heap_verify_zone_header --
+ *	(internal) verifies if the zone header is consistent
+ */
+static int
+heap_verify_zone_header(struct zone_header *hdr)
+{
+	if (hdr->magic != ZONE_HEADER_MAGIC) /* not initialized */
+		return 0;
+
+	if (hdr->size_idx == 0) {
+		ERR("heap: invalid zone size");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * heap_verify_chunk_header --
+ *	(internal) verifies if the chunk header is consistent
+ */
+static int
+heap_verify_chunk_header(struct chunk_header *hdr)
+{
+	if (hdr->type == CHUNK_TYPE_UNKNOWN) {
+		ERR("heap: invalid chunk type");
+		return -1;
+	}
+
+	if (hdr->type >= MAX_CHUNK_TYPE) {
+		ERR("heap: unknown chunk type");
+		return -1;
+	}
+
+	if (hdr->size_idx == 0) {
+		ERR("heap: invalid chunk size");
+		return -1;
+	}
+
+	if (hdr->flags & ~CHUNK_FLAGS_ALL_VALID) {
+		ERR("heap: invalid chunk flags");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * heap_verify_zone -- (internal) verifies if the zone is consistent
+ */
+static int
+heap_verify_zone(struct zone *zone)
+{
+	if (zone->header.magic == 0)
+		return 0; /* not initialized, and that is OK */
+
+	if (zone->header.magic != ZONE_HEADER_MAGIC) {
+		ERR("heap: invalid zone magic");
+		return -1;
+	}
+
+	if (heap_verify_zone_header(&zone->header))
+		return -1;
+
+	uint32_t i;
+	for (i = 0; i < zone->header.size_idx; ) {
+		if (heap_verify_chunk_header(&zone->chunk_headers[i]))
+			return -1;
+
+		i += zone->chunk_headers[i].size_idx;
+	}
+
+	if (i != zone->header.size_idx) {
+		ERR("heap: chunk sizes mismatch");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * heap_zones_verify -- (internal) verifies all the zones up to and including
+ *	zone_id that haven't been verified yet
+ *
+ * Zones are verified only once they are needed, so that opening the pool
+ * doesn't have to traverse the entire heap. Once a corrupted zone is found,
+ * the heap cannot be used anymore and all subsequent calls fail.
+ */
+static int
+heap_zones_verify(struct palloc_heap *heap, uint32_t zone_id)
+{
+	struct heap_rt *h = heap->rt;
+
+	util_mutex_lock(&h->zones_verify_lock);
+
+	while (!h->zones_corrupted && h->zones_verified <= zone_id) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, h->zones_verified);
+		if (heap_verify_zone(z) != 0) {
+			ERR("heap: zone %u is corrupted", h->zones_verified);
+			h->zones_corrupted = 1;
+		} else {
+			h->zones_verified++;
+		}
+	}
+
+	int ret = h->zones_corrupted ? -1 : 0;
+
+	util_mutex_unlock(&h->zones_verify_lock);
+
+	return ret;
+}
+
+/*
+ * heap_zone_update_if_needed -- (internal) updates the zone metadata if
+ *	the pool has been extended
+ */
+static void
+heap_zone_update_if_needed(struct palloc_heap *heap, uint32_t zone_id)
+{
+	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+
+	size_t size_idx = zone_calc_size_idx(zone_id, heap->rt->nzones,
+		*heap->sizep, heap_chunksize(heap));
+	if (size_idx == z->header.size_idx)
+		return;
+
+	heap_zone_init(heap, zone_id, z->header.size_idx);
+}
+
 /*
  * heap_populate_bucket -- (internal) creates volatile state of memory blocks
  */
@@ -718,6 +1076,9 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
 	if (h->zones_exhausted == h->nzones)
 		return ENOMEM;
 
+	if (heap_zones_verify(heap, h->zones_exhausted) != 0)
+		return EINVAL;
+
 	uint32_t zone_id = h->zones_exhausted++;
 	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
 
@@ -727,6 +1088,8 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
 
 	if (z->header.magic != ZONE_HEADER_MAGIC)
 		heap_zone_init(heap, zone_id, 0);
+	else
+		heap_zone_update_if_needed(heap, zone_id);
 
 	heap_reclaim_zone_garbage(heap, bucket, zone_id);
 
@@ -744,10 +1107,12 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
  *
  * If force is not set, this function might effectively be a noop if not enough
  * of space was freed.
+ *
+ * If reclaimed is not NULL, the size of the reclaimed runs is added to it.
  */
 static int
 heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
-	struct bucket *defb, int force)
+	struct bucket *defb, int force, size_t *reclaimed)
 {
 	struct empty_runs r = recycler_recalc(recycler, force);
 	if (VEC_SIZE(&r) == 0)
@@ -758,6 +1123,11 @@ heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
 
 	struct memory_block *nm;
 	VEC_FOREACH_BY_PTR(nm, &r) {
+		if (reclaimed != NULL) {
+			struct chunk_header *hdr = heap_get_chunk_hdr(heap, nm);
+			*reclaimed += hdr->size_idx * heap_chunksize(heap);
+		}
+
 		heap_run_into_free_chunk(heap, nb ? nb : defb, nm);
 	}
 
@@ -781,13 +1151,38 @@ heap_reclaim_garbage(struct palloc_heap *heap, struct bucket *bucket)
 		if ((r = heap->rt->recyclers[i]) == NULL)
 			continue;
 
-		if (heap_recycle_unused(heap, r, bucket, 1) == 0)
+		if (heap_recycle_unused(heap, r, bucket, 1, NULL) == 0)
 			ret = 0;
 	}
 
 	return ret;
 }
 
+/*
+ * heap_reclaim_empty_runs -- turns all empty runs held by the recyclers into
+ *	free chunks, returns the number of reclaimed bytes
+ */
+size_t
+heap_reclaim_empty_runs(struct palloc_heap *heap)
+{
+	size_t reclaimed = 0;
+
+	struct bucket *defb = heap_bucket_acquire_by_id(heap,
+		DEFAULT_ALLOC_CLASS_ID);
+
+	struct recycler *r;
+	for (size_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		if ((r = heap->rt->recyclers[i]) == NULL)
+			continue;
+
+		heap_recycle_unused(heap, r, defb, 1, &reclaimed);
+	}
+
+	heap_bucket_release(heap, defb);
+
+	return reclaimed;
+}
+
 /*
  * heap_ensure_huge_bucket_filled --
  *	(internal) refills the default bucket if needed
@@ -798,8 +1193,9 @@ heap_ensure_huge_bucket_filled(struct palloc_heap *heap, struct bucket *bucket)
 	if (heap_reclaim_garbage(heap, bucket) == 0)
 		return 0;
 
-	if (heap_populate_bucket(heap, bucket) == 0)
-		return 0;
+	int ret = heap_populate_bucket(heap, bucket);
+	if (ret != ENOMEM)
+		return ret;
 
 	int extend;
 	if ((extend = heap_extend(heap, bucket, heap->growsize)) < 0)
@@ -813,10 +1209,7 @@ heap_ensure_huge_bucket_filled(struct palloc_heap *heap, struct bucket *bucket)
 	 * runtime state of the bucket - we need to traverse the new zone if
 	 * it was created.
 	 */
-	if (heap_populate_bucket(heap, bucket) == 0)
-		return 0;
-
-	return ENOMEM;
+	return heap_populate_bucket(heap, bucket);
 }
 
 /*
@@ -837,7 +1230,7 @@ heap_reuse_from_recycler(struct palloc_heap *heap,
 		return 0;
 	}
 
-	heap_recycle_unused(heap, r, NULL, force);
+	heap_recycle_unused(heap, r, NULL, force, NULL);
 
 	if (recycler_get(r, &m) == 0) {
 		heap_run_reuse(heap, b, &m);
@@ -890,7 +1283,8 @@ heap_ensure_run_bucket_filled(struct palloc_heap *heap, struct bucket *b,
 	struct bucket *defb = heap_bucket_acquire_by_id(heap,
 		DEFAULT_ALLOC_CLASS_ID);
 	/* cannot reuse an existing run, create a new one */
-	if (heap_get_bestfit_block(heap, defb, &m) == 0) {
+	int err = heap_get_bestfit_block(heap, defb, &m);
+	if (err == 0) {
 
 		ASSERTeq(m.block_off, 0);
 		heap_run_create(heap, b, &m);
@@ -904,6 +1298,11 @@ heap_ensure_run_bucket_filled(struct palloc_heap *heap, struct bucket *b,
 	}
 	heap_bucket_release(heap, defb);
 
+	if (err != ENOMEM) {
+		ret = err;
+		goto out;
+	}
+
 	if (heap_reuse_from_recycler(heap, b, units, 0) == 0)
 		goto out;
 
@@ -993,15 +1392,16 @@ heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block *m)
 {
 	uint32_t units = m->size_idx;
+	int ret;
 
 	while (b->c_ops->get_rm_bestfit(b->container, m) != 0) {
-		if (b->aclass->type == CLASS_HUGE) {
-			if (heap_ensure_huge_bucket_filled(heap, b) != 0)
-				return ENOMEM;
-		} else {
-			if (heap_ensure_run_bucket_filled(heap, b, units) != 0)
-				return ENOMEM;
-		}
+		if (b->aclass->type == CLASS_HUGE)
+			ret = heap_ensure_huge_bucket_filled(heap, b);
+		else
+			ret = heap_ensure_run_bucket_filled(heap, b, units);
+
+		if (ret != 0)
+			return ret;
 	}
 
 	ASSERT(m->size_idx >= units);
@@ -1117,14 +1517,15 @@ heap_end(struct palloc_heap *h)
 
 	struct zone *last_zone = ZID_TO_ZONE(h->layout, h->rt->nzones - 1);
 
-	return &last_zone->chunks[last_zone->header.size_idx];
+	return GET_CHUNK(h->layout, h->rt->nzones - 1,
+		last_zone->header.size_idx);
 }
 
 /*
- * heap_get_narenas -- (internal) returns the number of arenas to create
+ * heap_default_narenas -- (internal) returns the number of arenas to create
  */
 static unsigned
-heap_get_narenas(void)
+heap_default_narenas(void)
 {
 	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
 	if (cpus < 1)
@@ -1153,27 +1554,62 @@ heap_create_alloc_class_buckets(struct palloc_heap *heap, struct alloc_class *c)
 			goto error_recycler_new;
 	}
 
-	int i;
-	for (i = 0; i < (int)h->narenas; ++i) {
-		h->arenas[i].buckets[c->id] = bucket_new(
+	/*
+	 * Arenas created after the class has been added to the collection
+	 * already have a bucket for it.
+	 */
+	util_mutex_lock(&h->arenas_lock);
+
+	struct arena *arena;
+	VEC_FOREACH(arena, &h->arenas) {
+		if (arena->buckets[c->id] != NULL)
+			continue;
+
+		arena->buckets[c->id] = bucket_new(
 			container_new_seglists(heap), c);
-		if (h->arenas[i].buckets[c->id] == NULL)
+		if (arena->buckets[c->id] == NULL)
 			goto error_cache_bucket_new;
 	}
 
+	util_mutex_unlock(&h->arenas_lock);
+
 	return 0;
 
 error_cache_bucket_new:
 	recycler_delete(h->recyclers[c->id]);
 
-	for (i -= 1; i >= 0; --i) {
-		bucket_delete(h->arenas[i].buckets[c->id]);
+	VEC_FOREACH(arena, &h->arenas) {
+		if (arena->buckets[c->id] != NULL)
+			bucket_delete(arena->buckets[c->id]);
+		arena->buckets[c->id] = NULL;
 	}
 
+	util_mutex_unlock(&h->arenas_lock);
+
 error_recycler_new:
 	return -1;
 }
 
+/*
+ * heap_huge_container_new -- (internal) creates a container for the free
+ *	huge blocks of the given type
+ */
+static struct block_container *
+heap_huge_container_new(struct palloc_heap *heap,
+	enum pobj_huge_container type)
+{
+	switch (type) {
+		case POBJ_HUGE_CONTAINER_RAVL:
+			return container_new_ravl(heap);
+		case POBJ_HUGE_CONTAINER_BITMAP:
+			return container_new_bitmap(heap);
+		default:
+			ASSERT(0);
+	}
+
+	return NULL;
+}
+
 /*
  * heap_buckets_init -- (internal) initializes bucket instances
  */
@@ -1190,21 +1626,372 @@ heap_buckets_init(struct palloc_heap *heap)
 		}
 	}
 
-	h->default_bucket = bucket_new(container_new_ravl(heap),
+	h->default_bucket = bucket_new(
+		heap_huge_container_new(heap, h->huge_container),
 		alloc_class_by_id(h->alloc_classes, DEFAULT_ALLOC_CLASS_ID));
 
 	if (h->default_bucket == NULL)
 		goto error_bucket_create;
 
+	util_mutex_lock(&h->arenas_lock);
+	int ret = heap_arenas_grow(heap, h->narenas);
+	util_mutex_unlock(&h->arenas_lock);
+
+	if (ret != 0)
+		goto error_arenas_grow;
+
 	return 0;
 
+error_arenas_grow:
+	bucket_delete(h->default_bucket);
+	h->default_bucket = NULL;
 error_bucket_create:
-	for (unsigned i = 0; i < h->narenas; ++i)
-		heap_arena_destroy(&h->arenas[i]);
-
 	return -1;
 }
 
+/*
+ * heap_get_narenas -- returns the number of arenas to which new threads
+ *	are assigned
+ */
+unsigned
+heap_get_narenas(struct palloc_heap *heap)
+{
+	return heap->rt->narenas;
+}
+
+/*
+ * heap_set_narenas -- changes the number of arenas to which new threads
+ *	are assigned
+ *
+ * Arenas are never destroyed at runtime, lowering the number only means that
+ * the remaining arenas won't be assigned to any new threads.
+ */
+int
+heap_set_narenas(struct palloc_heap *heap, unsigned narenas)
+{
+	struct heap_rt *h = heap->rt;
+
+	if (narenas == 0) {
+		ERR("the number of arenas must be larger than 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&h->arenas_lock);
+
+	int ret = heap_arenas_grow(heap, narenas);
+	if (ret == 0)
+		h->narenas = narenas;
+	else
+		errno = ENOMEM;
+
+	util_mutex_unlock(&h->arenas_lock);
+
+	return ret;
+}
+
+/*
+ * heap_get_arena_policy -- returns the policy of assigning threads to arenas
+ */
+enum pobj_arena_policy
+heap_get_arena_policy(struct palloc_heap *heap)
+{
+	return heap->rt->arena_policy;
+}
+
+/*
+ * heap_set_arena_policy -- changes the policy of assigning threads to arenas,
+ *	threads that already have an arena keep it
+ */
+int
+heap_set_arena_policy(struct palloc_heap *heap, enum pobj_arena_policy policy)
+{
+	if ((unsigned)policy >= MAX_POBJ_ARENA_POLICIES) {
+		ERR("invalid arena policy");
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&heap->rt->arenas_lock);
+	heap->rt->arena_policy = policy;
+	util_mutex_unlock(&heap->rt->arenas_lock);
+
+	return 0;
+}
+
+/*
+ * heap_get_huge_container -- returns the type of the container that holds
+ *	the free huge blocks
+ */
+enum pobj_huge_container
+heap_get_huge_container(struct palloc_heap *heap)
+{
+	struct bucket *b = heap_bucket_acquire_by_id(heap,
+		DEFAULT_ALLOC_CLASS_ID);
+	enum pobj_huge_container type = heap->rt->huge_container;
+	heap_bucket_release(heap, b);
+
+	return type;
+}
+
+/*
+ * heap_move_blocks -- (internal) moves all memory blocks from one container
+ *	to another
+ */
+static int
+heap_move_blocks(struct block_container *from, struct block_container *to)
+{
+	struct memory_block m = MEMORY_BLOCK_NONE;
+	m.size_idx = 1;
+
+	while (from->c_ops->get_rm_bestfit(from, &m) == 0) {
+		if (to->c_ops->insert(to, &m) != 0) {
+			/*
+			 * The block is still free on the medium, so failing to
+			 * put it back only hides it until the pool is reopened.
+			 */
+			if (from->c_ops->insert(from, &m) != 0)
+				LOG(2, "free block lost until reopen");
+			return -1;
+		}
+
+		m = MEMORY_BLOCK_NONE;
+		m.size_idx = 1;
+	}
+
+	return 0;
+}
+
+/*
+ * heap_set_huge_container -- replaces the container that holds the free huge
+ *	blocks, moving all of the blocks into the new one
+ */
+int
+heap_set_huge_container(struct palloc_heap *heap,
+	enum pobj_huge_container type)
+{
+	if ((unsigned)type >= MAX_POBJ_HUGE_CONTAINERS) {
+		ERR("invalid huge container type");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct block_container *c = heap_huge_container_new(heap, type);
+	if (c == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	struct bucket *b = heap_bucket_acquire_by_id(heap,
+		DEFAULT_ALLOC_CLASS_ID);
+
+	if (heap->rt->huge_container == type) {
+		heap_bucket_release(heap, b);
+		c->c_ops->destroy(c);
+		return 0;
+	}
+
+	if (heap_move_blocks(b->container, c) != 0) {
+		heap_move_blocks(c, b->container);
+		heap_bucket_release(heap, b);
+		c->c_ops->destroy(c);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	struct block_container *old = b->container;
+	b->container = c;
+	b->c_ops = c->c_ops;
+	heap->rt->huge_container = type;
+
+	heap_bucket_release(heap, b);
+
+	old->c_ops->destroy(old);
+
+	return 0;
+}
+
+/*
+ * heap_get_arena_info -- retrieves the number of threads assigned to an arena
+ *	and the NUMA node to which it's bound
+ */
+int
+heap_get_arena_info(struct palloc_heap *heap, unsigned arena_id,
+	uint64_t *nthreads, int *node)
+{
+	struct heap_rt *h = heap->rt;
+	int ret = 0;
+
+	util_mutex_lock(&h->arenas_lock);
+
+	if (arena_id >= VEC_SIZE(&h->arenas)) {
+		ERR("arena with the given id does not exist");
+		errno = ENOENT;
+		ret = -1;
+	} else {
+		struct arena *arena = VEC_ARR(&h->arenas)[arena_id];
+		*nthreads = arena->nthreads;
+		*node = arena->node;
+	}
+
+	util_mutex_unlock(&h->arenas_lock);
+
+	return ret;
+}
+
+/*
+ * heap_get_arena_lock_contention -- retrieves how many times threads had to
+ *	wait for the buckets of an arena
+ */
+int
+heap_get_arena_lock_contention(struct palloc_heap *heap, unsigned arena_id,
+	uint64_t *contention)
+{
+	struct heap_rt *h = heap->rt;
+	int ret = 0;
+
+	util_mutex_lock(&h->arenas_lock);
+
+	if (arena_id >= VEC_SIZE(&h->arenas)) {
+		ERR("arena with the given id does not exist");
+		errno = ENOENT;
+		ret = -1;
+	} else {
+		struct arena *arena = VEC_ARR(&h->arenas)[arena_id];
+		util_atomic_load_explicit64(&arena->lock_contention,
+			contention, memory_order_acquire);
+	}
+
+	util_mutex_unlock(&h->arenas_lock);
+
+	return ret;
+}
+
+/*
+ * heap_get_global_lock_contention -- returns how many times threads had to
+ *	wait for the default bucket
+ */
+uint64_t
+heap_get_global_lock_contention(struct palloc_heap *heap)
+{
+	uint64_t contention;
+	util_atomic_load_explicit64(&heap->rt->global_lock_contention,
+		&contention, memory_order_acquire);
+
+	return contention;
+}
+
+/*
+ * heap_get_recycler_pending -- returns the number of runs of an allocation
+ *	class that are waiting for their reservations to be fulfilled before
+ *	they can be recycled
+ */
+size_t
+heap_get_recycler_pending(struct palloc_heap *heap, uint8_t class_id)
+{
+	struct recycler *r = heap->rt->recyclers[class_id];
+
+	return r == NULL ? 0 : recycler_pending_count(r);
+}
+
+/*
+ * heap_get_zones_loaded -- returns the number of zones whose volatile state
+ *	has already been created
+ */
+unsigned
+heap_get_zones_loaded(struct palloc_heap *heap)
+{
+	struct bucket *defb = heap_bucket_acquire_by_id(heap,
+		DEFAULT_ALLOC_CLASS_ID);
+
+	unsigned nzones = heap->rt->zones_exhausted;
+
+	heap_bucket_release(heap, defb);
+
+	return nzones;
+}
+
+/*
+ * heap_prefetch_worker -- (internal) loads the zones one by one until all of
+ *	them are loaded or the prefetcher is stopped
+ */
+static void *
+heap_prefetch_worker(void *arg)
+{
+	struct palloc_heap *heap = arg;
+	struct heap_rt *h = heap->rt;
+
+	int32_t stop = 0;
+	while (!stop) {
+		struct bucket *defb = heap_bucket_acquire_by_id(heap,
+			DEFAULT_ALLOC_CLASS_ID);
+
+		/* the bucket is released between zones to not starve others */
+		int ret = heap_populate_bucket(heap, defb);
+
+		heap_bucket_release(heap, defb);
+
+		util_atomic_load_explicit32(&h->prefetch_stop, &stop,
+			memory_order_acquire);
+		stop = stop || ret != 0;
+	}
+
+	return NULL;
+}
+
+/*
+ * heap_get_zones_prefetch -- returns whether the zones are loaded in
+ *	the background
+ */
+int
+heap_get_zones_prefetch(struct palloc_heap *heap)
+{
+	struct heap_rt *h = heap->rt;
+
+	util_mutex_lock(&h->prefetch_lock);
+	int running = h->prefetch_running;
+	util_mutex_unlock(&h->prefetch_lock);
+
+	return running;
+}
+
+/*
+ * heap_set_zones_prefetch -- starts or stops loading the zones in
+ *	the background
+ *
+ * Stopping the prefetcher waits for the zone that is being loaded.
+ */
+int
+heap_set_zones_prefetch(struct palloc_heap *heap, int enable)
+{
+	struct heap_rt *h = heap->rt;
+	int ret = 0;
+
+	util_mutex_lock(&h->prefetch_lock);
+
+	if (enable && !h->prefetch_running) {
+		util_atomic_store_explicit32(&h->prefetch_stop, 0,
+			memory_order_release);
+		if ((errno = os_thread_create(&h->prefetcher, NULL,
+				heap_prefetch_worker, heap)) != 0) {
+			ERR("!os_thread_create");
+			ret = -1;
+		} else {
+			h->prefetch_running = 1;
+		}
+	} else if (!enable && h->prefetch_running) {
+		util_atomic_store_explicit32(&h->prefetch_stop, 1,
+			memory_order_release);
+		os_thread_join(&h->prefetcher, NULL);
+
+		h->prefetch_running = 0;
+	}
+
+	util_mutex_unlock(&h->prefetch_lock);
+
+	return ret;
+}
+
 /*
  * heap_extend -- extend the heap by the given size
  *
@@ -1229,7 +2016,7 @@ heap_extend(struct palloc_heap *heap, struct bucket *b, size_t size)
 	 * automatically on the next heap_boot.
 	 */
 
-	uint32_t nzones = heap_max_zone(*heap->sizep);
+	uint32_t nzones = heap_max_zone(*heap->sizep, heap_chunksize(heap));
 	uint32_t zone_id = nzones - 1;
 	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
 	uint32_t chunk_id = heap->rt->nzones == nzones ? z->header.size_idx : 0;
@@ -1254,29 +2041,6 @@ heap_extend(struct palloc_heap *heap, struct bucket *b, size_t size)
 	return 1;
 }
 
-/*
- * heap_zone_update_if_needed -- updates the zone metadata if the pool has been
- *	extended.
- */
-static void
-heap_zone_update_if_needed(struct palloc_heap *heap)
-{
-	struct zone *z;
-
-	for (uint32_t i = 0; i < heap->rt->nzones; ++i) {
-		z = ZID_TO_ZONE(heap->layout, i);
-		if (z->header.magic != ZONE_HEADER_MAGIC)
-			continue;
-
-		size_t size_idx = zone_calc_size_idx(i, heap->rt->nzones,
-			*heap->sizep);
-		if (size_idx == z->header.size_idx)
-			continue;
-
-		heap_zone_init(heap, i, z->header.size_idx);
-	}
-}
-
 /*
  * heap_boot -- opens the heap region of the pmemobj pool
  *
@@ -1308,23 +2072,34 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 		goto error_heap_malloc;
 	}
 
-	h->alloc_classes = alloc_class_collection_new();
+	h->alloc_classes = alloc_class_collection_new(
+		HEAP_CHUNKSIZE(heap_start),
+		HEAP_RUN_BITMAP_NVAL(heap_start));
 	if (h->alloc_classes == NULL) {
 		err = ENOMEM;
 		goto error_alloc_classes_new;
 	}
 
-	h->narenas = heap_get_narenas();
-	h->arenas = Malloc(sizeof(struct arena) * h->narenas);
-	if (h->arenas == NULL) {
+	h->tcaches = tcache_collection_new(heap);
+	if (h->tcaches == NULL) {
 		err = ENOMEM;
-		goto error_arenas_malloc;
+		goto error_tcaches_new;
 	}
 
-	h->nzones = heap_max_zone(heap_size);
+	h->narenas = heap_default_narenas();
+	h->arena_policy = POBJ_ARENA_POLICY_LEAST_USED;
+	h->huge_container = POBJ_HUGE_CONTAINER_RAVL;
+	VEC_INIT(&h->arenas);
+	h->global_lock_contention = 0;
+
+	h->nzones = heap_max_zone(heap_size, HEAP_CHUNKSIZE(heap_start));
 
 	h->zones_exhausted = 0;
 
+	util_mutex_init(&h->zones_verify_lock);
+	h->zones_verified = 0;
+	h->zones_corrupted = 0;
+
 	h->nlocks = On_valgrind ? MAX_RUN_LOCKS_VG : MAX_RUN_LOCKS;
 	for (unsigned i = 0; i < h->nlocks; ++i)
 		util_mutex_init(&h->run_locks[i]);
@@ -1342,19 +2117,19 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	heap->set = set;
 	heap->growsize = HEAP_DEFAULT_GROW_SIZE;
 	heap->alloc_pattern = PALLOC_CTL_DEBUG_NO_PATTERN;
+	heap->alloc_class_coloring = 0;
 	VALGRIND_DO_CREATE_MEMPOOL(heap->layout, 0, 0);
 
-	for (unsigned i = 0; i < h->narenas; ++i)
-		heap_arena_init(&h->arenas[i]);
-
 	for (unsigned i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
 		h->recyclers[i] = NULL;
 
-	heap_zone_update_if_needed(heap);
+	util_mutex_init(&h->prefetch_lock);
+	h->prefetch_running = 0;
+	h->prefetch_stop = 0;
 
 	return 0;
 
-error_arenas_malloc:
+error_tcaches_new:
 	alloc_class_collection_delete(h->alloc_classes);
 error_alloc_classes_new:
 	Free(h);
@@ -1363,6 +2138,93 @@ error_heap_malloc:
 	return err;
 }
 
+/*
+ * heap_verify_chunksize -- (internal) checks if the chunk size is valid
+ */
+static int
+heap_verify_chunksize(uint64_t chunksize)
+{
+	return chunksize < MIN_CHUNKSIZE || chunksize > MAX_CHUNKSIZE ||
+		!util_is_pow2(chunksize);
+}
+
+/*
+ * heap_verify_run_bitmap_nval -- (internal) checks if the number of run
+ *	bitmap values is valid
+ */
+static int
+heap_verify_run_bitmap_nval(uint64_t nval)
+{
+	return nval < MAX_BITMAP_VALUES || nval > MAX_RUN_BITMAP_VALUES ||
+		RUN_METASIZE_NVAL((unsigned)nval) % CACHELINE_SIZE != 0;
+}
+
+/*
+ * heap_get_create_chunksize -- returns the chunk size of new heaps
+ */
+size_t
+heap_get_create_chunksize(void)
+{
+	return Heap_create_chunksize;
+}
+
+/*
+ * heap_set_create_chunksize -- changes the chunk size of new heaps
+ */
+int
+heap_set_create_chunksize(size_t chunksize)
+{
+	if (heap_verify_chunksize(chunksize)) {
+		ERR("chunk size has to be a power of two between %zu and %zu",
+			MIN_CHUNKSIZE, MAX_CHUNKSIZE);
+		errno = EINVAL;
+		return -1;
+	}
+
+	Heap_create_chunksize = chunksize;
+
+	return 0;
+}
+
+/*
+ * heap_create_geometry_is_default -- checks whether new heaps are created
+ *	with the default chunk size and run bitmap length
+ */
+int
+heap_create_geometry_is_default(void)
+{
+	return Heap_create_chunksize == CHUNKSIZE &&
+		Heap_create_run_bitmap_nval == MAX_BITMAP_VALUES;
+}
+
+/*
+ * heap_get_create_run_bitmap_nval -- returns the maximum number of 8 byte
+ *	values of run bitmaps in new heaps
+ */
+unsigned
+heap_get_create_run_bitmap_nval(void)
+{
+	return Heap_create_run_bitmap_nval;
+}
+
+/*
+ * heap_set_create_run_bitmap_nval -- changes the maximum number of 8 byte
+ *	values of run bitmaps in new heaps
+ */
+int
+heap_set_create_run_bitmap_nval(unsigned nval)
+{
+	if (heap_verify_run_bitmap_nval(nval)) {
+		ERR("invalid run bitmap length");
+		errno = EINVAL;
+		return -1;
+	}
+
+	Heap_create_run_bitmap_nval = nval;
+
+	return 0;
+}
+
 /*
  * heap_write_header -- (internal) creates a clean header
  */
@@ -1374,8 +2236,11 @@ heap_write_header(struct heap_header *hdr)
 		.major = HEAP_MAJOR,
 		.minor = HEAP_MINOR,
 		.unused = 0,
-		.chunksize = CHUNKSIZE,
+		.chunksize = Heap_create_chunksize,
 		.chunks_per_zone = MAX_CHUNK,
+		.run_bitmap_nval =
+			Heap_create_run_bitmap_nval == MAX_BITMAP_VALUES ?
+			0 : Heap_create_run_bitmap_nval,
 		.reserved = {0},
 		.checksum = 0
 	};
@@ -1393,7 +2258,8 @@ int
 heap_init(void *heap_start, uint64_t heap_size, uint64_t *sizep,
 	struct pmem_ops *p_ops)
 {
-	if (heap_size < HEAP_MIN_SIZE)
+	if (heap_size < sizeof(struct heap_header) +
+			ZONE_SIZE(Heap_create_chunksize, 1))
 		return EINVAL;
 
 	VALGRIND_DO_MAKE_MEM_UNDEFINED(heap_start, heap_size);
@@ -1402,7 +2268,7 @@ heap_init(void *heap_start, uint64_t heap_size, uint64_t *sizep,
 	heap_write_header(&layout->header);
 	pmemops_persist(p_ops, &layout->header, sizeof(struct heap_header));
 
-	unsigned zones = heap_max_zone(heap_size);
+	unsigned zones = heap_max_zone(heap_size, Heap_create_chunksize);
 	for (unsigned i = 0; i < zones; ++i) {
 		struct zone *zone = ZID_TO_ZONE(layout, i);
 		pmemops_memset(p_ops, &zone->header, 0,
@@ -1429,12 +2295,19 @@ heap_cleanup(struct palloc_heap *heap)
 {
 	struct heap_rt *rt = heap->rt;
 
+	heap_set_zones_prefetch(heap, 0);
+	util_mutex_destroy(&rt->prefetch_lock);
+	util_mutex_destroy(&rt->zones_verify_lock);
+
+	tcache_collection_delete(rt->tcaches);
+
 	alloc_class_collection_delete(rt->alloc_classes);
 
 	bucket_delete(rt->default_bucket);
 
-	for (unsigned i = 0; i < rt->narenas; ++i)
-		heap_arena_destroy(&rt->arenas[i]);
+	struct arena *arena;
+	VEC_FOREACH(arena, &rt->arenas)
+		heap_arena_delete(arena);
 
 	for (unsigned i = 0; i < rt->nlocks; ++i)
 		util_mutex_destroy(&rt->run_locks[i]);
@@ -1443,7 +2316,7 @@ heap_cleanup(struct palloc_heap *heap)
 
 	os_tls_key_delete(rt->thread_arena);
 
-	Free(rt->arenas);
+	VEC_DELETE(&rt->arenas);
 
 	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
 		if (heap->rt->recyclers[i] == NULL)
@@ -1474,21 +2347,15 @@ heap_verify_header(struct heap_header *hdr)
 		return -1;
 	}
 
-	return 0;
-}
-
-/*
- * heap_verify_zone_header --
- *	(internal) verifies if the zone header is consistent
- */
-static int
-heap_verify_zone_header(struct zone_header *hdr)
-{
-	if (hdr->magic != ZONE_HEADER_MAGIC) /* not initialized */
-		return 0;
+	if (heap_verify_chunksize(hdr->chunksize)) {
+		ERR("heap: invalid chunk size %" PRIu64, hdr->chunksize);
+		return -1;
+	}
 
-	if (hdr->size_idx == 0) {
-		ERR("heap: invalid zone size");
+	if (hdr->run_bitmap_nval != 0 &&
+	    heap_verify_run_bitmap_nval(hdr->run_bitmap_nval)) {
+		ERR("heap: invalid run bitmap length %" PRIu64,
+			hdr->run_bitmap_nval);
 		return -1;
 	}
 
@@ -1496,24 +2363,15 @@ heap_verify_zone_header(struct zone_header *hdr)
 }
 
 /*
- * heap_verify_chunk_header --
- *	(internal) verifies if the chunk header is consistent
+ * heap_check_size -- (internal) verifies if the heap can fit at least
+ *	a single zone with one chunk
  */
 static int
-heap_verify_chunk_header(struct chunk_header *hdr)
+heap_check_size(uint64_t heap_size, struct heap_header *hdr)
 {
-	if (hdr->type == CHUNK_TYPE_UNKNOWN) {
-		ERR("heap: invalid chunk type");
-		return -1;
-	}
-
-	if (hdr->type >= MAX_CHUNK_TYPE) {
-		ERR("heap: unknown chunk type");
-		return -1;
-	}
-
-	if (hdr->flags & ~CHUNK_FLAGS_ALL_VALID) {
-		ERR("heap: invalid chunk flags");
+	if (heap_size < sizeof(struct heap_header) +
+			ZONE_SIZE(hdr->chunksize, 1)) {
+		ERR("heap: invalid heap size");
 		return -1;
 	}
 
@@ -1521,36 +2379,23 @@ heap_verify_chunk_header(struct chunk_header *hdr)
 }
 
 /*
- * heap_verify_zone -- (internal) verifies if the zone is consistent
+ * heap_check_header -- verifies the heap size and header, the zones are
+ *	verified once they are loaded
  */
-static int
-heap_verify_zone(struct zone *zone)
+int
+heap_check_header(void *heap_start, uint64_t heap_size)
 {
-	if (zone->header.magic == 0)
-		return 0; /* not initialized, and that is OK */
-
-	if (zone->header.magic != ZONE_HEADER_MAGIC) {
-		ERR("heap: invalid zone magic");
+	if (heap_size < HEAP_MIN_SIZE) {
+		ERR("heap: invalid heap size");
 		return -1;
 	}
 
-	if (heap_verify_zone_header(&zone->header))
-		return -1;
-
-	uint32_t i;
-	for (i = 0; i < zone->header.size_idx; ) {
-		if (heap_verify_chunk_header(&zone->chunk_headers[i]))
-			return -1;
-
-		i += zone->chunk_headers[i].size_idx;
-	}
+	struct heap_layout *layout = heap_start;
 
-	if (i != zone->header.size_idx) {
-		ERR("heap: chunk sizes mismatch");
+	if (heap_verify_header(&layout->header))
 		return -1;
-	}
 
-	return 0;
+	return heap_check_size(heap_size, &layout->header);
 }
 
 /*
@@ -1561,17 +2406,13 @@ heap_verify_zone(struct zone *zone)
 int
 heap_check(void *heap_start, uint64_t heap_size)
 {
-	if (heap_size < HEAP_MIN_SIZE) {
-		ERR("heap: invalid heap size");
+	if (heap_check_header(heap_start, heap_size))
 		return -1;
-	}
 
 	struct heap_layout *layout = heap_start;
+	unsigned zones = heap_max_zone(heap_size, HEAP_CHUNKSIZE(layout));
 
-	if (heap_verify_header(&layout->header))
-		return -1;
-
-	for (unsigned i = 0; i < heap_max_zone(heap_size); ++i) {
+	for (unsigned i = 0; i < zones; ++i) {
 		if (heap_verify_zone(ZID_TO_ZONE(layout, i)))
 			return -1;
 	}
@@ -1605,14 +2446,22 @@ heap_check_remote(void *heap_start, uint64_t heap_size, struct remote_ops *ops)
 	if (heap_verify_header(&header))
 		return -1;
 
+	if (heap_check_size(heap_size, &header))
+		return -1;
+
+	size_t zone_size = ZONE_SIZE(header.chunksize, MAX_CHUNK);
+	unsigned zones = heap_max_zone(heap_size, header.chunksize);
+
 	struct zone *zone_buff = (struct zone *)Malloc(sizeof(struct zone));
 	if (zone_buff == NULL) {
 		ERR("heap: zone_buff malloc error");
 		return -1;
 	}
-	for (unsigned i = 0; i < heap_max_zone(heap_size); ++i) {
+	for (unsigned i = 0; i < zones; ++i) {
+		/* the header of the remote heap is not accessible locally */
+		void *zone = (char *)&layout->zone0 + zone_size * i;
 		if (ops->read(ops->ctx, ops->base, zone_buff,
-				ZID_TO_ZONE(layout, i), sizeof(struct zone))) {
+				zone, sizeof(struct zone))) {
 			ERR("heap: obj_read_remote error");
 			goto out;
 		}
@@ -1641,13 +2490,15 @@ heap_run_foreach_object(struct palloc_heap *heap, object_callback cb,
 	uint16_t block_off;
 
 	struct chunk_run *run = heap_get_chunk_run(heap, m);
+	struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
 
 	struct alloc_class_run_proto run_proto;
-	alloc_class_generate_run_proto(&run_proto,
-		run->block_size, m->size_idx, run->alignment);
+	alloc_class_generate_run_proto(heap->rt->alloc_classes, &run_proto,
+		run->block_size, m->size_idx, run->alignment, hdr->flags);
 
+	uint64_t *bitmap = RUN_BITMAP(run);
 	for (; i < run_proto.bitmap_nval; ++i) {
-		uint64_t v = run->bitmap[i];
+		uint64_t v = bitmap[i];
 		block_off = (uint16_t)(BITS_PER_VALUE * i);
 
 		for (uint16_t j = block_start; j < BITS_PER_VALUE; ) {
@@ -1681,6 +2532,102 @@ heap_run_foreach_object(struct palloc_heap *heap, object_callback cb,
 	return 0;
 }
 
+/*
+ * heap_loaded_foreach_chunk -- (internal) calls cb for every chunk, or only
+ *	for every run, in the zones that have already been loaded into the
+ *	runtime state of the heap
+ *
+ * The default bucket is held for the duration of the traversal, so that the
+ * chunk headers cannot be split, coalesced or turned into runs in parallel.
+ * The callback must not acquire that bucket.
+ */
+static void
+heap_loaded_foreach_chunk(struct palloc_heap *heap, object_callback cb,
+	void *arg, int runs_only)
+{
+	struct bucket *defb = heap_bucket_acquire_by_id(heap,
+		DEFAULT_ALLOC_CLASS_ID);
+
+	for (uint32_t zone_id = 0; zone_id < heap->rt->zones_exhausted;
+		++zone_id) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+
+		for (uint32_t i = 0; i < z->header.size_idx; ) {
+			struct chunk_header *hdr = &z->chunk_headers[i];
+			ASSERT(hdr->size_idx != 0);
+
+			uint32_t size_idx = hdr->size_idx;
+			if (!runs_only || hdr->type == CHUNK_TYPE_RUN) {
+				struct memory_block m = MEMORY_BLOCK_NONE;
+				m.zone_id = zone_id;
+				m.chunk_id = i;
+				m.size_idx = size_idx;
+				memblock_rebuild_state(heap, &m);
+
+				if (cb(&m, arg) != 0)
+					goto out;
+			}
+
+			i += size_idx;
+		}
+	}
+
+out:
+	heap_bucket_release(heap, defb);
+}
+
+/*
+ * heap_foreach_chunk -- calls cb for every chunk in the zones that have
+ *	already been loaded into the runtime state of the heap
+ *
+ * The callback must not acquire the default bucket.
+ */
+void
+heap_foreach_chunk(struct palloc_heap *heap, object_callback cb, void *arg)
+{
+	heap_loaded_foreach_chunk(heap, cb, arg, 0);
+}
+
+/*
+ * heap_foreach_run -- calls cb for every run in the zones that have already
+ *	been loaded into the runtime state of the heap
+ *
+ * The callback must not acquire the default bucket.
+ */
+void
+heap_foreach_run(struct palloc_heap *heap, object_callback cb, void *arg)
+{
+	heap_loaded_foreach_chunk(heap, cb, arg, 1);
+}
+
+/*
+ * heap_run_get_usage -- retrieves the number of used units and the number of
+ *	all units in the run
+ *
+ * Must be called with the run lock held.
+ */
+void
+heap_run_get_usage(struct palloc_heap *heap, const struct memory_block *m,
+	uint32_t *used, uint32_t *nallocs)
+{
+	ASSERTeq(m->type, MEMORY_BLOCK_RUN);
+
+	struct chunk_run *run = heap_get_chunk_run(heap, m);
+	struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
+
+	struct alloc_class_run_proto run_proto;
+	alloc_class_generate_run_proto(heap->rt->alloc_classes, &run_proto,
+		run->block_size, hdr->size_idx, run->alignment, hdr->flags);
+
+	uint64_t *bitmap = RUN_BITMAP(run);
+	uint32_t free_space = 0;
+	for (unsigned i = 0; i < run_proto.bitmap_nval; ++i)
+		free_space += util_popcount64(~bitmap[i]);
+
+	*nallocs = run_proto.bitmap_nallocs;
+	*used = run_proto.bitmap_nallocs - free_space;
+}
+
 /*
  * heap_chunk_foreach_object -- (internal) iterates through objects in a chunk
  */
@@ -1733,17 +2680,24 @@ heap_zone_foreach_object(struct palloc_heap *heap, object_callback cb,
 
 /*
  * heap_foreach_object -- (internal) iterates through objects in the heap
+ *
+ * Returns -1 if one of the traversed zones is corrupted, 0 otherwise.
  */
-void
+int
 heap_foreach_object(struct palloc_heap *heap, object_callback cb, void *arg,
 	struct memory_block m)
 {
 	for (; m.zone_id < heap->rt->nzones; ++m.zone_id) {
+		if (heap_zones_verify(heap, m.zone_id) != 0)
+			return -1;
+
 		if (heap_zone_foreach_object(heap, cb, arg, &m) != 0)
 			break;
 
 		m.chunk_id = 0;
 	}
+
+	return 0;
 }
 
 #if VG_MEMCHECK_ENABLED
@@ -1764,11 +2718,10 @@ heap_vg_open_chunk(struct palloc_heap *heap,
 
 		ASSERTne(m->size_idx, 0);
 		VALGRIND_DO_MAKE_MEM_NOACCESS(run,
-			SIZEOF_RUN(run, m->size_idx));
+			m->size_idx * heap_chunksize(heap));
 
 		/* set the run metadata as defined */
-		VALGRIND_DO_MAKE_MEM_DEFINED(run,
-			sizeof(*run) - sizeof(run->data));
+		VALGRIND_DO_MAKE_MEM_DEFINED(run, heap_run_metasize(heap));
 
 		if (objects) {
 			int ret = heap_run_foreach_object(heap, cb, arg, m);
@@ -1787,8 +2740,10 @@ heap_vg_open_chunk(struct palloc_heap *heap,
 
 /*
  * heap_vg_open -- notifies Valgrind about heap layout
+ *
+ * Returns -1 if one of the zones is corrupted, 0 otherwise.
  */
-void
+int
 heap_vg_open(struct palloc_heap *heap, object_callback cb,
 	void *arg, int objects)
 {
@@ -1799,7 +2754,7 @@ heap_vg_open(struct palloc_heap *heap, object_callback cb,
 
 	VALGRIND_DO_MAKE_MEM_DEFINED(&layout->header, sizeof(layout->header));
 
-	unsigned zones = heap_max_zone(*heap->sizep);
+	unsigned zones = heap_max_zone(*heap->sizep, heap_chunksize(heap));
 
 	struct memory_block m = MEMORY_BLOCK_NONE;
 	for (unsigned i = 0; i < zones; ++i) {
@@ -1810,6 +2765,15 @@ heap_vg_open(struct palloc_heap *heap, object_callback cb,
 
 		VALGRIND_DO_MAKE_MEM_DEFINED(&z->header, sizeof(z->header));
 
+		/* the zone has to be verified before it can be traversed */
+		VALGRIND_DO_MAKE_MEM_DEFINED(&z->chunk_headers,
+			sizeof(z->chunk_headers));
+		int ret = heap_zones_verify(heap, i);
+		VALGRIND_DO_MAKE_MEM_UNDEFINED(&z->chunk_headers,
+			sizeof(z->chunk_headers));
+		if (ret != 0)
+			return -1;
+
 		if (z->header.magic != ZONE_HEADER_MAGIC)
 			continue;
 
@@ -1856,5 +2820,7 @@ heap_vg_open(struct palloc_heap *heap, object_callback cb,
 		VALGRIND_DO_MAKE_MEM_NOACCESS(&z->chunk_headers[chunks],
 			(MAX_CHUNK - chunks) * sizeof(struct chunk_header));
 	}
+
+	return 0;
 }
 #endif
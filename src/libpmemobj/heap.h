@@ -61,6 +61,7 @@ int heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 int heap_init(void *heap_start, uint64_t heap_size, uint64_t *sizep,
 	struct pmem_ops *p_ops);
 void heap_cleanup(struct palloc_heap *heap);
+int heap_check_header(void *heap_start, uint64_t heap_size);
 int heap_check(void *heap_start, uint64_t heap_size);
 int heap_check_remote(void *heap_start, uint64_t heap_size,
 		struct remote_ops *ops);
@@ -68,6 +69,30 @@ int heap_buckets_init(struct palloc_heap *heap);
 int heap_create_alloc_class_buckets(struct palloc_heap *heap,
 	struct alloc_class *c);
 
+unsigned heap_get_narenas(struct palloc_heap *heap);
+int heap_set_narenas(struct palloc_heap *heap, unsigned narenas);
+enum pobj_arena_policy heap_get_arena_policy(struct palloc_heap *heap);
+int heap_set_arena_policy(struct palloc_heap *heap,
+	enum pobj_arena_policy policy);
+enum pobj_huge_container heap_get_huge_container(struct palloc_heap *heap);
+int heap_set_huge_container(struct palloc_heap *heap,
+	enum pobj_huge_container type);
+int heap_get_arena_info(struct palloc_heap *heap, unsigned arena_id,
+	uint64_t *nthreads, int *node);
+int heap_get_arena_lock_contention(struct palloc_heap *heap,
+	unsigned arena_id, uint64_t *contention);
+uint64_t heap_get_global_lock_contention(struct palloc_heap *heap);
+size_t heap_get_recycler_pending(struct palloc_heap *heap, uint8_t class_id);
+
+size_t heap_get_create_chunksize(void);
+int heap_set_create_chunksize(size_t chunksize);
+unsigned heap_get_create_run_bitmap_nval(void);
+int heap_create_geometry_is_default(void);
+int heap_set_create_run_bitmap_nval(unsigned nval);
+unsigned heap_get_zones_loaded(struct palloc_heap *heap);
+int heap_get_zones_prefetch(struct palloc_heap *heap);
+int heap_set_zones_prefetch(struct palloc_heap *heap, int enable);
+
 int heap_extend(struct palloc_heap *heap, struct bucket *defb, size_t size);
 
 struct alloc_class *
@@ -99,16 +124,52 @@ heap_free_chunk_reuse(struct palloc_heap *heap,
 int
 heap_run_foreach_object(struct palloc_heap *heap, object_callback cb,
 	void *arg, struct memory_block *m);
-void heap_foreach_object(struct palloc_heap *heap, object_callback cb,
+int heap_foreach_object(struct palloc_heap *heap, object_callback cb,
 	void *arg, struct memory_block start);
+void heap_foreach_chunk(struct palloc_heap *heap, object_callback cb,
+	void *arg);
+void heap_foreach_run(struct palloc_heap *heap, object_callback cb,
+	void *arg);
+void heap_run_get_usage(struct palloc_heap *heap, const struct memory_block *m,
+	uint32_t *used, uint32_t *nallocs);
+size_t heap_reclaim_empty_runs(struct palloc_heap *heap);
 
 struct alloc_class_collection *heap_alloc_classes(struct palloc_heap *heap);
+struct tcache_collection *heap_tcaches(struct palloc_heap *heap);
 
 void *heap_end(struct palloc_heap *heap);
 
-void heap_vg_open(struct palloc_heap *heap, object_callback cb,
+int heap_vg_open(struct palloc_heap *heap, object_callback cb,
 		void *arg, int objects);
 
+/*
+ * heap_chunksize -- returns the size of a single chunk of the heap
+ */
+static inline size_t
+heap_chunksize(struct palloc_heap *heap)
+{
+	return HEAP_CHUNKSIZE(heap->layout);
+}
+
+/*
+ * heap_run_metasize -- returns the size of the metadata of a run, which
+ *	includes the longest bitmap allowed in the heap
+ */
+static inline size_t
+heap_run_metasize(struct palloc_heap *heap)
+{
+	return RUN_METASIZE_NVAL(HEAP_RUN_BITMAP_NVAL(heap->layout));
+}
+
+/*
+ * heap_run_data -- returns the beginning of the data of a run
+ */
+static inline void *
+heap_run_data(struct palloc_heap *heap, struct chunk_run *run)
+{
+	return (char *)run + heap_run_metasize(heap);
+}
+
 static inline struct chunk_header *
 heap_get_chunk_hdr(struct palloc_heap *heap, const struct memory_block *m)
 {
@@ -45,7 +45,9 @@
 
 #define MAX_CHUNK (UINT16_MAX - 7) /* has to be multiple of 8 */
 #define CHUNK_BASE_ALIGNMENT 1024
-#define CHUNKSIZE ((size_t)1024 * 256)	/* 256 kilobytes */
+#define CHUNKSIZE ((size_t)1024 * 256)	/* default, 256 kilobytes */
+#define MIN_CHUNKSIZE CHUNKSIZE
+#define MAX_CHUNKSIZE ((size_t)1024 * 1024 * 16)	/* 16 megabytes */
 #define MAX_MEMORY_BLOCK_SIZE (MAX_CHUNK * CHUNKSIZE)
 #define HEAP_SIGNATURE_LEN 16
 #define HEAP_SIGNATURE "MEMORY_HEAP_HDR\0"
@@ -58,11 +60,16 @@
 #define MAX_CACHELINE_ALIGNMENT 40 /* run alignment, 5 cachelines */
 #define RUN_METASIZE (MAX_CACHELINE_ALIGNMENT * 8)
 #define MAX_BITMAP_VALUES (MAX_CACHELINE_ALIGNMENT - 2)
+#define MAX_RUN_BITMAP_VALUES 1022 /* run metadata up to 8 kilobytes */
 #define RUN_BITMAP_SIZE (BITS_PER_VALUE * MAX_BITMAP_VALUES)
 #define RUNSIZE (CHUNKSIZE - RUN_METASIZE)
 #define MIN_RUN_SIZE 128
 #define RUN_BASE_ALIGNMENT 64
 
+/* distance between the color offsets of colored runs */
+#define RUN_COLOR_STRIDE(alignment)\
+((alignment) > RUN_BASE_ALIGNMENT ? (alignment) : RUN_BASE_ALIGNMENT)
+
 #define CHUNK_MASK ((CHUNKSIZE) - 1)
 #define CHUNK_ALIGN_UP(value) ((((value) + CHUNK_MASK) & ~CHUNK_MASK))
 
@@ -70,12 +77,16 @@ enum chunk_flags {
 	CHUNK_FLAG_COMPACT_HEADER	=	0x0001,
 	CHUNK_FLAG_HEADER_NONE		=	0x0002,
 	CHUNK_FLAG_ALIGNED		=	0x0004,
+	CHUNK_FLAG_COLORED		=	0x0008,
+	CHUNK_FLAG_ALIGNED_TAIL		=	0x0010,
 };
 
 #define CHUNK_FLAGS_ALL_VALID (\
 	CHUNK_FLAG_COMPACT_HEADER |\
 	CHUNK_FLAG_HEADER_NONE |\
-	CHUNK_FLAG_ALIGNED\
+	CHUNK_FLAG_ALIGNED |\
+	CHUNK_FLAG_COLORED |\
+	CHUNK_FLAG_ALIGNED_TAIL\
 )
 
 enum chunk_type {
@@ -93,6 +104,10 @@ struct chunk {
 	uint8_t data[CHUNKSIZE];
 };
 
+/*
+ * The run as laid out in the default geometry - heaps with longer run bitmaps
+ * have the data moved accordingly, see RUN_METASIZE_NVAL.
+ */
 struct chunk_run {
 	uint64_t block_size;
 	uint64_t alignment; /* valid only /w CHUNK_FLAG_ALIGNED */
@@ -125,7 +140,8 @@ struct heap_header {
 	uint64_t unused; /* might be garbage */
 	uint64_t chunksize;
 	uint64_t chunks_per_zone;
-	uint8_t reserved[960];
+	uint64_t run_bitmap_nval; /* 0 in heaps that use the default */
+	uint8_t reserved[952];
 	uint64_t checksum;
 };
 
@@ -152,11 +168,69 @@ struct allocation_header_compact {
 	uint64_t extra;
 };
 
+/*
+ * The size of chunks and the maximum length of run bitmaps are chosen when
+ * the heap is created and recorded in its header. The CHUNKSIZE, RUNSIZE,
+ * RUN_METASIZE, ZONE_MAX_SIZE and related definitions describe the default
+ * geometry, the functions below have to be used to access any heap.
+ */
+
+/*
+ * HEAP_CHUNKSIZE -- returns the size of a single chunk of the heap
+ */
+static inline size_t
+HEAP_CHUNKSIZE(struct heap_layout *layout)
+{
+	return layout->header.chunksize;
+}
+
+/*
+ * HEAP_RUN_BITMAP_NVAL -- returns the maximum number of 8 byte values of
+ *	a run bitmap
+ */
+static inline unsigned
+HEAP_RUN_BITMAP_NVAL(struct heap_layout *layout)
+{
+	uint64_t nval = layout->header.run_bitmap_nval;
+
+	return nval == 0 ? MAX_BITMAP_VALUES : (unsigned)nval;
+}
+
+/*
+ * RUN_METASIZE_NVAL -- returns the size of the run metadata, the data of the
+ *	run begins right after it
+ */
+static inline size_t
+RUN_METASIZE_NVAL(unsigned nval)
+{
+	return (nval + 2) * sizeof(uint64_t);
+}
+
+/*
+ * RUN_BITMAP -- returns the bitmap of a run, which might be longer than
+ *	the one in the definition of struct chunk_run
+ */
+static inline uint64_t *
+RUN_BITMAP(struct chunk_run *run)
+{
+	return (uint64_t *)
+		((uintptr_t)run + offsetof(struct chunk_run, bitmap));
+}
+
+/*
+ * ZONE_SIZE -- returns the size of a zone with the given number of chunks
+ */
+static inline size_t
+ZONE_SIZE(size_t chunksize, size_t nchunks)
+{
+	return sizeof(struct zone) + chunksize * nchunks;
+}
+
 static inline struct zone *
 ZID_TO_ZONE(struct heap_layout *layout, size_t zone_id)
 {
-	return (struct zone *)
-		((uintptr_t)&layout->zone0 + ZONE_MAX_SIZE * zone_id);
+	return (struct zone *)((uintptr_t)&layout->zone0 +
+		ZONE_SIZE(HEAP_CHUNKSIZE(layout), MAX_CHUNK) * zone_id);
 }
 
 static inline struct chunk_header *
@@ -168,7 +242,10 @@ GET_CHUNK_HDR(struct heap_layout *layout, size_t zone_id, unsigned chunk_id)
 static inline struct chunk *
 GET_CHUNK(struct heap_layout *layout, size_t zone_id, unsigned chunk_id)
 {
-	return &ZID_TO_ZONE(layout, zone_id)->chunks[chunk_id];
+	struct zone *z = ZID_TO_ZONE(layout, zone_id);
+
+	return (struct chunk *)((uintptr_t)z->chunks +
+		HEAP_CHUNKSIZE(layout) * chunk_id);
 }
 
 static inline struct chunk_run *
@@ -383,13 +383,13 @@ static struct {
 };
 
 /*
- * huge_block_size -- returns the compile-time constant which defines the
- *	huge memory block size.
+ * huge_block_size -- returns the size of a chunk, which is the huge memory
+ *	block size of the heap.
  */
 static size_t
 huge_block_size(const struct memory_block *m)
 {
-	return CHUNKSIZE;
+	return heap_chunksize(m->heap);
 }
 
 /*
@@ -413,37 +413,67 @@ huge_get_real_data(const struct memory_block *m)
 	return heap_get_chunk(m->heap, m)->data;
 }
 
+/*
+ * run_get_color_offset -- (internal) returns the offset by which the beginning
+ *	of allocations is moved in colored runs
+ *
+ * Consecutive runs of a class are given consecutive colors, so that objects
+ * at the same index in different runs do not map to the same cache sets.
+ * The color is derived from the location of the run, and the number of
+ * colors from the unit size, so neither has to be stored in the run.
+ */
+static size_t
+run_get_color_offset(const struct memory_block *m, struct chunk_header *hdr,
+	struct chunk_run *run)
+{
+	if (!(hdr->flags & CHUNK_FLAG_COLORED))
+		return 0;
+
+	size_t stride = RUN_COLOR_STRIDE(hdr->flags & CHUNK_FLAG_ALIGNED ?
+		run->alignment : 0);
+	size_t ncolors = run->block_size / stride;
+	if (ncolors <= 1)
+		return 0;
+
+	size_t color = (m->chunk_id / hdr->size_idx + m->zone_id) % ncolors;
+
+	return color * stride;
+}
+
 /*
  * run_get_data_start -- (internal) returns the pointer to the beginning of
  *	allocations in a run
  */
 static char *
-run_get_data_start(struct chunk_header *hdr, struct chunk_run *run,
-	enum header_type htype)
+run_get_data_start(const struct memory_block *m, struct chunk_header *hdr,
+	struct chunk_run *run)
 {
+	char *data = heap_run_data(m->heap, run);
+
 	if (hdr->flags & CHUNK_FLAG_ALIGNED) {
 		/*
 		 * Alignment is property of user data in allocations. And
 		 * since objects have headers, we need to take them into
 		 * account when calculating the address.
 		 */
-		uintptr_t hsize = header_type_to_size[htype];
-		uintptr_t base = (uintptr_t)run->data + hsize;
-		return (char *)(ALIGN_UP(base, run->alignment) - hsize);
-	} else {
-		return (char *)&run->data;
+		uintptr_t hsize = header_type_to_size[m->header_type];
+		uintptr_t base = (uintptr_t)data + hsize;
+		data = (char *)(ALIGN_UP(base, run->alignment) - hsize);
 	}
+
+	return data + run_get_color_offset(m, hdr, run);
 }
 
 /*
  * run_get_alignment_padding -- (internal) returns the number of bytes of
- *	padding in aligned runs
+ *	padding in aligned and colored runs
  */
 static size_t
-run_get_alignment_padding(struct chunk_header *hdr, struct chunk_run *run,
-	enum header_type htype)
+run_get_alignment_padding(const struct memory_block *m,
+	struct chunk_header *hdr, struct chunk_run *run)
 {
-	return (size_t)run_get_data_start(hdr, run, htype) - (size_t)&run->data;
+	return (size_t)run_get_data_start(m, hdr, run) -
+		(size_t)heap_run_data(m->heap, run);
 }
 
 /*
@@ -456,7 +486,7 @@ run_get_real_data(const struct memory_block *m)
 	struct chunk_header *hdr = heap_get_chunk_hdr(m->heap, m);
 	ASSERT(run->block_size != 0);
 
-	return run_get_data_start(hdr, run, m->header_type) +
+	return run_get_data_start(m, hdr, run) +
 		(run->block_size * m->block_off);
 }
 
@@ -591,10 +621,10 @@ run_prep_operation_hdr(const struct memory_block *m, enum memblock_state op,
 
 	/* the bit mask is applied immediately by the add entry operations */
 	if (op == MEMBLOCK_ALLOCATED) {
-		operation_add_entry(ctx, &r->bitmap[bpos],
+		operation_add_entry(ctx, &RUN_BITMAP(r)[bpos],
 			bmask, REDO_OPERATION_OR);
 	} else if (op == MEMBLOCK_FREE) {
-		operation_add_entry(ctx, &r->bitmap[bpos],
+		operation_add_entry(ctx, &RUN_BITMAP(r)[bpos],
 			~bmask, REDO_OPERATION_AND);
 	} else {
 		ASSERT(0);
@@ -648,10 +678,10 @@ run_get_state(const struct memory_block *m)
 	struct chunk_header *hdr = &z->chunk_headers[m->chunk_id];
 	ASSERTeq(hdr->type, CHUNK_TYPE_RUN);
 
-	struct chunk_run *r = (struct chunk_run *)&z->chunks[m->chunk_id];
+	struct chunk_run *r = heap_get_chunk_run(m->heap, m);
 
 	unsigned v = m->block_off / BITS_PER_VALUE;
-	uint64_t bitmap = r->bitmap[v];
+	uint64_t bitmap = RUN_BITMAP(r)[v];
 	unsigned b = m->block_off % BITS_PER_VALUE;
 
 	unsigned b_last = b + m->size_idx;
@@ -852,18 +882,23 @@ memblock_from_offset_opt(struct palloc_heap *heap, uint64_t off, int size)
 	struct memory_block m = MEMORY_BLOCK_NONE;
 	m.heap = heap;
 
+	size_t chunksize = heap_chunksize(heap);
+	size_t zone_size = ZONE_SIZE(chunksize, MAX_CHUNK);
+
 	off -= HEAP_PTR_TO_OFF(heap, &heap->layout->zone0);
-	m.zone_id = (uint32_t)(off / ZONE_MAX_SIZE);
+	m.zone_id = (uint32_t)(off / zone_size);
 
-	off -= (ZONE_MAX_SIZE * m.zone_id) + sizeof(struct zone);
-	m.chunk_id = (uint32_t)(off / CHUNKSIZE);
+	off -= (zone_size * m.zone_id) + sizeof(struct zone);
+	m.chunk_id = (uint32_t)(off / chunksize);
 
 	struct chunk_header *hdr = heap_get_chunk_hdr(heap, &m);
 
-	if (hdr->type == CHUNK_TYPE_RUN_DATA)
+	if (hdr->type == CHUNK_TYPE_RUN_DATA) {
 		m.chunk_id -= hdr->size_idx;
+		hdr = heap_get_chunk_hdr(heap, &m);
+	}
 
-	off -= CHUNKSIZE * m.chunk_id;
+	off -= chunksize * m.chunk_id;
 
 	m.header_type = memblock_header_type(&m);
 
@@ -879,8 +914,8 @@ memblock_from_offset_opt(struct palloc_heap *heap, uint64_t off, int size)
 	if (off != 0) { /* run */
 		struct chunk_run *run = heap_get_chunk_run(heap, &m);
 
-		off -= run_get_alignment_padding(hdr, run, m.header_type);
-		off -= RUN_METASIZE;
+		off -= run_get_alignment_padding(&m, hdr, run);
+		off -= heap_run_metasize(heap);
 		m.block_off = (uint16_t)(off / unit_size);
 		off -= m.block_off * unit_size;
 	}
@@ -47,6 +47,7 @@
 #include "mmap.h"
 #include "obj.h"
 #include "ctl_global.h"
+#include "defrag.h"
 
 #include "heap_layout.h"
 #include "os.h"
@@ -326,6 +327,7 @@ obj_init(void)
 	 * subsequent call to this function for individual pools.
 	 */
 	ctl_global_register();
+	pmalloc_global_ctl_register();
 
 	if (obj_ctl_init_and_load(NULL))
 		FATAL("error: %s", pmemobj_errormsg());
@@ -1259,6 +1261,10 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 	if (pop->stats == NULL)
 		goto err_stat;
 
+	pop->defrag = defrag_new(pop);
+	if (pop->defrag == NULL)
+		goto err_defrag;
+
 	VALGRIND_REMOVE_PMEM_MAPPING(&pop->mutex_head,
 		sizeof(pop->mutex_head));
 	VALGRIND_REMOVE_PMEM_MAPPING(&pop->rwlock_head,
@@ -1320,6 +1326,8 @@ err_tree_insert:
 err_cuckoo_insert:
 	obj_runtime_cleanup_common(pop);
 err_boot:
+	defrag_delete(pop->defrag);
+err_defrag:
 	stats_delete(pop, pop->stats);
 err_stat:
 	tx_params_delete(pop->tx_params);
@@ -1388,8 +1396,16 @@ pmemobj_createU(const char *path, const char *layout,
 	 */
 	unsigned runtime_nlanes = obj_get_nlanes();
 
+	/*
+	 * Older versions of the library assume the default geometry of
+	 * the heap and must not open pools that use a different one.
+	 */
+	struct pool_attr adj_pool_attr = Obj_create_attr;
+	if (!palloc_create_geometry_is_default())
+		adj_pool_attr.incompat_features |= POOL_FEAT_HEAP_GEOMETRY;
+
 	if (util_pool_create(&set, path, poolsize, PMEMOBJ_MIN_POOL,
-			PMEMOBJ_MIN_PART, &Obj_create_attr, &runtime_nlanes,
+			PMEMOBJ_MIN_PART, &adj_pool_attr, &runtime_nlanes,
 			REPLICAS_ENABLED) != 0) {
 		LOG(2, "cannot create pool or pool set");
 		return NULL;
@@ -1499,11 +1515,14 @@ pmemobj_createW(const wchar_t *path, const wchar_t *layout, size_t poolsize,
 /*
  * obj_check_basic_local -- (internal) basic pool consistency check
  *                              of a local replica
+ *
+ * If full is not set, only the heap header is verified. The zones are then
+ * verified once they are loaded by the allocator.
  */
 static int
-obj_check_basic_local(PMEMobjpool *pop, size_t mapped_size)
+obj_check_basic_local(PMEMobjpool *pop, size_t mapped_size, int full)
 {
-	LOG(3, "pop %p mapped_size %zu", pop, mapped_size);
+	LOG(3, "pop %p mapped_size %zu full %d", pop, mapped_size, full);
 
 	ASSERTeq(pop->rpp, NULL);
 
@@ -1519,8 +1538,12 @@ obj_check_basic_local(PMEMobjpool *pop, size_t mapped_size)
 		consistent = 0;
 	}
 
-	errno = palloc_heap_check((char *)pop + pop->heap_offset,
-		mapped_size);
+	if (full)
+		errno = palloc_heap_check((char *)pop + pop->heap_offset,
+			mapped_size);
+	else
+		errno = palloc_heap_check_header(
+			(char *)pop + pop->heap_offset, mapped_size);
 	if (errno != 0) {
 		LOG(2, "!heap_check");
 		consistent = 0;
@@ -1595,14 +1618,16 @@ obj_check_basic_remote(PMEMobjpool *pop, size_t mapped_size)
  * obj_check_basic -- (internal) basic pool consistency check
  *
  * Used to check if all the replicas are consistent prior to pool recovery.
+ * The full check of local replicas traverses the entire heap and is only
+ * performed when explicitly checking the pool.
  */
 static int
-obj_check_basic(PMEMobjpool *pop, size_t mapped_size)
+obj_check_basic(PMEMobjpool *pop, size_t mapped_size, int full)
 {
-	LOG(3, "pop %p mapped_size %zu", pop, mapped_size);
+	LOG(3, "pop %p mapped_size %zu full %d", pop, mapped_size, full);
 
 	if (pop->rpp == NULL)
-		return obj_check_basic_local(pop, mapped_size);
+		return obj_check_basic_local(pop, mapped_size, full);
 	else
 		return obj_check_basic_remote(pop, mapped_size);
 }
@@ -1703,12 +1728,12 @@ obj_replicas_fini(struct pool_set *set)
  * for all replicas
  */
 static int
-obj_replicas_check_basic(PMEMobjpool *pop)
+obj_replicas_check_basic(PMEMobjpool *pop, int full)
 {
 	PMEMobjpool *rep;
 	for (unsigned r = 0; r < pop->set->nreplicas; r++) {
 		rep = pop->set->replica[r]->part[0].addr;
-		if (obj_check_basic(rep, pop->set->poolsize) == 0) {
+		if (obj_check_basic(rep, pop->set->poolsize, full) == 0) {
 			ERR("inconsistent replica #%u", r);
 			return -1;
 		}
@@ -1778,13 +1803,13 @@ obj_open_common(const char *path, const char *layout, unsigned flags, int boot)
 
 	if (boot) {
 		/* check consistency of 'master' replica */
-		if (obj_check_basic(pop, pop->set->poolsize) == 0) {
+		if (obj_check_basic(pop, pop->set->poolsize, 0) == 0) {
 			goto err_check_basic;
 		}
 	}
 
 	if (set->nreplicas > 1) {
-		if (obj_replicas_check_basic(pop))
+		if (obj_replicas_check_basic(pop, !boot))
 			goto err_replicas_check_basic;
 	}
 
@@ -1950,6 +1975,9 @@ obj_pool_cleanup(PMEMobjpool *pop)
 {
 	LOG(3, "pop %p", pop);
 
+	tx_post_commit_stop(pop);
+
+	defrag_delete(pop->defrag);
 	stats_delete(pop, pop->stats);
 	tx_params_delete(pop->tx_params);
 	ctl_delete(pop->ctl);
@@ -1974,6 +2002,9 @@ pmemobj_close(PMEMobjpool *pop)
 
 	_pobj_cache_invalidate++;
 
+	/* the worker might still be using the pool */
+	defrag_disable(pop->defrag);
+
 	if (cuckoo_remove(pools_ht, pop->uuid_lo) != pop) {
 		ERR("cuckoo_remove");
 	}
@@ -2029,7 +2060,7 @@ pmemobj_checkU(const char *path, const char *layout)
 	 * in obj_open_common().
 	 */
 	if (pop->replica == NULL)
-		consistent = obj_check_basic(pop, pop->set->poolsize);
+		consistent = obj_check_basic(pop, pop->set->poolsize, 1);
 
 	if (consistent && (errno = obj_runtime_init_common(pop)) != 0) {
 		LOG(3, "!obj_boot");
@@ -2039,6 +2070,7 @@ pmemobj_checkU(const char *path, const char *layout)
 	if (consistent) {
 		obj_pool_cleanup(pop);
 	} else {
+		defrag_delete(pop->defrag);
 		stats_delete(pop, pop->stats);
 		tx_params_delete(pop->tx_params);
 		ctl_delete(pop->ctl);
@@ -2265,6 +2297,150 @@ pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 			flags, constructor, arg);
 }
 
+/*
+ * obj_alloc_batch -- (internal) allocates a batch of objects with constructor
+ *
+ * All of the objects are reserved and constructed first, and then published
+ * in a single operation, which requires only one redo log to be processed.
+ */
+static int
+obj_alloc_batch(PMEMobjpool *pop, PMEMoid *oids, const size_t *sizes,
+	size_t nobjs, type_num_t type_num, uint64_t flags,
+	pmemobj_constr constructor, void *arg)
+{
+	if (nobjs == 0)
+		return 0;
+
+	if (nobjs > SIZE_MAX / sizeof(struct pobj_action)) {
+		ERR("too many objects in the batch");
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (size_t i = 0; i < nobjs; ++i) {
+		if (sizes[i] == 0) {
+			ERR("allocation with size 0");
+			errno = EINVAL;
+			return -1;
+		}
+
+		if (sizes[i] > PMEMOBJ_MAX_ALLOC_SIZE) {
+			ERR("requested size too large");
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	struct pobj_action *actv = Malloc(sizeof(*actv) * nobjs);
+	if (actv == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.constructor = constructor;
+	carg.arg = arg;
+
+	int oerrno;
+	size_t nreserved;
+	for (nreserved = 0; nreserved < nobjs; ++nreserved) {
+		if (palloc_reserve(&pop->heap, sizes[nreserved],
+		    constructor_alloc, &carg, type_num, 0,
+		    CLASS_ID_FROM_FLAG(flags), &actv[nreserved]) != 0)
+			goto error_reserve;
+	}
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	/*
+	 * Each object needs at least its own metadata update, and the oids
+	 * stored in the pool are modified through the redo log as well.
+	 */
+	size_t nentries = nobjs;
+	if (oids != NULL && OBJ_PTR_IS_VALID(pop, oids))
+		nentries += 2 * nobjs;
+
+	if (operation_reserve(ctx, nentries) != 0)
+		goto error_operation;
+
+	if (oids != NULL) {
+		for (size_t i = 0; i < nobjs; ++i) {
+			if (operation_add_entry(ctx, &oids[i].pool_uuid_lo,
+			    pop->uuid_lo, REDO_OPERATION_SET) != 0 ||
+			    operation_add_entry(ctx, &oids[i].off,
+			    actv[i].heap.offset, REDO_OPERATION_SET) != 0)
+				goto error_operation;
+		}
+	}
+
+	palloc_publish(&pop->heap, actv, nobjs, ctx);
+
+	pmalloc_operation_release(pop);
+
+	Free(actv);
+
+	return 0;
+
+error_operation:
+	operation_cancel(ctx);
+	pmalloc_operation_release(pop);
+error_reserve:
+	oerrno = errno;
+	palloc_cancel(&pop->heap, actv, nreserved);
+	Free(actv);
+	errno = oerrno;
+
+	return -1;
+}
+
+/*
+ * pmemobj_alloc_batch -- allocates a batch of new objects
+ */
+int
+pmemobj_alloc_batch(PMEMobjpool *pop, PMEMoid *oids, const size_t *sizes,
+	size_t nobjs, uint64_t type_num, pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p oids %p sizes %p nobjs %zu type_num %llx "
+		"constructor %p arg %p",
+		pop, oids, sizes, nobjs, (unsigned long long)type_num,
+		constructor, arg);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	return obj_alloc_batch(pop, oids, sizes, nobjs, type_num,
+			0, constructor, arg);
+}
+
+/*
+ * pmemobj_xalloc_batch -- allocates a batch of new objects with flags
+ */
+int
+pmemobj_xalloc_batch(PMEMobjpool *pop, PMEMoid *oids, const size_t *sizes,
+	size_t nobjs, uint64_t type_num, uint64_t flags,
+	pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p oids %p sizes %p nobjs %zu type_num %llx flags %llx "
+		"constructor %p arg %p",
+		pop, oids, sizes, nobjs, (unsigned long long)type_num,
+		(unsigned long long)flags, constructor, arg);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (flags & ~POBJ_TX_XALLOC_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_TX_XALLOC_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	return obj_alloc_batch(pop, oids, sizes, nobjs, type_num,
+			flags, constructor, arg);
+}
+
 /* arguments for constructor_realloc and constructor_zrealloc */
 struct carg_realloc {
 	void *ptr;
@@ -62,7 +62,7 @@
 #define OBJ_FORMAT_RO_COMPAT_DEFAULT 0x0000
 
 #define OBJ_FORMAT_COMPAT_CHECK 0x0000
-#define OBJ_FORMAT_INCOMPAT_CHECK POOL_FEAT_ALL
+#define OBJ_FORMAT_INCOMPAT_CHECK (POOL_FEAT_ALL | POOL_FEAT_HEAP_GEOMETRY)
 #define OBJ_FORMAT_RO_COMPAT_CHECK 0x0000
 
 /* size of the persistent part of PMEMOBJ pool descriptor (2kB) */
@@ -190,6 +190,7 @@ struct pmemobjpool {
 	int tx_debug_skip_expensive_checks;
 
 	struct tx_parameters *tx_params;
+	struct defrag *defrag;
 
 	/*
 	 * Locks are dynamically allocated on FreeBSD. Keep track so
@@ -201,7 +202,7 @@ struct pmemobjpool {
 
 	/* padding to align size of this structure to page boundary */
 	/* sizeof(unused2) == 8192 - offsetof(struct pmemobjpool, unused2) */
-	char unused2[984];
+	char unused2[976];
 };
 
 /*
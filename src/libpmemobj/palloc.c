@@ -61,6 +61,7 @@
 #include "heap_layout.h"
 #include "heap.h"
 #include "alloc_class.h"
+#include "tcache.h"
 #include "out.h"
 #include "sys_util.h"
 #include "palloc.h"
@@ -232,9 +233,47 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	*new_block = MEMORY_BLOCK_NONE;
 	new_block->size_idx = (uint32_t)size_idx;
 
+	/*
+	 * Small blocks are served from the per-thread cache, which already
+	 * holds a reservation for each of them, so that the bucket lock
+	 * is not needed at all.
+	 */
+	struct tcache_collection *tc = heap_tcaches(heap);
+	if (tcache_get(tc, c, new_block, &out->resvp) == 0) {
+		if (alloc_prep_block(heap, new_block, constructor, arg,
+			extra_field, object_flags, &out->offset) != 0) {
+			tcache_put(tc, c, new_block, out->resvp);
+			errno = ECANCELED;
+			return -1;
+		}
+
+		out->lock = new_block->m_ops->get_lock(new_block);
+		out->new_state = MEMBLOCK_ALLOCATED;
+
+		return 0;
+	}
+
 	struct bucket *b = heap_bucket_acquire(heap, c);
 
 	err = heap_get_bestfit_block(heap, b, new_block);
+	if (err == ENOMEM) {
+		/*
+		 * The blocks held in the thread caches, including the ones
+		 * of idle threads, might be the only free memory left in
+		 * the heap.
+		 */
+		heap_bucket_release(heap, b);
+		if (tcache_flush_all(tc) == 0) {
+			errno = ENOMEM;
+			return -1;
+		}
+
+		*new_block = MEMORY_BLOCK_NONE;
+		new_block->size_idx = (uint32_t)size_idx;
+
+		b = heap_bucket_acquire(heap, c);
+		err = heap_get_bestfit_block(heap, b, new_block);
+	}
 	if (err != 0)
 		goto out;
 
@@ -775,14 +814,19 @@ pmalloc_search_cb(const struct memory_block *m, void *arg)
 
 /*
  * palloc_first -- returns the first object from the heap.
+ *
+ * Returns 0 and sets errno if the heap is corrupted.
  */
 uint64_t
 palloc_first(struct palloc_heap *heap)
 {
 	struct memory_block search = MEMORY_BLOCK_NONE;
 
-	heap_foreach_object(heap, pmalloc_search_cb,
-		&search, MEMORY_BLOCK_NONE);
+	if (heap_foreach_object(heap, pmalloc_search_cb,
+			&search, MEMORY_BLOCK_NONE) != 0) {
+		errno = EINVAL;
+		return 0;
+	}
 
 	if (MEMORY_BLOCK_IS_NONE(search))
 		return 0;
@@ -794,6 +838,8 @@ palloc_first(struct palloc_heap *heap)
 
 /*
  * palloc_next -- returns the next object relative to 'off'.
+ *
+ * Returns 0 and sets errno if the heap is corrupted.
  */
 uint64_t
 palloc_next(struct palloc_heap *heap, uint64_t off)
@@ -801,7 +847,10 @@ palloc_next(struct palloc_heap *heap, uint64_t off)
 	struct memory_block m = memblock_from_offset(heap, off);
 	struct memory_block search = m;
 
-	heap_foreach_object(heap, pmalloc_search_cb, &search, m);
+	if (heap_foreach_object(heap, pmalloc_search_cb, &search, m) != 0) {
+		errno = EINVAL;
+		return 0;
+	}
 
 	if (MEMORY_BLOCK_IS_NONE(search) ||
 		MEMORY_BLOCK_EQUALS(search, m))
@@ -853,6 +902,25 @@ palloc_heap_end(struct palloc_heap *h)
 	return heap_end(h);
 }
 
+/*
+ * palloc_create_geometry_is_default -- checks whether new heaps have
+ *	the default geometry
+ */
+int
+palloc_create_geometry_is_default(void)
+{
+	return heap_create_geometry_is_default();
+}
+
+/*
+ * palloc_heap_check_header -- verifies heap header
+ */
+int
+palloc_heap_check_header(void *heap_start, uint64_t heap_size)
+{
+	return heap_check_header(heap_start, heap_size);
+}
+
 /*
  * palloc_heap_check -- verifies heap state
  */
@@ -904,9 +972,9 @@ palloc_vg_register_alloc(const struct memory_block *m, void *arg)
 /*
  * palloc_heap_vg_open -- notifies Valgrind about heap layout
  */
-void
+int
 palloc_heap_vg_open(struct palloc_heap *heap, int objects)
 {
-	heap_vg_open(heap, palloc_vg_register_alloc, heap, objects);
+	return heap_vg_open(heap, palloc_vg_register_alloc, heap, objects);
 }
 #endif
@@ -61,6 +61,9 @@ struct palloc_heap {
 	void *base;
 
 	int alloc_pattern;
+
+	/* runs of classes created from now on have their objects colored */
+	int alloc_class_coloring;
 };
 
 struct memory_block;
@@ -113,6 +116,8 @@ int palloc_buckets_init(struct palloc_heap *heap);
 int palloc_init(void *heap_start, uint64_t heap_size, uint64_t *sizep,
 	struct pmem_ops *p_ops);
 void *palloc_heap_end(struct palloc_heap *h);
+int palloc_create_geometry_is_default(void);
+int palloc_heap_check_header(void *heap_start, uint64_t heap_size);
 int palloc_heap_check(void *heap_start, uint64_t heap_size);
 int palloc_heap_check_remote(void *heap_start, uint64_t heap_size,
 	struct remote_ops *ops);
@@ -123,7 +128,7 @@ size_t palloc_heap(void *heap_start);
 typedef int (*object_callback)(const struct memory_block *m, void *arg);
 
 #if VG_MEMCHECK_ENABLED
-void palloc_heap_vg_open(struct palloc_heap *heap, int objects);
+int palloc_heap_vg_open(struct palloc_heap *heap, int objects);
 #endif
 
 #endif
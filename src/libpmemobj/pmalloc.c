@@ -48,6 +48,7 @@
 #include "palloc.h"
 #include "pmalloc.h"
 #include "alloc_class.h"
+#include "defrag.h"
 #include "set.h"
 #include "mmap.h"
 
@@ -336,8 +337,10 @@ pmalloc_boot(PMEMobjpool *pop)
 		return ret;
 
 #if VG_MEMCHECK_ENABLED
-	if (On_valgrind)
-		palloc_heap_vg_open(&pop->heap, pop->vg_boot);
+	if (On_valgrind && palloc_heap_vg_open(&pop->heap, pop->vg_boot)) {
+		palloc_heap_cleanup(&pop->heap);
+		return EINVAL;
+	}
 #endif
 
 	ret = palloc_buckets_init(&pop->heap);
@@ -393,6 +396,12 @@ CTL_WRITE_HANDLER(desc)(void *ctx,
 		return -1;
 	}
 
+	if (p->alignment != 0 && !util_is_pow2(p->alignment)) {
+		ERR("alignment must be a power of two");
+		errno = EINVAL;
+		return -1;
+	}
+
 	if (p->alignment > (MEGABYTE * 2)) {
 		ERR("alignment cannot be larger than 2 megabytes");
 		errno = EINVAL;
@@ -442,21 +451,27 @@ CTL_WRITE_HANDLER(desc)(void *ctx,
 		}
 	}
 
-	size_t runsize_bytes =
-		CHUNK_ALIGN_UP((p->units_per_block * p->unit_size) +
-		RUN_METASIZE);
+	uint16_t flags = pop->heap.alloc_class_coloring ?
+		CHUNK_FLAG_COLORED : 0;
 
-	/* aligning the buffer might require up-to to 'alignment' bytes */
-	if (p->alignment != 0)
-		runsize_bytes += p->alignment;
+	/*
+	 * Aligning the buffer might require up-to 'alignment' bytes, and
+	 * colored runs need an additional unit for the color offset.
+	 */
+	size_t reserved = flags ? p->unit_size : p->alignment;
 
-	uint32_t size_idx = (uint32_t)(runsize_bytes / CHUNKSIZE);
+	size_t chunksize = heap_chunksize(&pop->heap);
+	size_t runsize_bytes =
+		ALIGN_UP((p->units_per_block * p->unit_size) + reserved +
+		heap_run_metasize(&pop->heap), chunksize);
+
+	uint32_t size_idx = (uint32_t)(runsize_bytes / chunksize);
 	if (size_idx > UINT16_MAX)
 		size_idx = UINT16_MAX;
 
 	struct alloc_class *c = alloc_class_new(id,
 		heap_alloc_classes(&pop->heap), CLASS_RUN,
-		lib_htype, p->unit_size, p->alignment, size_idx);
+		lib_htype, p->unit_size, p->alignment, size_idx, flags);
 	if (c == NULL) {
 		errno = EINVAL;
 		return -1;
@@ -498,25 +513,22 @@ pmalloc_header_type_parser(const void *arg, void *dest, size_t dest_size)
 }
 
 /*
- * CTL_READ_HANDLER(desc) -- reads the information about allocation class
+ * pmalloc_class_by_index -- (internal) returns the allocation class
+ *	identified by the class_id index of the query
  */
-static int
-CTL_READ_HANDLER(desc)(void *ctx,
-	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+static struct alloc_class *
+pmalloc_class_by_index(PMEMobjpool *pop, struct ctl_indexes *indexes)
 {
-	PMEMobjpool *pop = ctx;
-	uint8_t id;
-
 	struct ctl_index *idx = SLIST_FIRST(indexes);
 	ASSERTeq(strcmp(idx->name, "class_id"), 0);
 
 	if (idx->value < 0 || idx->value >= MAX_ALLOCATION_CLASSES) {
 		ERR("class id outside of the allowed range");
 		errno = ERANGE;
-		return -1;
+		return NULL;
 	}
 
-	id = (uint8_t)idx->value;
+	uint8_t id = (uint8_t)idx->value;
 
 	struct alloc_class *c = alloc_class_by_id(
 		heap_alloc_classes(&pop->heap), id);
@@ -524,9 +536,25 @@ CTL_READ_HANDLER(desc)(void *ctx,
 	if (c == NULL) {
 		ERR("class with the given id does not exist");
 		errno = ENOENT;
-		return -1;
+		return NULL;
 	}
 
+	return c;
+}
+
+/*
+ * CTL_READ_HANDLER(desc) -- reads the information about allocation class
+ */
+static int
+CTL_READ_HANDLER(desc)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct alloc_class *c = pmalloc_class_by_index(pop, indexes);
+	if (c == NULL)
+		return -1;
+
 	enum pobj_header_type user_htype = MAX_POBJ_HEADER_TYPES;
 	switch (c->header_type) {
 		case HEADER_LEGACY:
@@ -568,8 +596,35 @@ static struct ctl_argument CTL_ARG(desc) = {
 	}
 };
 
+/*
+ * CTL_READ_HANDLER(colors) -- reads the number of colors of the runs of
+ *	allocation class
+ */
+static int
+CTL_READ_HANDLER(colors)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct alloc_class *c = pmalloc_class_by_index(pop, indexes);
+	if (c == NULL)
+		return -1;
+
+	int *arg_out = arg;
+
+	if (c->type == CLASS_RUN && (c->flags & CHUNK_FLAG_COLORED)) {
+		size_t stride = RUN_COLOR_STRIDE(c->run.alignment);
+		*arg_out = (int)(c->unit_size / stride);
+	} else {
+		*arg_out = 0;
+	}
+
+	return 0;
+}
+
 static const struct ctl_node CTL_NODE(class_id)[] = {
 	CTL_LEAF_RW(desc),
+	CTL_LEAF_RO(colors),
 
 	CTL_NODE_END
 };
@@ -580,9 +635,46 @@ static const struct ctl_node CTL_NODE(new)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(coloring) -- reads whether new allocation classes are
+ *	colored
+ */
+static int
+CTL_READ_HANDLER(coloring)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->heap.alloc_class_coloring;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(coloring) -- enables or disables coloring of allocation
+ *	classes created from now on
+ */
+static int
+CTL_WRITE_HANDLER(coloring)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	pop->heap.alloc_class_coloring = arg_in;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(coloring) = CTL_ARG_BOOLEAN;
+
 static const struct ctl_node CTL_NODE(alloc_class)[] = {
 	CTL_INDEXED(class_id),
 	CTL_INDEXED(new),
+	CTL_LEAF_RW(coloring),
 
 	CTL_NODE_END
 };
@@ -660,9 +752,471 @@ static const struct ctl_node CTL_NODE(size)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(loaded) -- reads the number of zones already loaded
+ *	by the allocator
+ */
+static int
+CTL_READ_HANDLER(loaded)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = (int)heap_get_zones_loaded(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(prefetch) -- reads whether zones are loaded in
+ *	the background
+ */
+static int
+CTL_READ_HANDLER(prefetch)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = heap_get_zones_prefetch(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(prefetch) -- starts or stops loading zones in
+ *	the background
+ */
+static int
+CTL_WRITE_HANDLER(prefetch)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	return heap_set_zones_prefetch(&pop->heap, arg_in);
+}
+
+static struct ctl_argument CTL_ARG(prefetch) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(zones)[] = {
+	CTL_LEAF_RO(loaded),
+	CTL_LEAF_RW(prefetch),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(count) -- reads the number of arenas assigned to threads
+ */
+static int
+CTL_READ_HANDLER(count)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = (int)heap_get_narenas(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(count) -- changes the number of arenas assigned to threads
+ */
+static int
+CTL_WRITE_HANDLER(count)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+	if (arg_in < 1) {
+		ERR("incorrect arena count, must be larger than 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return heap_set_narenas(&pop->heap, (unsigned)arg_in);
+}
+
+static struct ctl_argument CTL_ARG(count) = CTL_ARG_INT;
+
+/*
+ * pmalloc_arena_policy_parser -- parses the arena policy argument
+ */
+static int
+pmalloc_arena_policy_parser(const void *arg, void *dest, size_t dest_size)
+{
+	const char *vstr = arg;
+	enum pobj_arena_policy *policy = dest;
+	ASSERTeq(dest_size, sizeof(enum pobj_arena_policy));
+
+	if (strcmp(vstr, "least_used") == 0) {
+		*policy = POBJ_ARENA_POLICY_LEAST_USED;
+	} else if (strcmp(vstr, "numa") == 0) {
+		*policy = POBJ_ARENA_POLICY_NUMA;
+	} else {
+		ERR("invalid arena policy");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(policy) -- reads the arena assignment policy
+ */
+static int
+CTL_READ_HANDLER(policy)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	enum pobj_arena_policy *arg_out = arg;
+
+	*arg_out = heap_get_arena_policy(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(policy) -- changes the arena assignment policy
+ */
+static int
+CTL_WRITE_HANDLER(policy)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	enum pobj_arena_policy arg_in = *(enum pobj_arena_policy *)arg;
+
+	return heap_set_arena_policy(&pop->heap, arg_in);
+}
+
+static struct ctl_argument CTL_ARG(policy) = {
+	.dest_size = sizeof(enum pobj_arena_policy),
+	.parsers = {
+		CTL_ARG_PARSER(enum pobj_arena_policy,
+			pmalloc_arena_policy_parser),
+		CTL_ARG_PARSER_END
+	}
+};
+
+/*
+ * pmalloc_arena_index -- (internal) returns the arena id from the query
+ */
+static int
+pmalloc_arena_index(struct ctl_indexes *indexes, unsigned *arena_id)
+{
+	struct ctl_index *idx = SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "arena_id"), 0);
+
+	if (idx->value < 0) {
+		ERR("arena id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	*arena_id = (unsigned)idx->value;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(thread_count) -- reads the number of threads assigned
+ *	to an arena
+ */
+static int
+CTL_READ_HANDLER(thread_count)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	unsigned arena_id;
+	if (pmalloc_arena_index(indexes, &arena_id) != 0)
+		return -1;
+
+	int node;
+
+	return heap_get_arena_info(&pop->heap, arena_id, arg, &node);
+}
+
+/*
+ * CTL_READ_HANDLER(node) -- reads the NUMA node to which an arena is bound
+ */
+static int
+CTL_READ_HANDLER(node)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	unsigned arena_id;
+	if (pmalloc_arena_index(indexes, &arena_id) != 0)
+		return -1;
+
+	uint64_t nthreads;
+
+	return heap_get_arena_info(&pop->heap, arena_id, &nthreads, arg);
+}
+
+static const struct ctl_node CTL_NODE(arena_id)[] = {
+	CTL_LEAF_RO(thread_count),
+	CTL_LEAF_RO(node),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(arenas)[] = {
+	CTL_LEAF_RW(count),
+	CTL_LEAF_RW(policy),
+	CTL_INDEXED(arena_id),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_WRITE_HANDLER(callback) -- sets the defragmentation relocation callback
+ */
+static int
+CTL_WRITE_HANDLER(callback)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	if (source == CTL_QUERY_CONFIG_INPUT) {
+		ERR("relocation callback cannot be set from a config");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return defrag_set_callback(pop->defrag, arg);
+}
+
+static struct ctl_argument CTL_ARG(callback) = {
+	.dest_size = sizeof(struct pobj_defrag_callback),
+	.parsers = {
+		CTL_ARG_PARSER_END
+	}
+};
+
+/*
+ * CTL_READ_HANDLER(threshold) -- reads the occupancy below which runs are
+ *	evacuated
+ */
+static int
+CTL_READ_HANDLER(threshold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = (int)defrag_get_threshold(pop->defrag);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(threshold) -- changes the occupancy below which runs are
+ *	evacuated
+ */
+static int
+CTL_WRITE_HANDLER(threshold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+	if (arg_in < 1) {
+		ERR("incorrect defragmentation threshold, must be between "
+			"1 and 100");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return defrag_set_threshold(pop->defrag, (unsigned)arg_in);
+}
+
+static struct ctl_argument CTL_ARG(threshold) = CTL_ARG_INT;
+
+/*
+ * CTL_READ_HANDLER(interval) -- reads the delay between background
+ *	defragmentation passes
+ */
+static int
+CTL_READ_HANDLER(interval)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = (int)defrag_get_interval(pop->defrag);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(interval) -- changes the delay between background
+ *	defragmentation passes
+ */
+static int
+CTL_WRITE_HANDLER(interval)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+	if (arg_in < 1) {
+		ERR("incorrect defragmentation interval, must be larger "
+			"than 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return defrag_set_interval(pop->defrag, (unsigned)arg_in);
+}
+
+static struct ctl_argument CTL_ARG(interval) = CTL_ARG_INT;
+
+/*
+ * CTL_READ_HANDLER(enabled) -- reads whether background defragmentation
+ *	is enabled
+ */
+static int
+CTL_READ_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = defrag_is_enabled(pop->defrag);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled) -- starts or stops background defragmentation
+ */
+static int
+CTL_WRITE_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	if (arg_in)
+		return defrag_enable(pop->defrag);
+
+	defrag_disable(pop->defrag);
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_RUNNABLE_HANDLER(run) -- performs a single defragmentation pass
+ */
+static int
+CTL_RUNNABLE_HANDLER(run)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	return defrag_run(pop->defrag);
+}
+
+static const struct ctl_node CTL_NODE(defrag)[] = {
+	CTL_LEAF_WO(callback),
+	CTL_LEAF_RW(threshold),
+	CTL_LEAF_RW(interval),
+	CTL_LEAF_RW(enabled),
+	CTL_LEAF_RUNNABLE(run),
+
+	CTL_NODE_END
+};
+
+/*
+ * pmalloc_huge_container_parser -- parses the huge container type argument
+ */
+static int
+pmalloc_huge_container_parser(const void *arg, void *dest, size_t dest_size)
+{
+	const char *vstr = arg;
+	enum pobj_huge_container *type = dest;
+	ASSERTeq(dest_size, sizeof(enum pobj_huge_container));
+
+	if (strcmp(vstr, "ravl") == 0) {
+		*type = POBJ_HUGE_CONTAINER_RAVL;
+	} else if (strcmp(vstr, "bitmap") == 0) {
+		*type = POBJ_HUGE_CONTAINER_BITMAP;
+	} else {
+		ERR("invalid huge container type");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(huge_container) -- reads the type of the container that
+ *	holds the free huge blocks
+ */
+static int
+CTL_READ_HANDLER(huge_container)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	enum pobj_huge_container *arg_out = arg;
+
+	*arg_out = heap_get_huge_container(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(huge_container) -- changes the type of the container that
+ *	holds the free huge blocks
+ */
+static int
+CTL_WRITE_HANDLER(huge_container)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	enum pobj_huge_container arg_in = *(enum pobj_huge_container *)arg;
+
+	return heap_set_huge_container(&pop->heap, arg_in);
+}
+
+static struct ctl_argument CTL_ARG(huge_container) = {
+	.dest_size = sizeof(enum pobj_huge_container),
+	.parsers = {
+		CTL_ARG_PARSER(enum pobj_huge_container,
+			pmalloc_huge_container_parser),
+		CTL_ARG_PARSER_END
+	}
+};
+
 static const struct ctl_node CTL_NODE(heap)[] = {
 	CTL_CHILD(alloc_class),
 	CTL_CHILD(size),
+	CTL_CHILD(zones),
+	CTL_CHILD(arenas),
+	CTL_CHILD(defrag),
+	CTL_LEAF_RW(huge_container),
 
 	CTL_NODE_END
 };
@@ -675,3 +1229,109 @@ pmalloc_ctl_register(PMEMobjpool *pop)
 {
 	CTL_REGISTER_MODULE(pop->ctl, heap);
 }
+
+/*
+ * CTL_READ_HANDLER(chunk_size) -- reads the chunk size of new heaps
+ */
+static int
+CTL_READ_HANDLER(chunk_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)heap_get_create_chunksize();
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(chunk_size) -- changes the chunk size of new heaps
+ */
+static int
+CTL_WRITE_HANDLER(chunk_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t arg_in = *(ssize_t *)arg;
+
+	if (arg_in < 0) {
+		ERR("chunk size cannot be negative");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return heap_set_create_chunksize((size_t)arg_in);
+}
+
+static struct ctl_argument CTL_ARG(chunk_size) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(run_bitmap_size) -- reads the maximum number of bits of
+ *	run bitmaps in new heaps
+ */
+static int
+CTL_READ_HANDLER(run_bitmap_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)heap_get_create_run_bitmap_nval() * BITS_PER_VALUE;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(run_bitmap_size) -- changes the maximum number of bits of
+ *	run bitmaps in new heaps
+ *
+ * The size is rounded up so that the run metadata occupies whole cachelines,
+ * sizes smaller than the default are rounded up to the default.
+ */
+static int
+CTL_WRITE_HANDLER(run_bitmap_size)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t arg_in = *(ssize_t *)arg;
+
+	if (arg_in <= 0 ||
+	    (size_t)arg_in > (size_t)MAX_RUN_BITMAP_VALUES * BITS_PER_VALUE) {
+		ERR("invalid run bitmap size");
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t nval = CALC_SIZE_IDX(BITS_PER_VALUE, (size_t)arg_in);
+	nval = ALIGN_UP(RUN_METASIZE_NVAL((unsigned)nval), CACHELINE_SIZE) /
+		sizeof(uint64_t) - 2;
+	if (nval < MAX_BITMAP_VALUES)
+		nval = MAX_BITMAP_VALUES;
+
+	return heap_set_create_run_bitmap_nval((unsigned)nval);
+}
+
+static struct ctl_argument CTL_ARG(run_bitmap_size) = CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(layout)[] = {
+	CTL_LEAF_RW(chunk_size),
+	CTL_LEAF_RW(run_bitmap_size),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(heap_global)[] = {
+	CTL_CHILD(layout),
+
+	CTL_NODE_END
+};
+
+/*
+ * pmalloc_global_ctl_register -- registers the global ctl nodes of the "heap"
+ *	module, used to configure the heaps before they are created
+ *
+ * The remaining "heap" queries fall through to the nodes of the pool.
+ */
+void
+pmalloc_global_ctl_register(void)
+{
+	ctl_register_module_node(NULL, "heap",
+		(struct ctl_node *)CTL_NODE(heap_global));
+}
@@ -78,5 +78,6 @@ struct operation_context *pmalloc_operation_hold_no_start(PMEMobjpool *pop);
 void pmalloc_operation_release(PMEMobjpool *pop);
 
 void pmalloc_ctl_register(PMEMobjpool *pop);
+void pmalloc_global_ctl_register(void);
 
 #endif
@@ -323,6 +323,19 @@ pvector_get(PMEMobjpool *pop, struct pvector *vec, uint64_t idx)
 	return arrp[s.pos];
 }
 
+/*
+ * pvector_at -- returns the vector value at the index, or zero if the index
+ *	is out of bounds. Doesn't modify the iterator position.
+ */
+uint64_t
+pvector_at(struct pvector_context *ctx, uint64_t idx)
+{
+	if (idx >= ctx->nvalues)
+		return 0;
+
+	return pvector_get(ctx->pop, ctx->vec, idx);
+}
+
 /*
  * pvector_first -- sets the iterator position to the first element and returns
  *	the value present at that index.
@@ -86,6 +86,7 @@ uint64_t pvector_pop_back(struct pvector_context *ctx,
 	entry_op_callback cb);
 
 uint64_t pvector_size(struct pvector_context *ctx);
+uint64_t pvector_at(struct pvector_context *ctx, uint64_t idx);
 uint64_t pvector_first(struct pvector_context *ctx);
 uint64_t pvector_last(struct pvector_context *ctx);
 uint64_t pvector_prev(struct pvector_context *ctx);
@@ -172,8 +172,11 @@ recycler_element_new(struct palloc_heap *heap, const struct memory_block *m)
 	uint16_t free_space = 0;
 	uint16_t max_block = 0;
 
-	for (int i = 0; i < MAX_BITMAP_VALUES; ++i) {
-		uint64_t value = ~run->bitmap[i];
+	uint64_t *bitmap = RUN_BITMAP(run);
+	unsigned nval = HEAP_RUN_BITMAP_NVAL(heap->layout);
+
+	for (unsigned i = 0; i < nval; ++i) {
+		uint64_t value = ~bitmap[i];
 		if (value == 0)
 			continue;
 
@@ -311,6 +314,20 @@ recycler_pending_put(struct recycler *r,
 	util_mutex_unlock(&r->lock);
 }
 
+/*
+ * recycler_pending_count -- returns the number of memory blocks waiting for
+ *	their reservations to be fulfilled
+ */
+size_t
+recycler_pending_count(struct recycler *r)
+{
+	util_mutex_lock(&r->lock);
+	size_t npending = VEC_SIZE(&r->pending);
+	util_mutex_unlock(&r->lock);
+
+	return npending;
+}
+
 /*
  * recycler_recalc -- recalculates the scores of runs in the recycler to match
  *	the updated persistent state
@@ -329,7 +346,13 @@ recycler_recalc(struct recycler *r, int force)
 	if (util_mutex_trylock(&r->lock) != 0)
 		return runs;
 
-	/* If the search is forced, recalculate everything */
+	/*
+	 * If the search is forced, recalculate everything, including the runs
+	 * that are still waiting for their reservations to be fulfilled.
+	 */
+	if (force)
+		recycler_pending_check(r);
+
 	uint64_t search_limit = force ? UINT64_MAX : units;
 
 	uint64_t found_units = 0;
@@ -71,6 +71,8 @@ recycler_pending_put(struct recycler *r,
 
 struct empty_runs recycler_recalc(struct recycler *r, int force);
 
+size_t recycler_pending_count(struct recycler *r);
+
 void recycler_inc_unaccounted(struct recycler *r,
 	const struct memory_block *m);
 
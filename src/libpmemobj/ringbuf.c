@@ -0,0 +1,232 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * ringbuf.c -- implementation of the bounded multi-producer, multi-consumer
+ *	queue
+ *
+ * Producers never block - if the queue is full or stopped, the enqueue fails
+ * and the caller is expected to process the element on its own. Consumers
+ * block until an element is available or the queue is stopped, in which case
+ * the remaining elements are still handed out before NULL is returned.
+ */
+
+#include <stdint.h>
+
+#include "out.h"
+#include "os_thread.h"
+#include "ringbuf.h"
+#include "sys_util.h"
+#include "util.h"
+
+struct ringbuf {
+	os_mutex_t lock;
+	os_cond_t nonempty;
+
+	unsigned read_pos; /* free running, masked on access */
+	unsigned write_pos;
+
+	unsigned len;
+	unsigned len_mask;
+	int running;
+
+	void *data[];
+};
+
+/*
+ * ringbuf_new -- creates a new queue that can hold up to 'length' elements,
+ *	rounded up to the nearest power of two
+ */
+struct ringbuf *
+ringbuf_new(unsigned length)
+{
+	LOG(4, "length %u", length);
+
+	if (length == 0 || length > (1U << 31)) {
+		ERR("invalid ring buffer length %u", length);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	unsigned len = 1;
+	while (len < length)
+		len <<= 1;
+
+	struct ringbuf *rbuf = Malloc(sizeof(*rbuf) + len * sizeof(void *));
+	if (rbuf == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	util_mutex_init(&rbuf->lock);
+	os_cond_init(&rbuf->nonempty);
+
+	rbuf->read_pos = 0;
+	rbuf->write_pos = 0;
+	rbuf->len = len;
+	rbuf->len_mask = len - 1;
+	rbuf->running = 1;
+
+	return rbuf;
+}
+
+/*
+ * ringbuf_delete -- deletes the queue, it must not contain any elements
+ */
+void
+ringbuf_delete(struct ringbuf *rbuf)
+{
+	ASSERTeq(ringbuf_size(rbuf), 0);
+
+	os_cond_destroy(&rbuf->nonempty);
+	util_mutex_destroy(&rbuf->lock);
+
+	Free(rbuf);
+}
+
+/*
+ * ringbuf_length -- returns the maximum number of elements in the queue
+ */
+unsigned
+ringbuf_length(struct ringbuf *rbuf)
+{
+	return rbuf->len;
+}
+
+/*
+ * ringbuf_size -- returns the number of elements currently in the queue
+ */
+size_t
+ringbuf_size(struct ringbuf *rbuf)
+{
+	util_mutex_lock(&rbuf->lock);
+	size_t size = rbuf->write_pos - rbuf->read_pos;
+	util_mutex_unlock(&rbuf->lock);
+
+	return size;
+}
+
+/*
+ * ringbuf_tryenqueue -- appends an element to the queue, fails if the queue
+ *	is full or stopped
+ */
+int
+ringbuf_tryenqueue(struct ringbuf *rbuf, void *data)
+{
+	ASSERTne(data, NULL);
+
+	util_mutex_lock(&rbuf->lock);
+
+	if (!rbuf->running || rbuf->write_pos - rbuf->read_pos == rbuf->len) {
+		util_mutex_unlock(&rbuf->lock);
+		return -1;
+	}
+
+	rbuf->data[rbuf->write_pos++ & rbuf->len_mask] = data;
+
+	os_cond_signal(&rbuf->nonempty);
+	util_mutex_unlock(&rbuf->lock);
+
+	return 0;
+}
+
+/*
+ * ringbuf_pop -- (internal) removes the oldest element from the queue, must be
+ *	called with the lock held
+ */
+static void *
+ringbuf_pop(struct ringbuf *rbuf)
+{
+	if (rbuf->read_pos == rbuf->write_pos)
+		return NULL;
+
+	return rbuf->data[rbuf->read_pos++ & rbuf->len_mask];
+}
+
+/*
+ * ringbuf_dequeue -- removes the oldest element from the queue, waits for one
+ *	if the queue is empty, returns NULL once the queue is stopped and empty
+ */
+void *
+ringbuf_dequeue(struct ringbuf *rbuf)
+{
+	util_mutex_lock(&rbuf->lock);
+
+	while (rbuf->running && rbuf->read_pos == rbuf->write_pos)
+		os_cond_wait(&rbuf->nonempty, &rbuf->lock);
+
+	void *data = ringbuf_pop(rbuf);
+
+	util_mutex_unlock(&rbuf->lock);
+
+	return data;
+}
+
+/*
+ * ringbuf_trydequeue -- removes the oldest element from the queue, returns
+ *	NULL if the queue is empty
+ */
+void *
+ringbuf_trydequeue(struct ringbuf *rbuf)
+{
+	util_mutex_lock(&rbuf->lock);
+	void *data = ringbuf_pop(rbuf);
+	util_mutex_unlock(&rbuf->lock);
+
+	return data;
+}
+
+/*
+ * ringbuf_stop -- makes all subsequent enqueues fail and wakes up all of
+ *	the waiting consumers
+ */
+void
+ringbuf_stop(struct ringbuf *rbuf)
+{
+	util_mutex_lock(&rbuf->lock);
+	rbuf->running = 0;
+	os_cond_broadcast(&rbuf->nonempty);
+	util_mutex_unlock(&rbuf->lock);
+}
+
+/*
+ * ringbuf_stopped -- returns !0 if the queue was stopped
+ */
+int
+ringbuf_stopped(struct ringbuf *rbuf)
+{
+	util_mutex_lock(&rbuf->lock);
+	int stopped = !rbuf->running;
+	util_mutex_unlock(&rbuf->lock);
+
+	return stopped;
+}
@@ -34,13 +34,322 @@
  * stats.c -- implementation of statistics
  */
 
+#include "alloc_class.h"
+#include "heap.h"
 #include "obj.h"
 #include "stats.h"
+#include "sys_util.h"
 
 STATS_CTL_HANDLER(persistent, curr_allocated, heap_curr_allocated);
+STATS_CTL_HANDLER(transient, defrag_relocated, heap_defrag_relocated);
+STATS_CTL_HANDLER(transient, defrag_reclaimed, heap_defrag_reclaimed);
+
+/*
+ * Usage of the heap by a single allocation class, gathered by traversing
+ * the chunks of the zones that have been loaded so far.
+ */
+struct stats_class_usage {
+	struct palloc_heap *heap;
+	uint8_t class_id;
+
+	uint64_t allocated;
+	uint64_t free;
+	uint64_t runs;
+	struct pobj_stats_run_fill run_fill;
+};
+
+/*
+ * stats_class_usage_cb -- (internal) accounts a single chunk in the usage of
+ *	the allocation class
+ */
+static int
+stats_class_usage_cb(const struct memory_block *m, void *arg)
+{
+	struct stats_class_usage *u = arg;
+	struct chunk_header *hdr = heap_get_chunk_hdr(u->heap, m);
+
+	if (hdr->type != CHUNK_TYPE_RUN) {
+		if (u->class_id != DEFAULT_ALLOC_CLASS_ID)
+			return 0;
+
+		uint64_t size = (uint64_t)hdr->size_idx *
+			heap_chunksize(u->heap);
+		if (hdr->type == CHUNK_TYPE_FREE)
+			u->free += size;
+		else
+			u->allocated += size;
+
+		return 0;
+	}
+
+	struct chunk_run *run = heap_get_chunk_run(u->heap, m);
+	struct alloc_class *c = alloc_class_by_run(
+		heap_alloc_classes(u->heap),
+		run->block_size, hdr->flags, hdr->size_idx);
+	if (c == NULL || c->id != u->class_id)
+		return 0;
+
+	uint32_t used;
+	uint32_t nallocs;
+
+	os_mutex_t *lock = m->m_ops->get_lock(m);
+	util_mutex_lock(lock);
+	heap_run_get_usage(u->heap, m, &used, &nallocs);
+	util_mutex_unlock(lock);
+
+	u->allocated += used * run->block_size;
+	u->free += (nallocs - used) * run->block_size;
+	u->runs++;
+	u->run_fill.runs[used * 10 / nallocs]++;
+
+	return 0;
+}
+
+/*
+ * stats_class_usage_get -- (internal) gathers the usage of the allocation
+ *	class selected by the query
+ */
+static int
+stats_class_usage_get(PMEMobjpool *pop, struct ctl_indexes *indexes,
+	struct stats_class_usage *u)
+{
+	struct ctl_index *idx = SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "class_id"), 0);
+
+	if (idx->value < 0 || idx->value >= MAX_ALLOCATION_CLASSES) {
+		ERR("class id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	memset(u, 0, sizeof(*u));
+	u->heap = &pop->heap;
+	u->class_id = (uint8_t)idx->value;
+
+	if (alloc_class_by_id(heap_alloc_classes(u->heap),
+			u->class_id) == NULL) {
+		ERR("class with the given id does not exist");
+		errno = ENOENT;
+		return -1;
+	}
+
+	heap_foreach_chunk(u->heap, stats_class_usage_cb, u);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(allocated) -- reads the number of bytes allocated from
+ *	the allocation class
+ */
+static int
+CTL_READ_HANDLER(allocated)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	struct stats_class_usage u;
+	if (stats_class_usage_get(ctx, indexes, &u) != 0)
+		return -1;
+
+	*(uint64_t *)arg = u.allocated;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(free) -- reads the number of free bytes in the runs of
+ *	the allocation class
+ */
+static int
+CTL_READ_HANDLER(free)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	struct stats_class_usage u;
+	if (stats_class_usage_get(ctx, indexes, &u) != 0)
+		return -1;
+
+	*(uint64_t *)arg = u.free;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(runs) -- reads the number of runs of the allocation class
+ */
+static int
+CTL_READ_HANDLER(runs)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	struct stats_class_usage u;
+	if (stats_class_usage_get(ctx, indexes, &u) != 0)
+		return -1;
+
+	*(uint64_t *)arg = u.runs;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(run_fill) -- reads the histogram of occupancy of the runs
+ *	of the allocation class
+ */
+static int
+CTL_READ_HANDLER(run_fill)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	struct stats_class_usage u;
+	if (stats_class_usage_get(ctx, indexes, &u) != 0)
+		return -1;
+
+	*(struct pobj_stats_run_fill *)arg = u.run_fill;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(recycler_pending) -- reads the number of runs of
+ *	the allocation class that wait for their reservations to be fulfilled
+ */
+static int
+CTL_READ_HANDLER(recycler_pending)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct ctl_index *idx = SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "class_id"), 0);
+
+	if (idx->value < 0 || idx->value >= MAX_ALLOCATION_CLASSES) {
+		ERR("class id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	*(uint64_t *)arg = heap_get_recycler_pending(&pop->heap,
+		(uint8_t)idx->value);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(class_id)[] = {
+	CTL_LEAF_RO(allocated),
+	CTL_LEAF_RO(free),
+	CTL_LEAF_RO(runs),
+	CTL_LEAF_RO(run_fill),
+	CTL_LEAF_RO(recycler_pending),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(alloc_class)[] = {
+	CTL_INDEXED(class_id),
+
+	CTL_NODE_END
+};
+
+struct stats_huge_free {
+	struct palloc_heap *heap;
+	struct pobj_stats_huge_free *hist;
+};
+
+/*
+ * stats_huge_free_cb -- (internal) accounts a free chunk in the histogram
+ */
+static int
+stats_huge_free_cb(const struct memory_block *m, void *arg)
+{
+	struct stats_huge_free *f = arg;
+	struct chunk_header *hdr = heap_get_chunk_hdr(f->heap, m);
+
+	if (hdr->type == CHUNK_TYPE_FREE)
+		f->hist->blocks[util_mssb_index(hdr->size_idx)]++;
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(huge_free) -- reads the histogram of sizes of free
+ *	huge blocks
+ */
+static int
+CTL_READ_HANDLER(huge_free)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct stats_huge_free f = {&pop->heap, arg};
+	memset(f.hist, 0, sizeof(*f.hist));
+
+	heap_foreach_chunk(&pop->heap, stats_huge_free_cb, &f);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(lock_contention) -- reads how many times threads had to
+ *	wait for the buckets of an arena
+ */
+static int
+CTL_READ_HANDLER(lock_contention)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct ctl_index *idx = SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "arena_id"), 0);
+
+	if (idx->value < 0) {
+		ERR("arena id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	return heap_get_arena_lock_contention(&pop->heap,
+		(unsigned)idx->value, arg);
+}
+
+static const struct ctl_node CTL_NODE(arena_id)[] = {
+	CTL_LEAF_RO(lock_contention),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(arenas)[] = {
+	CTL_INDEXED(arena_id),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(global_lock_contention) -- reads how many times threads
+ *	had to wait for the state of the heap shared by all arenas
+ */
+static int
+CTL_READ_HANDLER(global_lock_contention)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	*(uint64_t *)arg = heap_get_global_lock_contention(&pop->heap);
+
+	return 0;
+}
 
 static const struct ctl_node CTL_NODE(heap)[] = {
 	STATS_CTL_LEAF(persistent, curr_allocated),
+	STATS_CTL_LEAF(transient, defrag_relocated),
+	STATS_CTL_LEAF(transient, defrag_reclaimed),
+	CTL_CHILD(alloc_class),
+	CTL_LEAF_RO(huge_free),
+	CTL_CHILD(arenas),
+	CTL_LEAF_RO(global_lock_contention),
 
 	CTL_NODE_END
 };
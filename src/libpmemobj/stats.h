@@ -40,7 +40,8 @@
 #include "ctl.h"
 
 struct stats_transient {
-	int unused;
+	uint64_t heap_defrag_relocated;
+	uint64_t heap_defrag_reclaimed;
 };
 
 struct stats_persistent {
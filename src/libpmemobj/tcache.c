@@ -0,0 +1,409 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tcache.c -- per-thread allocation cache
+ *
+ * Small allocations are served from a thread-local cache of memory blocks
+ * which are reserved from the bucket of the thread's arena in batches, so
+ * that the bucket lock is taken once per TCACHE_BATCH allocations instead
+ * of once per allocation.
+ *
+ * A cached block is reserved in exactly the same way as a block returned by
+ * the regular allocation path - it holds a reference on the reservation
+ * count of the run it belongs to. This prevents the run from being recycled,
+ * and its free blocks from being handed out again, for as long as the block
+ * stays in the cache.
+ *
+ * Only the current remainder of the bucket is moved into the cache, i.e.
+ * refilling the cache never creates more runs than a single allocation
+ * would.
+ *
+ * Freed blocks are not returned to the cache, they go back to the transient
+ * state of the heap through the recycler, like in the regular path.
+ *
+ * The cached blocks are returned to their buckets when the thread exits, or
+ * when an allocation of any thread cannot be satisfied otherwise - in which
+ * case the caches of all threads are flushed. The lock of a cache is
+ * therefore also taken by its owner, but it is practically never contended.
+ */
+
+#include "bucket.h"
+#include "heap.h"
+#include "out.h"
+#include "sys_util.h"
+#include "tcache.h"
+#include "vec.h"
+
+struct tcache_entry {
+	struct memory_block m;
+	int *resvp; /* reservation count of the block's run */
+};
+
+/*
+ * Blocks are handed out in the order in which they were reserved, which is
+ * also the order in which the regular allocation path would return them.
+ */
+struct tcache_bin {
+	struct bucket *b; /* bucket from which the blocks were reserved */
+	unsigned first; /* index of the next block to hand out */
+	unsigned nentries;
+	struct tcache_entry entries[TCACHE_BATCH];
+};
+
+struct tcache {
+	struct tcache_collection *tc;
+
+	/* protects the bins from being flushed by other threads */
+	os_mutex_t lock;
+	struct tcache_bin *bins[MAX_ALLOCATION_CLASSES];
+};
+
+VEC(tcache_vec, struct tcache *);
+
+struct tcache_collection {
+	struct palloc_heap *heap;
+
+	/* stores the cache of the current thread */
+	os_tls_key_t thread_cache;
+
+	/* protects the list of caches */
+	os_mutex_t lock;
+	struct tcache_vec caches;
+};
+
+/*
+ * tcache_bin_flush -- (internal) returns all cached blocks to the bucket
+ *
+ * Blocks that belong to the run which is still active in the bucket are put
+ * back into the bucket's container. The remaining ones only drop their
+ * reservation, they will be found again once their run is recycled.
+ */
+static unsigned
+tcache_bin_flush(struct tcache_bin *bin)
+{
+	unsigned nflushed = bin->nentries - bin->first;
+	if (nflushed == 0)
+		return 0;
+
+	struct bucket *b = bin->b;
+
+	util_mutex_lock(&b->lock);
+
+	for (unsigned i = bin->first; i < bin->nentries; ++i) {
+		struct tcache_entry *e = &bin->entries[i];
+
+		if (b->is_active && e->resvp == bucket_current_resvp(b))
+			bucket_insert_block(b, &e->m);
+
+		if (e->resvp)
+			util_fetch_and_sub64(e->resvp, 1);
+	}
+	bin->first = 0;
+	bin->nentries = 0;
+
+	util_mutex_unlock(&b->lock);
+
+	return nflushed;
+}
+
+/*
+ * tcache_delete -- (internal) deletes a thread cache
+ */
+static void
+tcache_delete(struct tcache *t)
+{
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
+		Free(t->bins[i]);
+
+	util_mutex_destroy(&t->lock);
+	Free(t);
+}
+
+/*
+ * tcache_flush_bins -- (internal) returns all blocks of the cache to
+ *	the buckets, returns the number of flushed blocks
+ */
+static unsigned
+tcache_flush_bins(struct tcache *t)
+{
+	unsigned nflushed = 0;
+
+	util_mutex_lock(&t->lock);
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		if (t->bins[i] != NULL)
+			nflushed += tcache_bin_flush(t->bins[i]);
+	}
+	util_mutex_unlock(&t->lock);
+
+	return nflushed;
+}
+
+/*
+ * tcache_thread_destructor -- (internal) flushes and deletes the cache of
+ *	an exiting thread
+ */
+static void
+tcache_thread_destructor(void *arg)
+{
+	struct tcache *t = arg;
+	struct tcache_collection *tc = t->tc;
+
+	tcache_flush_bins(t);
+
+	util_mutex_lock(&tc->lock);
+
+	struct tcache **tp;
+	VEC_FOREACH_BY_PTR(tp, &tc->caches) {
+		if (*tp == t) {
+			VEC_ERASE_BY_PTR(&tc->caches, tp);
+			break;
+		}
+	}
+
+	util_mutex_unlock(&tc->lock);
+
+	tcache_delete(t);
+}
+
+/*
+ * tcache_thread -- (internal) returns the cache of the current thread,
+ *	creates a new one if needed
+ */
+static struct tcache *
+tcache_thread(struct tcache_collection *tc)
+{
+	struct tcache *t = os_tls_get(tc->thread_cache);
+	if (t != NULL)
+		return t;
+
+	t = Zalloc(sizeof(*t));
+	if (t == NULL)
+		return NULL;
+
+	t->tc = tc;
+	util_mutex_init(&t->lock);
+
+	util_mutex_lock(&tc->lock);
+	int ret = VEC_PUSH_BACK(&tc->caches, t);
+	util_mutex_unlock(&tc->lock);
+
+	if (ret != 0) {
+		tcache_delete(t);
+		return NULL;
+	}
+
+	os_tls_set(tc->thread_cache, t);
+
+	return t;
+}
+
+/*
+ * tcache_bin_refill -- (internal) reserves a batch of blocks from the bucket
+ */
+static void
+tcache_bin_refill(struct tcache_collection *tc, struct tcache_bin *bin,
+	struct alloc_class *c)
+{
+	struct palloc_heap *heap = tc->heap;
+	struct bucket *b = heap_bucket_acquire(heap, c);
+	bin->b = b;
+	bin->first = 0;
+	bin->nentries = 0;
+
+	while (bin->nentries < TCACHE_BATCH) {
+		struct tcache_entry *e = &bin->entries[bin->nentries];
+
+		/* don't pull in a new run only to fill up the cache */
+		if (bin->nentries != 0 && b->c_ops->is_empty(b->container))
+			break;
+
+		e->m = MEMORY_BLOCK_NONE;
+		e->m.size_idx = 1;
+		if (heap_get_bestfit_block(heap, b, &e->m) != 0)
+			break;
+
+		/*
+		 * The reservation has to be accounted for before the next
+		 * block is taken - doing so might replace the active run.
+		 */
+		if ((e->resvp = bucket_current_resvp(b)) != NULL)
+			util_fetch_and_add64(e->resvp, 1);
+
+		bin->nentries++;
+	}
+
+	heap_bucket_release(heap, b);
+}
+
+/*
+ * tcache_get -- takes a reserved block for a single unit allocation from
+ *	the thread cache
+ *
+ * Returns -1 if the allocation cannot be served from the cache, in which
+ * case the regular allocation path should be used.
+ */
+int
+tcache_get(struct tcache_collection *tc, struct alloc_class *c,
+	struct memory_block *m, int **resvp)
+{
+	if (c->type != CLASS_RUN || c->unit_size > TCACHE_MAX_UNIT_SIZE ||
+		m->size_idx != 1)
+		return -1;
+
+	struct tcache *t = tcache_thread(tc);
+	if (t == NULL)
+		return -1;
+
+	int ret = -1;
+	util_mutex_lock(&t->lock);
+
+	struct tcache_bin *bin = t->bins[c->id];
+	if (bin == NULL) {
+		if ((bin = Malloc(sizeof(*bin))) == NULL)
+			goto out;
+
+		bin->b = NULL;
+		bin->first = 0;
+		bin->nentries = 0;
+		t->bins[c->id] = bin;
+	}
+
+	if (bin->first == bin->nentries) {
+		tcache_bin_refill(tc, bin, c);
+		if (bin->nentries == 0)
+			goto out;
+	}
+
+	struct tcache_entry *e = &bin->entries[bin->first++];
+	*m = e->m;
+	*resvp = e->resvp;
+	ret = 0;
+
+out:
+	util_mutex_unlock(&t->lock);
+
+	return ret;
+}
+
+/*
+ * tcache_put -- returns an unused block taken by tcache_get to the thread
+ *	cache
+ */
+void
+tcache_put(struct tcache_collection *tc, struct alloc_class *c,
+	const struct memory_block *m, int *resvp)
+{
+	struct tcache *t = os_tls_get(tc->thread_cache);
+	ASSERTne(t, NULL);
+
+	util_mutex_lock(&t->lock);
+
+	struct tcache_bin *bin = t->bins[c->id];
+	ASSERTne(bin, NULL);
+
+	if (bin->first == 0) {
+		/* the bin was flushed since the block was taken */
+		ASSERTeq(bin->nentries, 0);
+		bin->first = 1;
+		bin->nentries = 1;
+	}
+
+	struct tcache_entry *e = &bin->entries[--bin->first];
+	e->m = *m;
+	e->resvp = resvp;
+
+	util_mutex_unlock(&t->lock);
+}
+
+/*
+ * tcache_flush_all -- returns all blocks cached by all of the threads to
+ *	the buckets, returns the number of flushed blocks
+ *
+ * Must not be called with any of the bucket locks held.
+ */
+unsigned
+tcache_flush_all(struct tcache_collection *tc)
+{
+	unsigned nflushed = 0;
+
+	util_mutex_lock(&tc->lock);
+
+	struct tcache *t;
+	VEC_FOREACH(t, &tc->caches) {
+		nflushed += tcache_flush_bins(t);
+	}
+
+	util_mutex_unlock(&tc->lock);
+
+	return nflushed;
+}
+
+/*
+ * tcache_collection_new -- creates a new collection of thread caches
+ */
+struct tcache_collection *
+tcache_collection_new(struct palloc_heap *heap)
+{
+	struct tcache_collection *tc = Malloc(sizeof(*tc));
+	if (tc == NULL)
+		return NULL;
+
+	tc->heap = heap;
+	util_mutex_init(&tc->lock);
+	VEC_INIT(&tc->caches);
+	os_tls_key_create(&tc->thread_cache, tcache_thread_destructor);
+
+	return tc;
+}
+
+/*
+ * tcache_collection_delete -- deletes the collection along with all thread
+ *	caches
+ *
+ * The cached blocks are not flushed, this is meant to be called only when
+ * the transient state of the entire heap is being destroyed.
+ */
+void
+tcache_collection_delete(struct tcache_collection *tc)
+{
+	os_tls_key_delete(tc->thread_cache);
+
+	struct tcache *t;
+	VEC_FOREACH(t, &tc->caches) {
+		tcache_delete(t);
+	}
+	VEC_DELETE(&tc->caches);
+
+	util_mutex_destroy(&tc->lock);
+	Free(tc);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * tcache.h -- internal definitions for per-thread allocation cache
+ */
+
+#ifndef LIBPMEMOBJ_TCACHE_H
+#define LIBPMEMOBJ_TCACHE_H 1
+
+#include "alloc_class.h"
+#include "memblock.h"
+
+/* largest unit size of an allocation class served from the cache */
+#define TCACHE_MAX_UNIT_SIZE 256
+
+/* number of blocks reserved at once when the cache runs empty */
+#define TCACHE_BATCH 32
+
+struct tcache_collection;
+
+struct tcache_collection *tcache_collection_new(struct palloc_heap *heap);
+void tcache_collection_delete(struct tcache_collection *tc);
+
+int tcache_get(struct tcache_collection *tc, struct alloc_class *c,
+	struct memory_block *m, int **resvp);
+void tcache_put(struct tcache_collection *tc, struct alloc_class *c,
+	const struct memory_block *m, int *resvp);
+unsigned tcache_flush_all(struct tcache_collection *tc);
+
+#endif
@@ -42,6 +42,7 @@
 #include "obj.h"
 #include "out.h"
 #include "pmalloc.h"
+#include "ringbuf.h"
 #include "tx.h"
 #include "valgrind_internal.h"
 
@@ -90,10 +91,17 @@ struct tx_undo_runtime {
 
 struct lane_tx_runtime {
 	struct ravl *ranges;
-	uint64_t cache_offset;
+	uint64_t ncaches; /* number of set caches used by the transaction */
+	uint64_t cache_offset; /* offset in the last used set cache */
 	struct tx_undo_runtime undo;
 
 	VEC(, struct pobj_action) actions;
+
+	unsigned lane_idx; /* valid only while in the post commit queue */
+
+	int redo; /* pmemobj_tx_write stages the data in the shadow */
+	struct ravl *shadow; /* words to be written by the commit redo log */
+	size_t shadow_words;
 };
 
 struct tx_alloc_args {
@@ -114,9 +122,19 @@ struct tx_range_def {
 	uint64_t flags;
 };
 
+struct tx_redo_word {
+	uint64_t offset; /* aligned to the size of the word */
+	uint64_t value;
+	uint64_t mask; /* bytes of the value written by the transaction */
+};
+
 struct tx_parameters {
 	size_t cache_size;
 	size_t cache_threshold;
+	size_t cache_retain; /* max number of set caches kept by a lane */
+
+	/* queue of committed lanes awaiting cleanup, NULL if disabled */
+	struct ringbuf *post_commit_tasks;
 };
 
 /*
@@ -136,6 +154,23 @@ tx_range_def_cmp(const void *lhs, const void *rhs)
 	return 0;
 }
 
+/*
+ * tx_redo_word_cmp -- compares two shadow words
+ */
+static int
+tx_redo_word_cmp(const void *lhs, const void *rhs)
+{
+	const struct tx_redo_word *l = lhs;
+	const struct tx_redo_word *r = rhs;
+
+	if (l->offset > r->offset)
+		return 1;
+	else if (l->offset < r->offset)
+		return -1;
+
+	return 0;
+}
+
 /*
  * tx_params_new -- creates a new transactional parameters instance and fills it
  *	with default values.
@@ -149,6 +184,8 @@ tx_params_new(void)
 
 	tx_params->cache_size = TX_DEFAULT_RANGE_CACHE_SIZE;
 	tx_params->cache_threshold = TX_DEFAULT_RANGE_CACHE_THRESHOLD;
+	tx_params->cache_retain = TX_DEFAULT_RANGE_CACHE_RETAIN;
+	tx_params->post_commit_tasks = NULL;
 
 	return tx_params;
 }
@@ -159,6 +196,9 @@ tx_params_new(void)
 void
 tx_params_delete(struct tx_parameters *tx_params)
 {
+	if (tx_params->post_commit_tasks != NULL)
+		ringbuf_delete(tx_params->post_commit_tasks);
+
 	Free(tx_params);
 }
 
@@ -497,57 +537,49 @@ tx_abort_recover_range(PMEMobjpool *pop, struct tx *tx, struct tx_range *range)
 }
 
 /*
- * tx_clear_set_cache_but_first -- (internal) removes all but the first cache
- *	from the UNDO_SET_CACHE vector
+ * tx_clear_set_cache -- (internal) zeroes the caches used by the transaction
+ *	and frees the ones above the retain limit
  *
- * Only the valgrind related flags are valid for the vg_flags variable.
+ * The caches are kept in the UNDO_SET_CACHE vector across transactions so
+ * that large transactions don't have to allocate and free them every time.
+ * The first cache is always retained.
  */
 static void
-tx_clear_set_cache_but_first(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
-	struct tx *tx, entry_op_callback cb)
+tx_clear_set_cache(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
+	struct lane_tx_runtime *lane)
 {
 	LOG(4, NULL);
 
 	struct pvector_context *cache_undo = tx_rt->ctx[UNDO_SET_CACHE];
-	uint64_t first_cache = pvector_first(cache_undo);
-
-	if (first_cache == 0)
-		return;
+	uint64_t retain = pop->tx_params->cache_retain;
 
-	uint64_t off;
+	while (pvector_size(cache_undo) > retain)
+		pvector_pop_back(cache_undo, tx_free_vec_entry);
 
-	int zero_all = 0;
+	uint64_t ncaches = pvector_size(cache_undo);
+	if (ncaches > lane->ncaches)
+		ncaches = lane->ncaches;
 
-	while ((off = pvector_last(cache_undo)) != first_cache) {
-		pvector_pop_back(cache_undo, cb);
-		zero_all = 1;
-	}
+	for (uint64_t i = 0; i < ncaches; ++i) {
+		uint64_t off = pvector_at(cache_undo, i);
+		struct tx_range_cache *cache = OBJ_OFF_TO_PTR(pop, off);
+		size_t usable_size = palloc_usable_size(&pop->heap, off);
 
-	struct tx_range_cache *cache = OBJ_OFF_TO_PTR(pop, first_cache);
-
-	size_t sz;
-	if (zero_all) {
-		sz = palloc_usable_size(&pop->heap, first_cache);
-	} else {
-		ASSERTne(tx, NULL);
-		struct lane_tx_runtime *r = tx->section->runtime;
-		sz = r->cache_offset;
-	}
+		/* only the last used cache can be partially filled */
+		size_t sz = i == lane->ncaches - 1 ?
+			lane->cache_offset : usable_size;
 
-	if (sz) {
-		VALGRIND_ADD_TO_TX(cache, sz);
-		pmemops_memset(&pop->p_ops, cache, 0, sz, 0);
-		VALGRIND_REMOVE_FROM_TX(cache, sz);
-	}
+		if (sz) {
+			VALGRIND_ADD_TO_TX(cache, sz);
+			pmemops_memset(&pop->p_ops, cache, 0, sz, 0);
+			VALGRIND_REMOVE_FROM_TX(cache, sz);
+		}
 
 #ifdef DEBUG
-	if (!zero_all && /* for recovery we know we zeroed everything */
-		!pop->tx_debug_skip_expensive_checks) {
-		uint64_t usable_size = palloc_usable_size(&pop->heap,
-			first_cache);
-		ASSERTeq(util_is_zeroed(cache, usable_size), 1);
-	}
+		if (!pop->tx_debug_skip_expensive_checks)
+			ASSERTeq(util_is_zeroed(cache, usable_size), 1);
 #endif
+	}
 }
 
 /*
@@ -567,23 +599,54 @@ tx_abort_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt, int recovery)
 
 	if (recovery) /* if recovering from a crash, remove all of the caches */
 		tx_clear_undo_log(pop, tx_rt->ctx[UNDO_SET_CACHE]);
-	else /* otherwise leave the first one */
-		tx_clear_set_cache_but_first(pop, tx_rt, tx, tx_free_vec_entry);
+	else /* otherwise keep them for the next transactions */
+		tx_clear_set_cache(pop, tx_rt, tx->section->runtime);
 
 	tx_clear_undo_log(pop, tx_rt->ctx[UNDO_SET]);
 }
 
+struct tx_flush_run {
+	PMEMobjpool *pop;
+	uint64_t offset; /* beginning of the pending flush */
+	uint64_t end; /* end of the pending flush, zero if there is none */
+};
+
+/*
+ * tx_flush_run_flush -- (internal) flushes the pending run of ranges
+ */
+static void
+tx_flush_run_flush(struct tx_flush_run *run)
+{
+	if (run->end == 0)
+		return;
+
+	PMEMobjpool *pop = run->pop;
+	pmemops_flush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, run->offset),
+		run->end - run->offset);
+	run->end = 0;
+}
+
 /*
  * tx_flush_range -- (internal) flush one range
+ *
+ * The ranges are visited in the order of their offsets. The ones that are
+ * within the same or the directly following cacheline are flushed together,
+ * so that neighbouring ranges don't flush the shared cachelines many times.
  */
 static void
 tx_flush_range(void *data, void *ctx)
 {
-	PMEMobjpool *pop = ctx;
+	struct tx_flush_run *run = ctx;
+	PMEMobjpool *pop = run->pop;
 	struct tx_range_def *range = data;
 	if (!(range->flags & POBJ_FLAG_NO_FLUSH)) {
-		pmemops_flush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, range->offset),
-				range->size);
+		if (run->end != 0 && ALIGN_DOWN(range->offset, CACHELINE_SIZE) >
+		    ALIGN_UP(run->end, CACHELINE_SIZE))
+			tx_flush_run_flush(run);
+
+		if (run->end == 0)
+			run->offset = range->offset;
+		run->end = range->offset + range->size;
 	}
 	VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, range->offset),
 		range->size);
@@ -611,7 +674,9 @@ tx_pre_commit(struct tx *tx, struct lane_tx_runtime *lane)
 	ASSERTne(tx->section->runtime, NULL);
 
 	/* Flush all regions and destroy the whole tree. */
-	ravl_delete_cb(lane->ranges, tx_flush_range, tx->pop);
+	struct tx_flush_run run = {tx->pop, 0, 0};
+	ravl_delete_cb(lane->ranges, tx_flush_range, &run);
+	tx_flush_run_flush(&run);
 	lane->ranges = NULL;
 }
 
@@ -684,6 +749,11 @@ tx_abort(PMEMobjpool *pop, struct lane_tx_runtime *lane,
 		VEC_CLEAR(&lane->actions);
 		ravl_delete_cb(lane->ranges, tx_clean_range, pop);
 		lane->ranges = NULL;
+
+		if (lane->shadow != NULL) {
+			ravl_delete(lane->shadow);
+			lane->shadow = NULL;
+		}
 	}
 
 	tx_abort_set(pop, tx_rt, recovery);
@@ -702,6 +772,35 @@ tx_get_pop(void)
 	return get_tx()->pop;
 }
 
+/*
+ * tx_frees -- returns whether the object at the given offset is freed by
+ * the current transaction
+ */
+int
+tx_frees(uint64_t off)
+{
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+
+	struct lane_tx_runtime *lane =
+		(struct lane_tx_runtime *)tx->section->runtime;
+
+	/* objects allocated in this transaction have a heap action too */
+	struct tx_range_def range = {off, 0, 0};
+	if (ravl_find(lane->ranges, &range, RAVL_PREDICATE_EQUAL) != NULL)
+		return 0;
+
+	struct pobj_action *action;
+	VEC_FOREACH_BY_PTR(action, &lane->actions) {
+		if (action->type == POBJ_ACTION_TYPE_HEAP &&
+		    action->heap.offset == off)
+			return 1;
+	}
+
+	return 0;
+}
+
 /*
  * add_to_tx_and_lock -- (internal) add lock to the transaction and acquire it
  */
@@ -937,7 +1036,11 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 		lane->ranges = ravl_new_sized(tx_range_def_cmp,
 			sizeof(struct tx_range_def));
+		lane->ncaches = 0;
 		lane->cache_offset = 0;
+		lane->redo = 0;
+		lane->shadow = NULL;
+		lane->shadow_words = 0;
 
 		struct lane_tx_layout *layout =
 			(struct lane_tx_layout *)tx->section->layout;
@@ -993,6 +1096,18 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 			tx->stage_callback = cb;
 			tx->stage_callback_arg = arg;
+		} else if (param_type == TX_PARAM_REDO) {
+			struct lane_tx_runtime *rt = tx->section->runtime;
+
+			if (SLIST_NEXT(txd, tx_entry) != NULL && !rt->redo) {
+				ERR("nested redo transaction within an undo "
+					"transaction");
+				err = EINVAL;
+				va_end(argp);
+				goto err_abort;
+			}
+
+			rt->redo = 1;
 		} else {
 			err = add_to_tx_and_lock(tx, param_type,
 				va_arg(argp, void *));
@@ -1083,6 +1198,7 @@ obj_tx_abort(int errnum, int user)
 
 		/* process the undo log */
 		tx_abort(tx->pop, lane, layout, 0 /* abort */);
+		pmalloc_operation_release(tx->pop);
 		tx->ctx = NULL;
 		lane_release(tx->pop);
 		tx->section = NULL;
@@ -1122,21 +1238,134 @@ pmemobj_tx_errno(void)
 	return get_tx()->last_errnum;
 }
 
+/*
+ * tx_post_commit -- (internal) cleans up the undo log of a committed
+ *	transaction and releases its lane
+ *
+ * If the lane was handed over to a post commit worker, it is attached to
+ * the calling thread for the duration of the cleanup.
+ */
 static void
-tx_post_commit(struct tx *tx, struct lane_tx_runtime *lane)
+tx_post_commit(PMEMobjpool *pop, struct lane_tx_runtime *lane, int detached)
 {
+	if (detached) {
+		lane_attach(pop, lane->lane_idx);
+		VALGRIND_START_TX;
+	}
+
 	/*
 	 * At this point the transaction is completed but we still need
-	 * to clear the first set cache.
-	 * The caches are deleted and zeroed by the redo log.
+	 * to clear the set caches it used.
+	 * The first range of each of them was already invalidated by the
+	 * redo log, so this step can be safely deferred.
 	 */
-	struct pvector_context *cache = lane->undo.ctx[UNDO_SET_CACHE];
-	if (pvector_size(cache) > 0)
-		tx_clear_set_cache_but_first(tx->pop, &lane->undo, tx, NULL);
+	tx_clear_set_cache(pop, &lane->undo, lane);
 
 	pvector_resize(lane->undo.ctx[UNDO_SET], 0);
 
 	VEC_CLEAR(&lane->actions);
+
+	if (detached)
+		VALGRIND_END_TX;
+
+	lane_release(pop);
+}
+
+/*
+ * tx_post_commit_enqueue -- (internal) hands over the lane of a committed
+ *	transaction to the post commit workers, returns -1 if the cleanup has to
+ *	be performed synchronously
+ */
+static int
+tx_post_commit_enqueue(PMEMobjpool *pop, struct lane_tx_runtime *lane)
+{
+	struct ringbuf *tasks = pop->tx_params->post_commit_tasks;
+	if (tasks == NULL)
+		return -1;
+
+	lane->lane_idx = lane_detach(pop);
+	if (ringbuf_tryenqueue(tasks, lane) != 0) {
+		lane_attach(pop, lane->lane_idx);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * tx_post_commit_drain -- (internal) performs all of the pending post commit
+ *	tasks in the calling thread
+ */
+static void
+tx_post_commit_drain(PMEMobjpool *pop, struct ringbuf *tasks)
+{
+	struct lane_tx_runtime *lane;
+	while ((lane = ringbuf_trydequeue(tasks)) != NULL)
+		tx_post_commit(pop, lane, 1);
+}
+
+/*
+ * tx_post_commit_stop -- stops the post commit workers and performs all of the
+ *	remaining tasks, must be called before the lanes are destroyed
+ */
+void
+tx_post_commit_stop(PMEMobjpool *pop)
+{
+	struct ringbuf *tasks = pop->tx_params->post_commit_tasks;
+	if (tasks == NULL)
+		return;
+
+	ringbuf_stop(tasks);
+	tx_post_commit_drain(pop, tasks);
+}
+
+/*
+ * tx_shadow_word_publish -- (internal) converts a shadow word into an action
+ */
+static void
+tx_shadow_word_publish(void *data, void *arg)
+{
+	struct tx *tx = arg;
+	struct tx_redo_word *word = data;
+	struct lane_tx_runtime *lane = tx->section->runtime;
+	uint64_t *dest = OBJ_OFF_TO_PTR(tx->pop, word->offset);
+
+	/*
+	 * The bytes of the word that were not written through the shadow
+	 * might have been modified directly since it was created, those are
+	 * taken from the pool as they are at the time of commit.
+	 */
+	uint64_t value = (word->value & word->mask) | (*dest & ~word->mask);
+
+	/* the space was reserved upfront, this cannot fail */
+	VEC_INC_BACK(&lane->actions);
+
+	palloc_set_value(&tx->pop->heap, &VEC_BACK(&lane->actions),
+		dest, value);
+}
+
+/*
+ * tx_shadow_publish -- (internal) appends the redo logged writes to the
+ *	transaction actions, in the order of their addresses
+ */
+static int
+tx_shadow_publish(struct tx *tx, struct lane_tx_runtime *lane)
+{
+	if (lane->shadow == NULL)
+		return 0;
+
+	size_t nactions = VEC_SIZE(&lane->actions) + lane->shadow_words;
+	if (operation_reserve(tx->ctx, nactions) != 0)
+		return -1;
+
+	if (VEC_RESERVE(&lane->actions, nactions) != 0)
+		return -1;
+
+	ravl_delete_cb(lane->shadow, tx_shadow_word_publish, tx);
+	lane->shadow = NULL;
+	lane->shadow_words = 0;
+
+	return 0;
 }
 
 /*
@@ -1165,6 +1394,11 @@ pmemobj_tx_commit(void)
 
 		PMEMobjpool *pop = tx->pop;
 
+		if (tx_shadow_publish(tx, lane) != 0) {
+			obj_tx_abort(errno, 0);
+			return;
+		}
+
 		/* pre-commit phase */
 		tx_pre_commit(tx, lane);
 
@@ -1177,9 +1411,8 @@ pmemobj_tx_commit(void)
 		pmalloc_operation_release(pop);
 		tx->ctx = NULL;
 
-		tx_post_commit(tx, lane);
-
-		lane_release(pop);
+		if (tx_post_commit_enqueue(pop, lane) != 0)
+			tx_post_commit(pop, lane, 0);
 
 		tx->section = NULL;
 	}
@@ -1301,6 +1534,7 @@ pmemobj_tx_add_large(struct tx *tx, struct tx_range_def *args)
 
 	if (ret != 0) {
 		pvector_pop_back(undo, NULL);
+		return ret;
 	}
 
 	struct pobj_action *action[2] = {tx_action_add(tx), tx_action_add(tx)};
@@ -1344,74 +1578,62 @@ static struct tx_range_cache *
 pmemobj_tx_get_range_cache(PMEMobjpool *pop, struct tx *tx,
 	struct pvector_context *undo, uint64_t *remaining_space)
 {
-	uint64_t first_cache = pvector_first(undo);
-	uint64_t last_cache = pvector_last(undo);
+	struct lane_tx_runtime *runtime = tx->section->runtime;
+	uint64_t cache_off = runtime->ncaches == 0 ? 0 :
+		pvector_at(undo, runtime->ncaches - 1);
 	uint64_t cache_size;
 
-	int is_first = first_cache == last_cache;
-
 	struct tx_range_cache *cache = NULL;
-	/* get the last element from the caches list */
-	if (last_cache != 0) {
-		cache = OBJ_OFF_TO_PTR(pop, last_cache);
-		cache_size = palloc_usable_size(&pop->heap, last_cache);
+	/* get the cache currently being filled */
+	if (cache_off != 0) {
+		cache = OBJ_OFF_TO_PTR(pop, cache_off);
+		cache_size = palloc_usable_size(&pop->heap, cache_off);
 	}
 
-	struct lane_tx_runtime *runtime = tx->section->runtime;
-
 	/* verify if the cache exists and has at least 8 bytes of free space */
 	if (cache != NULL && cache_size > runtime->cache_offset +
 	    sizeof(struct tx_range))
 		goto out;
 
-	/* no existing cache, allocate a new one */
-	uint64_t *entry = pvector_push_back(undo);
-	if (entry == NULL) {
-		ERR("cache set undo log too large");
-		return NULL;
-	}
-	int err = pmalloc_construct(pop, entry,
-		pop->tx_params->cache_size,
-		constructor_tx_range_cache, NULL,
-		0, OBJ_INTERNAL_OBJECT_MASK, 0);
-
-	if (err != 0) {
-		pvector_pop_back(undo, NULL);
-		return NULL;
-	}
-
-	if (!is_first) {
-		struct pobj_action *action[2] =
-			{tx_action_add(tx), tx_action_add(tx)};
-		if (action[0] == NULL || action[1] == NULL) {
-			if (action[0] != NULL)
-				tx_action_remove(tx);
+	/* reuse a cache retained from the previous transactions, if any */
+	cache_off = pvector_at(undo, runtime->ncaches);
+	if (cache_off == 0) {
+		/* no spare cache, allocate a new one */
+		uint64_t *entry = pvector_push_back(undo);
+		if (entry == NULL) {
+			ERR("cache set undo log too large");
+			return NULL;
+		}
+		int err = pmalloc_construct(pop, entry,
+			pop->tx_params->cache_size,
+			constructor_tx_range_cache, NULL,
+			0, OBJ_INTERNAL_OBJECT_MASK, 0);
 
+		if (err != 0) {
+			pvector_pop_back(undo, NULL);
 			return NULL;
 		}
-		palloc_defer_free(&pop->heap, *entry, action[0]);
-		palloc_set_value(&pop->heap, action[1], entry, 0);
+
+		cache_off = *entry;
 	}
 
-	cache = OBJ_OFF_TO_PTR(pop, *entry);
-	cache_size = palloc_usable_size(&pop->heap, *entry);
-
-	/* since the cache is new, we start the count from 0 */
-	runtime->cache_offset = 0;
+	cache = OBJ_OFF_TO_PTR(pop, cache_off);
+	cache_size = palloc_usable_size(&pop->heap, cache_off);
 
 	/*
-	 * If we are retrieving the first cache for the first time, setup a
-	 * redo log action to clear the first entry so that the undo log becomes
-	 * invalid once the redo log is processed.
+	 * Setup a redo log action to clear the first entry of the cache so
+	 * that its content becomes invalid once the redo log is processed.
 	 */
-	if (is_first && runtime->cache_offset == 0) {
-		struct pobj_action *action = tx_action_add(tx);
-		if (action == NULL)
-			return NULL;
+	struct pobj_action *action = tx_action_add(tx);
+	if (action == NULL)
+		return NULL;
 
-		struct tx_range *r = (struct tx_range *)cache;
-		palloc_set_value(&pop->heap, action, &r->offset, 0);
-	}
+	struct tx_range *r = (struct tx_range *)cache;
+	palloc_set_value(&pop->heap, action, &r->offset, 0);
+
+	/* since the cache is new, we start the count from 0 */
+	runtime->ncaches++;
+	runtime->cache_offset = 0;
 
 out:
 	*remaining_space = cache_size - runtime->cache_offset;
@@ -1419,6 +1641,46 @@ out:
 	return cache;
 }
 
+/*
+ * pmemobj_tx_range_cache_fits -- (internal) checks if the snapshot fits in the
+ *	remaining space of the caches that are, or can be, retained by the lane
+ */
+static int
+pmemobj_tx_range_cache_fits(struct tx *tx, uint64_t size)
+{
+	PMEMobjpool *pop = tx->pop;
+	struct lane_tx_runtime *runtime = tx->section->runtime;
+	struct pvector_context *undo = runtime->undo.ctx[UNDO_SET_CACHE];
+	uint64_t nretained = pvector_size(undo);
+	uint64_t space = 0;
+
+	for (uint64_t i = runtime->ncaches == 0 ? 0 : runtime->ncaches - 1;
+	    i < nretained && space < size; ++i) {
+		uint64_t off = pvector_at(undo, i);
+		uint64_t cache_space = palloc_usable_size(&pop->heap, off);
+		if (i + 1 == runtime->ncaches)
+			cache_space -= runtime->cache_offset;
+
+		/* each part of the snapshot requires its own header */
+		if (cache_space > sizeof(struct tx_range))
+			space += cache_space - sizeof(struct tx_range);
+	}
+
+	if (space >= size)
+		return 1;
+
+	uint64_t retain = pop->tx_params->cache_retain;
+	size_t cache_size = pop->tx_params->cache_size;
+	if (nretained >= retain || cache_size <= sizeof(struct tx_range))
+		return 0;
+
+	/* the number of new caches required for the rest of the snapshot */
+	uint64_t cache_space = cache_size - sizeof(struct tx_range);
+	uint64_t ncaches = (size - space + cache_space - 1) / cache_space;
+
+	return ncaches <= retain - nretained;
+}
+
 /*
  * pmemobj_tx_add_small -- (internal) adds small memory range to undo log cache
  */
@@ -1525,22 +1787,22 @@ pmemobj_tx_add_snapshot(struct tx *tx, struct tx_range_def *snapshot)
 
 	/*
 	 * Depending on the size of the block, either allocate an
-	 * entire new object or use cache.
+	 * entire new object or use cache. Blocks above the threshold still
+	 * use the cache if they fit in the caches retained by the lane.
 	 */
-	return snapshot->size > tx->pop->tx_params->cache_threshold ?
+	return snapshot->size > tx->pop->tx_params->cache_threshold &&
+		!pmemobj_tx_range_cache_fits(tx, snapshot->size) ?
 		pmemobj_tx_add_large(tx, snapshot) :
 		pmemobj_tx_add_small(tx, snapshot);
 }
 
 /*
- * pmemobj_tx_add_common -- (internal) common code for adding persistent memory
- *				into the transaction
+ * pmemobj_tx_range_check -- (internal) verifies that the range can be modified
+ *	by the transaction, aborts it otherwise
  */
 static int
-pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
+pmemobj_tx_range_check(struct tx *tx, struct tx_range_def *args)
 {
-	LOG(15, NULL);
-
 	if (args->size > PMEMOBJ_MAX_ALLOC_SIZE) {
 		ERR("snapshot size too large");
 		return obj_tx_abort_err(EINVAL);
@@ -1553,12 +1815,31 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 		return obj_tx_abort_err(EINVAL);
 	}
 
-	int ret = 0;
+	return 0;
+}
+
+/*
+ * pmemobj_tx_add_common -- (internal) common code for adding persistent memory
+ *				into the transaction
+ */
+static int
+pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
+{
+	LOG(15, NULL);
+
+	int ret = pmemobj_tx_range_check(tx, args);
+	if (ret != 0)
+		return ret;
+
 	struct lane_tx_runtime *runtime = tx->section->runtime;
 
 	/*
 	 * Search existing ranges backwards starting from the end of the
 	 * snapshot.
+	 *
+	 * Whenever the snapshot is merged with an existing range, their flags
+	 * are intersected - the merged range can only skip the flush on commit
+	 * if none of its parts requires it.
 	 */
 	struct tx_range_def r = *args;
 	struct tx_range_def search = {0, 0, 0};
@@ -1605,6 +1886,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 				ASSERTeq(rend, fprev->offset);
 				fprev->offset -= r.size;
 				fprev->size += r.size;
+				fprev->flags &= args->flags;
 			} else {
 				/*
 				 * If we don't have anything adjacent, create
@@ -1641,6 +1923,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 			size_t intersection = fend - MAX(f->offset, r.offset);
 			r.size -= intersection + snapshot.size;
 			f->size += snapshot.size;
+			f->flags &= args->flags;
 
 			if (snapshot.size != 0) {
 				ret = pmemobj_tx_add_snapshot(tx, &snapshot);
@@ -1656,6 +1939,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 				struct tx_range_def *fprev = ravl_data(nprev);
 				ASSERTeq(rend, fprev->offset);
 				f->size += fprev->size;
+				f->flags &= fprev->flags;
 				ravl_remove(runtime->ranges, nprev);
 			}
 		} else if (fend >= r.offset) {
@@ -1679,6 +1963,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 			 */
 			size_t overlap = rend - MAX(f->offset, r.offset);
 			r.size -= overlap;
+			f->flags &= args->flags;
 		} else {
 			ASSERT(0);
 		}
@@ -1755,6 +2040,118 @@ pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags)
 	return pmemobj_tx_add_common(tx, &args);
 }
 
+/*
+ * tx_shadow_word -- (internal) returns the shadow of the word at the given
+ *	offset, creates an empty one if necessary
+ */
+static struct tx_redo_word *
+tx_shadow_word(struct lane_tx_runtime *lane, uint64_t offset)
+{
+	struct tx_redo_word word = {offset, 0, 0};
+
+	struct ravl_node *n = ravl_find(lane->shadow, &word,
+		RAVL_PREDICATE_EQUAL);
+	if (n != NULL)
+		return ravl_data(n);
+
+	if (ravl_emplace_copy(lane->shadow, &word) != 0)
+		return NULL;
+
+	lane->shadow_words++;
+
+	n = ravl_find(lane->shadow, &word, RAVL_PREDICATE_EQUAL);
+	ASSERTne(n, NULL);
+
+	return ravl_data(n);
+}
+
+/*
+ * tx_shadow_write -- (internal) stages the data in the volatile shadow, it
+ *	will be written to the pool by the commit redo log
+ */
+static int
+tx_shadow_write(struct lane_tx_runtime *lane, uint64_t offset,
+	const void *src, size_t size)
+{
+	if (lane->shadow == NULL) {
+		lane->shadow = ravl_new_sized(tx_redo_word_cmp,
+			sizeof(struct tx_redo_word));
+		if (lane->shadow == NULL)
+			return -1;
+	}
+
+	const char *data = src;
+	uint64_t end = offset + size;
+	uint64_t w = ALIGN_DOWN(offset, sizeof(uint64_t));
+
+	for (; w < end; w += sizeof(uint64_t)) {
+		struct tx_redo_word *word = tx_shadow_word(lane, w);
+		if (word == NULL)
+			return -1;
+
+		uint64_t wbegin = w > offset ? w : offset;
+		uint64_t wend = w + sizeof(uint64_t) < end ?
+			w + sizeof(uint64_t) : end;
+
+		memcpy((char *)&word->value + (wbegin - w),
+			data + (wbegin - offset), wend - wbegin);
+		memset((char *)&word->mask + (wbegin - w),
+			0xff, wend - wbegin);
+	}
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_write -- transactionally writes the data to the persistent
+ *	memory range
+ */
+int
+pmemobj_tx_write(void *dest, const void *src, size_t size)
+{
+	LOG(3, NULL);
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	PMEMobjpool *pop = tx->pop;
+
+	if (!OBJ_PTR_FROM_POOL(pop, dest)) {
+		ERR("object outside of pool");
+		return obj_tx_abort_err(EINVAL);
+	}
+
+	struct lane_tx_runtime *lane = tx->section->runtime;
+
+	struct tx_range_def args = {
+		.offset = (uint64_t)((char *)dest - (char *)pop),
+		.size = size,
+		.flags = 0,
+	};
+
+	int ret;
+	if (!lane->redo) {
+		ret = pmemobj_tx_add_common(tx, &args);
+		if (ret == 0)
+			memcpy(dest, src, size);
+
+		return ret;
+	}
+
+	/* the shadow is written to the pool without a snapshot */
+	ret = pmemobj_tx_range_check(tx, &args);
+	if (ret != 0)
+		return ret;
+
+	if (tx_shadow_write(lane, args.offset, src, size) != 0) {
+		ERR("!cannot stage the redo logged write");
+		return obj_tx_abort_err(ENOMEM);
+	}
+
+	return 0;
+}
+
 /*
  * pmemobj_tx_add_range -- adds persistent memory range into the transaction
  */
@@ -2233,9 +2630,51 @@ CTL_WRITE_HANDLER(threshold)(void *ctx,
 
 static struct ctl_argument CTL_ARG(threshold) = CTL_ARG_LONG_LONG;
 
+/*
+ * CTL_READ_HANDLER(retain) -- gets the number of caches retained by a lane
+ */
+static int
+CTL_READ_HANDLER(retain)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->cache_retain;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(retain) --
+ *	sets the number of caches retained by a lane
+ */
+static int
+CTL_WRITE_HANDLER(retain)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(int *)arg;
+
+	if (arg_in < 1) {
+		errno = EINVAL;
+		ERR("invalid number of retained caches, must be at least 1");
+		return -1;
+	}
+
+	pop->tx_params->cache_retain = (size_t)arg_in;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(retain) = CTL_ARG_LONG_LONG;
+
 static const struct ctl_node CTL_NODE(cache)[] = {
 	CTL_LEAF_RW(size),
 	CTL_LEAF_RW(threshold),
+	CTL_LEAF_RW(retain),
 
 	CTL_NODE_END
 };
@@ -2282,12 +2721,19 @@ static const struct ctl_node CTL_NODE(debug)[] = {
 };
 
 /*
- * CTL_WRITE_HANDLER(queue_depth) -- returns the depth of the post commit queue
+ * CTL_READ_HANDLER(queue_depth) -- returns the depth of the post commit queue
  */
 static int
 CTL_READ_HANDLER(queue_depth)(void *ctx, enum ctl_query_source source,
 	void *arg, struct ctl_indexes *indexes)
 {
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	struct ringbuf *tasks = pop->tx_params->post_commit_tasks;
+	*arg_out = tasks == NULL ? 0 : (int)ringbuf_length(tasks);
+
 	return 0;
 }
 
@@ -2298,6 +2744,38 @@ static int
 CTL_WRITE_HANDLER(queue_depth)(void *ctx, enum ctl_query_source source,
 	void *arg, struct ctl_indexes *indexes)
 {
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 0 || (arg_in != 0 && !util_is_pow2((uint64_t)arg_in))) {
+		ERR("queue depth must be zero or a power of two");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct ringbuf *tasks = pop->tx_params->post_commit_tasks;
+	if (tasks != NULL) {
+		/* the workers might still be waiting on a running queue */
+		if (!ringbuf_stopped(tasks)) {
+			ERR("post commit workers need to be stopped first");
+			errno = EBUSY;
+			return -1;
+		}
+
+		ringbuf_delete(tasks);
+		pop->tx_params->post_commit_tasks = NULL;
+	}
+
+	if (arg_in == 0)
+		return 0;
+
+	tasks = ringbuf_new((unsigned)arg_in);
+	if (tasks == NULL)
+		return -1;
+
+	pop->tx_params->post_commit_tasks = tasks;
+
 	return 0;
 }
 
@@ -2310,6 +2788,16 @@ static int
 CTL_READ_HANDLER(worker)(void *ctx, enum ctl_query_source source,
 	void *arg, struct ctl_indexes *indexes)
 {
+	PMEMobjpool *pop = ctx;
+
+	struct ringbuf *tasks = pop->tx_params->post_commit_tasks;
+	if (tasks == NULL)
+		return 0;
+
+	struct lane_tx_runtime *lane;
+	while ((lane = ringbuf_dequeue(tasks)) != NULL)
+		tx_post_commit(pop, lane, 1);
+
 	return 0;
 }
 
@@ -2320,6 +2808,10 @@ static int
 CTL_READ_HANDLER(stop)(void *ctx, enum ctl_query_source source,
 	void *arg, struct ctl_indexes *indexes)
 {
+	PMEMobjpool *pop = ctx;
+
+	tx_post_commit_stop(pop);
+
 	return 0;
 }
 
@@ -43,6 +43,7 @@
 
 #define TX_DEFAULT_RANGE_CACHE_SIZE (1 << 15)
 #define TX_DEFAULT_RANGE_CACHE_THRESHOLD (1 << 12)
+#define TX_DEFAULT_RANGE_CACHE_RETAIN (8)
 
 #define TX_RANGE_MASK (8ULL - 1)
 #define TX_RANGE_MASK_LEGACY (32ULL - 1)
@@ -81,9 +82,16 @@ struct tx_parameters;
  */
 PMEMobjpool *tx_get_pop(void);
 
+/*
+ * Returns whether the object at the given offset is freed by the current
+ * transaction.
+ */
+int tx_frees(uint64_t off);
+
 void tx_ctl_register(PMEMobjpool *pop);
 
 struct tx_parameters *tx_params_new(void);
 void tx_params_delete(struct tx_parameters *tx_params);
+void tx_post_commit_stop(PMEMobjpool *pop);
 
 #endif
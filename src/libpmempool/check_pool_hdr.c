@@ -177,6 +177,23 @@ pool_hdr_preliminary_check(PMEMpoolcheck *ppc, location *loc)
 	return 0;
 }
 
+/*
+ * pool_hdr_expected -- (internal) return default pool header values expected
+ *	in the checked pool
+ *
+ * An obj pool with a non-default heap geometry has an additional incompat
+ * feature set.
+ */
+static void
+pool_hdr_expected(PMEMpoolcheck *ppc, struct pool_hdr *hdrp)
+{
+	pool_hdr_default(ppc->pool->params.type, hdrp);
+
+	if (ppc->pool->params.type == POOL_TYPE_OBJ &&
+	    !ppc->pool->params.obj.heap_geometry_default)
+		hdrp->incompat_features |= POOL_FEAT_HEAP_GEOMETRY;
+}
+
 /*
  * pool_hdr_default_check -- (internal) check some default values in pool header
  */
@@ -188,7 +205,7 @@ pool_hdr_default_check(PMEMpoolcheck *ppc, location *loc)
 	ASSERT(CHECK_IS(ppc, REPAIR));
 
 	struct pool_hdr def_hdr;
-	pool_hdr_default(ppc->pool->params.type, &def_hdr);
+	pool_hdr_expected(ppc, &def_hdr);
 
 	if (memcmp(loc->hdr.signature, def_hdr.signature, POOL_HDR_SIG_LEN)) {
 		CHECK_ASK(ppc, Q_DEFAULT_SIGNATURE,
@@ -243,7 +260,7 @@ pool_hdr_default_fix(PMEMpoolcheck *ppc, location *loc, uint32_t question,
 
 	ASSERTne(loc, NULL);
 	struct pool_hdr def_hdr;
-	pool_hdr_default(ppc->pool->params.type, &def_hdr);
+	pool_hdr_expected(ppc, &def_hdr);
 
 	switch (question) {
 	case Q_DEFAULT_SIGNATURE:
@@ -62,6 +62,7 @@
 #include "pool.h"
 #include "lane.h"
 #include "obj.h"
+#include "heap_layout.h"
 #include "btt.h"
 #include "cto.h"
 #include "file.h"
@@ -383,6 +384,19 @@ pool_params_parse(const PMEMpoolcheck *ppc, struct pool_params *params,
 		struct pmemobjpool *pop = addr;
 		memcpy(params->obj.layout, pop->layout,
 			PMEMOBJ_MAX_LAYOUT);
+
+		/* a heap that cannot be read is assumed to be the default */
+		params->obj.heap_geometry_default = 1;
+		if (pop->heap_offset < params->size &&
+		    params->size - pop->heap_offset >=
+		    sizeof(struct heap_header)) {
+			struct heap_header *hhdr = (struct heap_header *)
+				((uintptr_t)addr + pop->heap_offset);
+			params->obj.heap_geometry_default =
+				hhdr->chunksize == CHUNKSIZE &&
+				(hhdr->run_bitmap_nval == 0 ||
+				hhdr->run_bitmap_nval == MAX_BITMAP_VALUES);
+		}
 	} else if (params->type == POOL_TYPE_CTO) {
 		struct pmemcto *pcp = addr;
 		memcpy(params->cto.layout, pcp->layout,
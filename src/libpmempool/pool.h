@@ -74,6 +74,7 @@ struct pool_params {
 		} blk;
 		struct {
 			char layout[PMEMOBJ_MAX_LAYOUT];
+			int heap_geometry_default;
 		} obj;
 		struct {
 			char layout[PMEMCTO_MAX_LAYOUT];
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_alloc_batch.c -- tests for pmemobj_alloc_batch and pmemobj_xalloc_batch
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "alloc_batch"
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 4)
+
+#define NOBJS 100
+#define HUGE_SIZE (3 << 20) /* larger than the largest run */
+
+enum type {
+	TYPE_ROOT,
+	TYPE_DRAM,
+	TYPE_PMEM,
+	TYPE_CANCELED,
+	TYPE_ZERO,
+	TYPE_INVALID,
+};
+
+struct root {
+	PMEMoid oids[NOBJS];
+};
+
+struct constr_args {
+	size_t ncalls;
+	size_t fail_at;
+};
+
+/*
+ * constructor -- fills the object with a pattern, fails at the given call
+ */
+static int
+constructor(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	struct constr_args *args = arg;
+
+	if (args->ncalls++ == args->fail_at)
+		return 1;
+
+	size_t size = pmemobj_alloc_usable_size(pmemobj_oid(ptr));
+	pmemobj_memset_persist(pop, ptr, 0xc5, size);
+
+	return 0;
+}
+
+/*
+ * count_type -- returns the number of objects of the given type
+ */
+static size_t
+count_type(PMEMobjpool *pop, uint64_t type_num)
+{
+	size_t n = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		if (pmemobj_type_num(oid) == type_num)
+			n++;
+	}
+
+	return n;
+}
+
+/*
+ * check_objs -- verifies the objects of a batch
+ */
+static void
+check_objs(PMEMobjpool *pop, PMEMoid *oids, size_t *sizes, uint64_t type_num,
+	int pattern)
+{
+	for (size_t i = 0; i < NOBJS; ++i) {
+		UT_ASSERT(!OID_IS_NULL(oids[i]));
+		UT_ASSERTeq(pmemobj_pool_by_oid(oids[i]), pop);
+		UT_ASSERTeq(pmemobj_type_num(oids[i]), type_num);
+		UT_ASSERT(pmemobj_alloc_usable_size(oids[i]) >= sizes[i]);
+
+		char *data = pmemobj_direct(oids[i]);
+		for (size_t j = 0; j < sizes[i]; ++j)
+			UT_ASSERTeq(data[j], (char)pattern);
+
+		for (size_t j = 0; j < i; ++j)
+			UT_ASSERTne(oids[i].off, oids[j].off);
+	}
+
+	UT_ASSERTeq(count_type(pop, type_num), NOBJS);
+}
+
+/*
+ * test_dram_oids -- allocates a batch with the oids in volatile memory
+ */
+static void
+test_dram_oids(PMEMobjpool *pop, size_t *sizes)
+{
+	PMEMoid oids[NOBJS];
+	struct constr_args args = {0, SIZE_MAX};
+
+	int ret = pmemobj_alloc_batch(pop, oids, sizes, NOBJS, TYPE_DRAM,
+		constructor, &args);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(args.ncalls, NOBJS);
+
+	check_objs(pop, oids, sizes, TYPE_DRAM, 0xc5);
+}
+
+/*
+ * test_pmem_oids -- allocates a batch with the oids in the pool
+ */
+static void
+test_pmem_oids(PMEMobjpool *pop, size_t *sizes)
+{
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	UT_ASSERT(!OID_IS_NULL(root));
+	struct root *rootp = pmemobj_direct(root);
+
+	struct constr_args args = {0, SIZE_MAX};
+
+	int ret = pmemobj_alloc_batch(pop, rootp->oids, sizes, NOBJS,
+		TYPE_PMEM, constructor, &args);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(args.ncalls, NOBJS);
+
+	check_objs(pop, rootp->oids, sizes, TYPE_PMEM, 0xc5);
+}
+
+/*
+ * test_canceled -- verifies that a failed constructor cancels the entire batch
+ */
+static void
+test_canceled(PMEMobjpool *pop, size_t *sizes)
+{
+	PMEMoid oids[NOBJS];
+	for (size_t i = 0; i < NOBJS; ++i)
+		oids[i] = OID_NULL;
+
+	struct constr_args args = {0, NOBJS / 2};
+
+	int ret = pmemobj_alloc_batch(pop, oids, sizes, NOBJS, TYPE_CANCELED,
+		constructor, &args);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ECANCELED);
+	UT_ASSERTeq(args.ncalls, NOBJS / 2 + 1);
+
+	for (size_t i = 0; i < NOBJS; ++i)
+		UT_ASSERT(OID_IS_NULL(oids[i]));
+
+	UT_ASSERTeq(count_type(pop, TYPE_CANCELED), 0);
+
+	/* a batch that cannot fit in the pool is not allocated at all */
+	size_t big_sizes[NOBJS];
+	for (size_t i = 0; i < NOBJS; ++i)
+		big_sizes[i] = HUGE_SIZE;
+
+	ret = pmemobj_alloc_batch(pop, oids, big_sizes, NOBJS, TYPE_CANCELED,
+		NULL, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOMEM);
+
+	for (size_t i = 0; i < NOBJS; ++i)
+		UT_ASSERT(OID_IS_NULL(oids[i]));
+
+	UT_ASSERTeq(count_type(pop, TYPE_CANCELED), 0);
+}
+
+/*
+ * test_flags -- allocates a zeroed batch and verifies the argument checks
+ */
+static void
+test_flags(PMEMobjpool *pop, size_t *sizes)
+{
+	PMEMoid oids[NOBJS];
+
+	int ret = pmemobj_xalloc_batch(pop, oids, sizes, NOBJS, TYPE_ZERO,
+		POBJ_XALLOC_ZERO, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	check_objs(pop, oids, sizes, TYPE_ZERO, 0);
+
+	ret = pmemobj_xalloc_batch(pop, oids, sizes, NOBJS, TYPE_INVALID,
+		POBJ_XALLOC_ZERO << 8, NULL, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	size_t zero_sizes[2] = {64, 0};
+	ret = pmemobj_alloc_batch(pop, oids, zero_sizes, 2, TYPE_INVALID,
+		NULL, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = pmemobj_alloc_batch(pop, oids, sizes, 0, TYPE_INVALID,
+		NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	/* the sizes are never read if the batch is too large */
+	ret = pmemobj_alloc_batch(pop, oids, sizes, SIZE_MAX / 2, TYPE_INVALID,
+		NULL, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(count_type(pop, TYPE_INVALID), 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_alloc_batch");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	/* mix of sizes from different classes, with a single huge object */
+	size_t sizes[NOBJS];
+	for (size_t i = 0; i < NOBJS; ++i)
+		sizes[i] = 64 + (i % 10) * 1000;
+	sizes[NOBJS / 3] = HUGE_SIZE;
+
+	test_dram_oids(pop, sizes);
+	test_pmem_oids(pop, sizes);
+	test_canceled(pop, sizes);
+	test_flags(pop, sizes);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT), 1);
+
+	DONE(NULL);
+}
@@ -178,6 +178,29 @@ test_bucket_remove(void)
 	bucket_delete(b);
 }
 
+static void
+test_bucket_insert_blocks(void)
+{
+	struct bucket *b = bucket_new(container_new_test(), NULL);
+	UT_ASSERT(b != NULL);
+
+	struct memory_block m[2] = {
+		{TEST_CHUNK_ID, TEST_ZONE_ID, TEST_SIZE_IDX, TEST_BLOCK_OFF},
+		{TEST_CHUNK_ID + 1, TEST_ZONE_ID, TEST_SIZE_IDX, TEST_BLOCK_OFF},
+	};
+	m[0].m_ops = &mock_ops;
+	m[1].m_ops = &mock_ops;
+
+	/* the test container has no bulk insert, blocks go one by one */
+	UT_ASSERT(bucket_insert_blocks(b, m, 2) == 0);
+
+	struct memory_block r = MEMORY_BLOCK_NONE;
+	UT_ASSERT(b->c_ops->get_rm_bestfit(b->container, &r) == 0);
+	UT_ASSERT(r.chunk_id == TEST_CHUNK_ID + 1);
+
+	bucket_delete(b);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -185,6 +208,7 @@ main(int argc, char *argv[])
 
 	test_bucket_insert_get();
 	test_bucket_remove();
+	test_bucket_insert_blocks();
 
 	DONE(NULL);
 }
@@ -38,6 +38,9 @@
 
 #define LAYOUT "obj_ctl_alignment"
 
+#define HUGEPAGE_SIZE (2 << 20)
+#define HUGEPAGE_ALLOCS 8
+
 PMEMobjpool *pop;
 
 static void
@@ -51,6 +54,47 @@ test_fail(void)
 
 	int ret = pmemobj_ctl_set(pop, "heap.alloc_class.new.desc", &ac);
 	UT_ASSERTeq(ret, -1); /* unit_size must be multiple of alignment */
+
+	ac.unit_size = 3072;
+	ac.alignment = 768;
+
+	ret = pmemobj_ctl_set(pop, "heap.alloc_class.new.desc", &ac);
+	UT_ASSERTeq(ret, -1); /* alignment must be a power of two */
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+/*
+ * test_hugepage_aligned_allocs -- allocates more than a single block of
+ *	objects aligned to the size of a huge page, each filling an entire unit
+ */
+static void
+test_hugepage_aligned_allocs(void)
+{
+	struct pobj_alloc_class_desc ac;
+	ac.header_type = POBJ_HEADER_COMPACT;
+	ac.unit_size = HUGEPAGE_SIZE;
+	ac.units_per_block = 4;
+	ac.alignment = HUGEPAGE_SIZE;
+
+	int ret = pmemobj_ctl_set(pop, "heap.alloc_class.new.desc", &ac);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid oids[HUGEPAGE_ALLOCS];
+	for (int i = 0; i < HUGEPAGE_ALLOCS; ++i) {
+		ret = pmemobj_xalloc(pop, &oids[i], HUGEPAGE_SIZE - 16, 0,
+			POBJ_CLASS_ID(ac.class_id), NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+
+		void *ptr = pmemobj_direct(oids[i]);
+		UT_ASSERTeq((uintptr_t)ptr % HUGEPAGE_SIZE, 0);
+
+		/* the entire object must be located inside of the pool */
+		pmemobj_memset_persist(pop, ptr, 0xc5,
+			pmemobj_alloc_usable_size(oids[i]));
+	}
+
+	for (int i = 0; i < HUGEPAGE_ALLOCS; ++i)
+		pmemobj_free(&oids[i]);
 }
 
 static void
@@ -105,8 +149,11 @@ main(int argc, char *argv[])
 	test_aligned_allocs(1024, 512, POBJ_HEADER_NONE);
 	test_aligned_allocs(1024, 512, POBJ_HEADER_COMPACT);
 	test_aligned_allocs(64, 64, POBJ_HEADER_COMPACT);
+	test_hugepage_aligned_allocs();
 
 	pmemobj_close(pop);
 
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT), 1);
+
 	DONE(NULL);
 }
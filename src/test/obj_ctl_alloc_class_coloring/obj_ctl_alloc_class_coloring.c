@@ -0,0 +1,217 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_ctl_alloc_class_coloring.c -- tests for the cache coloring of
+ *	allocation classes
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_ctl_alloc_class_coloring"
+
+#define UNIT_SIZE 1024
+#define ALIGNED_UNIT_SIZE 16384
+#define ALIGNMENT 4096
+#define MAX_OBJS 4096
+
+static PMEMoid oids[MAX_OBJS];
+
+/*
+ * create_class -- creates a new allocation class, with or without coloring
+ */
+static unsigned
+create_class(PMEMobjpool *pop, size_t unit_size, size_t alignment,
+	int coloring)
+{
+	int ret = pmemobj_ctl_set(pop, "heap.alloc_class.coloring", &coloring);
+	UT_ASSERTeq(ret, 0);
+
+	struct pobj_alloc_class_desc ac;
+	ac.header_type = POBJ_HEADER_COMPACT;
+	ac.unit_size = unit_size;
+	ac.units_per_block = 100;
+	ac.alignment = alignment;
+
+	ret = pmemobj_ctl_set(pop, "heap.alloc_class.new.desc", &ac);
+	UT_ASSERTeq(ret, 0);
+
+	return ac.class_id;
+}
+
+/*
+ * class_colors -- returns the number of colors of the allocation class
+ */
+static int
+class_colors(PMEMobjpool *pop, unsigned class_id)
+{
+	char query[1024];
+	snprintf(query, 1024, "heap.alloc_class.%u.colors", class_id);
+
+	int colors;
+	int ret = pmemobj_ctl_get(pop, query, &colors);
+	UT_ASSERTeq(ret, 0);
+
+	return colors;
+}
+
+/*
+ * count_offsets -- allocates objects from the class and returns the number
+ *	of distinct positions of objects in relation to the unit size
+ */
+static unsigned
+count_offsets(PMEMobjpool *pop, unsigned class_id, size_t unit_size,
+	size_t alignment, size_t nobjs)
+{
+	UT_ASSERT(nobjs <= MAX_OBJS);
+
+	unsigned noffsets = 0;
+	size_t offsets[MAX_OBJS];
+
+	for (size_t i = 0; i < nobjs; ++i) {
+		int ret = pmemobj_xalloc(pop, &oids[i], unit_size - 16,
+			(uint64_t)class_id, POBJ_CLASS_ID(class_id),
+			NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+
+		uintptr_t ptr = (uintptr_t)pmemobj_direct(oids[i]);
+		if (alignment != 0)
+			UT_ASSERTeq(ptr % alignment, 0);
+
+		pmemobj_memset_persist(pop, (void *)ptr, 0xc5,
+			pmemobj_alloc_usable_size(oids[i]));
+
+		size_t offset = ptr % unit_size;
+		unsigned j;
+		for (j = 0; j < noffsets; ++j) {
+			if (offsets[j] == offset)
+				break;
+		}
+		if (j == noffsets)
+			offsets[noffsets++] = offset;
+	}
+
+	return noffsets;
+}
+
+/*
+ * count_objects -- returns the number of objects with the given type
+ */
+static size_t
+count_objects(PMEMobjpool *pop, uint64_t type_num, size_t usable_size)
+{
+	size_t n = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		if (pmemobj_type_num(oid) != type_num)
+			continue;
+
+		UT_ASSERTeq(pmemobj_alloc_usable_size(oid), usable_size);
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * free_objects -- frees all objects with the given type
+ */
+static void
+free_objects(PMEMobjpool *pop, uint64_t type_num)
+{
+	PMEMoid oid;
+	PMEMoid next;
+	POBJ_FOREACH_SAFE(pop, oid, next) {
+		if (pmemobj_type_num(oid) == type_num)
+			pmemobj_free(&oid);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_alloc_class_coloring");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop;
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 20,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int coloring;
+	int ret = pmemobj_ctl_get(pop, "heap.alloc_class.coloring", &coloring);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(coloring, 0);
+
+	unsigned plain = create_class(pop, UNIT_SIZE, 0, 0);
+	unsigned colored = create_class(pop, UNIT_SIZE, 0, 1);
+	unsigned aligned = create_class(pop, ALIGNED_UNIT_SIZE, ALIGNMENT, 1);
+
+	UT_ASSERTeq(class_colors(pop, plain), 0);
+	UT_ASSERTeq(class_colors(pop, colored), UNIT_SIZE / 64);
+	UT_ASSERTeq(class_colors(pop, aligned), ALIGNED_UNIT_SIZE / ALIGNMENT);
+
+	/* the objects of every class span multiple blocks */
+	UT_ASSERTeq(count_offsets(pop, plain, UNIT_SIZE, 0, 2048), 1);
+	UT_ASSERT(count_offsets(pop, colored, UNIT_SIZE, 0, 2048) > 1);
+	UT_ASSERT(count_offsets(pop, aligned, ALIGNED_UNIT_SIZE, ALIGNMENT,
+		128) > 1);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT), 1);
+
+	/* the colored objects can be found and freed without the classes */
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	UT_ASSERTeq(count_objects(pop, plain, UNIT_SIZE - 16), 2048);
+	UT_ASSERTeq(count_objects(pop, colored, UNIT_SIZE - 16), 2048);
+	UT_ASSERTeq(count_objects(pop, aligned, ALIGNED_UNIT_SIZE - 16), 128);
+
+	free_objects(pop, plain);
+	free_objects(pop, colored);
+	free_objects(pop, aligned);
+
+	UT_ASSERTeq(count_objects(pop, colored, UNIT_SIZE - 16), 0);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT), 1);
+
+	DONE(NULL);
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_ctl_arenas.c -- tests for the heap.arenas ctl entry points
+ */
+
+#include "unittest.h"
+
+#define NTHREADS 4
+
+static PMEMobjpool *pop;
+
+static os_mutex_t lock;
+static os_cond_t cond;
+static unsigned nready;
+static int finished;
+
+/*
+ * arena_thread_count -- returns the number of threads assigned to an arena
+ */
+static uint64_t
+arena_thread_count(unsigned arena_id)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "heap.arenas.%u.thread_count", arena_id);
+
+	uint64_t nthreads;
+	int ret = pmemobj_ctl_get(pop, name, &nthreads);
+	UT_ASSERTeq(ret, 0);
+
+	return nthreads;
+}
+
+/*
+ * arenas_thread_count -- returns the sum of threads assigned to all arenas
+ *	and the largest number of threads assigned to a single arena
+ */
+static uint64_t
+arenas_thread_count(unsigned narenas, uint64_t *max)
+{
+	uint64_t sum = 0;
+	*max = 0;
+
+	for (unsigned i = 0; i < narenas; ++i) {
+		uint64_t n = arena_thread_count(i);
+		sum += n;
+		if (n > *max)
+			*max = n;
+	}
+
+	return sum;
+}
+
+/*
+ * worker -- allocates an object and waits until the test is finished
+ */
+static void *
+worker(void *arg)
+{
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	os_mutex_lock(&lock);
+	nready++;
+	os_cond_broadcast(&cond);
+	while (!finished)
+		os_cond_wait(&cond, &lock);
+	os_mutex_unlock(&lock);
+
+	pmemobj_free(&oid);
+
+	return NULL;
+}
+
+/*
+ * test_count -- verifies changing the number of arenas
+ */
+static void
+test_count(void)
+{
+	int count;
+	int ret = pmemobj_ctl_get(pop, "heap.arenas.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(count > 0);
+
+	int new_count = 0;
+	ret = pmemobj_ctl_set(pop, "heap.arenas.count", &new_count);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	new_count = count + 2;
+	ret = pmemobj_ctl_set(pop, "heap.arenas.count", &new_count);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "heap.arenas.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, new_count);
+
+	UT_ASSERTeq(arena_thread_count((unsigned)count - 1), 0);
+
+	char name[64];
+	snprintf(name, sizeof(name), "heap.arenas.%d.thread_count", count);
+	uint64_t nthreads;
+	ret = pmemobj_ctl_get(pop, name, &nthreads);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOENT);
+
+	int node;
+	ret = pmemobj_ctl_get(pop, "heap.arenas.0.node", &node);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(node >= -1);
+
+	/* arenas are not destroyed when the count is lowered */
+	new_count = 1;
+	ret = pmemobj_ctl_set(pop, "heap.arenas.count", &new_count);
+	UT_ASSERTeq(ret, 0);
+
+	snprintf(name, sizeof(name), "heap.arenas.%d.thread_count", count - 1);
+	ret = pmemobj_ctl_get(pop, name, &nthreads);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * test_policy -- verifies that threads are spread evenly among the arenas
+ *	with the least used policy
+ */
+static void
+test_policy(void)
+{
+	enum pobj_arena_policy policy;
+	int ret = pmemobj_ctl_get(pop, "heap.arenas.policy", &policy);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(policy, POBJ_ARENA_POLICY_LEAST_USED);
+
+	policy = MAX_POBJ_ARENA_POLICIES;
+	ret = pmemobj_ctl_set(pop, "heap.arenas.policy", &policy);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	policy = POBJ_ARENA_POLICY_NUMA;
+	ret = pmemobj_ctl_set(pop, "heap.arenas.policy", &policy);
+	UT_ASSERTeq(ret, 0);
+
+	policy = POBJ_ARENA_POLICY_LEAST_USED;
+	ret = pmemobj_ctl_set(pop, "heap.arenas.policy", &policy);
+	UT_ASSERTeq(ret, 0);
+
+	/* one arena for each worker and one for the main thread */
+	int count = NTHREADS + 1;
+	ret = pmemobj_ctl_set(pop, "heap.arenas.count", &count);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid oid;
+	ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	os_thread_t threads[NTHREADS];
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_CREATE(&threads[i], NULL, worker, NULL);
+
+	os_mutex_lock(&lock);
+	while (nready != NTHREADS)
+		os_cond_wait(&cond, &lock);
+	os_mutex_unlock(&lock);
+
+	uint64_t max;
+	UT_ASSERTeq(arenas_thread_count((unsigned)count, &max), NTHREADS + 1);
+	UT_ASSERTeq(max, 1);
+
+	os_mutex_lock(&lock);
+	finished = 1;
+	os_cond_broadcast(&cond);
+	os_mutex_unlock(&lock);
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+
+	UT_ASSERTeq(arenas_thread_count((unsigned)count, &max), 1);
+
+	pmemobj_free(&oid);
+}
+
+/*
+ * test_config -- verifies the values set through the config
+ */
+static void
+test_config(void)
+{
+	int count;
+	int ret = pmemobj_ctl_get(pop, "heap.arenas.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, 3);
+
+	enum pobj_arena_policy policy;
+	ret = pmemobj_ctl_get(pop, "heap.arenas.policy", &policy);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(policy, POBJ_ARENA_POLICY_NUMA);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_arenas");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file-name a|c", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, "ctl", PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	os_mutex_init(&lock);
+	os_cond_init(&cond);
+
+	switch (argv[2][0]) {
+		case 'a':
+			test_count();
+			test_policy();
+			break;
+		case 'c':
+			test_config();
+			break;
+		default:
+			UT_FATAL("unknown test: %s", argv[2]);
+	}
+
+	os_cond_destroy(&cond);
+	os_mutex_destroy(&lock);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
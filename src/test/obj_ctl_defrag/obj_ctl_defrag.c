@@ -0,0 +1,365 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_ctl_defrag.c -- tests for the heap.defrag ctl entry points
+ */
+
+#include "unittest.h"
+
+#define NOBJS 8192
+#define OBJ_SIZE 128
+#define KEEP_EVERY 8
+
+static PMEMobjpool *pop;
+
+struct object {
+	uint64_t id;
+	char data[OBJ_SIZE - sizeof(uint64_t)];
+};
+
+/* transient references to the objects, updated on every relocation */
+static PMEMoid oids[NOBJS];
+static os_mutex_t lock;
+
+/*
+ * relocate -- updates the reference to the relocated object
+ */
+static int
+relocate(PMEMobjpool *p, PMEMoid oldoid, PMEMoid newoid, void *arg)
+{
+	UT_ASSERTeq(p, pop);
+	UT_ASSERTeq(arg, oids);
+	UT_ASSERT(!OID_EQUALS(oldoid, newoid));
+	UT_ASSERT(pmemobj_alloc_usable_size(newoid) >=
+		pmemobj_alloc_usable_size(oldoid));
+	UT_ASSERTeq(pmemobj_type_num(newoid), pmemobj_type_num(oldoid));
+
+	struct object *obj = pmemobj_direct(oldoid);
+	UT_ASSERT(obj->id < NOBJS);
+
+	os_mutex_lock(&lock);
+	UT_ASSERT(OID_EQUALS(oids[obj->id], oldoid));
+	oids[obj->id] = newoid;
+	os_mutex_unlock(&lock);
+
+	return 0;
+}
+
+/*
+ * relocate_free -- frees some of the objects instead of relocating them,
+ *	either atomically or transactionally
+ */
+static int
+relocate_free(PMEMobjpool *p, PMEMoid oldoid, PMEMoid newoid, void *arg)
+{
+	struct object *obj = pmemobj_direct(oldoid);
+	uint64_t id = obj->id;
+
+	switch (id / KEEP_EVERY % 3) {
+		case 0:
+			UT_ASSERTeq(pmemobj_tx_free(oldoid), 0);
+			break;
+		case 1:
+			pmemobj_free(&oldoid);
+			break;
+		default:
+			return relocate(p, oldoid, newoid, arg);
+	}
+
+	os_mutex_lock(&lock);
+	oids[id] = OID_NULL;
+	os_mutex_unlock(&lock);
+
+	return 0;
+}
+
+/*
+ * fragment -- allocates objects and frees most of them, leaving the runs
+ *	sparsely populated
+ */
+static void
+fragment(void)
+{
+	for (uint64_t i = 0; i < NOBJS; ++i) {
+		int ret = pmemobj_alloc(pop, &oids[i], sizeof(struct object),
+			(uint64_t)i % 4, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+
+		struct object *obj = pmemobj_direct(oids[i]);
+		obj->id = i;
+		memset(obj->data, (int)(i & 0xff), sizeof(obj->data));
+		pmemobj_persist(pop, obj, sizeof(*obj));
+	}
+
+	for (uint64_t i = 0; i < NOBJS; ++i) {
+		if (i % KEEP_EVERY != 0)
+			pmemobj_free(&oids[i]);
+	}
+}
+
+/*
+ * verify -- checks the contents of the remaining objects
+ */
+static void
+verify(void)
+{
+	for (uint64_t i = 0; i < NOBJS; i += KEEP_EVERY) {
+		if (OID_IS_NULL(oids[i]))
+			continue;
+
+		struct object *obj = pmemobj_direct(oids[i]);
+		UT_ASSERTeq(obj->id, i);
+		UT_ASSERTeq(pmemobj_type_num(oids[i]), i % 4);
+		for (size_t j = 0; j < sizeof(obj->data); ++j)
+			UT_ASSERTeq(obj->data[j], (char)(i & 0xff));
+	}
+}
+
+/*
+ * relocated_objects -- returns the number of relocated objects
+ */
+static uint64_t
+relocated_objects(void)
+{
+	uint64_t relocated;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.defrag_relocated",
+		&relocated);
+	UT_ASSERTeq(ret, 0);
+
+	return relocated;
+}
+
+/*
+ * test_params -- verifies the validation of defragmentation parameters
+ */
+static void
+test_params(void)
+{
+	int ret = pmemobj_ctl_exec(pop, "heap.defrag.run", NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	int enabled = 1;
+	ret = pmemobj_ctl_set(pop, "heap.defrag.enabled", &enabled);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = pmemobj_ctl_get(pop, "heap.defrag.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	int threshold;
+	ret = pmemobj_ctl_get(pop, "heap.defrag.threshold", &threshold);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(threshold, 50);
+
+	threshold = 0;
+	ret = pmemobj_ctl_set(pop, "heap.defrag.threshold", &threshold);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	threshold = 101;
+	ret = pmemobj_ctl_set(pop, "heap.defrag.threshold", &threshold);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	int interval = 0;
+	ret = pmemobj_ctl_set(pop, "heap.defrag.interval", &interval);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+/*
+ * test_run -- verifies a single defragmentation pass
+ */
+static void
+test_run(void)
+{
+	struct pobj_defrag_callback cb = {relocate, oids};
+	int ret = pmemobj_ctl_set(pop, "heap.defrag.callback", &cb);
+	UT_ASSERTeq(ret, 0);
+
+	/* relocations are not allowed inside of a transaction */
+	TX_BEGIN(pop) {
+		ret = pmemobj_ctl_exec(pop, "heap.defrag.run", NULL);
+		UT_ASSERTeq(ret, -1);
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_END
+
+	ret = pmemobj_ctl_exec(pop, "heap.defrag.run", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	verify();
+
+	UT_ASSERT(relocated_objects() > 0);
+
+	uint64_t reclaimed;
+	ret = pmemobj_ctl_get(pop, "stats.heap.defrag_reclaimed", &reclaimed);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(reclaimed > 0);
+
+	/* the remaining runs are dense enough */
+	uint64_t relocated = relocated_objects();
+	ret = pmemobj_ctl_exec(pop, "heap.defrag.run", NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(relocated_objects(), relocated);
+
+	verify();
+}
+
+/*
+ * test_free -- verifies that objects freed by the callback are skipped
+ */
+static void
+test_free(void)
+{
+	struct pobj_defrag_callback cb = {relocate_free, oids};
+	int ret = pmemobj_ctl_set(pop, "heap.defrag.callback", &cb);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_exec(pop, "heap.defrag.run", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	UT_ASSERT(relocated_objects() > 0);
+
+	verify();
+
+	/* every object is either freed once or relocated once */
+	size_t left = 0;
+	for (uint64_t i = 0; i < NOBJS; i += KEEP_EVERY) {
+		if (!OID_IS_NULL(oids[i]))
+			left++;
+	}
+
+	size_t nobjs = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid)
+		nobjs++;
+
+	UT_ASSERTeq(nobjs, left);
+	UT_ASSERT(left < NOBJS / KEEP_EVERY);
+}
+
+/*
+ * test_worker -- verifies background defragmentation
+ */
+static void
+test_worker(void)
+{
+	int threshold;
+	int ret = pmemobj_ctl_get(pop, "heap.defrag.threshold", &threshold);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(threshold, 80);
+
+	int interval;
+	ret = pmemobj_ctl_get(pop, "heap.defrag.interval", &interval);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(interval, 10);
+
+	struct pobj_defrag_callback cb = {relocate, oids};
+	ret = pmemobj_ctl_set(pop, "heap.defrag.callback", &cb);
+	UT_ASSERTeq(ret, 0);
+
+	int enabled = 1;
+	ret = pmemobj_ctl_set(pop, "heap.defrag.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	/* the callback cannot be removed while the worker is running */
+	struct pobj_defrag_callback nocb = {NULL, NULL};
+	ret = pmemobj_ctl_set(pop, "heap.defrag.callback", &nocb);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EBUSY);
+
+	while (relocated_objects() == 0)
+		usleep(1000);
+
+	enabled = 0;
+	ret = pmemobj_ctl_set(pop, "heap.defrag.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "heap.defrag.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	verify();
+
+	/* the worker is stopped when the pool is closed */
+	enabled = 1;
+	ret = pmemobj_ctl_set(pop, "heap.defrag.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_defrag");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file-name r|f|w", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, "ctl", PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	os_mutex_init(&lock);
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	switch (argv[2][0]) {
+		case 'r':
+			test_params();
+			fragment();
+			test_run();
+			break;
+		case 'f':
+			fragment();
+			test_free();
+			break;
+		case 'w':
+			fragment();
+			test_worker();
+			break;
+		default:
+			UT_FATAL("unknown test: %s", argv[2]);
+	}
+
+	pmemobj_close(pop);
+
+	os_mutex_destroy(&lock);
+
+	DONE(NULL);
+}
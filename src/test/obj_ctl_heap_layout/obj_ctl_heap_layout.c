@@ -0,0 +1,284 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_ctl_heap_layout.c -- tests for the heap.layout ctl entry points
+ */
+
+#include "pool_hdr.h"
+#include "unittest.h"
+
+#define LAYOUT "ctl"
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 8)
+
+#define DEFAULT_CHUNK_SIZE (256 << 10)
+#define DEFAULT_RUN_BITMAP_SIZE (38 * 64)
+
+#define CHUNK_SIZE (1 << 20)
+#define RUN_BITMAP_SIZE 4096
+#define RUN_BITMAP_SIZE_ROUNDED (70 * 64) /* metadata aligned to cachelines */
+
+#define HUGE_SIZE ((3 << 20) + 1) /* larger than the largest run */
+#define SMALL_SIZE 64
+#define NSMALL 10000
+
+/*
+ * layout_get -- reads one of the heap.layout entry points
+ */
+static ssize_t
+layout_get(const char *name)
+{
+	ssize_t value;
+	int ret = pmemobj_ctl_get(NULL, name, &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * layout_set -- writes one of the heap.layout entry points
+ */
+static int
+layout_set(const char *name, ssize_t value)
+{
+	return pmemobj_ctl_set(NULL, name, &value);
+}
+
+/*
+ * layout_set_invalid -- verifies that an invalid value is rejected
+ */
+static void
+layout_set_invalid(const char *name, ssize_t value)
+{
+	int ret = layout_set(name, value);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+/*
+ * check_huge -- verifies that huge blocks are made of chunks of given size
+ */
+static void
+check_huge(PMEMobjpool *pop, size_t chunk_size)
+{
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, HUGE_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	size_t real_size = pmemobj_alloc_usable_size(oid) + 16;
+	UT_ASSERTeq(real_size % chunk_size, 0);
+	UT_ASSERTeq(real_size / chunk_size, (HUGE_SIZE + 16 + chunk_size - 1) /
+		chunk_size);
+
+	pmemobj_free(&oid);
+}
+
+/*
+ * check_incompat -- verifies whether the pool is marked as incompatible with
+ *	libraries that only know the default heap layout
+ */
+static void
+check_incompat(const char *path, int expected)
+{
+	struct pool_hdr hdr;
+
+	int fd = OPEN(path, O_RDONLY);
+	UT_ASSERTeq(READ(fd, &hdr, sizeof(hdr)), sizeof(hdr));
+	CLOSE(fd);
+
+	uint32_t incompat = le32toh(hdr.incompat_features);
+
+	UT_ASSERTeq(!!(incompat & POOL_FEAT_HEAP_GEOMETRY), expected);
+}
+
+/*
+ * fill_small -- allocates small objects and stores their index in them
+ */
+static void
+fill_small(PMEMobjpool *pop)
+{
+	for (uint64_t i = 0; i < NSMALL; ++i) {
+		PMEMoid oid;
+		int ret = pmemobj_alloc(pop, &oid, SMALL_SIZE, 1, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+
+		uint64_t *data = pmemobj_direct(oid);
+		*data = i;
+		pmemobj_persist(pop, data, sizeof(*data));
+	}
+}
+
+/*
+ * check_small -- verifies the objects allocated by fill_small
+ */
+static void
+check_small(PMEMobjpool *pop)
+{
+	int *found = ZALLOC(sizeof(int) * NSMALL);
+
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		if (pmemobj_type_num(oid) != 1)
+			continue;
+
+		uint64_t *data = pmemobj_direct(oid);
+		UT_ASSERT(*data < NSMALL);
+		UT_ASSERTeq(found[*data], 0);
+		found[*data] = 1;
+	}
+
+	for (int i = 0; i < NSMALL; ++i)
+		UT_ASSERTeq(found[i], 1);
+
+	FREE(found);
+}
+
+/*
+ * test_runtime -- changes the layout of new heaps through the ctl interface
+ */
+static void
+test_runtime(const char *path)
+{
+	UT_ASSERTeq(layout_get("heap.layout.chunk_size"), DEFAULT_CHUNK_SIZE);
+	UT_ASSERTeq(layout_get("heap.layout.run_bitmap_size"),
+		DEFAULT_RUN_BITMAP_SIZE);
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	pmemobj_close(pop);
+	check_incompat(path, 0);
+	UNLINK(path);
+
+	layout_set_invalid("heap.layout.chunk_size", -1);
+	layout_set_invalid("heap.layout.chunk_size", 0);
+	layout_set_invalid("heap.layout.chunk_size", DEFAULT_CHUNK_SIZE / 2);
+	layout_set_invalid("heap.layout.chunk_size", CHUNK_SIZE + 4096);
+	layout_set_invalid("heap.layout.chunk_size", 32 << 20);
+	layout_set_invalid("heap.layout.run_bitmap_size", 0);
+	layout_set_invalid("heap.layout.run_bitmap_size", 1022 * 64 + 1);
+
+	UT_ASSERTeq(layout_get("heap.layout.chunk_size"), DEFAULT_CHUNK_SIZE);
+	UT_ASSERTeq(layout_get("heap.layout.run_bitmap_size"),
+		DEFAULT_RUN_BITMAP_SIZE);
+
+	/* smaller bitmaps are rounded up to the default */
+	UT_ASSERTeq(layout_set("heap.layout.run_bitmap_size", 1), 0);
+	UT_ASSERTeq(layout_get("heap.layout.run_bitmap_size"),
+		DEFAULT_RUN_BITMAP_SIZE);
+
+	UT_ASSERTeq(layout_set("heap.layout.chunk_size", CHUNK_SIZE), 0);
+	UT_ASSERTeq(layout_set("heap.layout.run_bitmap_size",
+		RUN_BITMAP_SIZE), 0);
+	UT_ASSERTeq(layout_get("heap.layout.chunk_size"), CHUNK_SIZE);
+	UT_ASSERTeq(layout_get("heap.layout.run_bitmap_size"),
+		RUN_BITMAP_SIZE_ROUNDED);
+
+	pop = pmemobj_create(path, LAYOUT, POOL_SIZE, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	check_huge(pop, CHUNK_SIZE);
+	fill_small(pop);
+	check_small(pop);
+
+	pmemobj_close(pop);
+	check_incompat(path, 1);
+
+	/* the layout of existing heaps is read from their header */
+	UT_ASSERTeq(layout_set("heap.layout.chunk_size",
+		DEFAULT_CHUNK_SIZE), 0);
+	UT_ASSERTeq(layout_set("heap.layout.run_bitmap_size",
+		DEFAULT_RUN_BITMAP_SIZE), 0);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	check_small(pop);
+	check_huge(pop, CHUNK_SIZE);
+	fill_small(pop);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT), 1);
+}
+
+/*
+ * test_config -- creates a heap with the layout set through the config
+ */
+static void
+test_config(const char *path)
+{
+	UT_ASSERTeq(layout_get("heap.layout.chunk_size"), CHUNK_SIZE);
+	UT_ASSERTeq(layout_get("heap.layout.run_bitmap_size"),
+		RUN_BITMAP_SIZE_ROUNDED);
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	check_huge(pop, CHUNK_SIZE);
+	fill_small(pop);
+	check_small(pop);
+
+	pmemobj_close(pop);
+	check_incompat(path, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_heap_layout");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file-name r|c", argv[0]);
+
+	const char *path = argv[1];
+
+	switch (argv[2][0]) {
+		case 'r':
+			test_runtime(path);
+			break;
+		case 'c':
+			test_config(path);
+			break;
+		default:
+			UT_FATAL("unknown test: %s", argv[2]);
+	}
+
+	DONE(NULL);
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_ctl_huge_container.c -- tests for the heap.huge_container ctl entry point
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "ctl"
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 8)
+#define HUGE_SIZE (3 << 20) /* larger than the largest run */
+#define MAX_OBJS (POOL_SIZE / HUGE_SIZE)
+
+static PMEMobjpool *pop;
+static PMEMoid oids[MAX_OBJS];
+
+/*
+ * huge_container -- returns the type of the container of free huge blocks
+ */
+static enum pobj_huge_container
+huge_container(void)
+{
+	enum pobj_huge_container type;
+	int ret = pmemobj_ctl_get(pop, "heap.huge_container", &type);
+	UT_ASSERTeq(ret, 0);
+
+	return type;
+}
+
+/*
+ * set_huge_container -- changes the container of free huge blocks
+ */
+static void
+set_huge_container(enum pobj_huge_container type)
+{
+	int ret = pmemobj_ctl_set(pop, "heap.huge_container", &type);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(huge_container(), type);
+}
+
+/*
+ * alloc_all -- allocates huge objects until the pool is exhausted
+ */
+static int
+alloc_all(void)
+{
+	int n = 0;
+	while (n < MAX_OBJS &&
+		pmemobj_alloc(pop, &oids[n], HUGE_SIZE, 0, NULL, NULL) == 0)
+		n++;
+
+	return n;
+}
+
+/*
+ * test_fragmented -- frees every other huge object, replaces the container
+ *	and frees the rest, which must coalesce the free blocks back into one
+ */
+static void
+test_fragmented(enum pobj_huge_container other)
+{
+	enum pobj_huge_container type = huge_container();
+
+	int n = alloc_all();
+	UT_ASSERT(n > 2);
+
+	for (int i = 0; i < n; i += 2)
+		pmemobj_free(&oids[i]);
+
+	set_huge_container(other);
+
+	/* the freed blocks have to be found in the new container */
+	int nfreed = (n + 1) / 2;
+	for (int i = 0; i < nfreed; ++i) {
+		int ret = pmemobj_alloc(pop, &oids[i * 2], HUGE_SIZE, 0,
+			NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	set_huge_container(type);
+
+	for (int i = 0; i < n; ++i)
+		pmemobj_free(&oids[i]);
+
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, (size_t)n * HUGE_SIZE, 0,
+		NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+}
+
+/*
+ * test_runtime -- verifies replacing the container in a running pool
+ */
+static void
+test_runtime(void)
+{
+	UT_ASSERTeq(huge_container(), POBJ_HUGE_CONTAINER_RAVL);
+
+	int n = alloc_all();
+	for (int i = 0; i < n; ++i)
+		pmemobj_free(&oids[i]);
+
+	set_huge_container(POBJ_HUGE_CONTAINER_BITMAP);
+
+	/* both containers must be able to serve the same amount of memory */
+	int nbitmap = alloc_all();
+	UT_ASSERTeq(nbitmap, n);
+	for (int i = 0; i < nbitmap; ++i)
+		pmemobj_free(&oids[i]);
+
+	test_fragmented(POBJ_HUGE_CONTAINER_RAVL);
+
+	enum pobj_huge_container invalid = MAX_POBJ_HUGE_CONTAINERS;
+	int ret = pmemobj_ctl_set(pop, "heap.huge_container", &invalid);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+	UT_ASSERTeq(huge_container(), POBJ_HUGE_CONTAINER_BITMAP);
+}
+
+/*
+ * test_config -- verifies the container selected through the config
+ */
+static void
+test_config(void)
+{
+	UT_ASSERTeq(huge_container(), POBJ_HUGE_CONTAINER_BITMAP);
+
+	test_fragmented(POBJ_HUGE_CONTAINER_RAVL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_huge_container");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file-name r|c", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, POOL_SIZE,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	switch (argv[2][0]) {
+		case 'r':
+			test_runtime();
+			break;
+		case 'c':
+			test_config();
+			break;
+		default:
+			UT_FATAL("unknown test: %s", argv[2]);
+	}
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
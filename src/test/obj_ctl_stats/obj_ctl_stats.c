@@ -36,6 +36,155 @@
 
 #include "unittest.h"
 
+#define POOL_SIZE (PMEMOBJ_MIN_POOL * 4)
+
+#define NOBJS 100
+#define UNIT_SIZE 128
+
+/* larger than the biggest run, so that it is allocated from whole chunks */
+#define HUGE_SIZE (3 << 20)
+
+/*
+ * test_class_stats -- verifies the usage of a custom allocation class
+ */
+static void
+test_class_stats(PMEMobjpool *pop)
+{
+	struct pobj_alloc_class_desc desc;
+	desc.header_type = POBJ_HEADER_NONE;
+	desc.unit_size = UNIT_SIZE;
+	desc.units_per_block = 1000;
+	desc.alignment = 0;
+
+	int ret = pmemobj_ctl_set(pop, "heap.alloc_class.new.desc", &desc);
+	UT_ASSERTeq(ret, 0);
+
+	char name[64];
+	uint64_t allocated;
+	uint64_t free;
+	uint64_t runs;
+	struct pobj_stats_run_fill fill;
+
+	snprintf(name, sizeof(name), "stats.heap.alloc_class.%u.runs",
+		desc.class_id);
+	ret = pmemobj_ctl_get(pop, name, &runs);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(runs, 0);
+
+	PMEMoid oids[NOBJS];
+	for (int i = 0; i < NOBJS; ++i) {
+		ret = pmemobj_xalloc(pop, &oids[i], UNIT_SIZE, 0,
+			POBJ_CLASS_ID(desc.class_id), NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	snprintf(name, sizeof(name), "stats.heap.alloc_class.%u.allocated",
+		desc.class_id);
+	ret = pmemobj_ctl_get(pop, name, &allocated);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(allocated, NOBJS * UNIT_SIZE);
+
+	snprintf(name, sizeof(name), "stats.heap.alloc_class.%u.free",
+		desc.class_id);
+	ret = pmemobj_ctl_get(pop, name, &free);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTne(free, 0);
+
+	snprintf(name, sizeof(name), "stats.heap.alloc_class.%u.runs",
+		desc.class_id);
+	ret = pmemobj_ctl_get(pop, name, &runs);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(runs, 1);
+
+	/* the only run is at least 1000 units long, so it's less than 10% full */
+	snprintf(name, sizeof(name), "stats.heap.alloc_class.%u.run_fill",
+		desc.class_id);
+	ret = pmemobj_ctl_get(pop, name, &fill);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(fill.runs[0], 1);
+	for (int i = 1; i < POBJ_STATS_RUN_FILL_BUCKETS; ++i)
+		UT_ASSERTeq(fill.runs[i], 0);
+
+	uint64_t pending;
+	snprintf(name, sizeof(name),
+		"stats.heap.alloc_class.%u.recycler_pending", desc.class_id);
+	ret = pmemobj_ctl_get(pop, name, &pending);
+	UT_ASSERTeq(ret, 0);
+
+	for (int i = 0; i < NOBJS; ++i)
+		pmemobj_free(&oids[i]);
+
+	snprintf(name, sizeof(name), "stats.heap.alloc_class.%u.allocated",
+		desc.class_id);
+	ret = pmemobj_ctl_get(pop, name, &allocated);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(allocated, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.heap.alloc_class.254.allocated",
+		&allocated);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOENT);
+
+	ret = pmemobj_ctl_get(pop, "stats.heap.alloc_class.255.allocated",
+		&allocated);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ERANGE);
+}
+
+/*
+ * test_huge_stats -- verifies the usage of huge chunks
+ */
+static void
+test_huge_stats(PMEMobjpool *pop)
+{
+	struct pobj_stats_huge_free hist;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.huge_free", &hist);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t nfree = 0;
+	for (int i = 0; i < POBJ_STATS_HUGE_FREE_BUCKETS; ++i)
+		nfree += hist.blocks[i];
+	UT_ASSERTne(nfree, 0);
+
+	uint64_t allocated_before;
+	ret = pmemobj_ctl_get(pop, "stats.heap.alloc_class.0.allocated",
+		&allocated_before);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid oid;
+	ret = pmemobj_alloc(pop, &oid, HUGE_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	uint64_t allocated;
+	ret = pmemobj_ctl_get(pop, "stats.heap.alloc_class.0.allocated",
+		&allocated);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(allocated >= allocated_before + HUGE_SIZE);
+
+	pmemobj_free(&oid);
+}
+
+/*
+ * test_contention_stats -- verifies reading the lock contention counters
+ */
+static void
+test_contention_stats(PMEMobjpool *pop)
+{
+	uint64_t contention;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.global_lock_contention",
+		&contention);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.heap.arenas.0.lock_contention",
+		&contention);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.heap.arenas.100000.lock_contention",
+		&contention);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOENT);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -47,7 +196,7 @@ main(int argc, char *argv[])
 	const char *path = argv[1];
 
 	PMEMobjpool *pop;
-	if ((pop = pmemobj_create(path, "ctl", PMEMOBJ_MIN_POOL,
+	if ((pop = pmemobj_create(path, "ctl", POOL_SIZE,
 		S_IWUSR | S_IRUSR)) == NULL)
 		UT_FATAL("!pmemobj_create: %s", path);
 
@@ -82,6 +231,10 @@ main(int argc, char *argv[])
 	UT_ASSERTeq(ret, 0);
 	UT_ASSERTeq(allocated, 0);
 
+	test_class_stats(pop);
+	test_huge_stats(pop);
+	test_contention_stats(pop);
+
 	pmemobj_close(pop);
 
 	DONE(NULL);
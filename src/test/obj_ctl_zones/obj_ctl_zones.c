@@ -0,0 +1,232 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_ctl_zones.c -- tests for the heap.zones ctl entry points
+ */
+
+#include "obj.h"
+#include "heap_layout.h"
+#include "unittest.h"
+
+#define LAYOUT "ctl"
+
+static PMEMobjpool *pop;
+
+/*
+ * zones_loaded -- returns the number of zones loaded by the allocator
+ */
+static int
+zones_loaded(void)
+{
+	int loaded;
+	int ret = pmemobj_ctl_get(pop, "heap.zones.loaded", &loaded);
+	UT_ASSERTeq(ret, 0);
+
+	return loaded;
+}
+
+/*
+ * zones_prefetch -- returns whether the zones are loaded in the background
+ */
+static int
+zones_prefetch(void)
+{
+	int prefetch;
+	int ret = pmemobj_ctl_get(pop, "heap.zones.prefetch", &prefetch);
+	UT_ASSERTeq(ret, 0);
+
+	return prefetch;
+}
+
+/*
+ * wait_zones_loaded -- waits until the prefetcher loads the only zone
+ */
+static void
+wait_zones_loaded(void)
+{
+	while (zones_loaded() != 1)
+		usleep(1000);
+}
+
+/*
+ * test_lazy -- verifies that the zones are loaded on the first allocation
+ */
+static void
+test_lazy(const char *path)
+{
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	UT_ASSERTeq(zones_loaded(), 0);
+
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	UT_ASSERTeq(zones_loaded(), 1);
+
+	pmemobj_free(&oid);
+}
+
+/*
+ * test_prefetch -- verifies starting and stopping the prefetcher
+ */
+static void
+test_prefetch(const char *path)
+{
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	UT_ASSERTeq(zones_prefetch(), 0);
+
+	int prefetch = 1;
+	int ret = pmemobj_ctl_set(pop, "heap.zones.prefetch", &prefetch);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(zones_prefetch(), 1);
+
+	wait_zones_loaded();
+
+	prefetch = 0;
+	ret = pmemobj_ctl_set(pop, "heap.zones.prefetch", &prefetch);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(zones_prefetch(), 0);
+
+	/* all zones are loaded, allocation must not load any more */
+	PMEMoid oid;
+	ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	UT_ASSERTeq(zones_loaded(), 1);
+
+	pmemobj_free(&oid);
+}
+
+/*
+ * test_config -- verifies the prefetcher started through the config
+ */
+static void
+test_config(void)
+{
+	UT_ASSERTeq(zones_prefetch(), 1);
+
+	wait_zones_loaded();
+
+	/* the prefetcher is stopped when the pool is closed */
+}
+
+/*
+ * test_corrupted -- verifies that a corrupted zone makes both the allocation
+ *	and the iteration over the objects fail
+ */
+static void
+test_corrupted(const char *path)
+{
+	PMEMoid oid;
+	int ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	UT_ASSERTeq(zones_loaded(), 0);
+
+	/* a chunk of size 0 would make any traversal of the zone loop */
+	struct heap_layout *layout =
+		(struct heap_layout *)((char *)pop + pop->heap_offset);
+	struct chunk_header *hdr = GET_CHUNK_HDR(layout, 0, 0);
+	hdr->size_idx = 0;
+	pmemobj_persist(pop, hdr, sizeof(*hdr));
+
+	errno = 0;
+	oid = pmemobj_first(pop);
+	UT_ASSERT(OID_IS_NULL(oid));
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(zones_loaded(), 0);
+
+	pmemobj_close(pop);
+
+	ret = pmemobj_check(path, LAYOUT);
+	UT_ASSERTeq(ret, 0);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_zones");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file-name l|p|c", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	switch (argv[2][0]) {
+		case 'l':
+			test_lazy(path);
+			test_prefetch(path);
+			break;
+		case 'p':
+			test_config();
+			break;
+		case 'c':
+			test_corrupted(path);
+			break;
+		default:
+			UT_FATAL("unknown test: %s", argv[2]);
+	}
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -128,13 +128,19 @@ init_run_with_max_block(struct heap_layout *l, uint32_t chunk_id)
 static void
 test_alloc_class_bitmap_correctness(void)
 {
+	struct alloc_class_collection *ac =
+		alloc_class_collection_new(CHUNKSIZE, MAX_BITMAP_VALUES);
+	UT_ASSERTne(ac, NULL);
+
 	struct alloc_class_run_proto proto;
-	alloc_class_generate_run_proto(&proto, RUNSIZE / 10, 1, 0);
+	alloc_class_generate_run_proto(ac, &proto, RUNSIZE / 10, 1, 0, 0);
 	/* 54 set (not available for allocations), and 10 clear (available) */
 	uint64_t bitmap_lastval =
 	0b1111111111111111111111111111111111111111111111111111110000000000;
 
 	UT_ASSERTeq(proto.bitmap_lastval, bitmap_lastval);
+
+	alloc_class_collection_delete(ac);
 }
 
 static void
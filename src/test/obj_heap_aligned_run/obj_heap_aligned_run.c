@@ -0,0 +1,217 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_heap_aligned_run.c -- tests for runs of aligned allocation classes
+ *	created before the end of the run was reserved for the alignment padding
+ */
+
+#include "obj.h"
+#include "heap_layout.h"
+#include "unittest.h"
+
+#define LAYOUT "aligned_run"
+
+/*
+ * The unit size and alignment are chosen so that reserving 'alignment' bytes
+ * at the end of a run in the default geometry leaves one unit fewer.
+ */
+#define UNIT_SIZE 1024
+#define ALIGNMENT 1024
+#define OBJ_SIZE 512
+#define HUGE_SIZE (1 << 20)
+
+static PMEMobjpool *pop;
+
+/*
+ * create_class -- creates the aligned allocation class
+ */
+static unsigned
+create_class(void)
+{
+	struct pobj_alloc_class_desc ac;
+	ac.header_type = POBJ_HEADER_COMPACT;
+	ac.unit_size = UNIT_SIZE;
+	ac.units_per_block = 100;
+	ac.alignment = ALIGNMENT;
+
+	int ret = pmemobj_ctl_set(pop, "heap.alloc_class.new.desc", &ac);
+	UT_ASSERTeq(ret, 0);
+
+	return ac.class_id;
+}
+
+/*
+ * run_hdr -- returns the chunk header of the run which contains the object
+ */
+static struct chunk_header *
+run_hdr(PMEMoid oid)
+{
+	struct heap_layout *layout =
+		(struct heap_layout *)((char *)pop + pop->heap_offset);
+	struct zone *z = ZID_TO_ZONE(layout, 0);
+
+	uintptr_t off = (uintptr_t)pmemobj_direct(oid) - (uintptr_t)z->chunks;
+	unsigned chunk_id = (unsigned)(off / HEAP_CHUNKSIZE(layout));
+
+	struct chunk_header *hdr = &z->chunk_headers[chunk_id];
+	if (hdr->type == CHUNK_TYPE_RUN_DATA)
+		hdr -= hdr->size_idx;
+
+	UT_ASSERTeq(hdr->type, CHUNK_TYPE_RUN);
+
+	return hdr;
+}
+
+/*
+ * make_old_layout -- turns the run into one written before the end of
+ *	aligned runs was reserved, in which the units span the whole run
+ */
+static void
+make_old_layout(struct chunk_header *hdr)
+{
+	struct heap_layout *layout =
+		(struct heap_layout *)((char *)pop + pop->heap_offset);
+	struct zone *z = ZID_TO_ZONE(layout, 0);
+	unsigned chunk_id = (unsigned)(hdr - z->chunk_headers);
+	struct chunk_run *run = GET_CHUNK_RUN(layout, 0, chunk_id);
+
+	UT_ASSERTeq(run->block_size, UNIT_SIZE);
+	UT_ASSERTeq(run->alignment, ALIGNMENT);
+	UT_ASSERTne(hdr->flags & CHUNK_FLAG_ALIGNED, 0);
+	UT_ASSERTne(hdr->flags & CHUNK_FLAG_ALIGNED_TAIL, 0);
+
+	size_t run_size = hdr->size_idx * HEAP_CHUNKSIZE(layout) -
+		RUN_METASIZE_NVAL(HEAP_RUN_BITMAP_NVAL(layout));
+	unsigned nallocs = (unsigned)((run_size - ALIGNMENT) / UNIT_SIZE);
+	unsigned old_nallocs = (unsigned)(run_size / UNIT_SIZE);
+	UT_ASSERT(old_nallocs > nallocs);
+
+	uint64_t *bitmap = RUN_BITMAP(run);
+	for (unsigned i = nallocs; i < old_nallocs; ++i)
+		bitmap[i / 64] &= ~(1ULL << (i % 64));
+	pmemobj_persist(pop, bitmap,
+		sizeof(uint64_t) * HEAP_RUN_BITMAP_NVAL(layout));
+
+	hdr->flags &= (uint16_t)~CHUNK_FLAG_ALIGNED_TAIL;
+	pmemobj_persist(pop, hdr, sizeof(*hdr));
+}
+
+/*
+ * verify_object -- checks the contents of the object
+ */
+static void
+verify_object(PMEMoid oid, int c)
+{
+	char *data = pmemobj_direct(oid);
+	UT_ASSERTeq((uintptr_t)data % ALIGNMENT, 0);
+	UT_ASSERT(pmemobj_alloc_usable_size(oid) >= OBJ_SIZE);
+
+	for (size_t i = 0; i < OBJ_SIZE; ++i)
+		UT_ASSERTeq(data[i], (char)c);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_heap_aligned_run");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	unsigned class_id = create_class();
+
+	PMEMoid oids[2];
+	for (int i = 0; i < 2; ++i) {
+		int ret = pmemobj_xalloc(pop, &oids[i], OBJ_SIZE, 0,
+			POBJ_CLASS_ID(class_id), NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		pmemobj_memset_persist(pop, pmemobj_direct(oids[i]), 'a' + i,
+			OBJ_SIZE);
+	}
+
+	struct chunk_header *hdr = run_hdr(oids[0]);
+	UT_ASSERTeq(run_hdr(oids[1]), hdr);
+	uint64_t hdr_off = (uint64_t)((uintptr_t)hdr - (uintptr_t)pop);
+
+	make_old_layout(hdr);
+
+	pmemobj_close(pop);
+
+	/* the run was written with the old layout, its objects are usable */
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	for (int i = 0; i < 2; ++i)
+		verify_object(oids[i], 'a' + i);
+
+	/* a new class is not equivalent to the one of the old run */
+	class_id = create_class();
+	PMEMoid oid;
+	int ret = pmemobj_xalloc(pop, &oid, OBJ_SIZE, 0,
+		POBJ_CLASS_ID(class_id), NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTne(run_hdr(oid), run_hdr(oids[0]));
+	pmemobj_free(&oid);
+
+	for (int i = 0; i < 2; ++i)
+		pmemobj_free(&oids[i]);
+
+	pmemobj_close(pop);
+
+	/*
+	 * The empty run is recognized as such and returned to the heap once
+	 * the zone is loaded by an allocation.
+	 */
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	ret = pmemobj_alloc(pop, &oid, HUGE_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	/* the chunk might have been reused already, but not by the old run */
+	hdr = (struct chunk_header *)((uintptr_t)pop + hdr_off);
+	UT_ASSERT(hdr->type != CHUNK_TYPE_RUN ||
+		!(hdr->flags & CHUNK_FLAG_ALIGNED));
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT), 1);
+
+	DONE(NULL);
+}
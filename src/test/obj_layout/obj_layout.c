@@ -130,6 +130,7 @@ main(int argc, char *argv[])
 	ASSERT_ALIGNED_FIELD(struct heap_header, unused);
 	ASSERT_ALIGNED_FIELD(struct heap_header, chunksize);
 	ASSERT_ALIGNED_FIELD(struct heap_header, chunks_per_zone);
+	ASSERT_ALIGNED_FIELD(struct heap_header, run_bitmap_nval);
 	ASSERT_ALIGNED_FIELD(struct heap_header, reserved);
 	ASSERT_ALIGNED_FIELD(struct heap_header, checksum);
 	ASSERT_ALIGNED_CHECK(struct heap_header);
@@ -202,6 +202,7 @@ main(int argc, char *argv[])
 
 	pop->heap.layout = ZALLOC(sizeof(struct heap_layout) +
 		NCHUNKS * sizeof(struct chunk));
+	pop->heap.layout->header.chunksize = CHUNKSIZE;
 
 	pop->heap.p_ops.persist = fake_persist;
 
@@ -246,7 +246,8 @@ main(int argc, char *argv[])
 	if (argc >= 3)
 		check_integrity = atoi(argv[2]);
 
-	alloc_classes = alloc_class_collection_new();
+	alloc_classes = alloc_class_collection_new(CHUNKSIZE,
+		MAX_BITMAP_VALUES);
 
 	/* test alloc and free */
 	test_alloc(pop, 16);
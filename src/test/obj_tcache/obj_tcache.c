@@ -0,0 +1,140 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_tcache.c -- unit test for the per-thread cache of small blocks
+ *
+ * An idle thread keeps a batch of reserved blocks in its cache, which must
+ * be reclaimed once the heap runs out of memory for another thread.
+ */
+
+#include "unittest.h"
+
+#define ALLOC_SIZE 64
+
+enum state {
+	STARTING,
+	IDLE_CACHED,
+	HEAP_EXHAUSTED,
+};
+
+static PMEMobjpool *pop;
+static os_mutex_t lock;
+static os_cond_t cond;
+static enum state state = STARTING;
+
+/*
+ * set_state -- changes the state and wakes up the other thread
+ */
+static void
+set_state(enum state s)
+{
+	os_mutex_lock(&lock);
+	state = s;
+	os_cond_signal(&cond);
+	os_mutex_unlock(&lock);
+}
+
+/*
+ * wait_state -- waits for the other thread to change the state
+ */
+static void
+wait_state(enum state s)
+{
+	os_mutex_lock(&lock);
+	while (state != s)
+		os_cond_wait(&cond, &lock);
+	os_mutex_unlock(&lock);
+}
+
+/*
+ * idle_thread -- fills the thread cache with a single allocation and stays
+ *	idle until the heap is exhausted by the main thread
+ */
+static void *
+idle_thread(void *arg)
+{
+	int ret = pmemobj_alloc(pop, NULL, ALLOC_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	set_state(IDLE_CACHED);
+	wait_state(HEAP_EXHAUSTED);
+
+	/* the remaining blocks from the cache were handed out already */
+	ret = pmemobj_alloc(pop, NULL, ALLOC_SIZE, 0, NULL, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOMEM);
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tcache");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	pop = pmemobj_create(argv[1], "tcache", PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	/* both threads have to allocate from the same buckets */
+	int count = 1;
+	int ret = pmemobj_ctl_set(pop, "heap.arenas.count", &count);
+	UT_ASSERTeq(ret, 0);
+
+	os_mutex_init(&lock);
+	os_cond_init(&cond);
+
+	os_thread_t t;
+	PTHREAD_CREATE(&t, NULL, idle_thread, NULL);
+
+	wait_state(IDLE_CACHED);
+
+	while (pmemobj_alloc(pop, NULL, ALLOC_SIZE, 0, NULL, NULL) == 0)
+		;
+	UT_ASSERTeq(errno, ENOMEM);
+
+	set_state(HEAP_EXHAUSTED);
+	PTHREAD_JOIN(&t, NULL);
+
+	os_cond_destroy(&cond);
+	os_mutex_destroy(&lock);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -402,6 +402,37 @@ do_tx_add_range_commit(PMEMobjpool *pop)
 	UT_ASSERTeq(D_RO(obj)->value, TEST_VALUE_1);
 }
 
+/*
+ * do_tx_xadd_range_merge_commit -- merge a range added without the flush
+ *	with a regular one and commit tx, the merged range must be flushed
+ */
+static void
+do_tx_xadd_range_merge_commit(PMEMobjpool *pop)
+{
+	int ret;
+	TOID(struct object) obj;
+	TOID_ASSIGN(obj, do_tx_zalloc(pop, TYPE_OBJ));
+
+	TX_BEGIN(pop) {
+		char *ptr = (char *)pmemobj_direct(obj.oid);
+		ret = pmemobj_tx_xadd_range_direct(ptr + VALUE_OFF,
+				VALUE_SIZE, POBJ_XADD_NO_FLUSH);
+		UT_ASSERTeq(ret, 0);
+
+		/* adjacent to the previous range */
+		ret = pmemobj_tx_add_range_direct(ptr + DATA_OFF, DATA_SIZE);
+		UT_ASSERTeq(ret, 0);
+
+		D_RW(obj)->value = TEST_VALUE_1;
+		D_RW(obj)->data[0] = TEST_VALUE_2;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(D_RO(obj)->value, TEST_VALUE_1);
+	UT_ASSERTeq(D_RO(obj)->data[0], TEST_VALUE_2);
+}
+
 /*
  * do_tx_xadd_range_commit -- call xadd_range_direct and commit tx
  */
@@ -650,6 +681,8 @@ main(int argc, char *argv[])
 	VALGRIND_WRITE_STATS;
 	do_tx_add_cache_overflowing_range(pop);
 	VALGRIND_WRITE_STATS;
+	do_tx_xadd_range_merge_commit(pop);
+	VALGRIND_WRITE_STATS;
 	do_tx_xadd_range_commit(pop);
 
 	pmemobj_close(pop);
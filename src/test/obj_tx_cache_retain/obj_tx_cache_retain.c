@@ -0,0 +1,232 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_tx_cache_retain.c -- unit test for the snapshot caches retained by
+ *	the lanes across transactions
+ */
+
+#include "unittest.h"
+
+#define RANGE_SIZE 1024
+#define NRANGES 128 /* requires a few snapshot caches of the default size */
+#define LARGE_SIZE (64 * RANGE_SIZE) /* above the default cache threshold */
+
+struct root {
+	char data[NRANGES][RANGE_SIZE];
+};
+
+static char model[NRANGES][RANGE_SIZE];
+
+/*
+ * curr_allocated -- returns the number of bytes currently allocated
+ */
+static size_t
+curr_allocated(PMEMobjpool *pop)
+{
+	size_t allocated;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.curr_allocated",
+		&allocated);
+	UT_ASSERTeq(ret, 0);
+
+	return allocated;
+}
+
+/*
+ * snapshot_all -- snapshots every range separately and fills it with c
+ */
+static void
+snapshot_all(PMEMobjpool *pop, struct root *r, int c, int abort)
+{
+	TX_BEGIN(pop) {
+		for (int i = 0; i < NRANGES; ++i) {
+			pmemobj_tx_add_range_direct(r->data[i], RANGE_SIZE);
+			memset(r->data[i], c + i, RANGE_SIZE);
+		}
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_ONABORT {
+		UT_ASSERT(abort);
+	} TX_ONCOMMIT {
+		UT_ASSERT(!abort);
+		for (int i = 0; i < NRANGES; ++i)
+			memset(model[i], c + i, RANGE_SIZE);
+	} TX_END
+
+	UT_ASSERTeq(memcmp(r->data, model, sizeof(model)), 0);
+}
+
+/*
+ * test_reuse -- verifies that the consecutive transactions don't allocate
+ *	new caches
+ */
+static void
+test_reuse(PMEMobjpool *pop, struct root *r)
+{
+	snapshot_all(pop, r, 1, 0);
+	size_t allocated = curr_allocated(pop);
+
+	for (int c = 2; c < 5; ++c) {
+		snapshot_all(pop, r, c, 0);
+		UT_ASSERTeq(curr_allocated(pop), allocated);
+	}
+
+	/* the retained caches must not corrupt the undo log on abort */
+	snapshot_all(pop, r, 5, 1);
+	UT_ASSERTeq(curr_allocated(pop), allocated);
+
+	snapshot_all(pop, r, 6, 0);
+	UT_ASSERTeq(curr_allocated(pop), allocated);
+}
+
+/*
+ * snapshot_large -- snapshots a range above the cache threshold, verifies
+ *	whether that required a persistent allocation
+ */
+static void
+snapshot_large(PMEMobjpool *pop, struct root *r, int c, int abort,
+	int allocates)
+{
+	size_t allocated = curr_allocated(pop);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(r->data, LARGE_SIZE);
+		if (allocates)
+			UT_ASSERT(curr_allocated(pop) > allocated);
+		else
+			UT_ASSERTeq(curr_allocated(pop), allocated);
+
+		memset(r->data, c, LARGE_SIZE);
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_ONABORT {
+		UT_ASSERT(abort);
+	} TX_ONCOMMIT {
+		UT_ASSERT(!abort);
+		memset(model, c, LARGE_SIZE);
+	} TX_END
+
+	UT_ASSERTeq(memcmp(r->data, model, sizeof(model)), 0);
+}
+
+/*
+ * test_large -- verifies that the snapshots above the cache threshold use
+ *	the retained caches
+ */
+static void
+test_large(PMEMobjpool *pop, struct root *r)
+{
+	size_t allocated = curr_allocated(pop);
+
+	snapshot_large(pop, r, 10, 0, 0);
+	snapshot_large(pop, r, 11, 1, 0);
+	UT_ASSERTeq(curr_allocated(pop), allocated);
+
+	/* mixed with the small snapshots that already filled the caches */
+	snapshot_all(pop, r, 12, 0);
+	UT_ASSERTeq(curr_allocated(pop), allocated);
+}
+
+/*
+ * test_limit -- verifies that the caches above the limit are freed
+ */
+static void
+test_limit(PMEMobjpool *pop, struct root *r)
+{
+	long long retain = 0;
+	int ret = pmemobj_ctl_set(pop, "tx.cache.retain", &retain);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = pmemobj_ctl_get(pop, "tx.cache.retain", &retain);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(retain, 8);
+
+	size_t allocated = curr_allocated(pop);
+
+	retain = 1;
+	ret = pmemobj_ctl_set(pop, "tx.cache.retain", &retain);
+	UT_ASSERTeq(ret, 0);
+
+	snapshot_all(pop, r, 7, 0);
+	size_t trimmed = curr_allocated(pop);
+	UT_ASSERT(trimmed < allocated);
+
+	snapshot_all(pop, r, 8, 1);
+	UT_ASSERTeq(curr_allocated(pop), trimmed);
+
+	snapshot_all(pop, r, 9, 0);
+	UT_ASSERTeq(curr_allocated(pop), trimmed);
+
+	/* a single cache is too small for the large snapshot */
+	snapshot_large(pop, r, 13, 0, 1);
+	UT_ASSERTeq(curr_allocated(pop), trimmed);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_cache_retain");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	PMEMobjpool *pop = pmemobj_create(argv[1], "tx_cache_retain",
+		PMEMOBJ_MIN_POOL * 10, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *r = pmemobj_direct(root);
+
+	test_reuse(pop, r);
+	test_large(pop, r);
+	test_limit(pop, r);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(argv[1], "tx_cache_retain");
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open");
+
+	r = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	UT_ASSERTeq(memcmp(r->data, model, sizeof(model)), 0);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_tx_post_commit.c -- tests for the asynchronous post commit workers
+ */
+
+#include "unittest.h"
+
+#define THREADS 4
+#define WORKERS 2
+#define TXS 1000 /* the last one must be committed */
+
+#define SMALL_SNAPSHOTS 16
+#define LARGE_SNAPSHOT (1 << 16) /* above the default cache threshold */
+
+struct thread_data {
+	uint64_t small[SMALL_SNAPSHOTS];
+	char large[LARGE_SNAPSHOT];
+	PMEMoid obj;
+};
+
+struct root {
+	struct thread_data data[THREADS];
+};
+
+static PMEMobjpool *pop;
+
+/*
+ * set_queue_depth -- sets the post commit queue depth
+ */
+static int
+set_queue_depth(int depth)
+{
+	return pmemobj_ctl_set(pop, "tx.post_commit.queue_depth", &depth);
+}
+
+/*
+ * get_queue_depth -- returns the post commit queue depth
+ */
+static int
+get_queue_depth(void)
+{
+	int depth;
+	int ret = pmemobj_ctl_get(pop, "tx.post_commit.queue_depth", &depth);
+	UT_ASSERTeq(ret, 0);
+
+	return depth;
+}
+
+/*
+ * worker -- runs the post commit worker until it's stopped
+ */
+static void *
+worker(void *arg)
+{
+	void *unused;
+	int ret = pmemobj_ctl_get(pop, "tx.post_commit.worker", &unused);
+	UT_ASSERTeq(ret, 0);
+
+	return NULL;
+}
+
+/*
+ * stop_workers -- stops the post commit workers
+ */
+static void
+stop_workers(void)
+{
+	void *unused;
+	int ret = pmemobj_ctl_get(pop, "tx.post_commit.stop", &unused);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * tx_worker -- performs a mix of committed and aborted transactions
+ */
+static void *
+tx_worker(void *arg)
+{
+	struct thread_data *d = arg;
+
+	for (int i = 0; i < TXS; ++i) {
+		TX_BEGIN(pop) {
+			for (int j = 0; j < SMALL_SNAPSHOTS; ++j) {
+				pmemobj_tx_add_range_direct(&d->small[j],
+					sizeof(d->small[j]));
+				d->small[j] = (uint64_t)i;
+			}
+
+			if (i % 8 == 0) {
+				pmemobj_tx_add_range_direct(d->large,
+					sizeof(d->large));
+				memset(d->large, i, sizeof(d->large));
+			}
+
+			pmemobj_tx_add_range_direct(&d->obj, sizeof(d->obj));
+			if (!OID_IS_NULL(d->obj))
+				pmemobj_tx_free(d->obj);
+			size_t size = sizeof(uint64_t) * (size_t)(1 + i % 8);
+			d->obj = pmemobj_tx_zalloc(size, 0);
+
+			if (i % 16 == 15)
+				pmemobj_tx_abort(ECANCELED);
+		} TX_END
+	}
+
+	return NULL;
+}
+
+/*
+ * check_data -- verifies the state left by the transactions
+ */
+static void
+check_data(struct root *r)
+{
+	uint64_t last = TXS - 1;
+	while (last % 16 == 15) /* aborted */
+		last--;
+
+	char last_large = (char)(last - last % 8);
+
+	for (int t = 0; t < THREADS; ++t) {
+		struct thread_data *d = &r->data[t];
+		for (int j = 0; j < SMALL_SNAPSHOTS; ++j)
+			UT_ASSERTeq(d->small[j], last);
+
+		for (size_t j = 0; j < sizeof(d->large); ++j)
+			UT_ASSERTeq(d->large[j], last_large);
+
+		UT_ASSERT(!OID_IS_NULL(d->obj));
+	}
+}
+
+/*
+ * run_transactions -- runs the transactional threads and waits for them
+ */
+static void
+run_transactions(struct root *r)
+{
+	os_thread_t threads[THREADS];
+
+	for (int i = 0; i < THREADS; ++i)
+		PTHREAD_CREATE(&threads[i], NULL, tx_worker, &r->data[i]);
+
+	for (int i = 0; i < THREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+}
+
+/*
+ * test_queue_depth -- verifies the queue depth argument checks
+ */
+static void
+test_queue_depth(void)
+{
+	UT_ASSERTeq(get_queue_depth(), 0);
+
+	UT_ASSERTeq(set_queue_depth(-1), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(set_queue_depth(3), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(set_queue_depth(0), 0);
+	UT_ASSERTeq(get_queue_depth(), 0);
+
+	UT_ASSERTeq(set_queue_depth(16), 0);
+	UT_ASSERTeq(get_queue_depth(), 16);
+
+	/* the running queue cannot be replaced */
+	UT_ASSERTeq(set_queue_depth(32), -1);
+	UT_ASSERTeq(errno, EBUSY);
+
+	stop_workers();
+
+	UT_ASSERTeq(set_queue_depth(0), 0);
+	UT_ASSERTeq(get_queue_depth(), 0);
+
+	/* the worker returns immediately if there's no queue */
+	worker(NULL);
+}
+
+/*
+ * test_workers -- performs transactions with post commit workers running
+ */
+static void
+test_workers(struct root *r)
+{
+	UT_ASSERTeq(set_queue_depth(64), 0);
+
+	os_thread_t workers[WORKERS];
+	for (int i = 0; i < WORKERS; ++i)
+		PTHREAD_CREATE(&workers[i], NULL, worker, NULL);
+
+	run_transactions(r);
+
+	stop_workers();
+
+	for (int i = 0; i < WORKERS; ++i)
+		PTHREAD_JOIN(&workers[i], NULL);
+
+	check_data(r);
+
+	/* transactions fall back to synchronous cleanup after a stop */
+	run_transactions(r);
+	check_data(r);
+
+	UT_ASSERTeq(set_queue_depth(0), 0);
+}
+
+/*
+ * test_no_workers -- performs transactions with a queue that has no workers,
+ *	the tasks that don't fit are processed synchronously and the rest
+ *	are processed when the pool is closed
+ */
+static void
+test_no_workers(struct root *r)
+{
+	UT_ASSERTeq(set_queue_depth(2), 0);
+
+	run_transactions(r);
+	check_data(r);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_post_commit");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	pop = pmemobj_create(path, POBJ_LAYOUT_NAME(obj_tx_post_commit),
+		PMEMOBJ_MIN_POOL * 10, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *r = pmemobj_direct(root);
+
+	test_queue_depth();
+	test_workers(r);
+	test_no_workers(r);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, POBJ_LAYOUT_NAME(obj_tx_post_commit));
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	r = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	check_data(r);
+
+	pmemobj_close(pop);
+
+	int ret = pmemobj_check(path, POBJ_LAYOUT_NAME(obj_tx_post_commit));
+	UT_ASSERTeq(ret, 1);
+
+	DONE(NULL);
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_tx_redo.c -- unit test for redo logged transactional writes
+ */
+
+#include "unittest.h"
+
+#define BUF_SIZE 256
+#define NWORDS 4096 /* more than fits in the base redo log of a lane */
+
+struct root {
+	uint64_t value;
+	struct {
+		uint32_t a;
+		uint32_t b;
+	} pair; /* two halves of a single 8-byte word */
+	char buf[BUF_SIZE];
+	uint64_t words[NWORDS];
+	PMEMoid obj;
+};
+
+static char model[BUF_SIZE];
+
+/*
+ * test_write -- verifies that the redo logged writes become visible only
+ *	after commit
+ */
+static void
+test_write(PMEMobjpool *pop, struct root *r)
+{
+	uint64_t v = 1;
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(&r->value, &v, sizeof(v));
+		UT_ASSERTeq(r->value, 0);
+
+		v = 2;
+		pmemobj_tx_write(&r->value, &v, sizeof(v));
+		UT_ASSERTeq(r->value, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->value, 2);
+}
+
+/*
+ * test_unaligned -- performs overlapping writes not aligned to the word size
+ */
+static void
+test_unaligned(PMEMobjpool *pop, struct root *r)
+{
+	char data[BUF_SIZE];
+	memset(data, 0xab, sizeof(data));
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(&r->buf[3], data, 10);
+		memcpy(&model[3], data, 10);
+
+		memset(data, 0xcd, sizeof(data));
+		pmemobj_tx_write(&r->buf[7], data, 1);
+		model[7] = data[0];
+
+		pmemobj_tx_write(&r->buf[100], data, 100);
+		memcpy(&model[100], data, 100);
+
+		memset(data, 0xef, sizeof(data));
+		pmemobj_tx_write(&r->buf[90], data, 20);
+		memcpy(&model[90], data, 20);
+
+		pmemobj_tx_write(&r->buf[BUF_SIZE - 1], data, 1);
+		model[BUF_SIZE - 1] = data[0];
+
+		char zeroes[BUF_SIZE] = {0};
+		UT_ASSERTeq(memcmp(r->buf, zeroes, BUF_SIZE), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(memcmp(r->buf, model, BUF_SIZE), 0);
+}
+
+/*
+ * test_partial -- verifies that the redo logged write of a part of a word
+ *	does not revert the rest of the word modified in the meantime
+ */
+static void
+test_partial(PMEMobjpool *pop, struct root *r)
+{
+	uint32_t v = 1;
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(&r->pair.a, &v, sizeof(v));
+
+		pmemobj_tx_add_range_direct(&r->pair.b, sizeof(r->pair.b));
+		r->pair.b = 5;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->pair.a, 1);
+	UT_ASSERTeq(r->pair.b, 5);
+
+	v = 2;
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(&r->pair.b, &v, sizeof(v));
+		r->pair.a = 3;
+		pmemobj_persist(pop, &r->pair.a, sizeof(r->pair.a));
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->pair.a, 3);
+	UT_ASSERTeq(r->pair.b, 2);
+}
+
+/*
+ * test_abort -- verifies that the redo logged writes are discarded on abort
+ */
+static void
+test_abort(PMEMobjpool *pop, struct root *r)
+{
+	char data[BUF_SIZE];
+	memset(data, 0x11, sizeof(data));
+
+	uint64_t v = 3;
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(&r->value, &v, sizeof(v));
+		pmemobj_tx_write(r->buf, data, sizeof(data));
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->value, 2);
+	UT_ASSERTeq(memcmp(r->buf, model, BUF_SIZE), 0);
+}
+
+/*
+ * write_invalid -- performs a redo logged write of a range outside of the heap
+ *	or too large, verifies that the transaction is aborted
+ */
+static void
+write_invalid(PMEMobjpool *pop, struct root *r, void *dest, size_t size)
+{
+	int aborted = 0;
+	uint64_t v = 7;
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(&r->value, &v, sizeof(v));
+		pmemobj_tx_write(dest, r->buf, size);
+		UT_ASSERT(0);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_ONABORT {
+		aborted = 1;
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_END
+
+	UT_ASSERTeq(aborted, 1);
+	UT_ASSERTeq(r->value, 2);
+}
+
+/*
+ * test_invalid -- verifies that the redo logged writes are limited to the heap
+ */
+static void
+test_invalid(PMEMobjpool *pop, struct root *r)
+{
+	/* the pool header */
+	write_invalid(pop, r, pop, sizeof(uint64_t));
+
+	write_invalid(pop, r, r->buf, PMEMOBJ_MAX_ALLOC_SIZE + 1);
+}
+
+/*
+ * test_undo -- verifies pmemobj_tx_write in undo logged transactions
+ */
+static void
+test_undo(PMEMobjpool *pop, struct root *r)
+{
+	uint64_t v = 4;
+	TX_BEGIN(pop) {
+		pmemobj_tx_write(&r->value, &v, sizeof(v));
+		UT_ASSERTeq(r->value, 4);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->value, 2);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_write(&r->value, &v, sizeof(v));
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->value, 4);
+}
+
+/*
+ * test_nested -- verifies the redo mode of nested transactions
+ */
+static void
+test_nested(PMEMobjpool *pop, struct root *r)
+{
+	uint64_t v = 5;
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		TX_BEGIN(pop) {
+			pmemobj_tx_write(&r->value, &v, sizeof(v));
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+			v = 6;
+			pmemobj_tx_write(&r->value, &v, sizeof(v));
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		UT_ASSERTeq(r->value, 4);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(r->value, 6);
+
+	int aborted = 0;
+	TX_BEGIN(pop) {
+		TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+			UT_ASSERT(0);
+		} TX_END
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_ONABORT {
+		aborted = 1;
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_END
+
+	UT_ASSERTeq(aborted, 1);
+}
+
+/*
+ * test_many -- performs more writes than fit in the base redo log, together
+ *	with an allocation
+ */
+static void
+test_many(PMEMobjpool *pop, struct root *r)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		for (uint64_t i = 0; i < NWORDS; ++i)
+			pmemobj_tx_write(&r->words[i], &i, sizeof(i));
+
+		PMEMoid obj = pmemobj_tx_zalloc(sizeof(uint64_t), 0);
+		pmemobj_tx_write(&r->obj, &obj, sizeof(obj));
+		UT_ASSERT(OID_IS_NULL(r->obj));
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(!OID_IS_NULL(r->obj));
+	for (uint64_t i = 0; i < NWORDS; ++i)
+		UT_ASSERTeq(r->words[i], i);
+}
+
+/*
+ * check_root -- verifies the final state of the pool
+ */
+static void
+check_root(struct root *r)
+{
+	UT_ASSERTeq(r->value, 6);
+	UT_ASSERTeq(r->pair.a, 3);
+	UT_ASSERTeq(r->pair.b, 2);
+	UT_ASSERTeq(memcmp(r->buf, model, BUF_SIZE), 0);
+	UT_ASSERT(!OID_IS_NULL(r->obj));
+	UT_ASSERTeq(*(uint64_t *)pmemobj_direct(r->obj), 0);
+
+	for (uint64_t i = 0; i < NWORDS; ++i)
+		UT_ASSERTeq(r->words[i], i);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_redo");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, POBJ_LAYOUT_NAME(obj_tx_redo),
+		PMEMOBJ_MIN_POOL * 10, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+
+	test_write(pop, r);
+	test_unaligned(pop, r);
+	test_partial(pop, r);
+	test_abort(pop, r);
+	test_invalid(pop, r);
+	test_undo(pop, r);
+	test_nested(pop, r);
+	test_many(pop, r);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, POBJ_LAYOUT_NAME(obj_tx_redo));
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	check_root(pmemobj_direct(pmemobj_root(pop, sizeof(struct root))));
+
+	pmemobj_close(pop);
+
+	int ret = pmemobj_check(path, POBJ_LAYOUT_NAME(obj_tx_redo));
+	UT_ASSERTeq(ret, 1);
+
+	DONE(NULL);
+}
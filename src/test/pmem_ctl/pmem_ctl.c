@@ -0,0 +1,235 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem_ctl.c -- unit test for libpmem ctl entry points
+ *
+ * usage: pmem_ctl op [value]
+ *
+ * op can be:
+ *	d - verify the default movnt threshold
+ *	r - read the movnt threshold and compare it with the given value
+ *	c - verify the movnt threshold looks like a calibrated one
+ *	w - check writing of the movnt threshold
+ *	s - check statistics counters
+ */
+
+#include "unittest.h"
+
+#define MOVNT_THRESHOLD_DEFAULT 256
+
+/*
+ * threshold_get -- reads the current movnt threshold
+ */
+static ssize_t
+threshold_get(void)
+{
+	ssize_t threshold;
+	int ret = pmem_ctl_get("movnt.threshold", &threshold);
+	UT_ASSERTeq(ret, 0);
+
+	return threshold;
+}
+
+/*
+ * test_calibrated -- verifies the calibration result is sane
+ */
+static void
+test_calibrated(void)
+{
+	ssize_t threshold = threshold_get();
+
+	UT_ASSERT(threshold >= 64);
+	UT_ASSERT(threshold <= 128 * 1024);
+	UT_ASSERTeq(threshold & (threshold - 1), 0);
+}
+
+/*
+ * test_write -- sets the movnt threshold and copies data with it
+ */
+static void
+test_write(void)
+{
+	ssize_t threshold = 1024;
+	int ret = pmem_ctl_set("movnt.threshold", &threshold);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(threshold_get(), 1024);
+
+	threshold = -1;
+	ret = pmem_ctl_set("movnt.threshold", &threshold);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+	UT_ASSERTeq(threshold_get(), 1024);
+
+	ret = pmem_ctl_get("movnt.nonexistent", &threshold);
+	UT_ASSERTeq(ret, -1);
+
+	char *src = MEMALIGN(64, 4096);
+	char *dst = MEMALIGN(64, 4096);
+	memset(src, 0x5a, 4096);
+
+	for (size_t size = 512; size <= 4096; size *= 2) {
+		memset(dst, 0, 4096);
+		pmem_memcpy_persist(dst, src, size);
+		UT_ASSERTeq(memcmp(src, dst, size), 0);
+	}
+
+	ALIGNED_FREE(dst);
+	ALIGNED_FREE(src);
+}
+
+/*
+ * stat_get -- reads a statistics counter
+ */
+static uint64_t
+stat_get(const char *name)
+{
+	char query[64];
+	snprintf(query, sizeof(query), "stats.%s", name);
+
+	uint64_t value;
+	int ret = pmem_ctl_get(query, &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * stats_thread -- flushes and copies data from a separate thread
+ */
+static void *
+stats_thread(void *arg)
+{
+	char *buf = arg;
+
+	pmem_flush(buf, 64);
+	pmem_memset(buf, 1, 64, PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
+
+	return NULL;
+}
+
+/*
+ * test_stats -- verifies the statistics counters
+ */
+static void
+test_stats(void)
+{
+	char *src = MEMALIGN(64, 4096);
+	char *dst = MEMALIGN(64, 4096);
+	memset(src, 0x5a, 4096);
+
+	int enabled = 1;
+	UT_ASSERTeq(pmem_ctl_get("stats.enabled", &enabled), 0);
+	UT_ASSERTeq(enabled, 0);
+
+	/* nothing is counted by default */
+	pmem_memcpy_persist(dst, src, 4096);
+	UT_ASSERTeq(stat_get("flushed_lines"), 0);
+	UT_ASSERTeq(stat_get("fences"), 0);
+	UT_ASSERTeq(stat_get("nt_bytes"), 0);
+	UT_ASSERTeq(stat_get("temporal_bytes"), 0);
+
+	enabled = 1;
+	UT_ASSERTeq(pmem_ctl_set("stats.enabled", &enabled), 0);
+	UT_ASSERTeq(pmem_ctl_get("stats.enabled", &enabled), 0);
+	UT_ASSERTeq(enabled, 1);
+
+	/* unaligned range spanning 3 cache lines */
+	pmem_flush(dst + 32, 128);
+	UT_ASSERTeq(stat_get("flushed_lines"), 3);
+
+	pmem_memcpy(dst, src, 128, PMEM_F_MEM_TEMPORAL | PMEM_F_MEM_NODRAIN);
+	UT_ASSERTeq(stat_get("temporal_bytes"), 128);
+	UT_ASSERTeq(stat_get("flushed_lines"), 5);
+
+	pmem_memcpy(dst, src, 4096,
+		PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
+	UT_ASSERTeq(stat_get("nt_bytes"), 4096);
+
+	/* fences are issued only if flushing needs them */
+	uint64_t fences = stat_get("fences");
+	pmem_drain();
+	pmem_drain();
+	UT_ASSERT(stat_get("fences") == fences ||
+		stat_get("fences") == fences + 2);
+
+	/* counters of exited threads are preserved */
+	os_thread_t t;
+	PTHREAD_CREATE(&t, NULL, stats_thread, dst);
+	PTHREAD_JOIN(&t, NULL);
+	UT_ASSERTeq(stat_get("flushed_lines"), 6);
+	UT_ASSERTeq(stat_get("nt_bytes"), 4096 + 64);
+
+	uint64_t value = 0;
+	UT_ASSERTeq(pmem_ctl_set("stats.flushed_lines", &value), -1);
+
+	enabled = 0;
+	UT_ASSERTeq(pmem_ctl_set("stats.enabled", &enabled), 0);
+	pmem_flush(dst, 4096);
+	UT_ASSERTeq(stat_get("flushed_lines"), 6);
+
+	ALIGNED_FREE(dst);
+	ALIGNED_FREE(src);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "pmem_ctl");
+
+	if (argc < 2)
+		UT_FATAL("usage: %s op [value]", argv[0]);
+
+	switch (argv[1][0]) {
+	case 'd':
+		UT_ASSERTeq(threshold_get(), MOVNT_THRESHOLD_DEFAULT);
+		break;
+	case 'r':
+		if (argc < 3)
+			UT_FATAL("missing value");
+		UT_ASSERTeq(threshold_get(), atoll(argv[2]));
+		break;
+	case 'c':
+		test_calibrated();
+		break;
+	case 'w':
+		test_write();
+		break;
+	case 's':
+		test_stats();
+		break;
+	default:
+		UT_FATAL("unknown operation %s", argv[1]);
+	}
+
+	DONE(NULL);
+}
@@ -34,7 +34,9 @@
  * pmem_is_pmem_posix.c -- Posix specific unit test for pmem_is_pmem()
  *
  * usage: pmem_is_pmem_posix op addr len [op addr len ...]
- * where op can be: 'a' (add), 'r' (remove), 't' (test)
+ * where op can be: 'a' (add), 'r' (remove), 't' (test),
+ * 'c' (test concurrently with registering ranges, followed by the number
+ * of ranges and rounds)
  */
 
 #include <stdlib.h>
@@ -42,6 +44,76 @@
 #include "unittest.h"
 #include "mmap.h"
 
+#define NREADERS 4
+
+struct reader_args {
+	void *addr;
+	size_t len;
+	int *stop;
+};
+
+/*
+ * reader -- repeatedly tests the range which stays registered
+ */
+static void *
+reader(void *arg)
+{
+	struct reader_args *a = arg;
+	int stop;
+
+	do {
+		UT_ASSERTeq(pmem_is_pmem(a->addr, a->len), 1);
+		util_atomic_load_explicit32(a->stop, &stop,
+				memory_order_acquire);
+	} while (!stop);
+
+	return NULL;
+}
+
+/*
+ * test_concurrent -- tests the registered range in multiple threads while
+ * the map tracking list grows and shrinks, adding nranges ranges of the
+ * same length right after it, repeats that nrounds times starting with
+ * the smallest copy of the list
+ */
+static void
+test_concurrent(void *addr, size_t len, unsigned nranges, unsigned nrounds)
+{
+	char *begin = (char *)addr + len;
+
+	for (unsigned r = 0; r < nrounds; ++r) {
+		int stop = 0;
+		struct reader_args args = {addr, len, &stop};
+		os_thread_t threads[NREADERS];
+
+		for (unsigned i = 0; i < NREADERS; ++i)
+			PTHREAD_CREATE(&threads[i], NULL, reader, &args);
+
+		for (unsigned i = 0; i < nranges; ++i)
+			UT_ASSERTeq(util_range_register(begin + i * len, len,
+				"", PMEM_DEV_DAX), 0);
+
+		for (unsigned i = 0; i < nranges; ++i)
+			UT_ASSERTeq(util_range_unregister(begin + i * len,
+				len), 0);
+
+		util_atomic_store_explicit32(&stop, 1, memory_order_release);
+
+		for (unsigned i = 0; i < NREADERS; ++i)
+			PTHREAD_JOIN(&threads[i], NULL);
+
+		/* drop the copy of the list, so that it has to grow again */
+		UT_ASSERTeq(util_range_unregister(addr, len), 0);
+		util_mmap_fini();
+		util_mmap_init();
+		UT_ASSERTeq(util_range_register(addr, len, "", PMEM_DEV_DAX),
+			0);
+	}
+
+	UT_OUT("addr %p len %zu concurrent with %u ranges %u times", addr, len,
+			nranges, nrounds);
+}
+
 static enum pmem_map_type
 str2type(char *str)
 {
@@ -95,6 +167,13 @@ main(int argc, char *argv[])
 					addr, len, pmem_is_pmem(addr, len));
 			i += 3;
 			break;
+		case 'c':
+			UT_ASSERT(i + 4 < argc);
+			test_concurrent(addr, len,
+				(unsigned)strtoul(argv[i + 3], NULL, 0),
+				(unsigned)strtoul(argv[i + 4], NULL, 0));
+			i += 5;
+			break;
 		default:
 			FATAL("invalid op '%c'", argv[i][0]);
 		}
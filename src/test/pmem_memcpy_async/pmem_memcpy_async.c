@@ -0,0 +1,199 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem_memcpy_async.c -- unit test for asynchronous and parallel memcpy
+ *	and memset
+ *
+ * usage: pmem_memcpy_async workers
+ *
+ * workers is the expected number of worker threads.
+ */
+
+#include "unittest.h"
+
+/* not a multiple of the 2 MiB job chunk */
+#define BUF_SIZE ((9 << 20) + 4096)
+#define OFFSET 123
+#define NJOBS 4
+
+/*
+ * test_memcpy -- copies a buffer to an unaligned destination
+ */
+static void
+test_memcpy(char *dst, char *src)
+{
+	size_t len = BUF_SIZE - OFFSET;
+
+	for (size_t i = 0; i < BUF_SIZE; ++i)
+		src[i] = (char)(i * 7);
+	memset(dst, 0, BUF_SIZE);
+
+	struct pmem_async *async = pmem_memcpy_async(dst + OFFSET, src, len, 0);
+	UT_ASSERTne(async, NULL);
+	pmem_async_wait(async);
+
+	for (size_t i = 0; i < OFFSET; ++i)
+		UT_ASSERTeq(dst[i], 0);
+	UT_ASSERTeq(memcmp(dst + OFFSET, src, len), 0);
+}
+
+/*
+ * test_poll -- runs several jobs at the same time and polls for completion
+ */
+static void
+test_poll(char *dst, char *src)
+{
+	struct pmem_async *async[NJOBS];
+	size_t len = BUF_SIZE / NJOBS;
+
+	memset(src, 0x5a, BUF_SIZE);
+	memset(dst, 0, BUF_SIZE);
+
+	for (int i = 0; i < NJOBS; ++i) {
+		async[i] = pmem_memcpy_async(dst + (size_t)i * len,
+				src + (size_t)i * len, len,
+				PMEM_F_MEM_NONTEMPORAL);
+		UT_ASSERTne(async[i], NULL);
+	}
+
+	for (int i = 0; i < NJOBS; ++i) {
+		while (!pmem_async_poll(async[i]))
+			;
+		UT_ASSERTeq(pmem_async_poll(async[i]), 1);
+		pmem_async_wait(async[i]);
+	}
+
+	UT_ASSERTeq(memcmp(dst, src, len * NJOBS), 0);
+}
+
+/*
+ * test_memset -- fills a buffer
+ */
+static void
+test_memset(char *dst)
+{
+	memset(dst, 0, BUF_SIZE);
+
+	struct pmem_async *async = pmem_memset_async(dst + OFFSET, 0x33,
+			BUF_SIZE - OFFSET, 0);
+	UT_ASSERTne(async, NULL);
+	pmem_async_wait(async);
+
+	for (size_t i = 0; i < BUF_SIZE; ++i)
+		UT_ASSERTeq(dst[i], i < OFFSET ? 0 : 0x33);
+}
+
+/*
+ * test_empty -- zero-length operation completes immediately
+ */
+static void
+test_empty(char *dst, char *src)
+{
+	struct pmem_async *async = pmem_memcpy_async(dst, src, 0, 0);
+	UT_ASSERTne(async, NULL);
+	UT_ASSERTeq(pmem_async_poll(async), 1);
+	pmem_async_wait(async);
+}
+
+/*
+ * test_parallel -- splits synchronous operations between the worker threads
+ */
+static void
+test_parallel(char *dst, char *src)
+{
+	size_t len = BUF_SIZE - OFFSET;
+
+	for (size_t i = 0; i < BUF_SIZE; ++i)
+		src[i] = (char)(i * 11);
+	memset(dst, 0, BUF_SIZE);
+
+	pmem_memcpy(dst + OFFSET, src, len, PMEM_F_MEM_PARALLEL);
+	UT_ASSERTeq(memcmp(dst + OFFSET, src, len), 0);
+
+	/* overlapping ranges are never split */
+	pmem_memmove(dst, dst + OFFSET, len, PMEM_F_MEM_PARALLEL);
+	UT_ASSERTeq(memcmp(dst, src, len), 0);
+
+	long long threshold = -1;
+	UT_ASSERTeq(pmem_ctl_set("workers.parallel_threshold", &threshold),
+			-1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	threshold = 4 << 20;
+	UT_ASSERTeq(pmem_ctl_set("workers.parallel_threshold", &threshold),
+			0);
+	threshold = 0;
+	UT_ASSERTeq(pmem_ctl_get("workers.parallel_threshold", &threshold),
+			0);
+	UT_ASSERTeq(threshold, 4 << 20);
+
+	pmem_memset(dst + OFFSET, 0x44, len, 0);
+	for (size_t i = 0; i < BUF_SIZE; ++i)
+		UT_ASSERTeq(dst[i], i < OFFSET ? src[i] : 0x44);
+
+	threshold = 0;
+	UT_ASSERTeq(pmem_ctl_set("workers.parallel_threshold", &threshold),
+			0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "pmem_memcpy_async");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s workers", argv[0]);
+
+	int workers;
+	UT_ASSERTeq(pmem_ctl_get("workers.count", &workers), 0);
+	UT_ASSERTeq(workers, atoi(argv[1]));
+
+	char *src = MEMALIGN(4096, BUF_SIZE);
+	char *dst = MEMALIGN(4096, BUF_SIZE);
+
+	test_empty(dst, src);
+	test_memcpy(dst, src);
+	test_poll(dst, src);
+	test_memset(dst);
+	test_parallel(dst, src);
+
+	/* the pool cannot be resized once it's running */
+	workers = 2;
+	UT_ASSERTeq(pmem_ctl_set("workers.count", &workers), -1);
+	UT_ASSERTeq(errno, EBUSY);
+
+	ALIGNED_FREE(dst);
+	ALIGNED_FREE(src);
+
+	DONE(NULL);
+}
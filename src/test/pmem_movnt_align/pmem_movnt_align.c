@@ -49,6 +49,7 @@
 
 #define CACHELINE 64
 #define N_BYTES 8192
+#define FIXED_MAX 256
 
 typedef void *(*mem_fn)(void *, const void *, size_t);
 
@@ -234,7 +235,7 @@ main(int argc, char *argv[])
 			avx ? "" : "!",
 			avx512f ? "" : "!");
 
-	size_t s;
+	size_t s, l;
 	switch (type) {
 	case 'C': /* memcpy */
 		/* mmap with guard pages */
@@ -260,6 +261,14 @@ main(int argc, char *argv[])
 		for (s = 0; s < CACHELINE; s++)
 			check_memcpy_variants(s, s, N_BYTES - 2 * s);
 
+		/* check memcpy around fixed-size lengths at every alignment */
+		for (s = 0; s < CACHELINE; s++)
+			for (l = 8; l <= FIXED_MAX; l *= 2) {
+				check_memcpy_variants(s, 0, l - 1);
+				check_memcpy_variants(s, 0, l);
+				check_memcpy_variants(s, 0, l + 1);
+			}
+
 		MUNMAP_ANON_ALIGNED(Src, N_BYTES);
 		MUNMAP_ANON_ALIGNED(Dst, N_BYTES);
 		FREE(Scratch);
@@ -343,6 +352,14 @@ main(int argc, char *argv[])
 		for (s = 0; s < CACHELINE; s++)
 			check_memset_variants(s, N_BYTES - 2 * s);
 
+		/* check memset around fixed-size lengths at every alignment */
+		for (s = 0; s < CACHELINE; s++)
+			for (l = 8; l <= FIXED_MAX; l *= 2) {
+				check_memset_variants(s, l - 1);
+				check_memset_variants(s, l);
+				check_memset_variants(s, l + 1);
+			}
+
 		MUNMAP_ANON_ALIGNED(Dst, N_BYTES);
 		FREE(Scratch);
 
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem_persist_iov.c -- unit test for pmem_flush_iov and pmem_persist_iov
+ *
+ * usage: pmem_persist_iov file
+ *
+ * Every cache line covered by the vector has to be flushed exactly once,
+ * which is verified using the number of flushed lines from libpmem stats.
+ */
+
+#include "unittest.h"
+
+#define BUF_SIZE 8192
+#define MAX_IOV 256
+#define LINE 64
+
+/* the number of lines counted for a single flushed line, 0 or 1 */
+static uint64_t Line_flushes;
+
+/*
+ * flushed_lines -- returns the number of cache lines flushed so far
+ */
+static uint64_t
+flushed_lines(void)
+{
+	uint64_t lines;
+	UT_ASSERTeq(pmem_ctl_get("stats.flushed_lines", &lines), 0);
+
+	return lines;
+}
+
+/*
+ * persist_and_check -- persists the ranges and verifies the number of
+ *	flushed lines
+ */
+static void
+persist_and_check(struct iovec *iov, int iovcnt, uint64_t nlines)
+{
+	uint64_t before = flushed_lines();
+
+	pmem_persist_iov(iov, iovcnt);
+
+	UT_ASSERTeq(flushed_lines() - before, nlines * Line_flushes);
+}
+
+/*
+ * fill_and_persist -- writes a pattern to every range, persists them and
+ *	verifies the number of flushed lines
+ */
+static void
+fill_and_persist(struct iovec *iov, int iovcnt, int c, uint64_t nlines)
+{
+	for (int i = 0; i < iovcnt; ++i)
+		memset(iov[i].iov_base, c, iov[i].iov_len);
+
+	persist_and_check(iov, iovcnt, nlines);
+
+	for (int i = 0; i < iovcnt; ++i) {
+		char *p = iov[i].iov_base;
+		for (size_t j = 0; j < iov[i].iov_len; ++j)
+			UT_ASSERTeq(p[j], c);
+	}
+}
+
+/*
+ * test_disjoint -- ranges that do not share any cache line
+ */
+static void
+test_disjoint(char *buf)
+{
+	struct iovec iov[3];
+	iov[0].iov_base = buf + 4096;
+	iov[0].iov_len = 8;
+	iov[1].iov_base = buf;
+	iov[1].iov_len = 1;
+	iov[2].iov_base = buf + 1000;
+	iov[2].iov_len = 300;
+
+	/* lines 64, 0 and 15 to 20 */
+	fill_and_persist(iov, 3, 0x11, 8);
+}
+
+/*
+ * test_overlapping -- ranges that overlap or share cache lines
+ */
+static void
+test_overlapping(char *buf)
+{
+	struct iovec iov[5];
+	iov[0].iov_base = buf + 10;
+	iov[0].iov_len = 20;
+	iov[1].iov_base = buf + 40;
+	iov[1].iov_len = 8;
+	iov[2].iov_base = buf + 20;
+	iov[2].iov_len = 200;
+	iov[3].iov_base = buf + 256;
+	iov[3].iov_len = 64;
+	iov[4].iov_base = buf + 30;
+	iov[4].iov_len = 1;
+
+	/* lines 0 to 4 */
+	fill_and_persist(iov, 5, 0x22, 5);
+
+	/* the same range twice */
+	iov[1] = iov[0];
+	fill_and_persist(iov, 2, 0x23, 1);
+}
+
+/*
+ * test_adjacent -- ranges that begin where the previous one ends
+ */
+static void
+test_adjacent(char *buf)
+{
+	struct iovec iov[5];
+
+	/* on cache line boundaries */
+	iov[0].iov_base = buf + 9 * LINE;
+	iov[0].iov_len = LINE;
+	iov[1].iov_base = buf + 8 * LINE;
+	iov[1].iov_len = LINE;
+	iov[2].iov_base = buf + 10 * LINE;
+	iov[2].iov_len = LINE;
+
+	/* within cache lines */
+	iov[3].iov_base = buf + 1000;
+	iov[3].iov_len = 50;
+	iov[4].iov_base = buf + 1050;
+	iov[4].iov_len = 50;
+
+	/* lines 8 to 10 and 15 to 17 */
+	fill_and_persist(iov, 5, 0x44, 6);
+}
+
+/*
+ * test_zero_length -- ranges of zero length are ignored
+ */
+static void
+test_zero_length(char *buf)
+{
+	struct iovec iov[3];
+	iov[0].iov_base = buf + 4096;
+	iov[0].iov_len = 0;
+	iov[1].iov_base = buf + 128;
+	iov[1].iov_len = 0;
+	iov[2].iov_base = buf + 100;
+	iov[2].iov_len = 100;
+
+	/* lines 1 to 3 */
+	fill_and_persist(iov, 3, 0x55, 3);
+
+	/* nothing but ranges of zero length */
+	fill_and_persist(iov, 2, 0x56, 0);
+}
+
+/*
+ * test_many -- more ranges than fit in the on-stack array
+ */
+static void
+test_many(char *buf)
+{
+	struct iovec iov[MAX_IOV];
+	for (int i = 0; i < MAX_IOV; ++i) {
+		/* reverse order, every other range shares a line */
+		iov[i].iov_base = buf + BUF_SIZE - 32 * (size_t)(i + 1);
+		iov[i].iov_len = (size_t)(i % 32) + 1;
+	}
+
+	/* every line of the buffer */
+	fill_and_persist(iov, MAX_IOV, 0x33, BUF_SIZE / LINE);
+
+	uint64_t before = flushed_lines();
+
+	pmem_flush_iov(iov, MAX_IOV);
+	pmem_drain();
+
+	UT_ASSERTeq(flushed_lines() - before,
+		BUF_SIZE / LINE * Line_flushes);
+}
+
+/*
+ * test_empty -- nothing to flush
+ */
+static void
+test_empty(char *buf)
+{
+	persist_and_check(NULL, 0, 0);
+
+	/* the vector is ignored when its length is 0 */
+	struct iovec iov;
+	iov.iov_base = buf;
+	iov.iov_len = LINE;
+	persist_and_check(&iov, 0, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "pmem_persist_iov");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	size_t mapped_len;
+	char *buf = pmem_map_file(argv[1], 0, 0, 0, &mapped_len, NULL);
+	if (buf == NULL)
+		UT_FATAL("!Could not mmap %s", argv[1]);
+
+	UT_ASSERT(mapped_len >= BUF_SIZE);
+
+	int enabled = 1;
+	UT_ASSERTeq(pmem_ctl_set("stats.enabled", &enabled), 0);
+
+	/* no lines are counted if flushing is disabled */
+	uint64_t before = flushed_lines();
+	pmem_persist(buf, 1);
+	Line_flushes = flushed_lines() - before;
+	UT_ASSERT(Line_flushes <= 1);
+
+	test_disjoint(buf);
+	test_overlapping(buf);
+	test_adjacent(buf);
+	test_zero_length(buf);
+	test_many(buf);
+	test_empty(buf);
+
+	UT_ASSERTeq(pmem_unmap(buf, mapped_len), 0);
+
+	DONE(NULL);
+}
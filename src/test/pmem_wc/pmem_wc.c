@@ -0,0 +1,174 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem_wc.c -- unit test for write-combining staging of persistent stores
+ *
+ * usage: pmem_wc
+ */
+
+#include "unittest.h"
+
+#define LINE 64
+#define NLINES 1024
+#define BUF_SIZE (NLINES * LINE)
+
+/*
+ * stage -- stages a store and applies it to the shadow copy
+ */
+static void
+stage(struct pmem_wc *wc, char *buf, char *shadow, size_t off,
+	const void *src, size_t len)
+{
+	UT_ASSERTeq(pmem_wc_write(wc, buf + off, src, len), 0);
+	memcpy(shadow + off, src, len);
+}
+
+/*
+ * test_scattered -- stages small overlapping stores spread over many lines
+ */
+static void
+test_scattered(char *buf, char *shadow)
+{
+	memset(buf, 0x11, BUF_SIZE);
+	memset(shadow, 0x11, BUF_SIZE);
+
+	struct pmem_wc *wc = pmem_wc_begin();
+	UT_ASSERTne(wc, NULL);
+
+	char data[3 * LINE];
+	for (size_t i = 0; i < sizeof(data); ++i)
+		data[i] = (char)i;
+
+	stage(wc, buf, shadow, 0, data, 1);
+	stage(wc, buf, shadow, 7, data + 5, 8);
+	stage(wc, buf, shadow, 10, data + 40, 3);	/* overlaps */
+	stage(wc, buf, shadow, 63, data + 9, 2);	/* crosses a line */
+	stage(wc, buf, shadow, 5 * LINE, data, LINE);	/* full line */
+	stage(wc, buf, shadow, 7 * LINE + 13, data, sizeof(data));
+	stage(wc, buf, shadow, 20 * LINE + 32, data, 32);
+	stage(wc, buf, shadow, 20 * LINE, data + 100, 32); /* completes */
+	stage(wc, buf, shadow, 30 * LINE + 1, data, 0);
+
+	/* nothing is stored before the commit */
+	for (size_t i = 0; i < BUF_SIZE; ++i)
+		UT_ASSERTeq(buf[i], 0x11);
+
+	pmem_wc_commit(wc);
+
+	UT_ASSERTeq(memcmp(buf, shadow, BUF_SIZE), 0);
+}
+
+/*
+ * test_untouched -- bytes not staged are not rewritten by the commit
+ */
+static void
+test_untouched(char *buf)
+{
+	memset(buf, 0, BUF_SIZE);
+
+	struct pmem_wc *wc = pmem_wc_begin();
+	UT_ASSERTne(wc, NULL);
+
+	char c = 'a';
+	UT_ASSERTeq(pmem_wc_write(wc, buf, &c, 1), 0);
+	UT_ASSERTeq(pmem_wc_write(wc, buf + 2, &c, 1), 0);
+
+	/* modified by someone else after the store was staged */
+	buf[1] = 'b';
+
+	pmem_wc_commit(wc);
+
+	UT_ASSERTeq(buf[0], 'a');
+	UT_ASSERTeq(buf[1], 'b');
+	UT_ASSERTeq(buf[2], 'a');
+	for (size_t i = 3; i < LINE; ++i)
+		UT_ASSERTeq(buf[i], 0);
+}
+
+/*
+ * test_many -- stages more lines than the initial capacity of the batch
+ */
+static void
+test_many(char *buf, char *shadow)
+{
+	memset(buf, 0, BUF_SIZE);
+	memset(shadow, 0, BUF_SIZE);
+
+	struct pmem_wc *wc = pmem_wc_begin();
+	UT_ASSERTne(wc, NULL);
+
+	/* every other line completely, the rest partially */
+	for (size_t i = 0; i < NLINES; ++i) {
+		uint64_t v = i * 0x0101010101010101ULL;
+		size_t len = i % 2 ? sizeof(v) : LINE;
+		for (size_t off = 0; off < len; off += sizeof(v))
+			stage(wc, buf, shadow, i * LINE + off, &v, sizeof(v));
+	}
+
+	pmem_wc_commit(wc);
+
+	UT_ASSERTeq(memcmp(buf, shadow, BUF_SIZE), 0);
+}
+
+/*
+ * test_empty -- commits a batch without any stores
+ */
+static void
+test_empty(void)
+{
+	struct pmem_wc *wc = pmem_wc_begin();
+	UT_ASSERTne(wc, NULL);
+	pmem_wc_commit(wc);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "pmem_wc");
+
+	if (argc != 1)
+		UT_FATAL("usage: %s", argv[0]);
+
+	char *buf = MEMALIGN(LINE, BUF_SIZE);
+	char *shadow = MALLOC(BUF_SIZE);
+
+	test_empty();
+	test_scattered(buf, shadow);
+	test_untouched(buf);
+	test_many(buf, shadow);
+
+	FREE(shadow);
+	ALIGNED_FREE(buf);
+
+	DONE(NULL);
+}
@@ -246,6 +246,8 @@ struct pmemspoil {
 	size_t size;
 	unsigned replica;
 	uint64_t arena_offset;
+	size_t heap_chunksize;
+	unsigned heap_run_bitmap_nval;
 };
 
 typedef enum chunk_type chunk_type_t;
@@ -1093,7 +1095,8 @@ pmemspoil_process_run(struct pmemspoil *psp, struct pmemspoil_list *pfp,
 
 	PROCESS_BEGIN(psp, pfp) {
 		PROCESS_FIELD(run, block_size, uint64_t);
-		PROCESS_FIELD_ARRAY(run, bitmap, uint64_t, MAX_BITMAP_VALUES);
+		PROCESS_FIELD_ARRAY(run, bitmap, uint64_t,
+			psp->heap_run_bitmap_nval);
 	} PROCESS_END
 
 	return PROCESS_RET;
@@ -1131,7 +1134,8 @@ pmemspoil_process_zone(struct pmemspoil *psp, struct pmemspoil_list *pfp,
 	PROCESS_BEGIN(psp, pfp) {
 		struct chunk_pair cpair = {
 			.hdr = &zone->chunk_headers[PROCESS_INDEX],
-			.chunk = &zone->chunks[PROCESS_INDEX],
+			.chunk = (struct chunk *)((uintptr_t)zone->chunks +
+				psp->heap_chunksize * PROCESS_INDEX),
 		};
 
 		PROCESS_FIELD(zhdr, magic, uint32_t);
@@ -1153,6 +1157,9 @@ pmemspoil_process_heap(struct pmemspoil *psp, struct pmemspoil_list *pfp,
 {
 	struct heap_header *hdr = &hlayout->header;
 
+	psp->heap_chunksize = HEAP_CHUNKSIZE(hlayout);
+	psp->heap_run_bitmap_nval = HEAP_RUN_BITMAP_NVAL(hlayout);
+
 	PROCESS_BEGIN(psp, pfp) {
 		PROCESS_FIELD(hdr, signature, char);
 		PROCESS_FIELD(hdr, major, uint64_t);
@@ -1160,11 +1167,13 @@ pmemspoil_process_heap(struct pmemspoil *psp, struct pmemspoil_list *pfp,
 		PROCESS_FIELD(hdr, unused, uint64_t);
 		PROCESS_FIELD(hdr, chunksize, uint64_t);
 		PROCESS_FIELD(hdr, chunks_per_zone, uint64_t);
+		PROCESS_FIELD(hdr, run_bitmap_nval, uint64_t);
 		PROCESS_FIELD(hdr, reserved, char);
 		PROCESS_FIELD(hdr, checksum, uint64_t);
 
 		PROCESS(zone, ZID_TO_ZONE(hlayout, PROCESS_INDEX),
-			util_heap_max_zone(psp->size), struct zone *);
+			util_heap_max_zone(psp->size, psp->heap_chunksize),
+			struct zone *);
 
 	} PROCESS_END
 
@@ -1038,6 +1038,12 @@ function require_x86_64() {
 	exit 0
 }
 
+function require_aarch64() {
+	[ $(get_arch) = "aarch64" ] && return
+	msg "$UNITTEST_NAME: SKIP: Not supported on arch != aarch64"
+	exit 0
+}
+
 #
 # require_test_type -- only allow script to continue for a certain test type
 #
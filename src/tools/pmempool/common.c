@@ -1136,64 +1136,24 @@ util_options_verify(const struct options *opts, pmem_pool_type_t type)
 }
 
 /*
- * util_heap_max_zone -- get number of zones
+ * util_heap_max_zone -- get number of zones of a heap with the given chunk size
  */
 unsigned
-util_heap_max_zone(size_t size)
+util_heap_max_zone(size_t size, size_t chunksize)
 {
 	unsigned max_zone = 0;
 	size -= sizeof(struct heap_header);
 
-	while (size >= ZONE_MIN_SIZE) {
+	size_t zone_min_size = ZONE_SIZE(chunksize, 1);
+	size_t zone_max_size = ZONE_SIZE(chunksize, MAX_CHUNK);
+	while (size >= zone_min_size) {
 		max_zone++;
-		size -= size <= ZONE_MAX_SIZE ? size : ZONE_MAX_SIZE;
+		size -= size <= zone_max_size ? size : zone_max_size;
 	}
 
 	return max_zone;
 }
 
-/*
- * util_heap_get_bitmap_params -- return bitmap parameters of given block size
- *
- * The function returns the following values:
- * - number of allocations
- * - number of used values in bitmap
- * - initial value of last used entry
- */
-int
-util_heap_get_bitmap_params(uint64_t block_size, uint64_t *nallocsp,
-		uint64_t *nvalsp, uint64_t *last_valp)
-{
-	assert(RUNSIZE / block_size <= UINT32_MAX);
-	uint32_t nallocs = (uint32_t)(RUNSIZE / block_size);
-
-	assert(nallocs <= RUN_BITMAP_SIZE);
-	unsigned unused_bits = RUN_BITMAP_SIZE - nallocs;
-
-	unsigned unused_values = unused_bits / BITS_PER_VALUE;
-
-	assert(MAX_BITMAP_VALUES >= unused_values);
-	uint64_t nvals = MAX_BITMAP_VALUES - unused_values;
-
-	assert(unused_bits >= unused_values * BITS_PER_VALUE);
-	unused_bits -= unused_values * BITS_PER_VALUE;
-
-	uint64_t last_val = unused_bits ? (((1ULL << unused_bits) - 1ULL) <<
-				(BITS_PER_VALUE - unused_bits)) : 0;
-
-	if (nvals >= MAX_BITMAP_VALUES || nvals == 0)
-		return -1;
-
-	if (nallocsp)
-		*nallocsp = nallocs;
-	if (nvalsp)
-		*nvalsp = nvals;
-	if (last_valp)
-		*last_valp = last_val;
-
-	return 0;
-}
-
 /*
  * pool_set_file_open -- opens pool set file or regular file
  */
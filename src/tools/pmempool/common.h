@@ -231,9 +231,7 @@ char ask(char op, char *answers, char def_ans, const char *fmt, va_list ap);
 char ask_yn(char op, char def_ans, const char *fmt, va_list ap);
 char ask_Yn(char op, const char *fmt, ...) FORMAT_PRINTF(2, 3);
 char ask_yN(char op, const char *fmt, ...) FORMAT_PRINTF(2, 3);
-unsigned util_heap_max_zone(size_t size);
-int util_heap_get_bitmap_params(uint64_t block_size, uint64_t *nallocsp,
-		uint64_t *nvalsp, uint64_t *last_valp);
+unsigned util_heap_max_zone(size_t size, size_t chunksize);
 
 int util_pool_clear_badblocks(const char *path, int create);
 
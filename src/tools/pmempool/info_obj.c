@@ -157,18 +157,19 @@ lane_need_recovery(struct pmem_info *pip, struct lane_layout *lane)
  * get_bitmap_reserved -- get number of reserved blocks in chunk run
  */
 static int
-get_bitmap_reserved(struct chunk_run *run, uint32_t *reserved)
+get_bitmap_reserved(struct chunk_run *run,
+	const struct alloc_class_run_proto *proto, uint32_t *reserved)
 {
-	uint64_t nvals = 0;
-	uint64_t last_val = 0;
-	if (util_heap_get_bitmap_params(run->block_size, NULL, &nvals,
-			&last_val))
+	unsigned nvals = proto->bitmap_nval;
+	if (nvals == 0)
 		return -1;
 
+	uint64_t *bitmap = RUN_BITMAP(run);
+
 	uint32_t ret = 0;
-	for (uint64_t i = 0; i < nvals - 1; i++)
-		ret += util_popcount64(run->bitmap[i]);
-	ret += util_popcount64(run->bitmap[nvals - 1] & ~last_val);
+	for (unsigned i = 0; i < nvals - 1; i++)
+		ret += util_popcount64(bitmap[i]);
+	ret += util_popcount64(bitmap[nvals - 1] & ~proto->bitmap_lastval);
 
 	*reserved = ret;
 
@@ -515,6 +516,7 @@ info_obj_heap(struct pmem_info *pip)
 	outv_field(v, "Chunk size", "%s",
 			out_get_size_str(heap->chunksize, pip->args.human));
 	outv_field(v, "Chunks per zone", "%ld", heap->chunks_per_zone);
+	outv_field(v, "Run bitmap values", "%u", HEAP_RUN_BITMAP_NVAL(layout));
 	outv_field(v, "Checksum", "%s", out_get_checksum(heap, sizeof(*heap),
 			&heap->checksum, 0));
 }
@@ -568,25 +570,28 @@ info_obj_object(struct pmem_info *pip, const struct memory_block *m,
  * info_obj_run_bitmap -- print chunk run's bitmap
  */
 static void
-info_obj_run_bitmap(int v, struct chunk_run *run, uint32_t bsize)
+info_obj_run_bitmap(int v, struct chunk_run *run, uint32_t bsize,
+	unsigned nval)
 {
+	uint64_t *bitmap = RUN_BITMAP(run);
+
 	if (outv_check(v) && outv_check(VERBOSE_MAX)) {
 		/* print all values from bitmap for higher verbosity */
-		for (int i = 0; i < MAX_BITMAP_VALUES; i++) {
+		for (unsigned i = 0; i < nval; i++) {
 			outv(VERBOSE_MAX, "%s\n",
-					get_bitmap_str(run->bitmap[i],
+					get_bitmap_str(bitmap[i],
 						BITS_PER_VALUE));
 		}
 	} else {
 		/* print only used values for lower verbosity */
 		uint32_t i;
 		for (i = 0; i < bsize / BITS_PER_VALUE; i++)
-			outv(v, "%s\n", get_bitmap_str(run->bitmap[i],
+			outv(v, "%s\n", get_bitmap_str(bitmap[i],
 						BITS_PER_VALUE));
 
 		unsigned mod = bsize % BITS_PER_VALUE;
 		if (mod != 0) {
-			outv(v, "%s\n", get_bitmap_str(run->bitmap[i], mod));
+			outv(v, "%s\n", get_bitmap_str(bitmap[i], mod));
 		}
 	}
 }
@@ -666,9 +671,12 @@ info_obj_chunk(struct pmem_info *pip, uint64_t c, uint64_t z,
 		}
 	} else if (chunk_hdr->type == CHUNK_TYPE_RUN) {
 		struct chunk_run *run = (struct chunk_run *)chunk;
+		struct heap_layout *layout = OFF_TO_PTR(pop, pop->heap_offset);
+		unsigned nval = HEAP_RUN_BITMAP_NVAL(layout);
 
 		outv_hexdump(v && pip->args.vhdrdump, run,
-				sizeof(run->block_size) + sizeof(run->bitmap),
+				sizeof(run->block_size) +
+				nval * sizeof(uint64_t),
 				PTR_TO_OFF(pop, run), 1);
 
 		struct alloc_class *aclass = alloc_class_by_run(
@@ -679,9 +687,14 @@ info_obj_chunk(struct pmem_info *pip, uint64_t c, uint64_t z,
 					out_get_size_str(run->block_size,
 						pip->args.human));
 
-			uint32_t units = aclass->run.bitmap_nallocs;
+			struct alloc_class_run_proto proto;
+			alloc_class_generate_run_proto(pip->obj.alloc_classes,
+				&proto, run->block_size, m.size_idx,
+				run->alignment, chunk_hdr->flags);
+
+			uint32_t units = proto.bitmap_nallocs;
 			uint32_t used = 0;
-			if (get_bitmap_reserved(run,  &used)) {
+			if (get_bitmap_reserved(run, &proto, &used)) {
 				outv_field(v, "Bitmap", "[error]");
 			} else {
 				stats->class_stats[aclass->id].n_units += units;
@@ -691,7 +704,7 @@ info_obj_chunk(struct pmem_info *pip, uint64_t c, uint64_t z,
 			}
 
 			info_obj_run_bitmap(v && pip->args.obj.vbitmap,
-				run, units);
+				run, units, nval);
 
 			heap_run_foreach_object(pip->obj.heap, info_obj_run_cb,
 				pip, &m);
@@ -710,6 +723,9 @@ static void
 info_obj_zone_chunks(struct pmem_info *pip, struct zone *zone, uint64_t z,
 	struct pmem_obj_zone_stats *stats)
 {
+	struct pmemobjpool *pop = pip->obj.pop;
+	struct heap_layout *layout = OFF_TO_PTR(pop, pop->heap_offset);
+
 	uint64_t c = 0;
 	while (c < zone->header.size_idx) {
 		enum chunk_type type = zone->chunk_headers[c].type;
@@ -724,7 +740,8 @@ info_obj_zone_chunks(struct pmem_info *pip, struct zone *zone, uint64_t z,
 
 				info_obj_chunk(pip, c, z,
 					&zone->chunk_headers[c],
-					&zone->chunks[c], stats);
+					GET_CHUNK(layout, z, (unsigned)c),
+					stats);
 
 			}
 
@@ -734,7 +751,8 @@ info_obj_zone_chunks(struct pmem_info *pip, struct zone *zone, uint64_t z,
 				size_t f = c + size_idx - 1;
 				info_obj_chunk(pip, f, z,
 					&zone->chunk_headers[f],
-					&zone->chunks[f], stats);
+					GET_CHUNK(layout, z, (unsigned)f),
+					stats);
 			}
 		}
 
@@ -782,7 +800,8 @@ info_obj_zones_chunks(struct pmem_info *pip)
 
 	struct pmemobjpool *pop = pip->obj.pop;
 	struct heap_layout *layout = OFF_TO_PTR(pop, pop->heap_offset);
-	size_t maxzone = util_heap_max_zone(pop->heap_size);
+	size_t maxzone = util_heap_max_zone(pop->heap_size,
+			HEAP_CHUNKSIZE(layout));
 	pip->obj.stats.n_zones = maxzone;
 	pip->obj.stats.zone_stats = calloc(maxzone,
 			sizeof(struct pmem_obj_zone_stats));
@@ -1138,7 +1157,9 @@ pmempool_info_obj(struct pmem_info *pip)
 
 	heap->layout = OFF_TO_PTR(pip->obj.pop, pip->obj.pop->heap_offset);
 	heap->base = pip->obj.pop;
-	pip->obj.alloc_classes = alloc_class_collection_new();
+	pip->obj.alloc_classes = alloc_class_collection_new(
+		HEAP_CHUNKSIZE(heap->layout),
+		HEAP_RUN_BITMAP_NVAL(heap->layout));
 	pip->obj.heap = heap;
 
 	Pip = pip;
@@ -884,6 +884,19 @@ out_get_incompat_features_str(uint32_t incompat)
 			incompat &= (uint32_t)(~(POOL_FEAT_SINGLEHDR));
 		}
 
+		/* print the name of HEAP_GEOMETRY option */
+		if (incompat & POOL_FEAT_HEAP_GEOMETRY) {
+			ret = snprintf(str_buff + curr,
+				(size_t)(STR_MAX - curr), "%s%s",
+				count ? ", " : "", "HEAP_GEOMETRY");
+			if (ret < 0 || curr + ret >= STR_MAX)
+				return "";
+			curr += ret;
+			++count;
+			/* take off the flag */
+			incompat &= (uint32_t)(~(POOL_FEAT_HEAP_GEOMETRY));
+		}
+
 		/* handle other flags here */
 
 		/* check if any unknown flags are set */